@@ -177,6 +177,7 @@ struct IReplayRenderer
   virtual bool GetD3D11PipelineState(D3D11PipelineState *state) = 0;
   virtual bool GetGLPipelineState(GLPipelineState *state) = 0;
   virtual bool GetVulkanPipelineState(VulkanPipelineState *state) = 0;
+  virtual bool GetPipelineStateChanges(uint32_t *changes) = 0;
 
   virtual ResourceId BuildCustomShader(const char *entry, const char *source,
                                        const uint32_t compileFlags, ShaderStageType type,
@@ -211,6 +212,10 @@ struct IReplayRenderer
   virtual bool DebugThread(uint32_t groupid[3], uint32_t threadid[3], ShaderDebugTrace *trace) = 0;
 
   virtual bool GetUsage(ResourceId id, rdctype::array<EventUsage> *usage) = 0;
+  virtual bool GetUsageInRange(ResourceId id, uint32_t startEID, uint32_t endEID,
+                               rdctype::array<EventUsage> *usage) = 0;
+  virtual bool GetResourcesUsedInRange(uint32_t startEID, uint32_t endEID, bool writesOnly,
+                                       rdctype::array<ResourceId> *resources) = 0;
 
   virtual bool GetCBufferVariableContents(ResourceId shader, const char *entryPoint,
                                           uint32_t cbufslot, ResourceId buffer, uint64_t offs,
@@ -218,8 +223,15 @@ struct IReplayRenderer
 
   virtual bool SaveTexture(const TextureSave &saveData, const char *path) = 0;
 
+  // the buffers in the returned data stay valid until the frame event changes. Calling this again
+  // after that returns the current buffers, which may differ if the data had to be re-fetched
   virtual bool GetPostVSData(uint32_t instID, MeshDataStage stage, MeshFormat *data) = 0;
 
+  // fetches post-transform data for every draw in [startEID, endEID] ahead of time, a whole pass
+  // at a time. Older data may be evicted to stay within the replay's memory budget, but never the
+  // current draw's or its pass's, so buffers already returned by GetPostVSData remain valid
+  virtual bool PrefetchPostVSData(uint32_t startEID, uint32_t endEID) = 0;
+
   virtual bool GetMinMax(ResourceId tex, uint32_t sliceFace, uint32_t mip, uint32_t sample,
                          PixelValue *minval, PixelValue *maxval) = 0;
   virtual bool GetHistogram(ResourceId tex, uint32_t sliceFace, uint32_t mip, uint32_t sample,
@@ -274,6 +286,8 @@ extern "C" RENDERDOC_API bool32 RENDERDOC_CC ReplayRenderer_GetGLPipelineState(R
                                                                                GLPipelineState *state);
 extern "C" RENDERDOC_API bool32 RENDERDOC_CC
 ReplayRenderer_GetVulkanPipelineState(ReplayRenderer *rend, VulkanPipelineState *state);
+extern "C" RENDERDOC_API bool32 RENDERDOC_CC
+ReplayRenderer_GetPipelineStateChanges(ReplayRenderer *rend, uint32_t *changes);
 
 extern "C" RENDERDOC_API void RENDERDOC_CC ReplayRenderer_BuildCustomShader(
     ReplayRenderer *rend, const char *entry, const char *source, const uint32_t compileFlags,
@@ -332,6 +346,12 @@ extern "C" RENDERDOC_API bool32 RENDERDOC_CC ReplayRenderer_DebugThread(ReplayRe
 
 extern "C" RENDERDOC_API bool32 RENDERDOC_CC
 ReplayRenderer_GetUsage(ReplayRenderer *rend, ResourceId id, rdctype::array<EventUsage> *usage);
+extern "C" RENDERDOC_API bool32 RENDERDOC_CC
+ReplayRenderer_GetUsageInRange(ReplayRenderer *rend, ResourceId id, uint32_t startEID,
+                               uint32_t endEID, rdctype::array<EventUsage> *usage);
+extern "C" RENDERDOC_API bool32 RENDERDOC_CC
+ReplayRenderer_GetResourcesUsedInRange(ReplayRenderer *rend, uint32_t startEID, uint32_t endEID,
+                                       bool32 writesOnly, rdctype::array<ResourceId> *resources);
 
 extern "C" RENDERDOC_API bool32 RENDERDOC_CC ReplayRenderer_GetCBufferVariableContents(
     ReplayRenderer *rend, ResourceId shader, const char *entryPoint, uint32_t cbufslot,
@@ -345,6 +365,8 @@ extern "C" RENDERDOC_API bool32 RENDERDOC_CC ReplayRenderer_GetPostVSData(Replay
                                                                           uint32_t instID,
                                                                           MeshDataStage stage,
                                                                           MeshFormat *data);
+extern "C" RENDERDOC_API bool32 RENDERDOC_CC
+ReplayRenderer_PrefetchPostVSData(ReplayRenderer *rend, uint32_t startEID, uint32_t endEID);
 
 extern "C" RENDERDOC_API bool32 RENDERDOC_CC
 ReplayRenderer_GetMinMax(ReplayRenderer *rend, ResourceId tex, uint32_t sliceFace, uint32_t mip,
@@ -534,6 +556,10 @@ extern "C" RENDERDOC_API uint32_t RENDERDOC_CC RENDERDOC_InjectIntoProcess(
 extern "C" RENDERDOC_API void RENDERDOC_CC RENDERDOC_TriggerExceptionHandler(void *exceptionPtrs,
                                                                              bool32 crashed);
 extern "C" RENDERDOC_API void RENDERDOC_CC RENDERDOC_LogText(const char *text);
+// profiles this process, and any launched afterwards, into a Chrome trace written at the end of
+// each capture and replay session. Must be called before launching any programs.
+extern "C" RENDERDOC_API void RENDERDOC_CC RENDERDOC_StartProfiling(const char *tracefile);
+extern "C" RENDERDOC_API void RENDERDOC_CC RENDERDOC_WriteProfileTrace();
 extern "C" RENDERDOC_API bool32 RENDERDOC_CC RENDERDOC_GetThumbnail(const char *filename, byte *buf,
                                                                     uint32_t &len);
 extern "C" RENDERDOC_API const char *RENDERDOC_CC RENDERDOC_GetVersionString();
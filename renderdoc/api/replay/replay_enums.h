@@ -305,6 +305,20 @@ enum ShaderStageType
   eShaderStage_Count,
 };
 
+// sections of the pipeline state that can change independently between two events. Only the
+// Vulkan pipeline state is tracked per-section, other APIs always report every section
+enum PipelineStateChanges
+{
+  ePipeChange_None = 0x0,
+  ePipeChange_Compute = 0x1,
+  ePipeChange_Graphics = 0x2,
+  ePipeChange_DynamicState = 0x4,
+  ePipeChange_Pass = 0x8,
+  ePipeChange_Descriptors = 0x10,
+  ePipeChange_ImageLayouts = 0x20,
+  ePipeChange_All = 0x3f,
+};
+
 enum ShaderStageBits
 {
   eStageBits_Vertex = 1 << eShaderStage_Vertex,
@@ -464,6 +478,7 @@ enum GPUCounters
   eCounter_PSInvocations,
   eCounter_RasterizedPrimitives,
   eCounter_SamplesWritten,
+  eCounter_EventCPUDuration,
 
   // IHV specific counters can be set above this point
   // with ranges reserved for each IHV
@@ -494,6 +509,7 @@ enum ReplayCreateStatus
   eReplayCreate_APIInitFailed,
   eReplayCreate_APIIncompatibleVersion,
   eReplayCreate_APIHardwareUnsupported,
+  eReplayCreate_NetworkRemoteBusy,
 };
 
 enum RemoteMessageType
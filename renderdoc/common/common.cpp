@@ -258,28 +258,104 @@ static string &logfile()
   return fn;
 }
 
-const char *rdclog_getfilename()
+// Log output is formatted on the calling thread and pushed into a fixed-size ring of slots that
+// any number of threads can write into without taking a lock. A single background thread drains
+// the ring in order and writes it out to the log file, which it keeps open. Until the writer is
+// started (and after it's stopped) lines are written synchronously, as they were originally.
+//
+// Each slot carries a sequence number in the style of a bounded MPMC queue. For slot index idx,
+// position p is free to be written when (seq + idx) == p, readable once (seq + idx) == p + 1, and
+// when it has been read it becomes free for p + LogSlotCount. Storing the sequence relative to
+// the index means the zero-initialised ring starts out with every slot free.
+//
+// The ring belongs to the process that started the writer. A child forked without exec inherits
+// it along with 'running', but not the writer thread, so it writes synchronously instead.
+//
+// Long lines take several consecutive slots, which are claimed with a single CAS on the write
+// position. Only the last claimed slot needs checking for free-ness since slots are released in
+// order.
+static const uint32_t LogSlotCount = 4096;
+static const uint32_t LogSlotSize = 256;
+
+struct LogSlot
 {
-  return logfile().c_str();
-}
+  volatile int32_t seq;
+  // only valid in the first slot of a line
+  uint32_t numSlots;
+  uint32_t length;
+  char data[LogSlotSize - sizeof(int32_t) - sizeof(uint32_t) * 2];
+};
 
-void rdclog_filename(const char *filename)
+static const uint32_t LogSlotPayload = sizeof(((LogSlot *)NULL)->data);
+
+struct LogWriterState
 {
-  logfile() = "";
-  if(filename && filename[0])
-    logfile() = filename;
-}
+  LogSlot ring[LogSlotCount];
+
+  volatile int32_t writePos;
+  // only touched with consumeLock held
+  uint32_t readPos;
+
+  // set by the writer when it's about to wait, so producers know they have to wake it
+  volatile int32_t writerSleeping;
+  volatile int32_t running;
+  // bumped each time the writer is stopped, so a writer that couldn't be joined still exits
+  // rather than running alongside one started later
+  volatile int32_t generation;
+  uint32_t ownerPID;
+
+  Threading::CriticalSection consumeLock;
+  // non-zero while consumeLock is held. The lock is recursive, so this is how a flush from a
+  // crash handler tells that it interrupted its own thread in the middle of a drain
+  volatile int32_t consuming;
+  Threading::Semaphore wake;
+  Threading::ThreadHandle thread;
+
+  // file kept open by the writer. Only touched with consumeLock held
+  FILE *file;
+  string batch;
+};
 
-void rdclog_flush()
+static LogWriterState &logstate()
 {
+  static LogWriterState state;
+  return state;
 }
 
-void rdclogprint_int(const char *str)
+// locks consumeLock for the scope and marks it as held
+struct LogConsumeScope
+{
+  LogConsumeScope(LogWriterState &state) : st(state)
+  {
+    st.consumeLock.Lock();
+    Atomic::Inc32(&st.consuming);
+  }
+  ~LogConsumeScope()
+  {
+    Atomic::Dec32(&st.consuming);
+    st.consumeLock.Unlock();
+  }
+
+private:
+  LogConsumeScope &operator=(const LogConsumeScope &other);
+  LogWriterState &st;
+};
+
+// full-barrier read, so that slot contents are only read after we've seen the sequence published
+static int32_t LoadSeq(volatile int32_t *seq)
 {
-  static Threading::CriticalSection lock;
+  return Atomic::CmpExch32(seq, 0, 0);
+}
 
-  SCOPED_LOCK(lock);
+// true if lines should be queued for the writer thread. After a fork() the child sees running
+// set but has no writer, and a lock held at the time of the fork would never be released
+static bool LogWriterOwned(LogWriterState &st)
+{
+  return st.running && st.ownerPID == Process::GetCurrentPID();
+}
 
+static void WriteLogOutputs(const char *str, size_t len, FILE *f)
+{
 #if defined(OUTPUT_LOG_TO_DEBUG_OUT)
   OSUtility::WriteOutput(OSUtility::Output_DebugMon, str);
 #endif
@@ -290,21 +366,332 @@ void rdclogprint_int(const char *str)
   OSUtility::WriteOutput(OSUtility::Output_StdErr, str);
 #endif
 #if defined(OUTPUT_LOG_TO_DISK)
-  if(!logfile().empty())
+  if(f)
   {
-    FILE *f = FileIO::fopen(logfile().c_str(), "a");
-    if(f)
+    // len is the byte length - str is UTF-8 so this is NOT number of characters
+    FileIO::fwrite(str, 1, len, f);
+  }
+#endif
+}
+
+// must be called with consumeLock held. Copies every complete line out of the ring, releasing
+// the slots, then writes them out in one go.
+static void DrainLogRing(LogWriterState &st)
+{
+  st.batch.clear();
+
+  for(;;)
+  {
+    uint32_t pos = st.readPos;
+    uint32_t idx = pos % LogSlotCount;
+    LogSlot &first = st.ring[idx];
+
+    // the first slot of a line is published last, so if it's readable the whole line is
+    if(uint32_t(LoadSeq(&first.seq)) + idx != pos + 1)
+      break;
+
+    uint32_t numSlots = first.numSlots;
+    uint32_t remaining = first.length;
+
+    for(uint32_t i = 0; i < numSlots; i++)
     {
-      // strlen used as byte length - str is UTF-8 so this is NOT number of characters
-      FileIO::fwrite(str, 1, strlen(str), f);
-      FileIO::fclose(f);
+      uint32_t p = pos + i;
+      uint32_t slotIdx = p % LogSlotCount;
+      LogSlot &slot = st.ring[slotIdx];
+
+      uint32_t len = RDCMIN(remaining, LogSlotPayload);
+      st.batch.append(slot.data, len);
+      remaining -= len;
+
+      Atomic::CmpExch32(&slot.seq, int32_t(p + 1 - slotIdx), int32_t(p + LogSlotCount - slotIdx));
     }
+
+    st.readPos = pos + numSlots;
+  }
+
+  if(st.batch.empty())
+    return;
+
+  FILE *f = st.file;
+  bool closeFile = false;
+
+#if defined(OUTPUT_LOG_TO_DISK)
+  if(f == NULL && !logfile().empty())
+  {
+    f = FileIO::fopen(logfile().c_str(), "a");
+
+    // only the running writer keeps the file open
+    if(st.running)
+      st.file = f;
+    else
+      closeFile = true;
   }
 #endif
+
+  WriteLogOutputs(st.batch.c_str(), st.batch.size(), f);
+
+  if(closeFile)
+    FileIO::fclose(f);
+  else if(f)
+    fflush(f);
+}
+
+// returns false if the line couldn't be queued and must be written synchronously
+static bool EnqueueLogLine(LogWriterState &st, const char *str, uint32_t length)
+{
+  uint32_t numSlots = RDCMAX(1U, (length + LogSlotPayload - 1) / LogSlotPayload);
+
+  // absurdly long lines aren't worth starving everyone else of slots for
+  if(numSlots > LogSlotCount / 8)
+    return false;
+
+  uint32_t pos = 0;
+
+  for(;;)
+  {
+    pos = uint32_t(st.writePos);
+
+    uint32_t last = pos + numSlots - 1;
+    uint32_t lastIdx = last % LogSlotCount;
+    int32_t diff = int32_t(uint32_t(LoadSeq(&st.ring[lastIdx].seq)) + lastIdx - last);
+
+    if(diff == 0)
+    {
+      if(uint32_t(Atomic::CmpExch32(&st.writePos, int32_t(pos), int32_t(pos + numSlots))) == pos)
+        break;
+    }
+    else if(diff < 0)
+    {
+      // ring is full. Make sure the writer is awake and let it catch up
+      if(!st.running)
+        return false;
+
+      st.wake.Wake(1);
+      Threading::Sleep(0);
+    }
+
+    // otherwise another thread claimed this position first, try again
+  }
+
+  uint32_t remaining = length;
+  const char *src = str;
+
+  for(uint32_t i = 0; i < numSlots; i++)
+  {
+    LogSlot &slot = st.ring[(pos + i) % LogSlotCount];
+
+    uint32_t len = RDCMIN(remaining, LogSlotPayload);
+    memcpy(slot.data, src, len);
+    src += len;
+    remaining -= len;
+  }
+
+  st.ring[pos % LogSlotCount].numSlots = numSlots;
+  st.ring[pos % LogSlotCount].length = length;
+
+  // publish in reverse so that the first slot becoming readable means the whole line is
+  for(uint32_t i = numSlots; i > 0; i--)
+  {
+    uint32_t p = pos + i - 1;
+    uint32_t idx = p % LogSlotCount;
+    Atomic::CmpExch32(&st.ring[idx].seq, int32_t(p - idx), int32_t(p + 1 - idx));
+  }
+
+  if(LoadSeq(&st.writerSleeping) && Atomic::CmpExch32(&st.writerSleeping, 1, 0) == 1)
+    st.wake.Wake(1);
+
+  return true;
+}
+
+static void LogWriterThread(void *param)
+{
+  Threading::KeepModuleAlive();
+
+  LogWriterState &st = logstate();
+
+  int32_t generation = int32_t((intptr_t)param);
+
+  while(LoadSeq(&st.generation) == generation)
+  {
+    {
+      LogConsumeScope consume(st);
+      DrainLogRing(st);
+    }
+
+    Atomic::CmpExch32(&st.writerSleeping, 0, 1);
+
+    // check again now that producers can see we're going to sleep, to close the window
+    // between the drain and setting the flag. The timeout is only a backstop.
+    uint32_t pos = st.readPos;
+    uint32_t idx = pos % LogSlotCount;
+    if(uint32_t(LoadSeq(&st.ring[idx].seq)) + idx != pos + 1)
+      st.wake.WaitForWake(100);
+
+    Atomic::CmpExch32(&st.writerSleeping, 1, 0);
+  }
+
+  Threading::ReleaseModuleExitThread();
+}
+
+const char *rdclog_getfilename()
+{
+  return logfile().c_str();
+}
+
+void rdclog_filename(const char *filename)
+{
+  LogWriterState &st = logstate();
+
+  LogConsumeScope consume(st);
+
+  // anything logged so far belongs to the old file
+  DrainLogRing(st);
+
+  if(st.file)
+    FileIO::fclose(st.file);
+  st.file = NULL;
+
+  logfile() = "";
+  if(filename && filename[0])
+    logfile() = filename;
+}
+
+void rdclog_async(bool enable, bool canJoin)
+{
+  LogWriterState &st = logstate();
+
+  if(enable)
+  {
+    LogConsumeScope consume(st);
+
+    if(LogWriterOwned(st))
+      return;
+
+    st.ownerPID = Process::GetCurrentPID();
+    st.running = 1;
+    intptr_t generation = LoadSeq(&st.generation);
+    st.thread = Threading::CreateThread(LogWriterThread, (void *)generation);
+
+    if(st.thread == 0)
+      st.running = 0;
+  }
+  else
+  {
+    {
+      LogConsumeScope consume(st);
+
+      if(!LogWriterOwned(st))
+        return;
+
+      // write out everything pending here rather than waiting on the thread - we might be
+      // called during module unload where we can't join threads.
+      DrainLogRing(st);
+
+      st.running = 0;
+
+      if(st.file)
+        FileIO::fclose(st.file);
+      st.file = NULL;
+    }
+
+    Atomic::Inc32(&st.generation);
+    st.wake.Wake(1);
+
+    if(canJoin)
+      Threading::JoinThread(st.thread);
+    Threading::CloseThread(st.thread);
+    st.thread = 0;
+  }
+}
+
+void rdclog_flush()
+{
+  LogWriterState &st = logstate();
+
+  // a forked child must not take the lock or drain the ring it inherited from its parent
+  if(st.ownerPID != Process::GetCurrentPID())
+    return;
+
+  LogConsumeScope consume(st);
+  DrainLogRing(st);
+}
+
+void rdclog_tryflush()
+{
+  LogWriterState &st = logstate();
+
+  if(st.ownerPID != Process::GetCurrentPID())
+    return;
+
+  // another thread holding the lock might be the one that crashed, so don't wait on it
+  if(!st.consumeLock.Trylock())
+    return;
+
+  // if the lock was already held it's by this thread, and we'd be re-entering its drain
+  if(LoadSeq(&st.consuming) == 0)
+  {
+    Atomic::Inc32(&st.consuming);
+    DrainLogRing(st);
+    Atomic::Dec32(&st.consuming);
+  }
+
+  st.consumeLock.Unlock();
+}
+
+void rdclogprint_int(const char *str)
+{
+  LogWriterState &st = logstate();
+
+  // strlen used as byte length - str is UTF-8 so this is NOT number of characters
+  size_t len = strlen(str);
+
+  if(st.running && st.ownerPID != Process::GetCurrentPID())
+  {
+    // forked child - don't touch the parent's ring, open file or locks
+    static Threading::CriticalSection forkedLock;
+    SCOPED_LOCK(forkedLock);
+
+    FILE *f = NULL;
+#if defined(OUTPUT_LOG_TO_DISK)
+    if(!logfile().empty())
+      f = FileIO::fopen(logfile().c_str(), "a");
+#endif
+
+    WriteLogOutputs(str, len, f);
+
+    if(f)
+      FileIO::fclose(f);
+    return;
+  }
+
+  if(st.running && len < 0x7fffffff && EnqueueLogLine(st, str, uint32_t(len)))
+    return;
+
+  LogConsumeScope consume(st);
+
+  // preserve ordering with anything already queued
+  DrainLogRing(st);
+
+  if(st.file)
+  {
+    WriteLogOutputs(str, len, st.file);
+    fflush(st.file);
+    return;
+  }
+
+  FILE *f = NULL;
+#if defined(OUTPUT_LOG_TO_DISK)
+  if(!logfile().empty())
+    f = FileIO::fopen(logfile().c_str(), "a");
+#endif
+
+  WriteLogOutputs(str, len, f);
+
+  if(f)
+    FileIO::fclose(f);
 }
 
 const size_t rdclog_outBufSize = 4 * 1024;
-static char rdclog_outputBuffer[rdclog_outBufSize + 1];
 
 void rdclog_int(LogType type, const char *file, unsigned int line, const char *fmt, ...)
 {
@@ -335,13 +722,11 @@ void rdclog_int(LogType type, const char *file, unsigned int line, const char *f
       "Debug  ", "Log    ", "Warning", "Error  ", "Fatal  ",
   };
 
-  static Threading::CriticalSection lock;
-
-  SCOPED_LOCK(lock);
-
-  rdclog_outputBuffer[rdclog_outBufSize] = rdclog_outputBuffer[0] = 0;
+  // formatted on the stack so concurrent loggers don't contend on a shared buffer
+  char outputBuffer[rdclog_outBufSize + 1];
+  outputBuffer[rdclog_outBufSize] = outputBuffer[0] = 0;
 
-  char *output = rdclog_outputBuffer;
+  char *output = outputBuffer;
   size_t available = rdclog_outBufSize;
 
   int numWritten = StringFormat::snprintf(output, available, "%s %s%s%s - ", name, timestamp,
@@ -372,5 +757,5 @@ void rdclog_int(LogType type, const char *file, unsigned int line, const char *f
   *output = '\n';
   *(output + 1) = 0;
 
-  rdclogprint_int(rdclog_outputBuffer);
+  rdclogprint_int(outputBuffer);
 }
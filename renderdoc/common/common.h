@@ -212,6 +212,10 @@ enum LogType
   do                   \
   {                    \
   } while((void)0, 0)
+#define RDCLOGASYNC(...) \
+  do                     \
+  {                      \
+  } while((void)0, 0)
 
 #define RDCDEBUG(...) \
   do                  \
@@ -242,8 +246,12 @@ enum LogType
     exit(0);                \
   } while((void)0, 0)
 #else
-// perform any operations necessary to flush the log
+// perform any operations necessary to flush the log. Writes out everything queued for the
+// background log writer on the calling thread, so it's safe to call just before crashing
 void rdclog_flush();
+// as above, but gives up rather than waiting if the log is being written out elsewhere, or
+// if the calling thread was interrupted while writing it. For use from crash handlers
+void rdclog_tryflush();
 
 // actual low-level print to log output streams defined (useful for if we need to print
 // fatal error messages from within the more complex log function).
@@ -257,8 +265,15 @@ void rdclog_int(LogType type, const char *file, unsigned int line, const char *f
 const char *rdclog_getfilename();
 void rdclog_filename(const char *filename);
 
+// starts or stops the background log writer. While it's running, log lines are queued without
+// locking and written out (and the log file kept open) on a separate thread. Stopping it writes
+// out anything pending and closes the file, and waits for the thread to exit unless canJoin is
+// false (e.g. during module unload).
+void rdclog_async(bool enable, bool canJoin = true);
+
 #define RDCLOGFILE(fn) rdclog_filename(fn)
 #define RDCGETLOGFILE() rdclog_getfilename()
+#define RDCLOGASYNC(...) rdclog_async(__VA_ARGS__)
 
 #if(!defined(RELEASE) || defined(FORCE_DEBUG_LOGS)) && !defined(STRIP_DEBUG_LOGS)
 #define RDCDEBUG(...) rdclog(RDCLog_Debug, __VA_ARGS__)
@@ -32,6 +32,11 @@
 #define RDC64BIT 1
 #endif
 
+// SSE2 is always available on x64, and on x86 if the compiler is targetting it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RDC_SSE2 1
+#endif
+
 /////////////////////////////////////////////////
 // Global constants
 enum
@@ -0,0 +1,307 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "profiler.h"
+#include <string.h>
+#include "common/threading.h"
+#include "serialise/string_utils.h"
+
+// number of scopes kept per thread before the oldest are overwritten
+static const int64_t ProfileRingSize = 16384;
+
+static const char *CounterNames[Profile_NumCounters] = {
+    "bytes serialised",    "chunks created",       "gpu waits",
+    "chunk bytes spilled", "chunk bytes paged in", "bytes read back",
+};
+
+struct ProfileEvent
+{
+  const char *name;
+  uint64_t start;
+  uint64_t end;
+  uint32_t depth;
+  // counter change over the scope, and this thread's running totals when it ended
+  uint64_t deltas[Profile_NumCounters];
+  uint64_t totals[Profile_NumCounters];
+};
+
+namespace Profiler
+{
+struct ThreadData
+{
+  uint32_t index;
+  uint64_t osID;
+  uint32_t depth;
+  uint64_t counters[Profile_NumCounters];
+
+  // total number of events ever recorded. Only written by the owning thread, and never reset -
+  // other threads read it to take consistent snapshots of the ring while it's being written
+  volatile int64_t written;
+  // events before this index were discarded by Clear(). Only touched with the lock held
+  int64_t cleared;
+  ProfileEvent events[ProfileRingSize];
+};
+
+volatile int32_t enabled = 0;
+
+static uint64_t tlsSlot = 0;
+static uint64_t baseTick = 0;
+
+static Threading::CriticalSection &lock()
+{
+  static Threading::CriticalSection cs;
+  return cs;
+}
+
+// thread data is never freed, as we can't know when a thread we don't own has gone away and
+// events may still be exported after it has.
+static vector<ThreadData *> &threads()
+{
+  static vector<ThreadData *> t;
+  return t;
+}
+
+void Enable(bool enable)
+{
+  SCOPED_LOCK(lock());
+
+  if(enable && tlsSlot == 0)
+    tlsSlot = Threading::AllocateTLSSlot();
+
+  if(enable && !enabled)
+    baseTick = Timing::GetTick();
+
+  enabled = enable ? 1 : 0;
+}
+
+// full-barrier read of another thread's write position
+static int64_t LoadWritten(ThreadData *thread)
+{
+  return Atomic::ExchAdd64(&thread->written, 0);
+}
+
+void Clear()
+{
+  SCOPED_LOCK(lock());
+
+  // the owning threads keep writing, so rather than resetting their rings just remember where
+  // they'd got to. Scopes still open now are dropped when exported, as they began before baseTick
+  baseTick = Timing::GetTick();
+
+  for(size_t i = 0; i < threads().size(); i++)
+    threads()[i]->cleared = LoadWritten(threads()[i]);
+}
+
+// copies out the events in a thread's ring that are valid, while the thread may still be writing
+// more
+static void SnapshotEvents(ThreadData *thread, vector<ProfileEvent> &events)
+{
+  int64_t end = LoadWritten(thread);
+  int64_t begin = RDCMAX(thread->cleared, end - ProfileRingSize + 1);
+
+  events.clear();
+  for(int64_t i = begin; i < end; i++)
+    events.push_back(thread->events[i % ProfileRingSize]);
+
+  // the thread may have wrapped around onto the oldest events while we copied them, anything it
+  // could have touched - including the event it's writing now - is discarded
+  int64_t after = LoadWritten(thread);
+  int64_t valid = RDCMAX(begin, after - ProfileRingSize + 1);
+
+  events.erase(events.begin(), events.begin() + size_t(RDCMIN(valid, end) - begin));
+}
+
+ThreadData *GetThreadData()
+{
+  ThreadData *data = (ThreadData *)Threading::GetTLSValue(tlsSlot);
+
+  if(data == NULL)
+  {
+    data = new ThreadData;
+    memset(data, 0, sizeof(ThreadData));
+
+    data->osID = Threading::GetCurrentID();
+
+    {
+      SCOPED_LOCK(lock());
+      data->index = (uint32_t)threads().size();
+      threads().push_back(data);
+    }
+
+    Threading::SetTLSValue(tlsSlot, data);
+  }
+
+  return data;
+}
+
+void BeginScope(ThreadData *thread, const char *name, uint64_t &startTick,
+                uint64_t startCounters[Profile_NumCounters])
+{
+  thread->depth++;
+
+  memcpy(startCounters, thread->counters, sizeof(thread->counters));
+  startTick = Timing::GetTick();
+}
+
+void EndScope(ThreadData *thread, const char *name, uint64_t startTick,
+              const uint64_t startCounters[Profile_NumCounters])
+{
+  uint64_t endTick = Timing::GetTick();
+
+  thread->depth--;
+
+  int64_t idx = thread->written;
+  ProfileEvent &ev = thread->events[idx % ProfileRingSize];
+
+  ev.name = name;
+  ev.start = startTick;
+  ev.end = endTick;
+  ev.depth = thread->depth;
+
+  for(int c = 0; c < Profile_NumCounters; c++)
+  {
+    ev.deltas[c] = thread->counters[c] - startCounters[c];
+    ev.totals[c] = thread->counters[c];
+  }
+
+  // publish with a full barrier, so anyone who sees the new position sees the event too
+  Atomic::Inc64(&thread->written);
+}
+
+void AddCounterValue(ThreadData *thread, ProfileCounter counter, uint64_t value)
+{
+  thread->counters[counter] += value;
+}
+
+static string EscapeJSON(const char *str)
+{
+  string ret;
+
+  for(; str && *str; str++)
+  {
+    if(*str == '"' || *str == '\\')
+      ret.push_back('\\');
+
+    // control characters can't appear in JSON strings, and shouldn't be in names anyway
+    if(uint8_t(*str) < 0x20)
+      ret.push_back(' ');
+    else
+      ret.push_back(*str);
+  }
+
+  return ret;
+}
+
+bool WriteChromeTrace(const char *filename)
+{
+  FILE *f = FileIO::fopen(filename, "wb");
+
+  if(f == NULL)
+  {
+    RDCERR("Couldn't open profile trace '%s' for writing", filename);
+    return false;
+  }
+
+  SCOPED_LOCK(lock());
+
+  // GetTickFrequency is ticks per millisecond, trace timestamps are in microseconds
+  double usPerTick = 1000.0 / Timing::GetTickFrequency();
+  uint32_t pid = Process::GetCurrentPID();
+
+  string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  bool first = true;
+
+  vector<ProfileEvent> events;
+
+  for(size_t t = 0; t < threads().size(); t++)
+  {
+    ThreadData *thread = threads()[t];
+
+    out += StringFormat::Fmt(
+        "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,"
+        "\"args\":{\"name\":\"Thread %u (%llu)\"}}",
+        first ? "" : ",\n", pid, thread->index, thread->index, thread->osID);
+    first = false;
+
+    // the owning thread may still be writing, so export from a snapshot
+    SnapshotEvents(thread, events);
+
+    for(size_t i = 0; i < events.size(); i++)
+    {
+      const ProfileEvent &ev = events[i];
+
+      // still open when the recording was last cleared
+      if(int64_t(ev.start - baseTick) < 0)
+        continue;
+
+      double ts = double(int64_t(ev.start - baseTick)) * usPerTick;
+      double dur = double(ev.end - ev.start) * usPerTick;
+
+      string args;
+      for(int c = 0; c < Profile_NumCounters; c++)
+      {
+        if(ev.deltas[c] == 0)
+          continue;
+
+        args += StringFormat::Fmt("%s\"%s\":%llu", args.empty() ? "" : ",", CounterNames[c],
+                                  ev.deltas[c]);
+      }
+
+      out += StringFormat::Fmt(
+          ",\n{\"name\":\"%s\",\"cat\":\"renderdoc\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+          "\"pid\":%u,\"tid\":%u,\"args\":{%s}}",
+          EscapeJSON(ev.name).c_str(), ts, dur, pid, thread->index, args.c_str());
+
+      // sample the running counter totals at the end of every outermost scope
+      if(ev.depth == 0)
+      {
+        args.clear();
+        for(int c = 0; c < Profile_NumCounters; c++)
+          args += StringFormat::Fmt("%s\"%s\":%llu", c == 0 ? "" : ",", CounterNames[c],
+                                    ev.totals[c]);
+
+        out += StringFormat::Fmt(
+            ",\n{\"name\":\"Thread %u counters\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%u,"
+            "\"args\":{%s}}",
+            thread->index, ts + dur, pid, args.c_str());
+      }
+
+      if(out.size() > 1024 * 1024)
+      {
+        FileIO::fwrite(out.c_str(), 1, out.size(), f);
+        out.clear();
+      }
+    }
+  }
+
+  out += "\n]}\n";
+
+  FileIO::fwrite(out.c_str(), 1, out.size(), f);
+  FileIO::fclose(f);
+
+  RDCLOG("Wrote profile trace to %s", filename);
+
+  return true;
+}
+};
@@ -0,0 +1,108 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include "os/os_specific.h"
+
+// Lightweight instrumentation. Scopes and counters are recorded per-thread into fixed-size rings
+// only while profiling is enabled - otherwise a scope costs a single flag check. The recorded
+// data can be exported as a Chrome trace (load in chrome://tracing) to see where time goes in
+// capture, load and replay.
+
+enum ProfileCounter
+{
+  Profile_BytesSerialised = 0,
+  Profile_ChunksCreated,
+  Profile_GPUWaits,
+  Profile_ChunkBytesSpilled,
+  Profile_ChunkBytesPagedIn,
+  Profile_ReadbackBytes,
+  Profile_NumCounters,
+};
+
+namespace Profiler
+{
+struct ThreadData;
+
+extern volatile int32_t enabled;
+
+void Enable(bool enable);
+inline bool IsEnabled()
+{
+  return enabled != 0;
+}
+
+// discard everything recorded so far
+void Clear();
+
+// returns this thread's recording data, allocating it on first use
+ThreadData *GetThreadData();
+
+void BeginScope(ThreadData *thread, const char *name, uint64_t &startTick,
+                uint64_t startCounters[Profile_NumCounters]);
+void EndScope(ThreadData *thread, const char *name, uint64_t startTick,
+              const uint64_t startCounters[Profile_NumCounters]);
+
+void AddCounterValue(ThreadData *thread, ProfileCounter counter, uint64_t value);
+
+inline void AddCounter(ProfileCounter counter, uint64_t value)
+{
+  if(IsEnabled())
+    AddCounterValue(GetThreadData(), counter, value);
+}
+
+// writes every thread's recorded scopes out as Chrome trace event JSON
+bool WriteChromeTrace(const char *filename);
+};
+
+class ProfileScope
+{
+public:
+  // name must outlive the profiling session, as only the pointer is stored
+  ProfileScope(const char *name) : m_Thread(NULL), m_Name(name)
+  {
+    if(Profiler::IsEnabled())
+    {
+      m_Thread = Profiler::GetThreadData();
+      Profiler::BeginScope(m_Thread, m_Name, m_Start, m_Counters);
+    }
+  }
+
+  ~ProfileScope()
+  {
+    if(m_Thread)
+      Profiler::EndScope(m_Thread, m_Name, m_Start, m_Counters);
+  }
+
+private:
+  Profiler::ThreadData *m_Thread;
+  const char *m_Name;
+  uint64_t m_Start;
+  uint64_t m_Counters[Profile_NumCounters];
+};
+
+#define RDCPROFILE_SCOPE(name) ProfileScope CONCAT(profilescope, __LINE__)(name);
+#define RDCPROFILE_COUNTER(counter, value) Profiler::AddCounter(counter, value)
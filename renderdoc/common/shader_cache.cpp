@@ -0,0 +1,314 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "shader_cache.h"
+
+static uint32_t BlobChecksum(const byte *data, uint32_t length)
+{
+  // 32-bit FNV-1a, only used to catch torn or damaged records
+  uint32_t hash = 2166136261U;
+
+  for(uint32_t i = 0; i < length; i++)
+  {
+    hash ^= data[i];
+    hash *= 16777619U;
+  }
+
+  return hash;
+}
+
+ShaderCacheFile::ShaderCacheFile(const char *filename, uint32_t magicNumber,
+                                 uint32_t versionNumber)
+{
+  m_Filename = FileIO::GetAppFolderFilename(filename);
+  m_Magic = magicNumber;
+  m_Version = versionNumber;
+
+  m_FileSize = 0;
+  m_WastedBytes = 0;
+  m_TornTail = false;
+
+  m_File = FileIO::fopen(m_Filename.c_str(), "rb");
+
+  if(!m_File)
+    return;
+
+  FileIO::fseek64(m_File, 0, SEEK_END);
+  uint64_t cachelen = FileIO::ftell64(m_File);
+  FileIO::fseek64(m_File, 0, SEEK_SET);
+
+  uint32_t header[2] = {0, 0};
+
+  if(cachelen < sizeof(header) ||
+     FileIO::fread(header, 1, sizeof(header), m_File) != sizeof(header) || header[0] != m_Magic ||
+     header[1] != m_Version)
+  {
+    RDCDEBUG("Out of date or invalid shader cache magic: %x version: %u", header[0], header[1]);
+
+    // the file will be replaced when we next write to it
+    FileIO::fclose(m_File);
+    m_File = NULL;
+    return;
+  }
+
+  m_FileSize = cachelen;
+
+  uint64_t offset = sizeof(header);
+
+  while(offset + sizeof(Record) <= cachelen)
+  {
+    Record rec;
+
+    FileIO::fseek64(m_File, offset, SEEK_SET);
+    if(FileIO::fread(&rec, 1, sizeof(rec), m_File) != sizeof(rec))
+      break;
+
+    // a record that runs off the end of the file was only partially written
+    if(rec.length == 0 || rec.length > cachelen - offset - sizeof(rec))
+      break;
+
+    if(m_Index.find(rec.hash) == m_Index.end())
+    {
+      Entry &entry = m_Index[rec.hash];
+      entry.offset = offset + sizeof(rec);
+      entry.length = rec.length;
+      entry.checksum = rec.checksum;
+      entry.used = false;
+    }
+    else
+    {
+      m_WastedBytes += sizeof(rec) + rec.length;
+    }
+
+    offset += sizeof(rec) + rec.length;
+  }
+
+  // anything after the last complete record is garbage
+  m_WastedBytes += cachelen - offset;
+  m_TornTail = (offset < cachelen);
+
+  RDCDEBUG("Indexed %u shaders in shader cache, %llu bytes wasted", (uint32_t)m_Index.size(),
+           m_WastedBytes);
+}
+
+ShaderCacheFile::~ShaderCacheFile()
+{
+  Close();
+}
+
+bool ShaderCacheFile::Read(uint64_t hash, std::vector<byte> &data)
+{
+  auto pending = m_Pending.find(hash);
+
+  if(pending != m_Pending.end())
+  {
+    data = pending->second;
+    return true;
+  }
+
+  auto it = m_Index.find(hash);
+
+  if(it == m_Index.end() || m_File == NULL)
+    return false;
+
+  Entry &entry = it->second;
+
+  data.resize(entry.length);
+
+  FileIO::fseek64(m_File, entry.offset, SEEK_SET);
+
+  if(FileIO::fread(&data[0], 1, entry.length, m_File) != entry.length ||
+     BlobChecksum(&data[0], entry.length) != entry.checksum)
+  {
+    RDCWARN("Damaged shader cache entry %llx, discarding", hash);
+
+    m_WastedBytes += sizeof(Record) + entry.length;
+    m_Index.erase(it);
+    data.clear();
+    return false;
+  }
+
+  entry.used = true;
+
+  return true;
+}
+
+void ShaderCacheFile::Append(uint64_t hash, const byte *data, uint32_t length)
+{
+  if(length == 0)
+    return;
+
+  auto it = m_Index.find(hash);
+
+  // already on disk
+  if(it != m_Index.end())
+  {
+    it->second.used = true;
+    return;
+  }
+
+  m_Pending[hash] = std::vector<byte>(data, data + length);
+}
+
+static void WriteRecord(FILE *f, uint64_t hash, const byte *data, uint32_t length)
+{
+  uint32_t checksum = BlobChecksum(data, length);
+
+  FileIO::fwrite(&hash, 1, sizeof(hash), f);
+  FileIO::fwrite(&length, 1, sizeof(length), f);
+  FileIO::fwrite(&checksum, 1, sizeof(checksum), f);
+  FileIO::fwrite(data, 1, length, f);
+}
+
+void ShaderCacheFile::Close()
+{
+  uint64_t pendingBytes = 0;
+  for(auto it = m_Pending.begin(); it != m_Pending.end(); ++it)
+    pendingBytes += sizeof(Record) + it->second.size();
+
+  uint64_t newSize = m_FileSize + pendingBytes;
+
+  // what a rewrite would get rid of. Once the file is over budget that includes every blob that
+  // wasn't used this time around
+  uint64_t reclaimable = m_WastedBytes;
+  if(newSize > MaxFileSize)
+  {
+    for(auto it = m_Index.begin(); it != m_Index.end(); ++it)
+      if(!it->second.used)
+        reclaimable += sizeof(Record) + it->second.length;
+  }
+
+  // a file that was missing or invalid is written from scratch, as is one ending in a torn record
+  // (appending after it would hide everything appended). Otherwise it's only rewritten when that
+  // frees a good fraction of it, so a cache whose used set is over budget isn't rewritten on
+  // every close.
+  if((m_File == NULL && !m_Pending.empty()) || m_TornTail || reclaimable > newSize / 4)
+  {
+    Compact();
+  }
+  else if(!m_Pending.empty())
+  {
+    FileIO::fclose(m_File);
+    m_File = NULL;
+
+    FILE *f = FileIO::fopen(m_Filename.c_str(), "ab");
+
+    if(f)
+    {
+      for(auto it = m_Pending.begin(); it != m_Pending.end(); ++it)
+        WriteRecord(f, it->first, &it->second[0], (uint32_t)it->second.size());
+
+      FileIO::fclose(f);
+
+      RDCDEBUG("Appended %u shaders to shader cache", (uint32_t)m_Pending.size());
+    }
+    else
+    {
+      RDCERR("Error opening shader cache for append");
+    }
+  }
+
+  if(m_File)
+    FileIO::fclose(m_File);
+
+  m_File = NULL;
+  m_FileSize = 0;
+  m_WastedBytes = 0;
+  m_TornTail = false;
+  m_Index.clear();
+  m_Pending.clear();
+}
+
+void ShaderCacheFile::Compact()
+{
+  // another process could be compacting the same cache at the same time
+  string tmpFilename = StringFormat::Fmt("%s.%u.tmp", m_Filename.c_str(), Process::GetCurrentPID());
+
+  FILE *f = FileIO::fopen(tmpFilename.c_str(), "wb");
+
+  if(!f)
+  {
+    RDCERR("Error opening shader cache for write");
+    return;
+  }
+
+  uint32_t header[2] = {m_Magic, m_Version};
+  FileIO::fwrite(header, 1, sizeof(header), f);
+
+  // if the cache is over budget, only keep what was used this time around
+  uint64_t size = sizeof(header);
+  for(auto it = m_Index.begin(); it != m_Index.end(); ++it)
+    size += sizeof(Record) + it->second.length;
+  for(auto it = m_Pending.begin(); it != m_Pending.end(); ++it)
+    size += sizeof(Record) + it->second.size();
+
+  bool trim = size > MaxFileSize;
+
+  uint32_t numentries = 0;
+
+  std::vector<byte> data;
+
+  for(auto it = m_Index.begin(); it != m_Index.end(); ++it)
+  {
+    if(trim && !it->second.used)
+      continue;
+
+    const Entry &entry = it->second;
+
+    data.resize(entry.length);
+
+    FileIO::fseek64(m_File, entry.offset, SEEK_SET);
+
+    // drop anything that's been damaged since we indexed it
+    if(FileIO::fread(&data[0], 1, entry.length, m_File) != entry.length ||
+       BlobChecksum(&data[0], entry.length) != entry.checksum)
+      continue;
+
+    WriteRecord(f, it->first, &data[0], (uint32_t)data.size());
+    numentries++;
+  }
+
+  for(auto it = m_Pending.begin(); it != m_Pending.end(); ++it)
+  {
+    WriteRecord(f, it->first, &it->second[0], (uint32_t)it->second.size());
+    numentries++;
+  }
+
+  bool success = (FileIO::fclose(f) == 0);
+
+  if(m_File)
+    FileIO::fclose(m_File);
+  m_File = NULL;
+
+  // replace the cache in one step, so it's never seen half-written. If that fails the old file
+  // is left as it was
+  if(!success || !FileIO::Move(tmpFilename.c_str(), m_Filename.c_str(), true))
+  {
+    RDCERR("Error replacing shader cache");
+    FileIO::Delete(tmpFilename.c_str());
+    return;
+  }
+
+  RDCDEBUG("Compacted shader cache to %u shaders", numentries);
+}
@@ -24,151 +24,132 @@
 
 #pragma once
 
+#include <map>
+#include <vector>
 #include "os/os_specific.h"
 
-template <typename ResultType, typename ShaderCallbacks>
-bool LoadShaderCache(const char *filename, const uint32_t magicNumber, const uint32_t versionNumber,
-                     std::map<uint32_t, ResultType> &resultCache, const ShaderCallbacks &callbacks)
+// On-disk store for compiled shader blobs, keyed by a 64-bit hash of everything that went into the
+// compile. The file is a small header followed by a log of records:
+//
+//   uint32_t magic, version
+//   { uint64_t hash; uint32_t length; uint32_t checksum; byte data[length]; } ...
+//
+// Opening only walks the fixed-size record headers to build the index, blobs are read on lookup.
+// New blobs are appended when the file is closed. The file is rewritten (compacted) instead if it
+// ends in a torn record, or if a rewrite would reclaim more than a quarter of it - counting
+// damaged and duplicate records, and once it's past MaxFileSize, blobs that weren't used.
+class ShaderCacheFile
 {
-  string shadercache = FileIO::GetAppFolderFilename(filename);
+public:
+  ShaderCacheFile(const char *filename, uint32_t magicNumber, uint32_t versionNumber);
+  ~ShaderCacheFile();
 
-  FILE *f = FileIO::fopen(shadercache.c_str(), "rb");
+  // reads the blob for hash from disk, returns false if it's not present or is damaged
+  bool Read(uint64_t hash, std::vector<byte> &data);
 
-  if(!f)
-    return false;
+  // queues a new blob to be written when the file is closed
+  void Append(uint64_t hash, const byte *data, uint32_t length);
 
-  FileIO::fseek64(f, 0, SEEK_END);
-  uint64_t cachelen = FileIO::ftell64(f);
-  FileIO::fseek64(f, 0, SEEK_SET);
+  void Close();
 
-  bool ret = true;
+  // once the file passes this size, compacting it only keeps blobs that were used
+  static const uint64_t MaxFileSize = 64 * 1024 * 1024;
 
-  // header: magic number, file version, number of entries
-  if(cachelen < sizeof(uint32_t) * 3)
+private:
+  struct Record
   {
-    RDCERR("Invalid shader cache");
-    ret = false;
-  }
-  else
+    uint64_t hash;
+    uint32_t length;
+    uint32_t checksum;
+  };
+
+  struct Entry
   {
-    byte *cache = new byte[(size_t)cachelen];
-    FileIO::fread(cache, 1, (size_t)cachelen, f);
+    uint64_t offset;
+    uint32_t length;
+    uint32_t checksum;
+    bool used;
+  };
 
-    uint32_t *header = (uint32_t *)cache;
+  void Compact();
 
-    uint32_t fileMagic = header[0];
-    uint32_t fileVer = header[1];
+  std::string m_Filename;
+  uint32_t m_Magic, m_Version;
 
-    if(fileMagic != magicNumber || fileVer != versionNumber)
-    {
-      RDCDEBUG("Out of date or invalid shader cache magic: %d version: %d", fileMagic, fileVer);
-      ret = false;
-    }
-    else
-    {
-      uint32_t numentries = header[2];
-
-      byte *ptr = cache + sizeof(uint32_t) * 3;
-
-      int64_t bufsize = (int64_t)cachelen - sizeof(uint32_t) * 3;
-
-      for(uint32_t i = 0; i < numentries; i++)
-      {
-        if((size_t)bufsize < sizeof(uint32_t))
-        {
-          RDCERR("Invalid shader cache - truncated, not enough data for shader hash");
-          ret = false;
-          break;
-        }
-
-        uint32_t hash = *(uint32_t *)ptr;
-        ptr += sizeof(uint32_t);
-        bufsize -= sizeof(uint32_t);
-
-        if((size_t)bufsize < sizeof(uint32_t))
-        {
-          RDCERR("Invalid shader cache - truncated, not enough data for shader length");
-          ret = false;
-          break;
-        }
-
-        uint32_t len = *(uint32_t *)ptr;
-        ptr += sizeof(uint32_t);
-        bufsize -= sizeof(uint32_t);
-
-        if(bufsize < len)
-        {
-          RDCERR("Invalid shader cache - truncated, not enough data for shader buffer");
-          ret = false;
-          break;
-        }
-
-        byte *data = ptr;
-        ptr += len;
-        bufsize -= len;
-
-        ResultType result;
-        bool created = callbacks.Create(len, data, &result);
-
-        if(!created)
-        {
-          RDCERR("Couldn't create blob of size %u from shadercache", len);
-          ret = false;
-          break;
-        }
-
-        resultCache[hash] = result;
-      }
-
-      if(ret == true && bufsize != 0)
-      {
-        RDCERR("Invalid shader cache - trailing data");
-        ret = false;
-      }
-
-      RDCDEBUG("Successfully loaded %d shaders from shader cache", resultCache.size());
-    }
-
-    delete[] cache;
-  }
+  FILE *m_File;
+  uint64_t m_FileSize;
 
-  FileIO::fclose(f);
+  // bytes in the file that don't belong to a live index entry
+  uint64_t m_WastedBytes;
+  // the file ends in a partial record, which anything appended would be read as part of
+  bool m_TornTail;
 
-  return ret;
-}
+  std::map<uint64_t, Entry> m_Index;
+  std::map<uint64_t, std::vector<byte> > m_Pending;
+};
 
+// an in-memory cache of created shader results, backed by a ShaderCacheFile. Results are created
+// from the file with callbacks.Create the first time they're looked up, and owned by the cache
+// until it's destroyed.
 template <typename ResultType, typename ShaderCallbacks>
-void SaveShaderCache(const char *filename, uint32_t magicNumber, uint32_t versionNumber,
-                     const std::map<uint32_t, ResultType> &cache, const ShaderCallbacks &callbacks)
+class ShaderCache
 {
-  string shadercache = FileIO::GetAppFolderFilename(filename);
-
-  FILE *f = FileIO::fopen(shadercache.c_str(), "wb");
+public:
+  ShaderCache(const char *filename, uint32_t magicNumber, uint32_t versionNumber,
+              const ShaderCallbacks &callbacks)
+      : m_File(filename, magicNumber, versionNumber), m_Callbacks(callbacks)
+  {
+    m_Filename = filename;
+    m_MemoryHits = m_DiskHits = m_Misses = 0;
+  }
 
-  if(!f)
+  ~ShaderCache()
   {
-    RDCERR("Error opening shader cache for write");
-    return;
+    RDCDEBUG("Shader cache %s: %u hits in memory, %u from disk, %u misses", m_Filename.c_str(),
+             m_MemoryHits, m_DiskHits, m_Misses);
+
+    m_File.Close();
+
+    for(auto it = m_Results.begin(); it != m_Results.end(); ++it)
+      m_Callbacks.Destroy(it->second);
   }
 
-  FileIO::fwrite(&magicNumber, 1, sizeof(magicNumber), f);
-  FileIO::fwrite(&versionNumber, 1, sizeof(versionNumber), f);
-  uint32_t numentries = (uint32_t)cache.size();
-  FileIO::fwrite(&numentries, 1, sizeof(numentries), f);
+  bool Find(uint64_t hash, ResultType &result)
+  {
+    auto it = m_Results.find(hash);
+
+    if(it != m_Results.end())
+    {
+      m_MemoryHits++;
+      result = it->second;
+      return true;
+    }
+
+    std::vector<byte> data;
+
+    if(m_File.Read(hash, data) && m_Callbacks.Create((uint32_t)data.size(), &data[0], &result))
+    {
+      m_DiskHits++;
+      m_Results[hash] = result;
+      return true;
+    }
+
+    m_Misses++;
+    return false;
+  }
 
-  for(auto it = cache.begin(); it != cache.end(); ++it)
+  // takes ownership of result
+  void Add(uint64_t hash, ResultType result)
   {
-    uint32_t hash = it->first;
-    uint32_t len = callbacks.GetSize(it->second);
-    byte *data = callbacks.GetData(it->second);
-    FileIO::fwrite(&hash, 1, sizeof(hash), f);
-    FileIO::fwrite(&len, 1, sizeof(len), f);
-    FileIO::fwrite(data, 1, len, f);
-
-    callbacks.Destroy(it->second);
+    m_Results[hash] = result;
+    m_File.Append(hash, m_Callbacks.GetData(result), m_Callbacks.GetSize(result));
   }
 
-  FileIO::fclose(f);
+private:
+  ShaderCacheFile m_File;
+  const ShaderCallbacks &m_Callbacks;
+  std::map<uint64_t, ResultType> m_Results;
 
-  RDCDEBUG("Successfully wrote %u shaders to shader cache", numentries);
-}
+  std::string m_Filename;
+  uint32_t m_MemoryHits, m_DiskHits, m_Misses;
+};
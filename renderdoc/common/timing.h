@@ -30,6 +30,7 @@
 #include <string>
 #include "os/os_specific.h"
 #include "common.h"
+#include "profiler.h"
 
 using std::string;
 
@@ -51,7 +52,7 @@ private:
 class ScopedTimer
 {
 public:
-  ScopedTimer(const char *file, unsigned int line, const char *fmt, ...)
+  ScopedTimer(const char *file, unsigned int line, const char *fmt, ...) : m_Profile(fmt)
   {
     m_File = file;
     m_Line = line;
@@ -79,6 +80,8 @@ private:
   unsigned int m_Line;
   string m_Message;
   PerformanceTimer m_Timer;
+  // the unformatted message is used as the name, so it stays valid for the profiler
+  ProfileScope m_Profile;
 };
 
 #define SCOPED_TIMER(...) ScopedTimer CONCAT(timer, __LINE__)(__FILE__, __LINE__, __VA_ARGS__);
@@ -27,6 +27,7 @@
 
 #include <stdint.h>
 #include <string.h>
+#include <vector>
 #include "common.h"
 #include "threading.h"
 
@@ -50,97 +51,101 @@ public:
   typedef C Type;
 };
 
-// allocate each class in its own pool so we can identify the type by the pointer
+// allocate each class in its own pool so we can identify the type by the pointer.
+//
+// Free items are kept on a single intrusive stack (the link is stored in the first pointer of the
+// free item) shared by all of the type's pools, so allocation is O(1) no matter how full the pools
+// are. Each thread also keeps a small cache of free items, so the common case of allocating and
+// freeing on the same thread never touches the lock. Items freed when the thread's cache is full
+// are pushed back onto the shared stack without locking - only popping from it takes the lock,
+// and with a single popper at a time the stack is safe from ABA.
+//
+// Additional pools are found by address through a hash table that's read without locking. When
+// it fills up it's replaced by a bigger one, and the old table is kept until the pool is
+// destroyed in case a reader is still in it.
 template <typename WrapType, int PoolCount = 8192, int MaxPoolByteSize = 1024 * 1024, bool DebugClear = true>
 class WrappingPool
 {
 public:
   void *Allocate()
   {
-    SCOPED_LOCK(m_Lock);
+    ThreadCache *cache = GetThreadCache();
 
-    // try and allocate from immediate pool
-    void *ret = m_ImmediatePool.Allocate();
-    if(ret != NULL)
-      return ret;
+    void *ret = NULL;
 
-    // fall back to additional pools, if there are any
-    for(size_t i = 0; i < m_AdditionalPools.size(); i++)
+    if(cache && cache->count > 0)
     {
-      ret = m_AdditionalPools[i]->Allocate();
-      if(ret != NULL)
-        return ret;
+      ret = cache->items[--cache->count];
     }
+    else
+    {
+      SCOPED_LOCK(m_Lock);
 
+      ret = PopFree();
+
+      if(ret == NULL)
+      {
 // warn when we need to allocate an additional pool
 #ifdef INCLUDE_TYPE_NAMES
-    RDCWARN("Ran out of free slots in %s pool!", GetTypeName<WrapType>::Name());
+        RDCWARN("Ran out of free slots in %s pool!", GetTypeName<WrapType>::Name());
 #else
-    RDCWARN("Ran out of free slots in pool 0x%p!", &m_ImmediatePool.items[0]);
+        RDCWARN("Ran out of free slots in pool 0x%p!", &m_ImmediatePool.items[0]);
 #endif
 
-    // allocate a new additional pool and use that to allocate from
-    m_AdditionalPools.push_back(new ItemPool());
+        AddPool();
 
-#ifdef INCLUDE_TYPE_NAMES
-    RDCDEBUG("WrappingPool[%d]<%s>: %p -> %p", (uint32_t)m_AdditionalPools.size() - 1,
-             GetTypeName<WrapType>::Name(), &m_AdditionalPools.back()->items[0],
-             &m_AdditionalPools.back()->items[AllocCount - 1]);
+        ret = PopFree();
+      }
+
+      // grab a batch for this thread while we hold the lock
+      if(cache)
+      {
+        while(cache->count < ThreadCacheSize / 2)
+        {
+          void *item = PopFree();
+          if(item == NULL)
+            break;
+          cache->items[cache->count++] = item;
+        }
+      }
+    }
+
+#if !defined(RELEASE)
+    memset(ret, 0xb0, AllocByteSize);
 #endif
 
-    return m_AdditionalPools.back()->Allocate();
+    return ret;
   }
 
-  bool IsAlloc(const void *p)
+  bool IsAlloc(const void *p) { return FindPool(p) != NULL; }
+  void Deallocate(void *p)
   {
-    // we can check the immediate pool without locking
-    if(m_ImmediatePool.IsAlloc(p))
-      return true;
-
-    // if we have additional pools, lock and check them.
-    // TODO: Check for additional pools in a lock-free manner,
-    // to prevent the cost of locking if there are no more pools.
+    if(FindPool(p) == NULL)
     {
-      SCOPED_LOCK(m_Lock);
-
-      for(size_t i = 0; i < m_AdditionalPools.size(); i++)
-        if(m_AdditionalPools[i]->IsAlloc(p))
-          return true;
+// this is an error - deleting an object that we don't recognise
+#ifdef INCLUDE_TYPE_NAMES
+      RDCERR("Resource being deleted through wrong pool - 0x%p not a member of %s", p,
+             GetTypeName<WrapType>::Name());
+#else
+      RDCERR("Resource being deleted through wrong pool - 0x%p not a member of 0x%p", p,
+             &m_ImmediatePool.items[0]);
+#endif
+      return;
     }
 
-    return false;
-  }
+#if !defined(RELEASE)
+    memset(p, 0xfe, DebugClear ? AllocByteSize : 0);
+#endif
 
-  void Deallocate(void *p)
-  {
-    SCOPED_LOCK(m_Lock);
+    ThreadCache *cache = GetThreadCache();
 
-    // try immediate pool
-    if(m_ImmediatePool.IsAlloc(p))
+    if(cache && cache->count < ThreadCacheSize)
     {
-      m_ImmediatePool.Deallocate(p);
+      cache->items[cache->count++] = p;
       return;
     }
-    else if(!m_AdditionalPools.empty())
-    {
-      // fall back and try additional pools
-      for(size_t i = 0; i < m_AdditionalPools.size(); i++)
-      {
-        if(m_AdditionalPools[i]->IsAlloc(p))
-        {
-          m_AdditionalPools[i]->Deallocate(p);
-          return;
-        }
-      }
-    }
 
-// this is an error - deleting an object that we don't recognise
-#ifdef INCLUDE_TYPE_NAMES
-    RDCERR("Resource being deleted through wrong pool - 0x%p not a member of %s", p,
-           GetTypeName<WrapType>::Name());
-#else
-      RDCERR("Resource being deleted through wrong pool - 0x%p not a member of 0x%p", p, &m_ImmediatePool.items[0]));
-#endif
+    PushFree(p);
   }
 
   static const size_t AllocCount = PoolCount;
@@ -150,6 +155,13 @@ public:
 private:
   WrappingPool()
   {
+    m_FreeHead = NULL;
+    m_NumAdditionalPools = 0;
+    m_TLSSlot = 0;
+    m_PoolLookup = NULL;
+
+    m_ImmediatePool.PushAll(*this);
+
 #ifdef INCLUDE_TYPE_NAMES
     // hack - print in kB because float printing relies on statics that might not be initialised
     // yet in loading order. Ugly :(
@@ -164,89 +176,237 @@ private:
       delete m_AdditionalPools[i];
 
     m_AdditionalPools.clear();
+    m_NumAdditionalPools = 0;
+
+    PoolLookupTable *table = m_PoolLookup;
+    while(table)
+    {
+      PoolLookupTable *retired = table->retired;
+      delete[] table->entries;
+      delete table;
+      table = retired;
+    }
+    m_PoolLookup = NULL;
+
+    for(size_t i = 0; i < m_ThreadCaches.size(); i++)
+      delete m_ThreadCaches[i];
+
+    m_ThreadCaches.clear();
+
+    Threading::FreeTLSSlot(m_TLSSlot);
+    m_TLSSlot = 0;
   }
 
-  Threading::CriticalSection m_Lock;
+  // number of free items each thread can hold on to before returning them to the shared stack
+  static const int ThreadCacheSize = 32;
 
-  struct ItemPool
+  // each additional pool registers up to two entries in the lookup table (see FindPool), and
+  // the table is kept at most half full so probes stay short
+  static const uint32_t MinPoolLookupSize = 64;
+
+  struct ThreadCache
   {
-    ItemPool()
-    {
-      lastAllocIdx = 0;
-      RDCEraseEl(allocated);
+    int count;
+    void *items[ThreadCacheSize];
+  };
 
-      items = (WrapType *)(new uint8_t[AllocCount * AllocByteSize]);
-    }
+  struct ItemPool
+  {
+    ItemPool() { items = (WrapType *)(new uint8_t[AllocCount * AllocByteSize]); }
     ~ItemPool() { delete[](uint8_t *) items; }
-    void *Allocate()
+    // push in reverse so the first allocations come from the start of the pool
+    void PushAll(WrappingPool &owner)
     {
-      int lastAlloc = lastAllocIdx;
+      for(int i = PoolCount - 1; i >= 0; i--)
+        owner.PushFree(&items[i]);
+    }
 
-      if(allocated[lastAlloc])
-      {
-        int end = lastAlloc;
+    bool IsAlloc(const void *p) const { return p >= &items[0] && p < &items[PoolCount]; }
+    WrapType *items;
+  };
 
-        do
-        {
-          lastAlloc = (lastAlloc + 1) % PoolCount;
-        } while(allocated[lastAlloc] && lastAlloc != end);
+  struct PoolLookup
+  {
+    // 0 for an empty entry, otherwise the address bucket + 1. Written last, so a reader that
+    // sees the key also sees the pool
+    void *volatile key;
+    ItemPool *pool;
+  };
 
-        if(allocated[lastAlloc])
-        {
-          return NULL;
-        }
-      }
+  struct PoolLookupTable
+  {
+    uint32_t size;
+    PoolLookup *entries;
+    // the table this replaced, freed with the pool
+    PoolLookupTable *retired;
+  };
 
-      void *ret = (void *)&items[lastAlloc];
-      allocated[lastAlloc] = true;
+  // the lock only serialises popping from the free stack and adding pools
+  Threading::CriticalSection m_Lock;
 
-#if !defined(RELEASE)
-      memset(ret, 0xb0, AllocByteSize);
-#endif
+  void *volatile m_FreeHead;
+
+  volatile uint64_t m_TLSSlot;
+
+  ItemPool m_ImmediatePool;
+
+  // only touched with m_Lock held, readers go through m_PoolLookup
+  std::vector<ItemPool *> m_AdditionalPools;
+  volatile int32_t m_NumAdditionalPools;
+  PoolLookupTable *volatile m_PoolLookup;
+
+  // every thread's cache, so they can be freed with the pool. Only touched with m_Lock held
+  std::vector<ThreadCache *> m_ThreadCaches;
+
+  static void *&FreeLink(void *p) { return *(void **)p; }
+  void PushFree(void *p)
+  {
+    void *head;
+    do
+    {
+      head = m_FreeHead;
+      FreeLink(p) = head;
+    } while(Atomic::CmpExchPtr(&m_FreeHead, head, p) != head);
+  }
 
-      lastAllocIdx = lastAlloc;
+  // must be called with m_Lock held
+  void *PopFree()
+  {
+    void *head;
+    do
+    {
+      head = m_FreeHead;
+      if(head == NULL)
+        return NULL;
+    } while(Atomic::CmpExchPtr(&m_FreeHead, head, FreeLink(head)) != head);
 
-      return ret;
+    return head;
+  }
+
+  ThreadCache *GetThreadCache()
+  {
+    if(m_TLSSlot == 0)
+    {
+      SCOPED_LOCK(m_Lock);
+      if(m_TLSSlot == 0)
+        m_TLSSlot = Threading::AllocateTLSSlot();
     }
 
-    void Deallocate(void *p)
+    ThreadCache *cache = (ThreadCache *)Threading::GetTLSValue(m_TLSSlot);
+
+    // caches (and any items in them) stay around when a thread exits, as we have no
+    // notification of threads we don't own going away. They're freed with the pool
+    if(cache == NULL)
     {
-      RDCASSERT(IsAlloc(p));
+      cache = new ThreadCache;
+      cache->count = 0;
+      Threading::SetTLSValue(m_TLSSlot, cache);
 
-#if !defined(RELEASE)
-      if(!IsAlloc(p))
-      {
-        RDCERR("Resource being deleted through wrong pool - 0x%p not a memory of 0x%p", p, &items[0]);
-        return;
-      }
-#endif
+      SCOPED_LOCK(m_Lock);
+      m_ThreadCaches.push_back(cache);
+    }
+
+    return cache;
+  }
 
-      size_t idx = (WrapType *)p - &items[0];
+  // pools are looked up by address bucket, where a bucket is the size of a whole pool. A pool can
+  // then only straddle two buckets, and a bucket can only overlap two pools.
+  static uintptr_t PoolBucket(const void *p)
+  {
+    return uintptr_t(p) / (AllocCount * AllocByteSize);
+  }
 
-      allocated[idx] = false;
+  static uint32_t BucketHash(uintptr_t bucket, uint32_t size)
+  {
+    return uint32_t(bucket * 2654435761U) % size;
+  }
 
-#if !defined(RELEASE)
-      memset(p, 0xfe, DebugClear ? AllocByteSize : 0);
-#endif
+  static void RegisterPoolBucket(PoolLookupTable *table, uintptr_t bucket, ItemPool *pool)
+  {
+    uint32_t idx = BucketHash(bucket, table->size);
+    while(table->entries[idx].key != NULL)
+      idx = (idx + 1) % table->size;
+
+    table->entries[idx].pool = pool;
+    Atomic::CmpExchPtr(&table->entries[idx].key, NULL, (void *)(bucket + 1));
+  }
+
+  static void RegisterPool(PoolLookupTable *table, ItemPool *pool)
+  {
+    RegisterPoolBucket(table, PoolBucket(&pool->items[0]), pool);
+    if(PoolBucket(&pool->items[AllocCount - 1]) != PoolBucket(&pool->items[0]))
+      RegisterPoolBucket(table, PoolBucket(&pool->items[AllocCount - 1]), pool);
+  }
+
+  // must be called with m_Lock held. Makes sure the lookup table has room for one more pool
+  void ReserveLookup()
+  {
+    PoolLookupTable *table = m_PoolLookup;
+
+    uint32_t needed = uint32_t(m_AdditionalPools.size() + 1) * 2;
+
+    if(table && needed * 2 <= table->size)
+      return;
+
+    PoolLookupTable *grown = new PoolLookupTable;
+    grown->size = RDCMAX(MinPoolLookupSize, table ? table->size * 2 : 0U);
+    grown->entries = new PoolLookup[grown->size];
+    memset(grown->entries, 0, sizeof(PoolLookup) * grown->size);
+    grown->retired = table;
+
+    for(size_t i = 0; i < m_AdditionalPools.size(); i++)
+      RegisterPool(grown, m_AdditionalPools[i]);
+
+    // readers either see the old table, which stays valid, or the complete new one
+    Atomic::CmpExchPtr((void *volatile *)&m_PoolLookup, table, grown);
+  }
+
+  ItemPool *FindPool(const void *p)
+  {
+    // we can check the immediate pool without going any further
+    if(m_ImmediatePool.IsAlloc(p))
+      return &m_ImmediatePool;
+
+    if(m_NumAdditionalPools == 0)
+      return NULL;
+
+    PoolLookupTable *table = m_PoolLookup;
+
+    if(table == NULL)
+      return NULL;
+
+    uintptr_t bucket = PoolBucket(p);
+
+    for(uint32_t idx = BucketHash(bucket, table->size); table->entries[idx].key != NULL;
+        idx = (idx + 1) % table->size)
+    {
+      const PoolLookup &entry = table->entries[idx];
+      if(entry.key == (void *)(bucket + 1) && entry.pool->IsAlloc(p))
+        return entry.pool;
     }
 
-    bool IsAlloc(const void *p) const { return p >= &items[0] && p < &items[PoolCount]; }
-    WrapType *items;
+    return NULL;
+  }
 
-    // could possibly make this uint32s and check via bitmasks, but
-    // we'll see if it shows up in profiling
-    bool allocated[PoolCount];
+  // must be called with m_Lock held
+  void AddPool()
+  {
+    ReserveLookup();
 
-    // store the last allocations index. Good place to start from and we
-    // go through the pool in a ring. Good performance when the pool is empty
-    // or contiguously allocated, poorer performance when the pool gets filled up.
-    // It also has the bonus of handling repeated new/free well by reallocating the
-    // same element.
-    int lastAllocIdx;
-  };
+    ItemPool *pool = new ItemPool();
 
-  ItemPool m_ImmediatePool;
-  std::vector<ItemPool *> m_AdditionalPools;
+    RegisterPool(m_PoolLookup, pool);
+
+    m_AdditionalPools.push_back(pool);
+    Atomic::Inc32(&m_NumAdditionalPools);
+
+#ifdef INCLUDE_TYPE_NAMES
+    RDCDEBUG("WrappingPool[%d]<%s>: %p -> %p", m_NumAdditionalPools - 1,
+             GetTypeName<WrapType>::Name(), &pool->items[0], &pool->items[AllocCount - 1]);
+#endif
+
+    pool->PushAll(*this);
+  }
 
   friend typename FriendMaker<WrapType>::Type;
 };
@@ -276,4 +436,6 @@ private:
                     "Pool is bigger than max pool size cap");                             \
   RDCCOMPILE_ASSERT(a::PoolType::AllocCount > 2,                                          \
                     "Pool isn't greater than 2 in size. Bad parameters?");                \
+  RDCCOMPILE_ASSERT(sizeof(a) >= sizeof(void *),                                          \
+                    "Pooled type is too small to hold a free-list link");                 \
   DECL_TYPENAME(a);
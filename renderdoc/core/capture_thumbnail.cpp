@@ -0,0 +1,300 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "capture_thumbnail.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include "common/common.h"
+#include "jpeg-compressor/jpge.h"
+#include "maths/formatconvert.h"
+
+#if defined(RDC_SSE2)
+#include <emmintrin.h>
+#endif
+
+// the thumbnail's width, at most
+static const uint32_t MaxThumbnailSize = 1024;
+
+// entries in the table used to encode linear values to sRGB
+static const uint32_t SRGBTableSize = 4096;
+
+// adds each column's box of texels in a row onto that column's sum
+static void AccumulateRow(const Vec4f *row, const uint32_t *colStart, uint32_t numCols,
+                          Vec4f *sums)
+{
+  for(uint32_t x = 0; x < numCols; x++)
+  {
+#if defined(RDC_SSE2)
+    __m128 sum = _mm_loadu_ps(&sums[x].x);
+
+    for(uint32_t sx = colStart[x]; sx < colStart[x + 1]; sx++)
+      sum = _mm_add_ps(sum, _mm_loadu_ps(&row[sx].x));
+
+    _mm_storeu_ps(&sums[x].x, sum);
+#else
+    for(uint32_t sx = colStart[x]; sx < colStart[x + 1]; sx++)
+    {
+      sums[x].x += row[sx].x;
+      sums[x].y += row[sx].y;
+      sums[x].z += row[sx].z;
+    }
+#endif
+  }
+}
+
+// as AccumulateRow, for 8-bit four component texels summed as integers without decoding them
+static void AccumulateRow8(const byte *row, const uint32_t *colStart, uint32_t numCols,
+                           uint32_t *sums)
+{
+  for(uint32_t x = 0; x < numCols; x++)
+  {
+#if defined(RDC_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i sum = _mm_loadu_si128((const __m128i *)(sums + x * 4));
+
+    for(uint32_t sx = colStart[x]; sx < colStart[x + 1]; sx++)
+    {
+      int32_t texel = 0;
+      memcpy(&texel, row + sx * 4, sizeof(texel));
+
+      __m128i t = _mm_unpacklo_epi8(_mm_cvtsi32_si128(texel), zero);
+      sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(t, zero));
+    }
+
+    _mm_storeu_si128((__m128i *)(sums + x * 4), sum);
+#else
+    for(uint32_t sx = colStart[x]; sx < colStart[x + 1]; sx++)
+      for(uint32_t c = 0; c < 4; c++)
+        sums[x * 4 + c] += row[sx * 4 + c];
+#endif
+  }
+}
+
+static inline byte UNormToByte(float f)
+{
+  f = RDCCLAMP(f, 0.0f, 1.0f);
+  return byte(f * 255.0f + 0.5f);
+}
+
+CaptureThumbnail::CaptureThumbnail()
+{
+  m_Data = NULL;
+  m_SrcWidth = m_SrcHeight = 0;
+  m_RowPitch = 0;
+  m_Width = m_Height = 0;
+  m_Thread = 0;
+}
+
+CaptureThumbnail::~CaptureThumbnail()
+{
+  Finish();
+}
+
+void CaptureThumbnail::Start(const ResourceFormat &fmt, const byte *data, uint32_t width,
+                             uint32_t height, size_t rowPitch)
+{
+  Finish();
+
+  m_Format = fmt;
+  m_Data = data;
+  m_SrcWidth = width;
+  m_SrcHeight = height;
+  m_RowPitch = rowPitch;
+
+  m_Width = m_Height = 0;
+  m_JPEG.clear();
+
+  m_Thread = Threading::CreateThread(&CaptureThumbnail::EncodeThread, this);
+}
+
+bool CaptureThumbnail::Finish()
+{
+  if(m_Thread)
+  {
+    Threading::JoinThread(m_Thread);
+    Threading::CloseThread(m_Thread);
+    m_Thread = 0;
+  }
+
+  return !m_JPEG.empty();
+}
+
+void CaptureThumbnail::EncodeThread(void *param)
+{
+  ((CaptureThumbnail *)param)->Encode();
+}
+
+void CaptureThumbnail::Encode()
+{
+  if(m_Data == NULL || m_SrcWidth == 0 || m_SrcHeight == 0)
+    return;
+
+  ResourceFormat fmt = m_Format;
+
+  // 8-bit backbuffers are averaged and stored as they are, any sRGB curve is left in place.
+  // Floating point backbuffers are linear, and are encoded to sRGB after averaging
+  if(!fmt.special && fmt.compType == eCompType_UNorm && fmt.compByteWidth == 1)
+    fmt.srgbCorrected = false;
+
+  bool encodeSRGB = !fmt.special && fmt.compType == eCompType_Float;
+
+  if(GetFloat4TexelSize(fmt) == 0)
+  {
+    RDCWARN("Can't make a thumbnail from this backbuffer format");
+    return;
+  }
+
+  float aspect = float(m_SrcWidth) / float(m_SrcHeight);
+
+  uint32_t width = RDCMIN(MaxThumbnailSize, m_SrcWidth);
+  width &= ~0x7;    // align down to multiple of 8
+  uint32_t height = RDCMIN(m_SrcHeight, uint32_t(float(width) / aspect));
+
+  if(width == 0 || height == 0)
+    return;
+
+  // each thumbnail texel is the average of a box of source texels, with the box edges spread
+  // evenly over the source
+  std::vector<uint32_t> colStart(width + 1);
+  for(uint32_t x = 0; x <= width; x++)
+    colStart[x] = uint32_t(uint64_t(x) * m_SrcWidth / width);
+
+  byte srgbTable[SRGBTableSize];
+  if(encodeSRGB)
+  {
+    for(uint32_t i = 0; i < SRGBTableSize; i++)
+    {
+      float linear = float(i) / float(SRGBTableSize - 1);
+
+      if(linear < 0.0031308f)
+        srgbTable[i] = UNormToByte(12.92f * linear);
+      else
+        srgbTable[i] = UNormToByte(1.055f * powf(linear, 1.0f / 2.4f) - 0.055f);
+    }
+  }
+
+  // RGBA8 and BGRA8 are summed directly, anything else is decoded to float4 first
+  bool rgba8 = !fmt.special && fmt.compType == eCompType_UNorm && fmt.compByteWidth == 1 &&
+               fmt.compCount == 4;
+
+  std::vector<Vec4f> row;
+  std::vector<Vec4f> sums;
+  std::vector<uint32_t> sums8;
+
+  if(rgba8)
+  {
+    sums8.resize(width * 4);
+  }
+  else
+  {
+    row.resize(m_SrcWidth);
+    sums.resize(width);
+  }
+
+  std::vector<byte> pixels(width * height * 3);
+
+  byte *dst = &pixels[0];
+
+  for(uint32_t y = 0; y < height; y++)
+  {
+    uint32_t rowStart = uint32_t(uint64_t(y) * m_SrcHeight / height);
+    uint32_t rowEnd = uint32_t(uint64_t(y + 1) * m_SrcHeight / height);
+
+    if(rgba8)
+      memset(&sums8[0], 0, sums8.size() * sizeof(uint32_t));
+    else
+      std::fill(sums.begin(), sums.end(), Vec4f(0.0f, 0.0f, 0.0f, 0.0f));
+
+    for(uint32_t sy = rowStart; sy < rowEnd; sy++)
+    {
+      if(rgba8)
+      {
+        AccumulateRow8(m_Data + sy * m_RowPitch, &colStart[0], width, &sums8[0]);
+      }
+      else
+      {
+        ConvertToFloat4(fmt, m_Data + sy * m_RowPitch, m_SrcWidth, &row[0]);
+        AccumulateRow(&row[0], &colStart[0], width, &sums[0]);
+      }
+    }
+
+    for(uint32_t x = 0; x < width; x++)
+    {
+      float scale = 1.0f / float((colStart[x + 1] - colStart[x]) * (rowEnd - rowStart));
+
+      float rgb[3];
+
+      if(rgba8)
+      {
+        const uint32_t *sum = &sums8[x * 4];
+        scale /= 255.0f;
+
+        rgb[0] = float(sum[fmt.bgraOrder ? 2 : 0]) * scale;
+        rgb[1] = float(sum[1]) * scale;
+        rgb[2] = float(sum[fmt.bgraOrder ? 0 : 2]) * scale;
+      }
+      else
+      {
+        rgb[0] = sums[x].x * scale;
+        rgb[1] = sums[x].y * scale;
+        rgb[2] = sums[x].z * scale;
+      }
+
+      for(int c = 0; c < 3; c++)
+      {
+        if(encodeSRGB)
+        {
+          float linear = RDCCLAMP(rgb[c], 0.0f, 1.0f);
+          dst[c] = srgbTable[uint32_t(linear * float(SRGBTableSize - 1) + 0.5f)];
+        }
+        else
+        {
+          dst[c] = UNormToByte(rgb[c]);
+        }
+      }
+
+      dst += 3;
+    }
+  }
+
+  // a JPEG at this quality is well under one byte per texel
+  int len = width * height;
+  m_JPEG.resize(len);
+
+  jpge::params p;
+  p.m_quality = 40;
+
+  if(!jpge::compress_image_to_jpeg_file_in_memory(&m_JPEG[0], len, width, height, 3, &pixels[0], p))
+  {
+    RDCERR("Failed to compress to jpg");
+    m_JPEG.clear();
+    return;
+  }
+
+  m_JPEG.resize(len);
+  m_Width = width;
+  m_Height = height;
+}
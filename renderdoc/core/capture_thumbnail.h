@@ -0,0 +1,66 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include "api/replay/renderdoc_replay.h"
+#include "os/os_specific.h"
+
+// The JPEG thumbnail stored at the start of a capture, made from a CPU readback of the backbuffer.
+// The box filter downsample and the compression run on a worker thread, so they overlap with
+// serialising the frame instead of stalling the application's thread at the end of the capture.
+class CaptureThumbnail
+{
+public:
+  CaptureThumbnail();
+  ~CaptureThumbnail();
+
+  // starts encoding a thumbnail of width x height texels of fmt, with rows rowPitch bytes apart.
+  // The data must stay valid until Finish() has returned
+  void Start(const ResourceFormat &fmt, const byte *data, uint32_t width, uint32_t height,
+             size_t rowPitch);
+
+  // waits for the worker thread. Returns true if a thumbnail was encoded
+  bool Finish();
+
+  const byte *GetJPEG() const { return m_JPEG.empty() ? NULL : &m_JPEG[0]; }
+  size_t GetJPEGSize() const { return m_JPEG.size(); }
+  uint32_t GetWidth() const { return m_Width; }
+  uint32_t GetHeight() const { return m_Height; }
+
+private:
+  static void EncodeThread(void *param);
+  void Encode();
+
+  ResourceFormat m_Format;
+  const byte *m_Data;
+  uint32_t m_SrcWidth, m_SrcHeight;
+  size_t m_RowPitch;
+
+  uint32_t m_Width, m_Height;
+  std::vector<byte> m_JPEG;
+
+  Threading::ThreadHandle m_Thread;
+};
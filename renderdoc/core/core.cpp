@@ -27,9 +27,11 @@
 #include <time.h>
 #include <algorithm>
 #include "common/dds_readwrite.h"
+#include "common/profiler.h"
 #include "data/version.h"
 #include "hooks/hooks.h"
 #include "replay/replay_driver.h"
+#include "serialise/chunk_store.h"
 #include "serialise/serialiser.h"
 #include "serialise/string_utils.h"
 #include "stb/stb_image.h"
@@ -174,7 +176,7 @@ RenderDoc::RenderDoc()
   m_CaptureKeys.push_back(eRENDERDOC_Key_F12);
   m_CaptureKeys.push_back(eRENDERDOC_Key_PrtScrn);
 
-  m_ProgressPtr = NULL;
+  m_ProgressTLSSlot = 0;
 
   m_ExHandler = NULL;
 
@@ -184,6 +186,18 @@ RenderDoc::RenderDoc()
   m_RemoteClientThreadShutdown = false;
 }
 
+// inserts _suffix before the extension, e.g. trace.json -> trace_pid123.json
+static string ProfileTraceFilename(const string &filename, const string &suffix)
+{
+  size_t dot = filename.find_last_of('.');
+  size_t sep = filename.find_last_of("/\\");
+
+  if(dot == string::npos || (sep != string::npos && dot < sep))
+    return filename + "_" + suffix;
+
+  return filename.substr(0, dot) + "_" + suffix + filename.substr(dot);
+}
+
 void RenderDoc::Initialise()
 {
   Callstack::Init();
@@ -192,6 +206,8 @@ void RenderDoc::Initialise()
 
   Threading::Init();
 
+  m_ProgressTLSSlot = Threading::AllocateTLSSlot();
+
   m_RemoteIdent = 0;
   m_RemoteThread = 0;
 
@@ -243,6 +259,33 @@ void RenderDoc::Initialise()
     RDCLOGFILE(m_LoggingFilename.c_str());
   }
 
+  // from here on log lines are written out on a background thread
+  RDCLOGASYNC(true);
+
+  if(!IsReplayApp())
+  {
+    uint64_t budgetMB = ChunkStore::DefaultBudgetMB;
+
+    const char *budget = getenv("RENDERDOC_CHUNK_BUDGET_MB");
+    if(budget && budget[0])
+      budgetMB = (uint64_t)RDCMAX(0, atoi(budget));
+
+    if(budgetMB > 0)
+      ChunkStore::Init(StringFormat::Fmt("%s/RenderDoc_chunks_%u.tmp",
+                                         dirname(m_LoggingFilename).c_str(),
+                                         Process::GetCurrentPID()),
+                       budgetMB * 1024 * 1024);
+  }
+
+  // processes launched while profiling is enabled profile themselves too, each to its own file
+  // so they don't overwrite the trace of the process that launched them or of each other
+  {
+    const char *trace = getenv("RENDERDOC_PROFILE_TRACE");
+    if(trace && trace[0])
+      SetProfileTrace(
+          ProfileTraceFilename(trace, StringFormat::Fmt("pid%u", Process::GetCurrentPID())));
+  }
+
   if(IsReplayApp())
     RDCLOG("RenderDoc v%s %s (%s) loaded in replay application", RENDERDOC_VERSION_STRING,
            sizeof(uintptr_t) == sizeof(uint64_t) ? "x64" : "x86", GIT_COMMIT_HASH);
@@ -297,6 +340,7 @@ RenderDoc::~RenderDoc()
   if(m_RemoteThread)
   {
     m_RemoteServerThreadShutdown = true;
+    m_RemoteServerWaiter.Wake();
     // don't join, just close the thread, as we can't wait while in the middle of module unloading
     Threading::CloseThread(m_RemoteThread);
     m_RemoteThread = 0;
@@ -304,6 +348,12 @@ RenderDoc::~RenderDoc()
 
   Network::Shutdown();
 
+  ChunkStore::Shutdown();
+
+  // write out anything pending and close the log so it can be deleted. We can't join the writer
+  // thread in the middle of module unloading
+  RDCLOGASYNC(false, false);
+
   Threading::Shutdown();
 
   FileIO::Delete(m_LoggingFilename.c_str());
@@ -321,10 +371,14 @@ void RenderDoc::Shutdown()
     // explicitly wait for thread to shutdown, this call is not from module unloading and
     // we want to be sure everything is gone before we remove our module & hooks
     m_RemoteServerThreadShutdown = true;
+    m_RemoteServerWaiter.Wake();
     Threading::JoinThread(m_RemoteThread);
     Threading::CloseThread(m_RemoteThread);
     m_RemoteThread = 0;
   }
+
+  // the log writer thread holds a reference on our module, so stop it too
+  RDCLOGASYNC(false);
 }
 
 bool RenderDoc::MatchClosestWindow(void *&dev, void *&wnd)
@@ -518,6 +572,15 @@ bool RenderDoc::ShouldTriggerCapture(uint32_t frameNumber)
 
 Serialiser *RenderDoc::OpenWriteSerialiser(uint32_t frameNum, RDCInitParams *params, void *thpixels,
                                            size_t thlen, uint32_t thwidth, uint32_t thheight)
+{
+  Serialiser *fileSerialiser = OpenWriteSerialiser(frameNum, params);
+
+  InsertThumbnail(fileSerialiser, thpixels, thlen, thwidth, thheight);
+
+  return fileSerialiser;
+}
+
+Serialiser *RenderDoc::OpenWriteSerialiser(uint32_t frameNum, RDCInitParams *params)
 {
   RDCASSERT(m_CurrentDriver != RDC_Unknown);
 
@@ -534,23 +597,6 @@ Serialiser *RenderDoc::OpenWriteSerialiser(uint32_t frameNum, RDCInitParams *par
 
   Serialiser *chunkSerialiser = new Serialiser(NULL, Serialiser::WRITING, debugSerialiser);
 
-  {
-    ScopedContext scope(chunkSerialiser, "Thumbnail", THUMBNAIL_DATA, false);
-
-    bool HasThumbnail = (thpixels != NULL && thwidth > 0 && thheight > 0);
-    chunkSerialiser->Serialise("HasThumbnail", HasThumbnail);
-
-    if(HasThumbnail)
-    {
-      byte *buf = (byte *)thpixels;
-      chunkSerialiser->Serialise("ThumbWidth", thwidth);
-      chunkSerialiser->Serialise("ThumbHeight", thheight);
-      chunkSerialiser->SerialiseBuffer("ThumbnailPixels", buf, thlen);
-    }
-
-    fileSerialiser->Insert(scope.Get(true));
-  }
-
   {
     ScopedContext scope(chunkSerialiser, "Capture Create Parameters", CREATE_PARAMS, false);
 
@@ -570,9 +616,49 @@ Serialiser *RenderDoc::OpenWriteSerialiser(uint32_t frameNum, RDCInitParams *par
 
   SAFE_DELETE(chunkSerialiser);
 
+  m_CurrentThumbnail.clear();
+
   return fileSerialiser;
 }
 
+void RenderDoc::InsertThumbnail(Serialiser *fileSerialiser, const void *thpixels, size_t thlen,
+                                uint32_t thwidth, uint32_t thheight)
+{
+#if defined(RELEASE)
+  const bool debugSerialiser = false;
+#else
+  const bool debugSerialiser = true;
+#endif
+
+  Serialiser *chunkSerialiser = new Serialiser(NULL, Serialiser::WRITING, debugSerialiser);
+
+  bool HasThumbnail = (thpixels != NULL && thwidth > 0 && thheight > 0);
+
+  {
+    ScopedContext scope(chunkSerialiser, "Thumbnail", THUMBNAIL_DATA, false);
+
+    chunkSerialiser->Serialise("HasThumbnail", HasThumbnail);
+
+    if(HasThumbnail)
+    {
+      byte *buf = (byte *)thpixels;
+      chunkSerialiser->Serialise("ThumbWidth", thwidth);
+      chunkSerialiser->Serialise("ThumbHeight", thheight);
+      chunkSerialiser->SerialiseBuffer("ThumbnailPixels", buf, thlen);
+    }
+
+    // the thumbnail is always the first chunk, so it can be read without parsing the capture
+    fileSerialiser->InsertFront(scope.Get(true));
+  }
+
+  SAFE_DELETE(chunkSerialiser);
+
+  if(HasThumbnail)
+    m_CurrentThumbnail.assign((const byte *)thpixels, (const byte *)thpixels + thlen);
+  else
+    m_CurrentThumbnail.clear();
+}
+
 ReplayCreateStatus RenderDoc::FillInitParams(const char *logFile, RDCDriver &driverType,
                                              string &driverName, RDCInitParams *params)
 {
@@ -757,6 +843,8 @@ void RenderDoc::SetCurrentDriver(RDCDriver driver)
   }
   m_CurrentDriver = driver;
   m_CurrentDriverName = m_DriverNames[driver];
+
+  m_RemoteClientWaiter.Wake();
 }
 
 void RenderDoc::GetCurrentDriver(RDCDriver &driver, string &name)
@@ -807,9 +895,16 @@ void RenderDoc::SetLogFile(const char *logFile)
   FileIO::CreateParentDirectory(m_LogFile);
 }
 
+void RenderDoc::SetProgressPtr(float *progress)
+{
+  Threading::SetTLSValue(m_ProgressTLSSlot, progress);
+}
+
 void RenderDoc::SetProgress(LoadProgressSection section, float delta)
 {
-  if(m_ProgressPtr == NULL || section < 0 || section >= NumSections)
+  float *progressPtr = (float *)Threading::GetTLSValue(m_ProgressTLSSlot);
+
+  if(progressPtr == NULL || section < 0 || section >= NumSections)
     return;
 
   float weights[NumSections];
@@ -827,7 +922,7 @@ void RenderDoc::SetProgress(LoadProgressSection section, float delta)
 
   progress += weights[section] * delta;
 
-  *m_ProgressPtr = progress;
+  *progressPtr = progress;
 }
 
 void RenderDoc::SuccessfullyWrittenLog()
@@ -838,7 +933,38 @@ void RenderDoc::SuccessfullyWrittenLog()
   {
     SCOPED_LOCK(m_CaptureLock);
     m_Captures.push_back(cap);
+    m_CaptureThumbnails[m_CurrentLogFile].swap(m_CurrentThumbnail);
   }
+
+  m_CurrentThumbnail.clear();
+
+  m_RemoteClientWaiter.Wake();
+
+  WriteProfileTrace();
+}
+
+void RenderDoc::SetProfileTrace(const string &filename)
+{
+  m_ProfileTrace = filename;
+
+  Profiler::Enable(!m_ProfileTrace.empty());
+
+  if(!m_ProfileTrace.empty())
+    RDCLOG("Profiling enabled, writing trace to %s", m_ProfileTrace.c_str());
+}
+
+void RenderDoc::WriteProfileTrace(uint32_t session)
+{
+  if(m_ProfileTrace.empty())
+    return;
+
+  // the recording covers the whole process, but each session writes it out when it finishes so
+  // concurrent sessions mustn't share a file
+  if(session != 0)
+    Profiler::WriteChromeTrace(
+        ProfileTraceFilename(m_ProfileTrace, StringFormat::Fmt("session%u", session)).c_str());
+  else
+    Profiler::WriteChromeTrace(m_ProfileTrace.c_str());
 }
 
 void RenderDoc::AddDeviceFrameCapturer(void *dev, IFrameCapturer *cap)
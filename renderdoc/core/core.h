@@ -176,7 +176,8 @@ class RenderDoc
 public:
   static RenderDoc &Inst();
 
-  void SetProgressPtr(float *progress) { m_ProgressPtr = progress; }
+  // the progress pointer is per-thread, so several logs can be loaded at once
+  void SetProgressPtr(float *progress);
   void SetProgress(LoadProgressSection section, float delta);
 
   // set from outside of the device creation interface
@@ -200,12 +201,25 @@ public:
   ICrashHandler *GetCrashHandler() const { return m_ExHandler; }
   Serialiser *OpenWriteSerialiser(uint32_t frameNum, RDCInitParams *params, void *thpixels,
                                   size_t thlen, uint32_t thwidth, uint32_t thheight);
+  // opens a capture without its thumbnail, for when that's still being encoded. InsertThumbnail
+  // must be called before the capture is flushed to disk
+  Serialiser *OpenWriteSerialiser(uint32_t frameNum, RDCInitParams *params);
+  void InsertThumbnail(Serialiser *fileSerialiser, const void *thpixels, size_t thlen,
+                       uint32_t thwidth, uint32_t thheight);
   void SuccessfullyWrittenLog();
 
+  // enables profiling, with the trace written to this file after each capture or replay session
+  void SetProfileTrace(const string &filename);
+  // session is non-zero for a replay host session, which gets its own trace file
+  void WriteProfileTrace(uint32_t session = 0);
+
   void AddChildProcess(uint32_t pid, uint32_t ident)
   {
-    SCOPED_LOCK(m_ChildLock);
-    m_Children.push_back(std::make_pair(pid, ident));
+    {
+      SCOPED_LOCK(m_ChildLock);
+      m_Children.push_back(std::make_pair(pid, ident));
+    }
+    m_RemoteClientWaiter.Wake();
   }
   vector<pair<uint32_t, uint32_t> > GetChildProcesses()
   {
@@ -219,6 +233,19 @@ public:
     return m_Captures;
   }
 
+  // the JPEG thumbnail of a capture written by this process, kept from when it was written so it
+  // doesn't have to be read back out of the capture. Returns false if the capture isn't cached,
+  // and an empty thumbnail if it has none
+  bool GetCaptureThumbnail(const string &path, vector<byte> &thumbnail)
+  {
+    SCOPED_LOCK(m_CaptureLock);
+    auto it = m_CaptureThumbnails.find(path);
+    if(it == m_CaptureThumbnails.end())
+      return false;
+    thumbnail = it->second;
+    return true;
+  }
+
   void MarkCaptureRetrieved(uint32_t idx)
   {
     SCOPED_LOCK(m_CaptureLock);
@@ -309,6 +336,7 @@ private:
   vector<RENDERDOC_InputButton> m_CaptureKeys;
 
   string m_LoggingFilename;
+  string m_ProfileTrace;
 
   string m_Target;
   string m_LogFile;
@@ -325,10 +353,14 @@ private:
   RDCDriver m_CurrentDriver;
   string m_CurrentDriverName;
 
-  float *m_ProgressPtr;
+  uint64_t m_ProgressTLSSlot;
 
   Threading::CriticalSection m_CaptureLock;
   vector<CaptureData> m_Captures;
+  map<string, vector<byte> > m_CaptureThumbnails;
+
+  // the thumbnail of the capture being written, cached once it's successfully written
+  vector<byte> m_CurrentThumbnail;
 
   Threading::CriticalSection m_ChildLock;
   vector<pair<uint32_t, uint32_t> > m_Children;
@@ -385,6 +417,10 @@ private:
 
   volatile bool m_RemoteServerThreadShutdown;
   volatile bool m_RemoteClientThreadShutdown;
+  // the remote access threads sleep on their sockets, these wake them for shutdown, and the
+  // client thread whenever there's a new capture, child process or API to notify
+  Network::SocketWaiter m_RemoteServerWaiter;
+  Network::SocketWaiter m_RemoteClientWaiter;
   Threading::CriticalSection m_SingleClientLock;
   string m_SingleClientName;
 
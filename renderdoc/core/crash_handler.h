@@ -34,6 +34,15 @@
 class CrashHandler : public ICrashHandler
 {
 public:
+  // called before the minidump is written, make sure any queued log lines make it to disk so the
+  // log sent along with the crash report is complete
+  static bool FlushLogFilter(void *context, EXCEPTION_POINTERS *exinfo,
+                             MDRawAssertionInfo *assertion)
+  {
+    rdclog_tryflush();
+    return true;
+  }
+
   CrashHandler(ICrashHandler *existing)
   {
     m_ExHandler = NULL;
@@ -120,8 +129,9 @@ public:
 
     _CrtSetReportMode(_CRT_ASSERT, 0);
     m_ExHandler = new google_breakpad::ExceptionHandler(
-        dumpFolder.c_str(), NULL, NULL, NULL, google_breakpad::ExceptionHandler::HANDLER_ALL,
-        dumpType, L"\\\\.\\pipe\\RenderDocBreakpadServer", &custom);
+        dumpFolder.c_str(), &FlushLogFilter, NULL, NULL,
+        google_breakpad::ExceptionHandler::HANDLER_ALL, dumpType,
+        L"\\\\.\\pipe\\RenderDocBreakpadServer", &custom);
 
     m_ExHandler->set_handle_debug_exceptions(true);
 
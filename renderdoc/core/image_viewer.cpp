@@ -25,6 +25,7 @@
 #include "common/dds_readwrite.h"
 #include "core/core.h"
 #include "replay/replay_driver.h"
+#include "replay/texture_stats.h"
 #include "replay/type_helpers.h"
 #include "stb/stb_image.h"
 #include "tinyexr/tinyexr.h"
@@ -92,14 +93,33 @@ public:
   {
     m_Proxy->RenderHighlightBox(w, h, scale);
   }
+  // min/max and histograms are calculated on the CPU from the file's data where the format can be
+  // decoded, and only fall back to the proxy otherwise
   bool GetMinMax(ResourceId texid, uint32_t sliceFace, uint32_t mip, uint32_t sample, float *minval,
                  float *maxval)
   {
+    const byte *data = NULL;
+    size_t size = 0;
+    uint32_t width = 0, height = 0;
+
+    if(GetSliceData(sliceFace, mip, data, size, width, height) &&
+       TextureStats::GetMinMax(m_TexDetails.format, data, size, width, height, minval, maxval))
+      return true;
+
     return m_Proxy->GetMinMax(m_TextureID, sliceFace, mip, sample, minval, maxval);
   }
   bool GetHistogram(ResourceId texid, uint32_t sliceFace, uint32_t mip, uint32_t sample,
                     float minval, float maxval, bool channels[4], vector<uint32_t> &histogram)
   {
+    const byte *data = NULL;
+    size_t size = 0;
+    uint32_t width = 0, height = 0;
+
+    if(GetSliceData(sliceFace, mip, data, size, width, height) &&
+       TextureStats::GetHistogram(m_TexDetails.format, data, size, width, height, minval, maxval,
+                                  channels, histogram))
+      return true;
+
     return m_Proxy->GetHistogram(m_TextureID, sliceFace, mip, sample, minval, maxval, channels,
                                  histogram);
   }
@@ -135,6 +155,11 @@ public:
     return m_Proxy->GetTextureData(m_TextureID, arrayIdx, mip, resolve, forceRGBA8unorm, blackPoint,
                                    whitePoint, dataSize);
   }
+  void GetTextureDataBatch(const vector<TextureDataRequest> &requests,
+                           TextureDataReceiver *receiver)
+  {
+    GetTextureDataSerially(this, requests, receiver);
+  }
 
   // handle a couple of operations ourselves to return a simple fake log
   APIProperties GetAPIProperties() { return m_Props; }
@@ -153,13 +178,17 @@ public:
     RDCEraseEl(ret);
     return ret;
   }
-  void SavePipelineState() {}
+  uint32_t SavePipelineState() { return ePipeChange_None; }
   GLPipelineState GetGLPipelineState() { return GLPipelineState(); }
   VulkanPipelineState GetVulkanPipelineState() { return VulkanPipelineState(); }
   void SetContextFilter(ResourceId id, uint32_t firstDefEv, uint32_t lastDefEv) {}
   void ReplayLog(uint32_t endEventID, ReplayLogType replayType) {}
   vector<uint32_t> GetPassEvents(uint32_t eventID) { return vector<uint32_t>(); }
   vector<EventUsage> GetUsage(ResourceId id) { return vector<EventUsage>(); }
+  vector<vector<EventUsage> > GetUsages(const vector<ResourceId> &ids)
+  {
+    return vector<vector<EventUsage> >(ids.size());
+  }
   bool IsRenderOutput(ResourceId id) { return false; }
   ResourceId GetLiveID(ResourceId id) { return id; }
   vector<uint32_t> EnumerateCounters() { return vector<uint32_t>(); }
@@ -179,6 +208,7 @@ public:
   void GetBufferData(ResourceId buff, uint64_t offset, uint64_t len, vector<byte> &retData) {}
   void InitPostVSBuffers(uint32_t eventID) {}
   void InitPostVSBuffers(const vector<uint32_t> &eventID) {}
+  void PinPostVSBuffers(const vector<uint32_t> &events) {}
   MeshFormat GetPostVSBuffers(uint32_t eventID, uint32_t instID, MeshDataStage stage)
   {
     MeshFormat ret;
@@ -253,6 +283,8 @@ public:
   void FileChanged() { RefreshFile(); }
 private:
   void RefreshFile();
+  bool GetSliceData(uint32_t sliceFace, uint32_t mip, const byte *&data, size_t &size,
+                    uint32_t &width, uint32_t &height);
 
   APIProperties m_Props;
   FetchFrameRecord m_FrameRecord;
@@ -261,6 +293,9 @@ private:
   string m_Filename;
   ResourceId m_TextureID;
   FetchTexture m_TexDetails;
+
+  // a CPU copy of each subresource as loaded from the file, indexed by slice * mips + mip
+  vector<vector<byte> > m_SubresourceData;
 };
 
 ReplayCreateStatus IMG_CreateReplayDevice(const char *logfile, IReplayDriver **driver)
@@ -611,18 +646,29 @@ void ImageViewer::RefreshFile()
   if(m_TextureID == ResourceId())
     m_TextureID = m_Proxy->CreateProxyTexture(texDetails);
 
+  m_TexDetails = texDetails;
+  m_TexDetails.ID = m_TextureID;
+
+  m_SubresourceData.clear();
+
   if(!dds)
   {
     m_Proxy->SetProxyTextureData(m_TextureID, 0, 0, data, datasize);
+    m_SubresourceData.push_back(vector<byte>(data, data + datasize));
     free(data);
   }
   else
   {
+    m_SubresourceData.resize(texDetails.numSubresources);
+
     for(uint32_t i = 0; i < texDetails.numSubresources; i++)
     {
       m_Proxy->SetProxyTextureData(m_TextureID, i / texDetails.mips, i % texDetails.mips,
                                    read_data.subdata[i], (size_t)read_data.subsizes[i]);
 
+      m_SubresourceData[i].assign(read_data.subdata[i],
+                                  read_data.subdata[i] + (size_t)read_data.subsizes[i]);
+
       delete[] read_data.subdata[i];
     }
 
@@ -633,4 +679,37 @@ void ImageViewer::RefreshFile()
   FileIO::fclose(f);
 }
 
+bool ImageViewer::GetSliceData(uint32_t sliceFace, uint32_t mip, const byte *&data, size_t &size,
+                               uint32_t &width, uint32_t &height)
+{
+  uint32_t texelSize = GetFloat4TexelSize(m_TexDetails.format);
+
+  if(texelSize == 0 || mip >= m_TexDetails.mips)
+    return false;
+
+  width = RDCMAX(1U, m_TexDetails.width >> mip);
+  height = RDCMAX(1U, m_TexDetails.height >> mip);
+
+  // 3D textures have one subresource per mip, and sliceFace selects the depth slice within it
+  uint32_t subresource = mip;
+  size_t sliceSize = size_t(width) * height * texelSize;
+  size_t offset = 0;
+
+  if(m_TexDetails.dimension == 3)
+    offset = RDCMIN(sliceFace, RDCMAX(1U, m_TexDetails.depth >> mip) - 1) * sliceSize;
+  else if(sliceFace < m_TexDetails.arraysize)
+    subresource = sliceFace * m_TexDetails.mips + mip;
+  else
+    return false;
+
+  if(subresource >= m_SubresourceData.size() ||
+     m_SubresourceData[subresource].size() < offset + sliceSize)
+    return false;
+
+  data = &m_SubresourceData[subresource][offset];
+  size = sliceSize;
+
+  return true;
+}
+
 static DriverRegistration IMGDriverRegistration(RDC_Image, "Image", &IMG_CreateReplayDevice);
@@ -24,6 +24,7 @@
  ******************************************************************************/
 
 #include "api/replay/renderdoc_replay.h"
+#include "common/timing.h"
 #include "core/core.h"
 #include "os/os_specific.h"
 #include "replay/type_helpers.h"
@@ -43,6 +44,9 @@ enum PacketType
   ePacket_NewChild,
 };
 
+// flush a batch of outgoing packets once it reaches this size
+static const size_t MaxTargetControlBatch = 1024 * 1024;
+
 void RenderDoc::RemoteAccessClientThread(void *s)
 {
   Threading::KeepModuleAlive();
@@ -76,13 +80,17 @@ void RenderDoc::RemoteAccessClientThread(void *s)
     return;
   }
 
-  const int pingtime = 1000;    // ping every 1000ms
-  const int ticktime = 10;      // tick every 10ms
-  int curtime = 0;
+  const uint32_t pingtime = 1000;    // ping if nothing else has been sent for 1000ms
 
   vector<CaptureData> captures;
   vector<pair<uint32_t, uint32_t> > children;
 
+  // packets are batched up and sent together, so a burst of new captures or children goes out
+  // in one send instead of one per wake
+  vector<byte> batch;
+
+  PerformanceTimer lastSend;
+
   while(client)
   {
     if(RenderDoc::Inst().m_RemoteClientThreadShutdown || (client && !client->Connected()))
@@ -91,13 +99,6 @@ void RenderDoc::RemoteAccessClientThread(void *s)
       break;
     }
 
-    ser.Rewind();
-
-    Threading::Sleep(ticktime);
-    curtime += ticktime;
-
-    PacketType packetType = ePacket_Noop;
-
     string curapi;
     RenderDoc::Inst().GetCurrentDriver(driver, curapi);
 
@@ -108,113 +109,156 @@ void RenderDoc::RemoteAccessClientThread(void *s)
     {
       api = curapi;
 
+      ser.Rewind();
       ser.Serialise("", api);
 
-      packetType = ePacket_RegisterAPI;
+      AppendPacket(batch, ePacket_RegisterAPI, ser);
     }
-    else if(caps.size() != captures.size())
+
+    while(client && captures.size() < caps.size())
     {
       uint32_t idx = (uint32_t)captures.size();
 
       captures.push_back(caps[idx]);
 
-      packetType = ePacket_NewCapture;
-
       std::string path = FileIO::GetFullPathname(captures.back().path);
 
+      ser.Rewind();
       ser.Serialise("", idx);
       ser.Serialise("", captures.back().timestamp);
       ser.Serialise("", path);
 
-      uint32_t len = 0;
-      RENDERDOC_GetThumbnail(captures.back().path.c_str(), NULL, len);
-      byte *thumb = new byte[len];
-      RENDERDOC_GetThumbnail(captures.back().path.c_str(), thumb, len);
+      // thumbnails of captures written by this process are cached, anything else has to be read
+      // back out of the capture
+      vector<byte> thumbnail;
+      if(!RenderDoc::Inst().GetCaptureThumbnail(captures.back().path, thumbnail))
+      {
+        uint32_t len = 0;
+        if(RENDERDOC_GetThumbnail(captures.back().path.c_str(), NULL, len) && len > 0)
+        {
+          thumbnail.resize(len);
+          RENDERDOC_GetThumbnail(captures.back().path.c_str(), &thumbnail[0], len);
+        }
+      }
+
+      uint32_t len = (uint32_t)thumbnail.size();
+      byte empty = 0;
+      byte *thumb = thumbnail.empty() ? &empty : &thumbnail[0];
 
       size_t l = len;
       ser.Serialise("", len);
       ser.SerialiseBuffer("", thumb, l);
-      delete[] thumb;
+
+      AppendPacket(batch, ePacket_NewCapture, ser);
+
+      // stream a large backlog out rather than holding every thumbnail in memory at once. The
+      // send blocks until the client reads, which holds off only this thread - captures keep
+      // being recorded and are picked up on the next pass
+      if(batch.size() >= MaxTargetControlBatch && !SendPacketBatch(client, batch))
+        SAFE_DELETE(client);
     }
-    else if(childprocs.size() != children.size())
+
+    if(client == NULL)
+      continue;
+
+    while(children.size() < childprocs.size())
     {
       uint32_t idx = (uint32_t)children.size();
 
       children.push_back(childprocs[idx]);
 
-      packetType = ePacket_NewChild;
-
+      ser.Rewind();
       ser.Serialise("", children.back().first);
       ser.Serialise("", children.back().second);
+
+      AppendPacket(batch, ePacket_NewChild, ser);
     }
 
-    if(curtime < pingtime && packetType == ePacket_Noop)
+    if(batch.empty() && lastSend.GetMilliseconds() >= (double)pingtime)
     {
-      if(client->IsRecvDataWaiting())
+      ser.Rewind();
+      AppendPacket(batch, ePacket_Noop, ser);
+    }
+
+    if(!batch.empty())
+    {
+      if(!SendPacketBatch(client, batch))
       {
-        PacketType type;
-        Serialiser *recvser = NULL;
+        SAFE_DELETE(client);
+        continue;
+      }
 
-        if(!RecvPacket(client, type, &recvser))
-          SAFE_DELETE(client);
+      lastSend.Restart();
+    }
 
-        if(client == NULL)
-        {
-          SAFE_DELETE(recvser);
-          continue;
-        }
-        else if(type == ePacket_TriggerCapture)
-        {
-          RenderDoc::Inst().TriggerCapture();
-        }
-        else if(type == ePacket_QueueCapture)
-        {
-          uint32_t frameNum = 0;
-          recvser->Serialise("", frameNum);
+    // sleep until the client sends something, there's something new to tell it, or it's time to
+    // ping
+    uint32_t timeout = pingtime - RDCMIN(pingtime, (uint32_t)lastSend.GetMilliseconds());
 
-          RenderDoc::Inst().QueueCapture(frameNum);
-        }
-        else if(type == ePacket_CopyCapture)
-        {
-          caps = RenderDoc::Inst().GetCaptures();
+    uint32_t woken = RenderDoc::Inst().m_RemoteClientWaiter.Wait(client, timeout);
 
-          uint32_t id = 0;
-          recvser->Serialise("", id);
+    if((woken & Network::SocketWaiter::eWait_Data) == 0)
+      continue;
 
-          if(id < caps.size())
-          {
-            ser.Serialise("", id);
+    while(client && client->IsRecvDataWaiting())
+    {
+      PacketType type;
+      Serialiser *recvser = NULL;
 
-            if(!SendPacket(client, ePacket_CopyCapture, ser))
-            {
-              SAFE_DELETE(client);
-              continue;
-            }
+      if(!RecvPacket(client, type, &recvser))
+        SAFE_DELETE(client);
+
+      if(client == NULL)
+      {
+        SAFE_DELETE(recvser);
+        continue;
+      }
+      else if(type == ePacket_TriggerCapture)
+      {
+        RenderDoc::Inst().TriggerCapture();
+      }
+      else if(type == ePacket_QueueCapture)
+      {
+        uint32_t frameNum = 0;
+        recvser->Serialise("", frameNum);
 
-            ser.Rewind();
+        RenderDoc::Inst().QueueCapture(frameNum);
+      }
+      else if(type == ePacket_CopyCapture)
+      {
+        caps = RenderDoc::Inst().GetCaptures();
 
-            if(!SendChunkedFile(client, ePacket_CopyCapture, caps[id].path.c_str(), ser, NULL))
-            {
-              SAFE_DELETE(client);
-              continue;
-            }
+        uint32_t id = 0;
+        recvser->Serialise("", id);
 
-            RenderDoc::Inst().MarkCaptureRetrieved(id);
+        if(id < caps.size())
+        {
+          ser.Rewind();
+          ser.Serialise("", id);
+
+          if(!SendPacket(client, ePacket_CopyCapture, ser))
+          {
+            SAFE_DELETE(client);
+            SAFE_DELETE(recvser);
+            continue;
           }
-        }
 
-        SAFE_DELETE(recvser);
-      }
+          ser.Rewind();
 
-      continue;
-    }
+          if(!SendChunkedFile(client, ePacket_CopyCapture, caps[id].path.c_str(), ser, NULL))
+          {
+            SAFE_DELETE(client);
+            SAFE_DELETE(recvser);
+            continue;
+          }
 
-    curtime = 0;
+          lastSend.Restart();
 
-    if(!SendPacket(client, packetType, ser))
-    {
-      SAFE_DELETE(client);
-      continue;
+          RenderDoc::Inst().MarkCaptureRetrieved(id);
+        }
+      }
+
+      SAFE_DELETE(recvser);
     }
   }
 
@@ -241,7 +285,7 @@ void RenderDoc::RemoteAccessServerThread(void *s)
 
   while(!RenderDoc::Inst().m_RemoteServerThreadShutdown)
   {
-    Network::Socket *client = sock->AcceptClient(false);
+    Network::Socket *client = sock->AcceptClient(0);
 
     if(client == NULL)
     {
@@ -254,7 +298,8 @@ void RenderDoc::RemoteAccessServerThread(void *s)
         return;
       }
 
-      Threading::Sleep(5);
+      // sleep until a connection is pending, or we're woken to shut down
+      RenderDoc::Inst().m_RemoteServerWaiter.Wait(sock, 1000);
 
       continue;
     }
@@ -303,6 +348,7 @@ void RenderDoc::RemoteAccessServerThread(void *s)
     {
       // forcibly close communication thread which will kill the connection
       RenderDoc::Inst().m_RemoteClientThreadShutdown = true;
+      RenderDoc::Inst().m_RemoteClientWaiter.Wake();
       Threading::JoinThread(clientThread);
       Threading::CloseThread(clientThread);
       clientThread = 0;
@@ -346,6 +392,7 @@ void RenderDoc::RemoteAccessServerThread(void *s)
   }
 
   RenderDoc::Inst().m_RemoteClientThreadShutdown = true;
+  RenderDoc::Inst().m_RemoteClientWaiter.Wake();
   // don't join, just close the thread, as we can't wait while in the middle of module unloading
   Threading::CloseThread(clientThread);
   clientThread = 0;
@@ -459,6 +506,11 @@ public:
       return;
     }
 
+    // sleep until data arrives rather than for a fixed time, but return regularly so callers
+    // looping on this can send their own commands
+    if(!m_Socket->IsRecvDataWaiting() && m_Socket->Connected())
+      m_Waiter.Wait(m_Socket, 10);
+
     if(!m_Socket->IsRecvDataWaiting())
     {
       if(!m_Socket->Connected())
@@ -468,7 +520,6 @@ public:
       }
       else
       {
-        Threading::Sleep(2);
         msg->Type = eRemoteMsg_Noop;
       }
 
@@ -604,6 +655,8 @@ private:
   string m_Target, m_API, m_BusyClient;
   uint32_t m_PID;
 
+  Network::SocketWaiter m_Waiter;
+
   map<uint32_t, string> m_CaptureCopies;
 
   void GetPacket(PacketType &type, Serialiser *&ser)
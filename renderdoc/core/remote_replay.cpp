@@ -41,6 +41,7 @@ enum PacketType
   ePacket_CopyCapture,
   ePacket_LogOpenProgress,
   ePacket_LogReady,
+  ePacket_HostBusy,
 };
 
 struct ProgressLoopData
@@ -61,171 +62,477 @@ static void ProgressTicker(void *d)
     ser.Rewind();
     ser.Serialise("", data->progress);
 
+    // the socket is still in use receiving the capture, so it's left for its owner to clean up
     if(!SendPacket(data->sock, ePacket_LogOpenProgress, ser))
-    {
-      SAFE_DELETE(data->sock);
       break;
-    }
+
     Threading::Sleep(100);
   }
 }
 
-void RenderDoc::BecomeReplayHost(volatile bool32 &killReplay)
+struct CaptureReceiveData
 {
-  Network::Socket *sock = Network::CreateServerSocket("0.0.0.0", RenderDoc_ReplayNetworkPort, 1);
+  Network::Socket *sock;
+  string path;
+  PartialCaptureFile *partial;
+  bool success;
+};
 
-  if(sock == NULL)
-    return;
+static void ReceiveCaptureThread(void *d)
+{
+  CaptureReceiveData *data = (CaptureReceiveData *)d;
 
-  Serialiser ser("", Serialiser::WRITING, false);
+  Serialiser *fileRecv = NULL;
 
-  bool newlyReady = true;
+  data->success = RecvChunkedFile(data->sock, ePacket_CopyCapture, data->path.c_str(), fileRecv,
+                                  NULL, data->partial);
 
-  while(!killReplay)
+  SAFE_DELETE(fileRecv);
+
+  data->partial->Finish(data->success);
+}
+
+// limits on what the replay host will take on at once. Sessions beyond the count limit are
+// turned away as soon as they connect. Once the capture has started arriving its memory use is
+// estimated from the file size, and the session is turned away if that would not fit in the
+// memory that's free - less anything reserved by other sessions that are still loading.
+static const size_t MaxReplayHostSessions = 8;
+static const uint64_t ReplayHostMemoryMultiplier = 3;
+static const uint64_t ReplayHostMemoryHeadroom = 256 * 1024 * 1024;
+
+struct ReplayHostSession;
+
+struct ReplayHost
+{
+  ReplayHost(volatile bool32 &kill) : killReplay(kill), nextID(1), reservedMemory(0) {}
+  volatile bool32 &killReplay;
+
+  Threading::CriticalSection lock;
+  vector<ReplayHostSession *> sessions;
+
+  // drivers keep process-wide state while creating, loading and shutting down (GL's function
+  // pointers and counters, the progress pointer) so only one session does any of that at a time
+  Threading::CriticalSection loadLock;
+
+  uint32_t nextID;
+  uint64_t reservedMemory;
+
+  void LogStatus();
+};
+
+// a single connected client, served on its own thread with its own remote driver and proxy
+struct ReplayHostSession
+{
+  enum Status
+  {
+    eStatus_Connected,
+    eStatus_ReceivingCapture,
+    eStatus_Loading,
+    eStatus_Replaying,
+    eStatus_Finished,
+  };
+
+  ReplayHostSession(ReplayHost &h, uint32_t i, Network::Socket *sock)
+      : host(h), id(i), client(sock), thread(0), status(eStatus_Connected), memoryEstimate(0)
+  {
+  }
+
+  ReplayHost &host;
+  uint32_t id;
+  Network::Socket *client;
+  Threading::ThreadHandle thread;
+
+  volatile int32_t status;
+  string driverName;
+  uint64_t memoryEstimate;
+
+  void SetStatus(Status s)
   {
-    if(newlyReady)
     {
-      RDCLOG("Replay host ready for requests.");
-      newlyReady = false;
+      SCOPED_LOCK(host.lock);
+      status = s;
     }
 
-    Network::Socket *client = sock->AcceptClient(false);
+    host.LogStatus();
+  }
 
-    if(client == NULL)
-    {
-      if(!sock->Connected())
-      {
-        RDCERR("Error in accept - shutting down server");
+  void Run();
+  IRemoteDriver *Load(const string &cap_file, PartialCaptureFile &partial);
+  bool Admit(uint64_t fileSize);
+};
 
-        SAFE_DELETE(sock);
-        return;
-      }
+static const char *ToStr(ReplayHostSession::Status status)
+{
+  switch(status)
+  {
+    case ReplayHostSession::eStatus_Connected: return "Connected";
+    case ReplayHostSession::eStatus_ReceivingCapture: return "Receiving capture";
+    case ReplayHostSession::eStatus_Loading: return "Loading";
+    case ReplayHostSession::eStatus_Replaying: return "Replaying";
+    case ReplayHostSession::eStatus_Finished: return "Finished";
+  }
 
-      Threading::Sleep(5);
+  return "Unknown";
+}
 
-      continue;
-    }
+void ReplayHost::LogStatus()
+{
+  SCOPED_LOCK(lock);
 
-    newlyReady = true;
+  RDCLOG("Replay host: %u session(s), %llu MB reserved for loading", (uint32_t)sessions.size(),
+         reservedMemory / (1024 * 1024));
 
-    RDCLOG("Connection received.");
+  for(size_t i = 0; i < sessions.size(); i++)
+  {
+    ReplayHostSession *s = sessions[i];
+    RDCLOG("  Session %u: %s %s (~%llu MB)", s->id, ToStr((ReplayHostSession::Status)s->status),
+           s->driverName.c_str(), s->memoryEstimate / (1024 * 1024));
+  }
+}
+
+static void SendHostBusy(Network::Socket *sock, string reason)
+{
+  RDCWARN("Turning away replay client: %s", reason.c_str());
 
-    map<RDCDriver, string> drivers = RenderDoc::Inst().GetRemoteDrivers();
+  Serialiser ser("", Serialiser::WRITING, false);
+  ser.Serialise("", reason);
 
-    uint32_t count = (uint32_t)drivers.size();
-    ser.Serialise("", count);
+  SendPacket(sock, ePacket_HostBusy, ser);
+}
 
-    for(auto it = drivers.begin(); it != drivers.end(); ++it)
+bool ReplayHostSession::Admit(uint64_t fileSize)
+{
+  uint64_t estimate = fileSize * ReplayHostMemoryMultiplier;
+  uint64_t available = OSUtility::GetAvailableSystemMemory();
+  uint64_t reserved = 0;
+
+  {
+    SCOPED_LOCK(host.lock);
+
+    reserved = host.reservedMemory;
+
+    // if we can't tell how much memory is free, only the session count limit applies
+    if(available == 0 || reserved + estimate + ReplayHostMemoryHeadroom <= available)
     {
-      RDCDriver driver = it->first;
-      ser.Serialise("", driver);
-      ser.Serialise("", (*it).second);
+      memoryEstimate = estimate;
+      host.reservedMemory += estimate;
+      return true;
     }
+  }
+
+  SendHostBusy(client, StringFormat::Fmt("Not enough memory to load capture (needs ~%llu MB, "
+                                         "%llu MB free with %llu MB reserved by other sessions)",
+                                         estimate / (1024 * 1024), available / (1024 * 1024),
+                                         reserved / (1024 * 1024)));
+
+  return false;
+}
+
+void ReplayHostSession::Run()
+{
+  // blocking sends and receives - the capture transfer, progress ticks, proxied replay calls -
+  // give up when the host is killed, so it isn't left waiting on this session to finish
+  client->SetCancelFlag(&host.killReplay);
+
+  Serialiser ser("", Serialiser::WRITING, false);
+
+  map<RDCDriver, string> drivers = RenderDoc::Inst().GetRemoteDrivers();
+
+  uint32_t count = (uint32_t)drivers.size();
+  ser.Serialise("", count);
+
+  for(auto it = drivers.begin(); it != drivers.end(); ++it)
+  {
+    RDCDriver driver = it->first;
+    ser.Serialise("", driver);
+    ser.Serialise("", (*it).second);
+  }
+
+  if(!SendPacket(client, ePacket_RemoteDriverList, ser))
+  {
+    RDCERR("Network error sending supported driver list");
+    return;
+  }
+
+  Threading::Sleep(4);
+
+  // don't care about the result, just want to check that the socket hasn't been gracefully shut
+  // down
+  client->IsRecvDataWaiting();
+  if(!client->Connected())
+  {
+    RDCLOG("Connection closed after sending remote driver list");
+    return;
+  }
+
+  SetStatus(eStatus_ReceivingCapture);
 
-    if(!SendPacket(client, ePacket_RemoteDriverList, ser))
+  string cap_file;
+  string dummy, dummy2;
+  FileIO::GetDefaultFiles("remotecopy", cap_file, dummy, dummy2);
+
+  // default files are only unique to the minute, so make sure concurrent sessions don't collide
+  if(cap_file.length() > 4 && cap_file.substr(cap_file.length() - 4) == ".rdc")
+    cap_file = cap_file.substr(0, cap_file.length() - 4);
+  cap_file += StringFormat::Fmt("_session%u.rdc", id);
+
+  // the capture is received on its own thread and published as it's written, so identifying and
+  // loading it overlaps with the transfer
+  PartialCaptureFile partial(cap_file.c_str());
+
+  CaptureReceiveData receive;
+  receive.sock = client;
+  receive.path = cap_file;
+  receive.partial = &partial;
+  receive.success = false;
+
+  Threading::ThreadHandle receiver = Threading::CreateThread(ReceiveCaptureThread, &receive);
+
+  IRemoteDriver *driver = Load(cap_file, partial);
+
+  // the replay proxy reads from the same socket, and loading can finish before the sections at
+  // the end of the file have arrived
+  Threading::JoinThread(receiver);
+  Threading::CloseThread(receiver);
+
+  if(!receive.success)
+  {
+    RDCERR("Network error receiving file");
+
+    if(driver)
     {
-      RDCERR("Network error sending supported driver list");
-      SAFE_DELETE(client);
-      continue;
+      SCOPED_LOCK(host.loadLock);
+      driver->Shutdown();
     }
 
-    Threading::Sleep(4);
+    FileIO::Delete(cap_file.c_str());
+    return;
+  }
+
+  RDCLOG("File received.");
 
-    // don't care about the result, just want to check that the socket hasn't been gracefully shut
-    // down
-    client->IsRecvDataWaiting();
-    if(!client->Connected())
+  if(driver == NULL)
+  {
+    FileIO::Delete(cap_file.c_str());
+    return;
+  }
+
+  if(client)
+  {
+    SendPacket(client, ePacket_LogReady);
+
+    SetStatus(eStatus_Replaying);
+
+    ProxySerialiser *proxy = new ProxySerialiser(client, driver);
+
+    while(client)
     {
-      RDCLOG("Connection closed after sending remote driver list");
-      SAFE_DELETE(client);
-      continue;
+      if(!proxy->Tick() || host.killReplay)
+      {
+        SAFE_DELETE(client);
+      }
     }
 
-    string cap_file;
-    string dummy, dummy2;
-    FileIO::GetDefaultFiles("remotecopy", cap_file, dummy, dummy2);
+    SAFE_DELETE(proxy);
+  }
 
-    Serialiser *fileRecv = NULL;
+  {
+    SCOPED_LOCK(host.loadLock);
+    driver->Shutdown();
+  }
 
-    if(!RecvChunkedFile(client, ePacket_CopyCapture, cap_file.c_str(), fileRecv, NULL))
-    {
-      FileIO::Delete(cap_file.c_str());
+  // sections after the frame capture are read from the file when they're first needed, so it's
+  // kept until the driver is gone
+  FileIO::Delete(cap_file.c_str());
 
-      RDCERR("Network error receiving file");
+  RDCLOG("Closing replay connection for session %u", id);
 
-      SAFE_DELETE(fileRecv);
-      SAFE_DELETE(client);
-      continue;
-    }
+  {
+    SCOPED_LOCK(host.lock);
+    RenderDoc::Inst().WriteProfileTrace(id);
+  }
+}
 
-    RDCLOG("File received.");
+IRemoteDriver *ReplayHostSession::Load(const string &cap_file, PartialCaptureFile &partial)
+{
+  // wait for the start of the file, so it exists to be opened
+  if(!partial.WaitFor(1))
+    return NULL;
 
-    SAFE_DELETE(fileRecv);
+  RDCDriver driverType = RDC_Unknown;
+  ReplayCreateStatus status =
+      RenderDoc::Inst().FillInitParams(cap_file.c_str(), driverType, driverName, NULL);
+
+  // only captures can be read while they arrive, anything else - e.g. an image - is identified
+  // and loaded once it's complete
+  if(status != eReplayCreate_Success || driverType == RDC_Image)
+  {
+    if(!partial.WaitForComplete())
+      return NULL;
 
-    RDCDriver driverType = RDC_Unknown;
-    string driverName = "";
     RenderDoc::Inst().FillInitParams(cap_file.c_str(), driverType, driverName, NULL);
+  }
 
-    if(RenderDoc::Inst().HasRemoteDriver(driverType))
-    {
-      ProgressLoopData data;
+  if(!RenderDoc::Inst().HasRemoteDriver(driverType))
+  {
+    RDCERR("File needs driver for %s which isn't supported!", driverName.c_str());
+    return NULL;
+  }
 
-      data.sock = client;
-      data.killsignal = false;
-      data.progress = 0.0f;
+  if(!Admit(partial.GetLength()))
+    return NULL;
 
-      RenderDoc::Inst().SetProgressPtr(&data.progress);
+  SetStatus(eStatus_Loading);
 
-      Threading::ThreadHandle ticker = Threading::CreateThread(ProgressTicker, &data);
+  ProgressLoopData data;
 
-      IRemoteDriver *driver = NULL;
-      auto status = RenderDoc::Inst().CreateRemoteDriver(driverType, cap_file.c_str(), &driver);
+  data.sock = client;
+  data.killsignal = false;
+  data.progress = 0.0f;
 
-      if(status != eReplayCreate_Success || driver == NULL)
-      {
-        RDCERR("Failed to create remote driver for driver type %d name %s", driverType,
-               driverName.c_str());
-        SAFE_DELETE(client);
-        continue;
-      }
+  Threading::ThreadHandle ticker = Threading::CreateThread(ProgressTicker, &data);
+
+  IRemoteDriver *driver = NULL;
+  status = eReplayCreate_UnknownError;
+
+  // loading reads the frame capture under loadLock, so wait for it to arrive first - otherwise a
+  // slow upload would hold up every other session's load. The sections after it carry on
+  // arriving and are read when they're needed. If where it ends isn't known, wait for all of it
+  uint64_t frameCaptureEnd = partial.GetFrameCaptureEnd();
+  bool arrived = frameCaptureEnd > 0 ? partial.WaitFor(frameCaptureEnd) : partial.WaitForComplete();
+
+  if(arrived)
+  {
+    SCOPED_LOCK(host.loadLock);
 
-      driver->ReadLogInitialisation();
+    // the host may have been killed while this session queued behind another load
+    if(!host.killReplay)
+    {
+      RenderDoc::Inst().SetProgressPtr(&data.progress);
+
+      status = RenderDoc::Inst().CreateRemoteDriver(driverType, cap_file.c_str(), &driver);
+
+      if(status == eReplayCreate_Success && driver != NULL)
+        driver->ReadLogInitialisation();
 
       RenderDoc::Inst().SetProgressPtr(NULL);
+    }
+  }
+
+  data.killsignal = true;
+  Threading::JoinThread(ticker);
+  Threading::CloseThread(ticker);
 
-      data.killsignal = true;
-      Threading::JoinThread(ticker);
-      Threading::CloseThread(ticker);
+  // whatever was going to be allocated by loading now has been, so stop reserving it
+  {
+    SCOPED_LOCK(host.lock);
+    host.reservedMemory -= memoryEstimate;
+  }
 
-      FileIO::Delete(cap_file.c_str());
+  if(status != eReplayCreate_Success || driver == NULL)
+  {
+    RDCERR("Failed to create remote driver for driver type %d name %s", driverType,
+           driverName.c_str());
+    return NULL;
+  }
 
-      SendPacket(client, ePacket_LogReady);
+  return driver;
+}
+
+static void ReplayHostSessionThread(void *s)
+{
+  ReplayHostSession *session = (ReplayHostSession *)s;
 
-      ProxySerialiser *proxy = new ProxySerialiser(client, driver);
+  session->Run();
 
-      while(client)
+  SAFE_DELETE(session->client);
+
+  session->SetStatus(ReplayHostSession::eStatus_Finished);
+}
+
+void RenderDoc::BecomeReplayHost(volatile bool32 &killReplay)
+{
+  Network::Socket *sock = Network::CreateServerSocket("0.0.0.0", RenderDoc_ReplayNetworkPort, 4);
+
+  if(sock == NULL)
+    return;
+
+  ReplayHost host(killReplay);
+
+  RDCLOG("Replay host ready for requests.");
+
+  while(!killReplay)
+  {
+    // wait for a connection, but wake up periodically to check for the kill signal
+    Network::Socket *client = sock->AcceptClient(100);
+
+    // reap any sessions that have finished
+    {
+      SCOPED_LOCK(host.lock);
+
+      for(size_t i = 0; i < host.sessions.size();)
       {
-        if(!proxy->Tick() || killReplay)
+        ReplayHostSession *session = host.sessions[i];
+
+        if(session->status == ReplayHostSession::eStatus_Finished)
+        {
+          Threading::JoinThread(session->thread);
+          Threading::CloseThread(session->thread);
+          delete session;
+
+          host.sessions.erase(host.sessions.begin() + i);
+        }
+        else
         {
-          SAFE_DELETE(client);
+          i++;
         }
       }
+    }
 
-      driver->Shutdown();
-
-      RDCLOG("Closing replay connection");
+    if(client == NULL)
+    {
+      if(!sock->Connected())
+      {
+        RDCERR("Error in accept - shutting down server");
+        break;
+      }
 
-      SAFE_DELETE(proxy);
-      SAFE_DELETE(client);
+      continue;
     }
-    else
+
+    RDCLOG("Connection received.");
+
+    ReplayHostSession *session = NULL;
+
     {
-      RDCERR("File needs driver for %s which isn't supported!", driverName.c_str());
+      SCOPED_LOCK(host.lock);
 
-      FileIO::Delete(cap_file.c_str());
+      if(host.sessions.size() < MaxReplayHostSessions)
+      {
+        session = new ReplayHostSession(host, host.nextID++, client);
+        host.sessions.push_back(session);
+      }
     }
 
-    SAFE_DELETE(client);
+    if(session == NULL)
+    {
+      SendHostBusy(client, StringFormat::Fmt("Replay host is already serving %u sessions",
+                                             (uint32_t)MaxReplayHostSessions));
+      SAFE_DELETE(client);
+      continue;
+    }
+
+    host.LogStatus();
+
+    session->thread = Threading::CreateThread(ReplayHostSessionThread, session);
+  }
+
+  // sessions that are replaying see the kill signal and disconnect, wait for them all to finish
+  for(size_t i = 0; i < host.sessions.size(); i++)
+  {
+    Threading::JoinThread(host.sessions[i]->thread);
+    Threading::CloseThread(host.sessions[i]->thread);
+    delete host.sessions[i];
   }
 
   SAFE_DELETE(sock);
@@ -234,7 +541,7 @@ void RenderDoc::BecomeReplayHost(volatile bool32 &killReplay)
 struct RemoteRenderer : public IRemoteRenderer
 {
 public:
-  RemoteRenderer(Network::Socket *sock) : m_Socket(sock)
+  RemoteRenderer(Network::Socket *sock) : m_Socket(sock), m_Busy(false)
   {
     map<RDCDriver, string> m = RenderDoc::Inst().GetReplayDrivers();
 
@@ -249,6 +556,18 @@ public:
 
       m.clear();
 
+      if(ser && type == ePacket_HostBusy)
+      {
+        string reason;
+        ser->Serialise("", reason);
+
+        RDCERR("Replay host is busy: %s", reason.c_str());
+
+        m_Busy = true;
+        SAFE_DELETE(ser);
+        SAFE_DELETE(m_Socket);
+      }
+
       if(ser)
       {
         uint32_t count = 0;
@@ -275,6 +594,7 @@ public:
   virtual ~RemoteRenderer() { SAFE_DELETE(m_Socket); }
   void Shutdown() { delete this; }
   bool Connected() { return m_Socket != NULL && m_Socket->Connected(); }
+  bool Busy() { return m_Busy; }
   bool LocalProxies(rdctype::array<rdctype::str> *out)
   {
     if(out == NULL)
@@ -338,10 +658,27 @@ public:
       GetPacket(type, &progressSer);
 
       if(!m_Socket || type != ePacket_LogOpenProgress)
+      {
+        if(m_Socket && type == ePacket_HostBusy)
+        {
+          string reason;
+          progressSer->Serialise("", reason);
+
+          RDCERR("Replay host is busy: %s", reason.c_str());
+
+          SAFE_DELETE(progressSer);
+          SAFE_DELETE(m_Socket);
+          return eReplayCreate_NetworkRemoteBusy;
+        }
+
+        SAFE_DELETE(progressSer);
         break;
+      }
 
       progressSer->Serialise("", *progress);
 
+      SAFE_DELETE(progressSer);
+
       RDCLOG("% 3.0f%%...", (*progress) * 100.0f);
     }
 
@@ -355,11 +692,16 @@ public:
     IReplayDriver *proxyDriver = NULL;
     auto status = RenderDoc::Inst().CreateReplayDriver(proxydrivertype, NULL, &proxyDriver);
 
+    // without a local renderer the capture can still be inspected, there's just no display. The
+    // proxy serialiser handles a NULL proxy, and calculates texture min/max and histograms on the
+    // CPU instead
     if(status != eReplayCreate_Success || !proxyDriver)
     {
+      RDCWARN("Couldn't create local proxy renderer (%d), continuing without display", status);
+
       if(proxyDriver)
         proxyDriver->Shutdown();
-      return status;
+      proxyDriver = NULL;
     }
 
     ReplayRenderer *ret = new ReplayRenderer();
@@ -383,6 +725,7 @@ public:
 
 private:
   Network::Socket *m_Socket;
+  bool m_Busy;
 
   void GetPacket(PacketType &type, Serialiser **ser)
   {
@@ -448,7 +791,15 @@ RENDERDOC_CreateRemoteReplayConnection(const char *host, RemoteRenderer **rend)
       return eReplayCreate_NetworkIOFailed;
   }
 
-  *rend = new RemoteRenderer(sock);
+  RemoteRenderer *remote = new RemoteRenderer(sock);
+
+  if(remote->Busy())
+  {
+    remote->Shutdown();
+    return eReplayCreate_NetworkRemoteBusy;
+  }
+
+  *rend = remote;
 
   return eReplayCreate_Success;
 }
@@ -1368,6 +1368,20 @@ void Serialiser::Serialise(const char *name, MeshFormat &el)
   SIZE_CHECK(MeshFormat, 104);
 }
 
+template <>
+void Serialiser::Serialise(const char *name, TextureDataRequest &el)
+{
+  Serialise("", el.tex);
+  Serialise("", el.arrayIdx);
+  Serialise("", el.mip);
+  Serialise("", el.resolve);
+  Serialise("", el.forceRGBA8unorm);
+  Serialise("", el.blackPoint);
+  Serialise("", el.whitePoint);
+
+  SIZE_CHECK(TextureDataRequest, 32);
+}
+
 template <>
 void Serialiser::Serialise(const char *name, CounterDescription &el)
 {
@@ -1721,6 +1735,53 @@ void ProxySerialiser::EnsureTexCached(ResourceId texid, uint32_t arrayIdx, uint3
   }
 }
 
+bool ProxySerialiser::FetchCPUSlice(ResourceId texid, uint32_t sliceFace, uint32_t mip)
+{
+  TextureCacheEntry entry = {texid, sliceFace, mip};
+
+  if(m_CPUSliceValid && !(m_CPUSlice.entry < entry) && !(entry < m_CPUSlice.entry))
+    return true;
+
+  m_CPUSliceValid = false;
+  m_CPUSlice.data.clear();
+
+  FetchTexture tex = GetTexture(texid);
+
+  uint32_t texelSize = GetFloat4TexelSize(tex.format);
+
+  if(texelSize == 0 || mip >= tex.mips)
+    return false;
+
+  // 3D textures fetch the whole mip, and sliceFace selects the depth slice within it
+  size_t size = 0;
+  byte *data = GetTextureData(texid, tex.dimension == 3 ? 0 : sliceFace, mip, false, false, 0.0f,
+                              0.0f, size);
+
+  if(data == NULL)
+    return false;
+
+  m_CPUSlice.entry = entry;
+  m_CPUSlice.format = tex.format;
+  m_CPUSlice.width = RDCMAX(1U, tex.width >> mip);
+  m_CPUSlice.height = RDCMAX(1U, tex.height >> mip);
+
+  size_t sliceSize = size_t(m_CPUSlice.width) * m_CPUSlice.height * texelSize;
+  size_t offset = 0;
+
+  if(tex.dimension == 3)
+    offset = RDCMIN(sliceFace, RDCMAX(1U, tex.depth >> mip) - 1) * sliceSize;
+
+  if(size >= offset + sliceSize)
+  {
+    m_CPUSlice.data.assign(data + offset, data + offset + sliceSize);
+    m_CPUSliceValid = true;
+  }
+
+  delete[] data;
+
+  return m_CPUSliceValid;
+}
+
 void ProxySerialiser::EnsureBufCached(ResourceId bufid)
 {
   if(m_BufferProxyCache.find(bufid) == m_BufferProxyCache.end())
@@ -1772,6 +1833,12 @@ bool ProxySerialiser::Tick()
     case eCommand_GetDebugMessages: GetDebugMessages(); break;
     case eCommand_SavePipelineState: SavePipelineState(); break;
     case eCommand_GetUsage: GetUsage(ResourceId()); break;
+    case eCommand_GetUsages:
+    {
+      vector<ResourceId> ids;
+      GetUsages(ids);
+      break;
+    }
     case eCommand_GetLiveID: GetLiveID(ResourceId()); break;
     case eCommand_GetFrameRecord: GetFrameRecord(); break;
     case eCommand_IsRenderOutput: IsRenderOutput(ResourceId()); break;
@@ -1819,6 +1886,12 @@ bool ProxySerialiser::Tick()
       InitPostVSBuffers(dummy);
       break;
     }
+    case eCommand_PinPostVS:
+    {
+      vector<uint32_t> dummy;
+      PinPostVSBuffers(dummy);
+      break;
+    }
     case eCommand_GetPostVS: GetPostVSBuffers(0, 0, eMeshDataStage_Unknown); break;
     case eCommand_BuildTargetShader:
       BuildTargetShader("", "", 0, eShaderStage_Vertex, NULL, NULL);
@@ -1831,6 +1904,12 @@ bool ProxySerialiser::Tick()
     case eCommand_PixelHistory:
       PixelHistory(vector<EventUsage>(), ResourceId(), 0, 0, 0, 0, 0);
       break;
+    case eCommand_GetTextureDataBatch:
+    {
+      vector<TextureDataRequest> dummy;
+      GetTextureDataBatch(dummy, NULL);
+      break;
+    }
     case eCommand_DebugVertex: DebugVertex(0, 0, 0, 0, 0, 0); break;
     case eCommand_DebugPixel: DebugPixel(0, 0, 0, 0, 0); break;
     case eCommand_DebugThread:
@@ -1996,20 +2075,34 @@ FetchBuffer ProxySerialiser::GetBuffer(ResourceId id)
   return ret;
 }
 
-void ProxySerialiser::SavePipelineState()
+uint32_t ProxySerialiser::SavePipelineState()
 {
+  uint32_t changes = ePipeChange_All;
+
+  if(m_ReplayHost)
+  {
+    changes = m_Remote->SavePipelineState();
+  }
+  else
+  {
+    if(!SendReplayCommand(eCommand_SavePipelineState))
+      return changes;
+  }
+
+  m_FromReplaySerialiser->Serialise("", changes);
+
+  // the state is only sent again when something in it changed
+  if(changes == ePipeChange_None)
+    return changes;
+
   if(m_ReplayHost)
   {
-    m_Remote->SavePipelineState();
     m_D3D11PipelineState = m_Remote->GetD3D11PipelineState();
     m_GLPipelineState = m_Remote->GetGLPipelineState();
     m_VulkanPipelineState = m_Remote->GetVulkanPipelineState();
   }
   else
   {
-    if(!SendReplayCommand(eCommand_SavePipelineState))
-      return;
-
     m_D3D11PipelineState = D3D11PipelineState();
     m_GLPipelineState = GLPipelineState();
     m_VulkanPipelineState = VulkanPipelineState();
@@ -2018,6 +2111,8 @@ void ProxySerialiser::SavePipelineState()
   m_FromReplaySerialiser->Serialise("", m_D3D11PipelineState);
   m_FromReplaySerialiser->Serialise("", m_GLPipelineState);
   m_FromReplaySerialiser->Serialise("", m_VulkanPipelineState);
+
+  return changes;
 }
 
 void ProxySerialiser::SetContextFilter(ResourceId id, uint32_t firstDefEv, uint32_t lastDefEv)
@@ -2053,6 +2148,7 @@ void ProxySerialiser::ReplayLog(uint32_t endEventID, ReplayLogType replayType)
 
     m_TextureProxyCache.clear();
     m_BufferProxyCache.clear();
+    m_CPUSliceValid = false;
   }
 }
 
@@ -2098,6 +2194,27 @@ vector<EventUsage> ProxySerialiser::GetUsage(ResourceId id)
   return ret;
 }
 
+vector<vector<EventUsage> > ProxySerialiser::GetUsages(const vector<ResourceId> &ids)
+{
+  vector<vector<EventUsage> > ret;
+
+  m_ToReplaySerialiser->Serialise("", (vector<ResourceId> &)ids);
+
+  if(m_ReplayHost)
+  {
+    ret = m_Remote->GetUsages(ids);
+  }
+  else
+  {
+    if(!SendReplayCommand(eCommand_GetUsages))
+      return ret;
+  }
+
+  m_FromReplaySerialiser->Serialise("", ret);
+
+  return ret;
+}
+
 FetchFrameRecord ProxySerialiser::GetFrameRecord()
 {
   FetchFrameRecord ret;
@@ -2284,6 +2401,36 @@ void ProxySerialiser::GetBufferData(ResourceId buff, uint64_t offset, uint64_t l
   }
 }
 
+static void WriteTextureData(Serialiser *ser, byte *data, size_t dataSize)
+{
+  byte *compressed = new byte[dataSize + 512];
+
+  size_t compressedSize =
+      (size_t)LZ4_compress((const char *)data, (char *)compressed, (int)dataSize);
+
+  ser->Serialise("", dataSize);
+  ser->Serialise("", compressedSize);
+  ser->RawWriteBytes(compressed, compressedSize);
+
+  delete[] compressed;
+}
+
+static byte *ReadTextureData(Serialiser *ser, size_t &dataSize)
+{
+  size_t compressedSize;
+
+  ser->Serialise("", dataSize);
+  ser->Serialise("", compressedSize);
+
+  byte *ret = new byte[dataSize + 512];
+
+  byte *compressed = (byte *)ser->RawReadBytes(compressedSize);
+
+  LZ4_decompress_fast((const char *)compressed, (char *)ret, (int)dataSize);
+
+  return ret;
+}
+
 byte *ProxySerialiser::GetTextureData(ResourceId tex, uint32_t arrayIdx, uint32_t mip, bool resolve,
                                       bool forceRGBA8unorm, float blackPoint, float whitePoint,
                                       size_t &dataSize)
@@ -2301,38 +2448,75 @@ byte *ProxySerialiser::GetTextureData(ResourceId tex, uint32_t arrayIdx, uint32_
     byte *data = m_Remote->GetTextureData(tex, arrayIdx, mip, resolve, forceRGBA8unorm, blackPoint,
                                           whitePoint, dataSize);
 
-    byte *compressed = new byte[dataSize + 512];
-
-    size_t compressedSize =
-        (size_t)LZ4_compress((const char *)data, (char *)compressed, (int)dataSize);
-
-    m_FromReplaySerialiser->Serialise("", dataSize);
-    m_FromReplaySerialiser->Serialise("", compressedSize);
-    m_FromReplaySerialiser->RawWriteBytes(compressed, compressedSize);
+    WriteTextureData(m_FromReplaySerialiser, data, dataSize);
 
     delete[] data;
-    delete[] compressed;
   }
   else
   {
     if(!SendReplayCommand(eCommand_GetTextureData))
       return NULL;
 
-    size_t compressedSize;
+    return ReadTextureData(m_FromReplaySerialiser, dataSize);
+  }
 
-    m_FromReplaySerialiser->Serialise("", dataSize);
-    m_FromReplaySerialiser->Serialise("", compressedSize);
+  return NULL;
+}
 
-    byte *ret = new byte[dataSize + 512];
+// on the replay host, writes each subresource into the reply as the remote driver returns it
+class ProxyTextureDataWriter : public TextureDataReceiver
+{
+public:
+  ProxyTextureDataWriter(Serialiser *ser) : m_Ser(ser) {}
+  void ReceiveTextureData(size_t requestIdx, byte *data, size_t dataSize)
+  {
+    bool valid = (data != NULL);
+    m_Ser->Serialise("", valid);
 
-    byte *compressed = (byte *)m_FromReplaySerialiser->RawReadBytes(compressedSize);
+    if(valid)
+      WriteTextureData(m_Ser, data, dataSize);
 
-    LZ4_decompress_fast((const char *)compressed, (char *)ret, (int)dataSize);
+    delete[] data;
+  }
 
-    return ret;
+private:
+  Serialiser *m_Ser;
+};
+
+void ProxySerialiser::GetTextureDataBatch(const vector<TextureDataRequest> &requests,
+                                          TextureDataReceiver *receiver)
+{
+  m_ToReplaySerialiser->Serialise("", (vector<TextureDataRequest> &)requests);
+
+  if(m_ReplayHost)
+  {
+    ProxyTextureDataWriter writer(m_FromReplaySerialiser);
+    m_Remote->GetTextureDataBatch(requests, &writer);
   }
+  else
+  {
+    if(!SendReplayCommand(eCommand_GetTextureDataBatch))
+    {
+      for(size_t i = 0; i < requests.size(); i++)
+        receiver->ReceiveTextureData(i, NULL, 0);
+      return;
+    }
 
-  return NULL;
+    // the whole batch comes back in one reply, hand each subresource on as it's decompressed
+    for(size_t i = 0; i < requests.size(); i++)
+    {
+      bool valid = false;
+      m_FromReplaySerialiser->Serialise("", valid);
+
+      size_t dataSize = 0;
+      byte *data = NULL;
+
+      if(valid)
+        data = ReadTextureData(m_FromReplaySerialiser, dataSize);
+
+      receiver->ReceiveTextureData(i, data, dataSize);
+    }
+  }
 }
 
 void ProxySerialiser::InitPostVSBuffers(uint32_t eventID)
@@ -2365,6 +2549,21 @@ void ProxySerialiser::InitPostVSBuffers(const vector<uint32_t> &events)
   }
 }
 
+void ProxySerialiser::PinPostVSBuffers(const vector<uint32_t> &events)
+{
+  m_ToReplaySerialiser->Serialise("", (vector<uint32_t> &)events);
+
+  if(m_ReplayHost)
+  {
+    m_Remote->PinPostVSBuffers(events);
+  }
+  else
+  {
+    if(!SendReplayCommand(eCommand_PinPostVS))
+      return;
+  }
+}
+
 MeshFormat ProxySerialiser::GetPostVSBuffers(uint32_t eventID, uint32_t instID, MeshDataStage stage)
 {
   MeshFormat ret;
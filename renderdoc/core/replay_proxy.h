@@ -27,6 +27,7 @@
 
 #include "os/os_specific.h"
 #include "replay/replay_driver.h"
+#include "replay/texture_stats.h"
 #include "serialise/serialiser.h"
 #include "socket_helpers.h"
 
@@ -82,6 +83,10 @@ enum CommandPacketType
   eCommand_GetAPIProperties,
 
   eCommand_PixelHistory,
+
+  eCommand_GetTextureDataBatch,
+  eCommand_GetUsages,
+  eCommand_PinPostVS,
 };
 
 // This class implements IReplayDriver and StackResolver. On the local machine where the UI
@@ -99,6 +104,7 @@ public:
     m_FromReplaySerialiser = NULL;
     m_ToReplaySerialiser = new Serialiser(NULL, Serialiser::WRITING, false);
     m_RemoteHasResolver = false;
+    m_CPUSliceValid = false;
   }
 
   ProxySerialiser(Network::Socket *sock, IRemoteDriver *remote)
@@ -107,6 +113,7 @@ public:
     m_ToReplaySerialiser = NULL;
     m_FromReplaySerialiser = new Serialiser(NULL, Serialiser::WRITING, false);
     m_RemoteHasResolver = false;
+    m_CPUSliceValid = false;
   }
 
   virtual ~ProxySerialiser();
@@ -183,6 +190,12 @@ public:
       EnsureTexCached(texid, sliceFace, mip);
       return m_Proxy->GetMinMax(m_ProxyTextureIds[texid], sliceFace, mip, sample, minval, maxval);
     }
+    else if(!m_ReplayHost && FetchCPUSlice(texid, sliceFace, mip))
+    {
+      return TextureStats::GetMinMax(m_CPUSlice.format, &m_CPUSlice.data[0],
+                                     m_CPUSlice.data.size(), m_CPUSlice.width, m_CPUSlice.height,
+                                     minval, maxval);
+    }
 
     return false;
   }
@@ -196,6 +209,12 @@ public:
       return m_Proxy->GetHistogram(m_ProxyTextureIds[texid], sliceFace, mip, sample, minval, maxval,
                                    channels, histogram);
     }
+    else if(!m_ReplayHost && FetchCPUSlice(texid, sliceFace, mip))
+    {
+      return TextureStats::GetHistogram(m_CPUSlice.format, &m_CPUSlice.data[0],
+                                        m_CPUSlice.data.size(), m_CPUSlice.width,
+                                        m_CPUSlice.height, minval, maxval, channels, histogram);
+    }
 
     return false;
   }
@@ -339,7 +358,7 @@ public:
 
   vector<DebugMessage> GetDebugMessages();
 
-  void SavePipelineState();
+  uint32_t SavePipelineState();
   D3D11PipelineState GetD3D11PipelineState() { return m_D3D11PipelineState; }
   GLPipelineState GetGLPipelineState() { return m_GLPipelineState; }
   VulkanPipelineState GetVulkanPipelineState() { return m_VulkanPipelineState; }
@@ -349,6 +368,7 @@ public:
   vector<uint32_t> GetPassEvents(uint32_t eventID);
 
   vector<EventUsage> GetUsage(ResourceId id);
+  vector<vector<EventUsage> > GetUsages(const vector<ResourceId> &ids);
   FetchFrameRecord GetFrameRecord();
 
   bool IsRenderOutput(ResourceId id);
@@ -365,9 +385,12 @@ public:
   void GetBufferData(ResourceId buff, uint64_t offset, uint64_t len, vector<byte> &retData);
   byte *GetTextureData(ResourceId tex, uint32_t arrayIdx, uint32_t mip, bool resolve,
                        bool forceRGBA8unorm, float blackPoint, float whitePoint, size_t &dataSize);
+  void GetTextureDataBatch(const vector<TextureDataRequest> &requests,
+                           TextureDataReceiver *receiver);
 
   void InitPostVSBuffers(uint32_t eventID);
   void InitPostVSBuffers(const vector<uint32_t> &passEvents);
+  void PinPostVSBuffers(const vector<uint32_t> &events);
   MeshFormat GetPostVSBuffers(uint32_t eventID, uint32_t instID, MeshDataStage stage);
 
   ResourceId RenderOverlay(ResourceId texid, TextureDisplayOverlay overlay, uint32_t eventID,
@@ -428,6 +451,10 @@ private:
   void EnsureTexCached(ResourceId texid, uint32_t arrayIdx, uint32_t mip);
   void EnsureBufCached(ResourceId bufid);
 
+  // without a local proxy renderer, min/max and histograms are calculated on the CPU from the
+  // texture data. Returns false if the slice is empty or in a format that can't be decoded
+  bool FetchCPUSlice(ResourceId texid, uint32_t sliceFace, uint32_t mip);
+
   struct TextureCacheEntry
   {
     ResourceId replayid;
@@ -444,6 +471,17 @@ private:
     }
   };
   set<TextureCacheEntry> m_TextureProxyCache;
+
+  // the last slice fetched by FetchCPUSlice, as min/max and histograms are usually requested
+  // together
+  struct CPUTextureSlice
+  {
+    TextureCacheEntry entry;
+    ResourceFormat format;
+    uint32_t width, height;
+    vector<byte> data;
+  } m_CPUSlice;
+  bool m_CPUSliceValid;
   set<ResourceId> m_LocalTextures;
   map<ResourceId, ResourceId> m_ProxyTextureIds;
 
@@ -24,6 +24,7 @@
  ******************************************************************************/
 
 #include "resource_manager.h"
+#include <algorithm>
 
 namespace ResourceIDGen
 {
@@ -47,6 +48,75 @@ void SetReplayResourceIDs()
 }
 };
 
+struct ChunkListCursor
+{
+  int32_t id;
+  uint32_t list;
+  size_t idx;
+
+  // std heaps are max-heaps, so order 'greater' to pop the lowest ID - and for equal IDs the
+  // earliest list - first
+  bool operator<(const ChunkListCursor &o) const
+  {
+    if(id != o.id)
+      return id > o.id;
+    return list > o.list;
+  }
+};
+
+void ChunkListMerger::Merge(std::vector<Chunk *> &sorted) const
+{
+  sorted.clear();
+  sorted.reserve(m_NumChunks);
+
+  if(m_Lists.size() == 1)
+  {
+    const ChunkList &list = *m_Lists[0];
+    for(size_t i = 0; i < list.size(); i++)
+      sorted.push_back(list[i].second);
+    return;
+  }
+
+  std::vector<ChunkListCursor> heap;
+  heap.reserve(m_Lists.size());
+
+  for(uint32_t l = 0; l < (uint32_t)m_Lists.size(); l++)
+  {
+    ChunkListCursor c = {(*m_Lists[l])[0].first, l, 0};
+    heap.push_back(c);
+  }
+
+  std::make_heap(heap.begin(), heap.end());
+
+  int32_t lastID = 0;
+
+  while(!heap.empty())
+  {
+    std::pop_heap(heap.begin(), heap.end());
+    ChunkListCursor &c = heap.back();
+
+    const ChunkList &list = *m_Lists[c.list];
+
+    if(sorted.empty() || c.id != lastID)
+    {
+      sorted.push_back(list[c.idx].second);
+      lastID = c.id;
+    }
+
+    c.idx++;
+
+    if(c.idx < list.size())
+    {
+      c.id = list[c.idx].first;
+      std::push_heap(heap.begin(), heap.end());
+    }
+    else
+    {
+      heap.pop_back();
+    }
+  }
+}
+
 void ResourceRecord::MarkResourceFrameReferenced(ResourceId id, FrameRefType refType)
 {
   if(id == ResourceId())
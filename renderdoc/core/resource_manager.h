@@ -25,12 +25,15 @@
 
 #pragma once
 
+#include <algorithm>
 #include <map>
 #include <set>
+#include <vector>
 #include "api/replay/renderdoc_replay.h"
 #include "common/threading.h"
 #include "core/core.h"
 #include "os/os_specific.h"
+#include "serialise/chunk_store.h"
 #include "serialise/serialiser.h"
 
 using std::set;
@@ -65,6 +68,34 @@ void SetReplayResourceIDs();
 
 struct ResourceRecord;
 
+// a record's chunks, sorted by ID. IDs come from a global counter so almost all chunks are
+// appended at the end.
+typedef std::vector<std::pair<int32_t, Chunk *> > ChunkList;
+
+// gathers the chunk lists of all the records being written out, then merges them into a single
+// list in ID order.
+class ChunkListMerger
+{
+public:
+  ChunkListMerger() : m_NumChunks(0) {}
+  void Add(const ChunkList &list)
+  {
+    if(list.empty())
+      return;
+
+    m_Lists.push_back(&list);
+    m_NumChunks += list.size();
+  }
+
+  size_t NumChunks() const { return m_NumChunks; }
+  // if the same ID is in several lists, only the chunk from the first list added is kept
+  void Merge(std::vector<Chunk *> &sorted) const;
+
+private:
+  std::vector<const ChunkList *> m_Lists;
+  size_t m_NumChunks;
+};
+
 class ResourceRecordHandler
 {
 public:
@@ -133,7 +164,7 @@ struct ResourceRecord
   }
 
   void MarkDataUnwritten() { DataWritten = false; }
-  void Insert(map<int32_t, Chunk *> &recordlist)
+  void Insert(ChunkListMerger &recordlist)
   {
     bool dataWritten = DataWritten;
 
@@ -148,7 +179,7 @@ struct ResourceRecord
     }
 
     if(!dataWritten)
-      recordlist.insert(m_Chunks.begin(), m_Chunks.end());
+      recordlist.Add(m_Chunks);
   }
 
   void AddRef() { Atomic::Inc32(&RefCount); }
@@ -175,8 +206,26 @@ struct ResourceRecord
     LockChunks();
     if(ID == 0)
       ID = GetID();
-    m_Chunks[ID] = chunk;
+    if(m_Chunks.empty() || m_Chunks.back().first < ID)
+    {
+      m_Chunks.push_back(std::make_pair(ID, chunk));
+    }
+    else
+    {
+      // explicit IDs can go anywhere, and with several threads recording into one record the
+      // IDs can arrive slightly out of order
+      auto it = std::lower_bound(m_Chunks.begin(), m_Chunks.end(),
+                                 std::make_pair(ID, (Chunk *)NULL), ChunkIDLess);
+      if(it != m_Chunks.end() && it->first == ID)
+        it->second = chunk;
+      else
+        m_Chunks.insert(it, std::make_pair(ID, chunk));
+    }
     UnlockChunks();
+
+    // records can hold chunks for as long as the resource lives, so let them be spilled
+    if(ChunkStore::Get())
+      ChunkStore::Get()->Register(chunk);
   }
 
   void LockChunks()
@@ -214,16 +263,16 @@ struct ResourceRecord
   Chunk *GetLastChunk() const
   {
     RDCASSERT(HasChunks());
-    return m_Chunks.rbegin()->second;
+    return m_Chunks.back().second;
   }
 
   int32_t GetLastChunkID() const
   {
     RDCASSERT(HasChunks());
-    return m_Chunks.rbegin()->first;
+    return m_Chunks.back().first;
   }
 
-  void PopChunk() { m_Chunks.erase(m_Chunks.rbegin()->first); }
+  void PopChunk() { m_Chunks.pop_back(); }
   byte *GetDataPtr() { return DataPtr + DataOffset; }
   bool HasDataPtr() { return DataPtr != NULL; }
   void SetDataOffset(uint64_t offs) { DataOffset = offs; }
@@ -260,7 +309,12 @@ protected:
     return Atomic::Inc32(&globalIDCounter);
   }
 
-  std::map<int32_t, Chunk *> m_Chunks;
+  static bool ChunkIDLess(const ChunkList::value_type &a, const ChunkList::value_type &b)
+  {
+    return a.first < b.first;
+  }
+
+  ChunkList m_Chunks;
   Threading::CriticalSection *m_ChunkLock;
 
   map<ResourceId, FrameRefType> m_FrameRefs;
@@ -319,8 +373,10 @@ public:
   void MarkInFrame(bool inFrame) { m_InFrame = inFrame; }
   void ReleaseInFrameResources();
 
-  // insert the chunks for the resources referenced in the frame
-  void InsertReferencedChunks(Serialiser *fileSer);
+  // insert the chunks for the resources referenced in the frame. If heldRecords is given, each
+  // inserted record gets a reference added and is returned there, so that its chunks outlive the
+  // resource until the file has been written and the records are Delete()d
+  void InsertReferencedChunks(Serialiser *fileSer, vector<RecordType *> *heldRecords = NULL);
 
   // mark resource records as unwritten, ready to be written to a new logfile.
   void MarkUnwrittenResources();
@@ -417,6 +473,17 @@ protected:
   virtual bool Prepare_InitialState(WrappedResourceType res) = 0;
   virtual bool Serialise_InitialState(ResourceId id, WrappedResourceType res) = 0;
   virtual void Create_InitialState(ResourceId id, WrappedResourceType live, bool hasData) = 0;
+
+  // optionally, the initial states of some resources can be serialised on worker threads once
+  // their readbacks are complete. Serialise_InitialStateParallel writes to the serialiser it's
+  // given instead of m_pSerialiser, and mustn't call back into the resource manager - the
+  // initial contents are looked up beforehand.
+  virtual bool AllowParallel_InitialState(ResourceId id, WrappedResourceType res) { return false; }
+  virtual void Serialise_InitialStateParallel(Serialiser *ser, ResourceId id,
+                                              WrappedResourceType res,
+                                              const InitialContentData &contents)
+  {
+  }
   virtual void Apply_InitialState(WrappedResourceType live, InitialContentData initial) = 0;
 
   LogState m_State;
@@ -425,6 +492,26 @@ protected:
   Serialiser *GetSerialiser() { return m_pSerialiser; }
   bool m_InFrame;
 
+  struct InitialStateJob
+  {
+    ResourceId id;
+    WrappedResourceType res;
+    InitialContentData contents;
+    Chunk *chunk;
+  };
+
+  struct InitialStateWorkerData
+  {
+    ResourceManager *mgr;
+    vector<InitialStateJob> *jobs;
+    volatile int32_t next;
+  };
+
+  static const int MaxInitialStateWorkers = 4;
+
+  void AddInitialStateJob(vector<InitialStateJob> &jobs, ResourceId id, WrappedResourceType res);
+  static void InitialStateWorker(void *d);
+
   // very coarse lock, protects EVERYTHING. This could certainly be improved and it may be a
   // bottleneck
   // for performance. Given that the main use cases are write-rarely read-often the lock should be
@@ -850,9 +937,9 @@ void ResourceManager<WrappedResourceType, RealResourceType, RecordType>::MarkUnw
 
 template <typename WrappedResourceType, typename RealResourceType, typename RecordType>
 void ResourceManager<WrappedResourceType, RealResourceType, RecordType>::InsertReferencedChunks(
-    Serialiser *fileSer)
+    Serialiser *fileSer, vector<RecordType *> *heldRecords)
 {
-  map<int32_t, Chunk *> sortedChunks;
+  ChunkListMerger recordlist;
 
   SCOPED_LOCK(m_Lock);
 
@@ -865,7 +952,13 @@ void ResourceManager<WrappedResourceType, RealResourceType, RecordType>::InsertR
       if(!SerialisableResource(it->first, it->second))
         continue;
 
-      it->second->Insert(sortedChunks);
+      it->second->Insert(recordlist);
+
+      if(heldRecords)
+      {
+        it->second->AddRef();
+        heldRecords->push_back(it->second);
+      }
     }
   }
   else
@@ -874,17 +967,34 @@ void ResourceManager<WrappedResourceType, RealResourceType, RecordType>::InsertR
     {
       RecordType *record = GetResourceRecord(it->first);
       if(record)
-        record->Insert(sortedChunks);
+      {
+        record->Insert(recordlist);
+
+        if(heldRecords)
+        {
+          record->AddRef();
+          heldRecords->push_back(record);
+        }
+      }
     }
   }
 
+  vector<Chunk *> sortedChunks;
+  recordlist.Merge(sortedChunks);
+
   RDCDEBUG("%u frame resource chunks", (uint32_t)sortedChunks.size());
 
-  for(auto it = sortedChunks.begin(); it != sortedChunks.end(); it++)
+  if(ChunkStore::Get())
   {
-    fileSer->Insert(it->second);
+    ChunkStore *store = ChunkStore::Get();
+    RDCLOG("Chunk store: %llu MB resident, %llu MB spilled (%llu MB on disk)",
+           store->GetResidentBytes() / (1024 * 1024), store->GetSpilledBytes() / (1024 * 1024),
+           store->GetSpillFileBytes() / (1024 * 1024));
   }
 
+  for(size_t i = 0; i < sortedChunks.size(); i++)
+    fileSer->Insert(sortedChunks[i]);
+
   RDCDEBUG("inserted to serialiser");
 }
 
@@ -946,6 +1056,10 @@ void ResourceManager<WrappedResourceType, RealResourceType, RecordType>::InsertI
   uint32_t dirty = 0;
   uint32_t skipped = 0;
 
+  // chunks are gathered in the order resources are visited and only inserted at the end, once any
+  // serialised on worker threads are done, so the file comes out the same either way
+  vector<InitialStateJob> jobs;
+
   RDCDEBUG("Checking %u possibly dirty resources", (uint32_t)m_DirtyResources.size());
 
   for(auto it = m_DirtyResources.begin(); it != m_DirtyResources.end(); ++it)
@@ -1007,21 +1121,7 @@ void ResourceManager<WrappedResourceType, RealResourceType, RecordType>::InsertI
       continue;
     }
 
-    auto preparedChunk = m_InitialChunks.find(id);
-    if(preparedChunk != m_InitialChunks.end())
-    {
-      fileSerialiser->Insert(preparedChunk->second);
-      m_InitialChunks.erase(preparedChunk);
-    }
-    else
-    {
-      ScopedContext scope(m_pSerialiser, "Initial Contents", "Initial Contents", INITIAL_CONTENTS,
-                          false);
-
-      Serialise_InitialState(id, res);
-
-      fileSerialiser->Insert(scope.Get(true));
-    }
+    AddInitialStateJob(jobs, id, res);
   }
 
   RDCDEBUG("Serialised %u dirty resources, skipped %u unreferenced", dirty, skipped);
@@ -1037,25 +1137,44 @@ void ResourceManager<WrappedResourceType, RealResourceType, RecordType>::InsertI
     {
       dirty++;
 
-      auto preparedChunk = m_InitialChunks.find(it->first);
-      if(preparedChunk != m_InitialChunks.end())
-      {
-        fileSerialiser->Insert(preparedChunk->second);
-        m_InitialChunks.erase(preparedChunk);
-      }
-      else
-      {
-        ScopedContext scope(m_pSerialiser, "Initial Contents", "Initial Contents", INITIAL_CONTENTS,
-                            false);
+      AddInitialStateJob(jobs, it->first, it->second);
+    }
+  }
 
-        Serialise_InitialState(it->first, it->second);
+  RDCDEBUG("Force-serialised %u dirty resources", dirty);
 
-        fileSerialiser->Insert(scope.Get(true));
-      }
+  uint32_t numParallel = 0;
+  for(size_t i = 0; i < jobs.size(); i++)
+    if(jobs[i].chunk == NULL)
+      numParallel++;
+
+  if(numParallel > 0)
+  {
+    InitialStateWorkerData data;
+    data.mgr = this;
+    data.jobs = &jobs;
+    data.next = 0;
+
+    // this thread works through the jobs too, so only start extra threads if there's work for them
+    uint32_t numThreads = RDCMIN(numParallel, (uint32_t)MaxInitialStateWorkers) - 1;
+
+    Threading::ThreadHandle threads[MaxInitialStateWorkers];
+    for(uint32_t i = 0; i < numThreads; i++)
+      threads[i] = Threading::CreateThread(&InitialStateWorker, &data);
+
+    InitialStateWorker(&data);
+
+    for(uint32_t i = 0; i < numThreads; i++)
+    {
+      Threading::JoinThread(threads[i]);
+      Threading::CloseThread(threads[i]);
     }
+
+    RDCDEBUG("Serialised %u initial states on %u threads", numParallel, numThreads + 1);
   }
 
-  RDCDEBUG("Force-serialised %u dirty resources", dirty);
+  for(size_t i = 0; i < jobs.size(); i++)
+    fileSerialiser->Insert(jobs[i].chunk);
 
   // delete/cleanup any chunks that weren't used (maybe the resource was not
   // referenced).
@@ -1065,6 +1184,75 @@ void ResourceManager<WrappedResourceType, RealResourceType, RecordType>::InsertI
   m_InitialChunks.clear();
 }
 
+template <typename WrappedResourceType, typename RealResourceType, typename RecordType>
+void ResourceManager<WrappedResourceType, RealResourceType, RecordType>::AddInitialStateJob(
+    vector<InitialStateJob> &jobs, ResourceId id, WrappedResourceType res)
+{
+  InitialStateJob job;
+  job.id = id;
+  job.res = res;
+  job.chunk = NULL;
+
+  auto preparedChunk = m_InitialChunks.find(id);
+  if(preparedChunk != m_InitialChunks.end())
+  {
+    job.chunk = preparedChunk->second;
+    m_InitialChunks.erase(preparedChunk);
+  }
+  else if(AllowParallel_InitialState(id, res))
+  {
+    // serialised later on a worker thread
+    job.contents = GetInitialContents(id);
+  }
+  else
+  {
+    ScopedContext scope(m_pSerialiser, "Initial Contents", "Initial Contents", INITIAL_CONTENTS,
+                        false);
+
+    Serialise_InitialState(id, res);
+
+    job.chunk = scope.Get(true);
+  }
+
+  jobs.push_back(job);
+}
+
+template <typename WrappedResourceType, typename RealResourceType, typename RecordType>
+void ResourceManager<WrappedResourceType, RealResourceType, RecordType>::InitialStateWorker(void *d)
+{
+  InitialStateWorkerData *data = (InitialStateWorkerData *)d;
+  vector<InitialStateJob> &jobs = *data->jobs;
+
+  Serialiser *ser = NULL;
+
+  for(;;)
+  {
+    int32_t idx = Atomic::Inc32(&data->next) - 1;
+
+    if(idx >= (int32_t)jobs.size())
+      break;
+
+    InitialStateJob &job = jobs[idx];
+
+    if(job.chunk)
+      continue;
+
+    if(ser == NULL)
+    {
+      ser = new Serialiser(NULL, Serialiser::WRITING, false);
+      ser->SetUserData(data->mgr->m_pSerialiser->GetUserData());
+    }
+
+    ScopedContext scope(ser, "Initial Contents", "Initial Contents", INITIAL_CONTENTS, false);
+
+    data->mgr->Serialise_InitialStateParallel(ser, job.id, job.res, job.contents);
+
+    job.chunk = scope.Get(true);
+  }
+
+  SAFE_DELETE(ser);
+}
+
 template <typename WrappedResourceType, typename RealResourceType, typename RecordType>
 void ResourceManager<WrappedResourceType, RealResourceType, RecordType>::ReleaseInFrameResources()
 {
@@ -0,0 +1,289 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "3rdparty/lz4/lz4.h"
+#include "os/os_specific.h"
+#include "serialise/serialiser.h"
+#include "socket_helpers.h"
+
+// File blocks are pipelined through a small ring, so that on the sending side reading and
+// compressing the next blocks overlaps with sending the current one, and on the receiving side
+// decompressing and writing to disk overlaps with receiving.
+//
+// Each block packet's payload starts with a BlockHeader. Blocks that LZ4 doesn't shrink by at
+// least 1/8th - typically the frame capture section, which is already LZ4 compressed in the
+// file - are sent raw so we don't pay for decompressing them again.
+struct BlockHeader
+{
+  uint32_t rawLength;
+  // 0 if the block is stored raw
+  uint32_t compressedLength;
+};
+
+struct FileBlock
+{
+  vector<byte> data;
+};
+
+struct BlockPipeline
+{
+  static const uint32_t NumBlocks = 4;
+
+  BlockPipeline(FILE *file, uint64_t len, uint32_t blockSize, uint32_t count,
+                PartialCaptureFile *partialFile)
+      : f(file), fileLen(len), bufLen(blockSize), numBufs(count), partial(partialFile), failed(0)
+  {
+    freeBlocks.Wake(NumBlocks);
+  }
+
+  FILE *f;
+  uint64_t fileLen;
+  uint32_t bufLen;
+  uint32_t numBufs;
+
+  // when receiving, told about each block once it's on disk
+  PartialCaptureFile *partial;
+
+  FileBlock blocks[NumBlocks];
+
+  // counts of blocks ready for the producer to fill, and ready for the consumer
+  Threading::Semaphore freeBlocks;
+  Threading::Semaphore fullBlocks;
+
+  // set by either side to make the other give up
+  volatile int32_t failed;
+
+  void Fail()
+  {
+    Atomic::Inc32(&failed);
+    // make sure neither side is left waiting
+    freeBlocks.Wake(NumBlocks);
+    fullBlocks.Wake(NumBlocks);
+  }
+
+  bool Wait(Threading::Semaphore &sem)
+  {
+    while(!sem.WaitForWake(1000))
+    {
+      if(failed)
+        return false;
+    }
+
+    return failed == 0;
+  }
+};
+
+static void ReadCompressThread(void *d)
+{
+  BlockPipeline &pipe = *(BlockPipeline *)d;
+
+  vector<byte> raw(pipe.bufLen);
+
+  uint64_t remaining = pipe.fileLen;
+
+  for(uint32_t i = 0; i < pipe.numBufs; i++)
+  {
+    if(!pipe.Wait(pipe.freeBlocks))
+      return;
+
+    FileBlock &block = pipe.blocks[i % BlockPipeline::NumBlocks];
+
+    BlockHeader header;
+    header.rawLength = (uint32_t)RDCMIN((uint64_t)pipe.bufLen, remaining);
+    header.compressedLength = 0;
+
+    if(FileIO::fread(&raw[0], 1, header.rawLength, pipe.f) != header.rawLength)
+    {
+      RDCERR("Failed to read %u bytes from file to send", header.rawLength);
+      pipe.Fail();
+      return;
+    }
+
+    remaining -= header.rawLength;
+
+    block.data.resize(sizeof(BlockHeader) + LZ4_COMPRESSBOUND(header.rawLength));
+
+    int compSize = LZ4_compress_default((const char *)&raw[0],
+                                        (char *)&block.data[sizeof(BlockHeader)],
+                                        (int)header.rawLength, LZ4_COMPRESSBOUND(header.rawLength));
+
+    if(compSize > 0 && (uint32_t)compSize < header.rawLength - header.rawLength / 8)
+    {
+      header.compressedLength = (uint32_t)compSize;
+    }
+    else
+    {
+      block.data.resize(sizeof(BlockHeader) + header.rawLength);
+      memcpy(&block.data[sizeof(BlockHeader)], &raw[0], header.rawLength);
+    }
+
+    if(header.compressedLength)
+      block.data.resize(sizeof(BlockHeader) + header.compressedLength);
+
+    memcpy(&block.data[0], &header, sizeof(BlockHeader));
+
+    pipe.fullBlocks.Wake(1);
+  }
+}
+
+static void DecompressWriteThread(void *d)
+{
+  BlockPipeline &pipe = *(BlockPipeline *)d;
+
+  vector<byte> raw(pipe.bufLen);
+
+  for(uint32_t i = 0; i < pipe.numBufs; i++)
+  {
+    if(!pipe.Wait(pipe.fullBlocks))
+      return;
+
+    FileBlock &block = pipe.blocks[i % BlockPipeline::NumBlocks];
+
+    BlockHeader header = {};
+    if(block.data.size() >= sizeof(BlockHeader))
+      memcpy(&header, &block.data[0], sizeof(BlockHeader));
+
+    const byte *payload = block.data.data() + sizeof(BlockHeader);
+    size_t payloadLength = block.data.size() - RDCMIN(block.data.size(), sizeof(BlockHeader));
+
+    if(header.rawLength > pipe.bufLen ||
+       payloadLength != (header.compressedLength ? header.compressedLength : header.rawLength))
+    {
+      RDCERR("Invalid file block %u received", i);
+      pipe.Fail();
+      return;
+    }
+
+    if(header.compressedLength)
+    {
+      int decompSize = LZ4_decompress_safe((const char *)payload, (char *)&raw[0],
+                                           (int)header.compressedLength, (int)pipe.bufLen);
+
+      if(decompSize != (int)header.rawLength)
+      {
+        RDCERR("Failed to decompress file block %u", i);
+        pipe.Fail();
+        return;
+      }
+
+      payload = &raw[0];
+    }
+
+    if(FileIO::fwrite(payload, 1, header.rawLength, pipe.f) != header.rawLength)
+    {
+      RDCERR("Failed to write %u bytes to received file", header.rawLength);
+      pipe.Fail();
+      return;
+    }
+
+    if(pipe.partial)
+    {
+      // readers of the file open their own handle, so the block has to be out of our buffers
+      FileIO::fflush(pipe.f);
+      pipe.partial->Advance(header.rawLength);
+    }
+
+    pipe.freeBlocks.Wake(1);
+  }
+}
+
+bool SendFileBlocks(Network::Socket *sock, uint32_t packetType, FILE *f, uint64_t fileLen,
+                    uint32_t bufLen, uint32_t numBufs, float *progress)
+{
+  BlockPipeline pipe(f, fileLen, bufLen, numBufs, NULL);
+
+  Threading::ThreadHandle reader = Threading::CreateThread(ReadCompressThread, &pipe);
+
+  for(uint32_t i = 0; i < numBufs; i++)
+  {
+    if(!pipe.Wait(pipe.fullBlocks))
+      break;
+
+    FileBlock &block = pipe.blocks[i % BlockPipeline::NumBlocks];
+
+    uint32_t payloadLength = (uint32_t)block.data.size();
+
+    if(!sock->SendDataBlocking(&packetType, sizeof(packetType)) ||
+       !sock->SendDataBlocking(&payloadLength, sizeof(payloadLength)) ||
+       !sock->SendDataBlocking(&block.data[0], payloadLength))
+    {
+      pipe.Fail();
+      break;
+    }
+
+    pipe.freeBlocks.Wake(1);
+
+    if(progress)
+      *progress = float(i + 1) / float(numBufs);
+  }
+
+  Threading::JoinThread(reader);
+  Threading::CloseThread(reader);
+
+  return pipe.failed == 0;
+}
+
+bool RecvFileBlocks(Network::Socket *sock, uint32_t packetType, FILE *f, uint64_t fileLen,
+                    uint32_t bufLen, uint32_t numBufs, float *progress,
+                    PartialCaptureFile *partial)
+{
+  // blocks are never bigger than this, anything else is garbage
+  if(bufLen > 64 * 1024 * 1024)
+  {
+    RDCERR("Invalid file block size %u", bufLen);
+    return false;
+  }
+
+  BlockPipeline pipe(f, fileLen, bufLen, numBufs, partial);
+
+  Threading::ThreadHandle writer = Threading::CreateThread(DecompressWriteThread, &pipe);
+
+  for(uint32_t i = 0; i < numBufs; i++)
+  {
+    if(!pipe.Wait(pipe.freeBlocks))
+      break;
+
+    FileBlock &block = pipe.blocks[i % BlockPipeline::NumBlocks];
+
+    block.data.clear();
+
+    uint32_t type = 0;
+    if(!RecvPacket(sock, type, block.data) || type != packetType)
+    {
+      pipe.Fail();
+      break;
+    }
+
+    pipe.fullBlocks.Wake(1);
+
+    if(progress)
+      *progress = float(i + 1) / float(numBufs);
+  }
+
+  // the writer finishes once it has consumed every block, or bails out on failure
+  Threading::JoinThread(writer);
+  Threading::CloseThread(writer);
+
+  return pipe.failed == 0;
+}
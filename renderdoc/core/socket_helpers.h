@@ -25,6 +25,13 @@
 
 #pragma once
 
+// send/receive the blocks of a file after the header packet, see SendChunkedFile/RecvChunkedFile
+bool SendFileBlocks(Network::Socket *sock, uint32_t packetType, FILE *f, uint64_t fileLen,
+                    uint32_t bufLen, uint32_t numBufs, float *progress);
+bool RecvFileBlocks(Network::Socket *sock, uint32_t packetType, FILE *f, uint64_t fileLen,
+                    uint32_t bufLen, uint32_t numBufs, float *progress,
+                    PartialCaptureFile *partial);
+
 template <typename PacketTypeEnum>
 bool RecvPacket(Network::Socket *sock, PacketTypeEnum &type, vector<byte> &payload)
 {
@@ -109,9 +116,42 @@ bool SendPacket(Network::Socket *sock, PacketTypeEnum type, const Serialiser &se
   return true;
 }
 
+// appends a packet to a batch in the same wire format SendPacket uses, so several packets can go
+// out in a single send and be received one at a time with RecvPacket
+template <typename PacketTypeEnum>
+void AppendPacket(vector<byte> &batch, PacketTypeEnum type, const Serialiser &ser)
+{
+  uint32_t t = (uint32_t)type;
+  uint32_t payloadLength = ser.GetOffset() & 0xffffffff;
+
+  size_t offs = batch.size();
+  batch.resize(offs + sizeof(t) + sizeof(payloadLength) + payloadLength);
+
+  memcpy(&batch[offs], &t, sizeof(t));
+  offs += sizeof(t);
+  memcpy(&batch[offs], &payloadLength, sizeof(payloadLength));
+  offs += sizeof(payloadLength);
+  if(payloadLength > 0)
+    memcpy(&batch[offs], ser.GetRawPtr(0), payloadLength);
+}
+
+inline bool SendPacketBatch(Network::Socket *sock, vector<byte> &batch)
+{
+  if(sock == NULL)
+    return false;
+
+  bool ret = batch.empty() || sock->SendDataBlocking(&batch[0], (uint32_t)batch.size());
+
+  batch.clear();
+
+  return ret;
+}
+
+// if partial is set, each part of the file is published to it as soon as it's on disk so the
+// capture can be read while the rest arrives. The caller calls partial->Finish() once this returns
 template <typename PacketTypeEnum>
 bool RecvChunkedFile(Network::Socket *sock, PacketTypeEnum packetType, const char *logfile,
-                     Serialiser *&ser, float *progress)
+                     Serialiser *&ser, float *progress, PartialCaptureFile *partial = NULL)
 {
   if(sock == NULL)
     return false;
@@ -140,6 +180,9 @@ bool RecvChunkedFile(Network::Socket *sock, PacketTypeEnum packetType, const cha
 
   ser->SetOffset(0);
 
+  if(partial)
+    partial->Begin(fileLength);
+
   FILE *f = FileIO::fopen(logfile, "wb");
 
   if(f == NULL)
@@ -150,29 +193,12 @@ bool RecvChunkedFile(Network::Socket *sock, PacketTypeEnum packetType, const cha
   if(progress)
     *progress = 0.0001f;
 
-  for(uint32_t i = 0; i < numBuffers; i++)
-  {
-    if(!RecvPacket(sock, type, payload))
-    {
-      FileIO::fclose(f);
-      return false;
-    }
-
-    if(type != packetType)
-    {
-      FileIO::fclose(f);
-      return false;
-    }
-
-    FileIO::fwrite(&payload[0], 1, payload.size(), f);
-
-    if(progress)
-      *progress = float(i + 1) / float(numBuffers);
-  }
+  bool success = RecvFileBlocks(sock, (uint32_t)packetType, f, fileLength, bufLength, numBuffers,
+                                progress, partial);
 
   FileIO::fclose(f);
 
-  return true;
+  return success;
 }
 
 template <typename PacketTypeEnum>
@@ -193,7 +219,7 @@ bool SendChunkedFile(Network::Socket *sock, PacketTypeEnum type, const char *log
   uint64_t fileLen = FileIO::ftell64(f);
   FileIO::fseek64(f, 0, SEEK_SET);
 
-  uint32_t bufLen = (uint32_t)RDCMIN((uint64_t)4 * 1024 * 1024, fileLen);
+  uint32_t bufLen = (uint32_t)RDCMAX((uint64_t)1, RDCMIN((uint64_t)4 * 1024 * 1024, fileLen));
   uint64_t n = fileLen / (uint64_t)bufLen;
   uint32_t numBufs = (uint32_t)n;
   if(fileLen % (uint64_t)bufLen > 0)
@@ -209,39 +235,12 @@ bool SendChunkedFile(Network::Socket *sock, PacketTypeEnum type, const char *log
     return false;
   }
 
-  byte *buf = new byte[bufLen];
-
-  uint32_t t = (uint32_t)type;
-
   if(progress)
     *progress = 0.0001f;
 
-  for(uint32_t i = 0; i < numBufs; i++)
-  {
-    uint32_t payloadLength = RDCMIN(bufLen, (uint32_t)(fileLen & 0xffffffff));
-
-    FileIO::fread(buf, 1, payloadLength, f);
-
-    if(!sock->SendDataBlocking(&t, sizeof(t)) ||
-       !sock->SendDataBlocking(&payloadLength, sizeof(payloadLength)) ||
-       !sock->SendDataBlocking(buf, payloadLength))
-    {
-      break;
-    }
-
-    fileLen -= payloadLength;
-    if(progress)
-      *progress = float(i + 1) / float(numBufs);
-  }
-
-  delete[] buf;
+  bool success = SendFileBlocks(sock, (uint32_t)type, f, fileLen, bufLen, numBufs, progress);
 
   FileIO::fclose(f);
 
-  if(fileLen != 0)
-  {
-    return false;
-  }
-
-  return true;
+  return success;
 }
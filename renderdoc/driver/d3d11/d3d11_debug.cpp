@@ -169,11 +169,9 @@ D3D11DebugManager::D3D11DebugManager(WrappedID3D11Device *wrapper)
     }
   }
 
-  bool success = LoadShaderCache("d3dshaders.cache", m_ShaderCacheMagic, m_ShaderCacheVersion,
-                                 m_ShaderCache, ShaderCacheCallbacks);
-
-  // if we failed to load from the cache
-  m_ShaderCacheDirty = !success;
+  // blobs are only read from disk the first time they're looked up
+  m_ShaderCache = new ShaderCache<ID3DBlob *, D3DBlobShaderCallbacks>(
+      "d3dshaders.cache", m_ShaderCacheMagic, m_ShaderCacheVersion, ShaderCacheCallbacks);
 
   m_CacheShaders = true;
 
@@ -192,16 +190,8 @@ D3D11DebugManager::~D3D11DebugManager()
 {
   PreDeviceShutdownCounters();
 
-  if(m_ShaderCacheDirty)
-  {
-    SaveShaderCache("d3dshaders.cache", m_ShaderCacheMagic, m_ShaderCacheVersion, m_ShaderCache,
-                    ShaderCacheCallbacks);
-  }
-  else
-  {
-    for(auto it = m_ShaderCache.begin(); it != m_ShaderCache.end(); ++it)
-      ShaderCacheCallbacks.Destroy(it->second);
-  }
+  // writes out any new shaders and releases the cached blobs
+  SAFE_DELETE(m_ShaderCache);
 
   ShutdownFontRendering();
   ShutdownStreamOut();
@@ -248,14 +238,13 @@ string D3D11DebugManager::GetShaderBlob(const char *source, const char *entry,
                                         const uint32_t compileFlags, const char *profile,
                                         ID3DBlob **srcblob)
 {
-  uint32_t hash = strhash(source);
-  hash = strhash(entry, hash);
-  hash = strhash(profile, hash);
+  uint64_t hash = strhash64(source);
+  hash = strhash64(entry, hash);
+  hash = strhash64(profile, hash);
   hash ^= compileFlags;
 
-  if(m_ShaderCache.find(hash) != m_ShaderCache.end())
+  if(m_ShaderCache->Find(hash, *srcblob))
   {
-    *srcblob = m_ShaderCache[hash];
     (*srcblob)->AddRef();
     return "";
   }
@@ -307,9 +296,8 @@ string D3D11DebugManager::GetShaderBlob(const char *source, const char *entry,
 
   if(m_CacheShaders)
   {
-    m_ShaderCache[hash] = byteBlob;
+    m_ShaderCache->Add(hash, byteBlob);
     byteBlob->AddRef();
-    m_ShaderCacheDirty = true;
   }
 
   SAFE_RELEASE(errBlob);
@@ -47,6 +47,10 @@ struct CounterContext;
 
 class D3D11ResourceManager;
 
+template <typename ResultType, typename ShaderCallbacks>
+class ShaderCache;
+struct D3DBlobShaderCallbacks;
+
 namespace ShaderDebug
 {
 struct GlobalState;
@@ -312,10 +316,10 @@ private:
   map<uint64_t, OutputWindow> m_OutputWindows;
 
   static const uint32_t m_ShaderCacheMagic = 0xf000baba;
-  static const uint32_t m_ShaderCacheVersion = 3;
+  static const uint32_t m_ShaderCacheVersion = 4;
 
-  bool m_ShaderCacheDirty, m_CacheShaders;
-  map<uint32_t, ID3DBlob *> m_ShaderCache;
+  bool m_CacheShaders;
+  ShaderCache<ID3DBlob *, D3DBlobShaderCallbacks> *m_ShaderCache;
 
   static const int m_SOBufferSize = 32 * 1024 * 1024;
   ID3D11Buffer *m_SOBuffer;
@@ -2889,13 +2889,16 @@ bool WrappedID3D11Device::EndFrameCapture(void *dev, void *wnd)
 
       RDCDEBUG("Accumulating context resource list");
 
-      map<int32_t, Chunk *> recordlist;
+      ChunkListMerger recordlist;
       record->Insert(recordlist);
 
-      RDCDEBUG("Flushing %u records to file serialiser", (uint32_t)recordlist.size());
+      vector<Chunk *> sortedChunks;
+      recordlist.Merge(sortedChunks);
 
-      for(auto it = recordlist.begin(); it != recordlist.end(); ++it)
-        m_pFileSerialiser->Insert(it->second);
+      RDCDEBUG("Flushing %u records to file serialiser", (uint32_t)sortedChunks.size());
+
+      for(size_t i = 0; i < sortedChunks.size(); i++)
+        m_pFileSerialiser->Insert(sortedChunks[i]);
 
       RDCDEBUG("Done");
     }
@@ -59,10 +59,18 @@ public:
   ShaderReflection *GetShader(ResourceId shader, string entryPoint);
 
   vector<EventUsage> GetUsage(ResourceId id);
+  vector<vector<EventUsage> > GetUsages(const vector<ResourceId> &ids)
+  {
+    return GetUsagesSerially(this, ids);
+  }
 
   FetchFrameRecord GetFrameRecord();
 
-  void SavePipelineState() { m_CurPipelineState = MakePipelineState(); }
+  uint32_t SavePipelineState()
+  {
+    m_CurPipelineState = MakePipelineState();
+    return ePipeChange_All;
+  }
   D3D11PipelineState GetD3D11PipelineState() { return m_CurPipelineState; }
   GLPipelineState GetGLPipelineState() { return GLPipelineState(); }
   VulkanPipelineState GetVulkanPipelineState() { return VulkanPipelineState(); }
@@ -87,6 +95,7 @@ public:
 
   void InitPostVSBuffers(uint32_t eventID);
   void InitPostVSBuffers(const vector<uint32_t> &passEvents);
+  void PinPostVSBuffers(const vector<uint32_t> &events) {}
 
   ResourceId GetLiveID(ResourceId id);
 
@@ -100,6 +109,11 @@ public:
   void GetBufferData(ResourceId buff, uint64_t offset, uint64_t len, vector<byte> &retData);
   byte *GetTextureData(ResourceId tex, uint32_t arrayIdx, uint32_t mip, bool resolve,
                        bool forceRGBA8unorm, float blackPoint, float whitePoint, size_t &dataSize);
+  void GetTextureDataBatch(const vector<TextureDataRequest> &requests,
+                           TextureDataReceiver *receiver)
+  {
+    GetTextureDataSerially(this, requests, receiver);
+  }
 
   void BuildTargetShader(string source, string entry, const uint32_t compileFlags,
                          ShaderStageType type, ResourceId *id, string *errors);
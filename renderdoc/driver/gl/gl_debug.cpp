@@ -1002,34 +1002,12 @@ uint32_t GLReplay::PickVertex(uint32_t eventID, const MeshDisplay &cfg, uint32_t
 
   MakeCurrentReplayContext(m_DebugCtx);
 
-  gl.glUseProgram(DebugData.meshPickProgram);
-
-  GLint loc = gl.glGetUniformLocation(DebugData.meshPickProgram, "PickCoords");
-  gl.glUniform2f(loc, (float)x, (float)y);
-  loc = gl.glGetUniformLocation(DebugData.meshPickProgram, "PickViewport");
-  gl.glUniform2f(loc, DebugData.outWidth, DebugData.outHeight);
-  loc = gl.glGetUniformLocation(DebugData.meshPickProgram, "PickIdx");
-  gl.glUniform1ui(loc, cfg.position.idxByteWidth ? 1U : 0U);
-  loc = gl.glGetUniformLocation(DebugData.meshPickProgram, "PickNumVerts");
-  gl.glUniform1ui(loc, cfg.position.numVerts);
-
   Matrix4f projMat =
       Matrix4f::Perspective(90.0f, 0.1f, 100000.0f, DebugData.outWidth / DebugData.outHeight);
 
   Matrix4f camMat = cfg.cam ? cfg.cam->GetMatrix() : Matrix4f::Identity();
   Matrix4f PickMVP = projMat.Mul(camMat);
 
-  ResourceFormat resFmt;
-  resFmt.compByteWidth = cfg.position.compByteWidth;
-  resFmt.compCount = cfg.position.compCount;
-  resFmt.compType = cfg.position.compType;
-  resFmt.special = false;
-  if(cfg.position.specialFormat != eSpecial_Unknown)
-  {
-    resFmt.special = true;
-    resFmt.specialFormat = cfg.position.specialFormat;
-  }
-
   if(cfg.position.unproject)
   {
     // the derivation of the projection matrix might not be right (hell, it could be an
@@ -1043,70 +1021,135 @@ uint32_t GLReplay::PickVertex(uint32_t eventID, const MeshDisplay &cfg, uint32_t
     PickMVP = projMat.Mul(camMat.Mul(guessProj.Inverse()));
   }
 
-  loc = gl.glGetUniformLocation(DebugData.meshPickProgram, "PickMVP");
-  gl.glUniformMatrix4fv(loc, 1, GL_FALSE, PickMVP.Data());
+  vector<FloatVector> positions;
+  vector<uint32_t> indices;
 
-  GLuint ib = 0;
+  // picking runs on the CPU against an index over the mesh's positions, so the only GPU work is
+  // reading the mesh back the first time it's picked
+  bool built = false;
 
-  if(cfg.position.idxByteWidth && cfg.position.idxbuf != ResourceId())
-    ib = m_pDriver->GetResourceManager()->GetCurrentResource(cfg.position.idxbuf).name;
+  if(!m_MeshPickIndex.IsBuiltFor(eventID, cfg.position))
+  {
+    GLuint ib = 0;
 
-  // We copy into our own buffers to promote to the target type (uint32) that the
-  // shader expects. Most IBs will be 16-bit indices, most VBs will not be float4.
+    if(cfg.position.idxByteWidth && cfg.position.idxbuf != ResourceId())
+      ib = m_pDriver->GetResourceManager()->GetCurrentResource(cfg.position.idxbuf).name;
 
-  if(ib)
-  {
-    // resize up on demand
-    if(DebugData.pickIBBuf == 0 || DebugData.pickIBSize < cfg.position.numVerts * sizeof(uint32_t))
+    // promote indices to 32-bit
+    if(ib)
     {
-      gl.glDeleteBuffers(1, &DebugData.pickIBBuf);
+      byte *idxs = new byte[cfg.position.numVerts * cfg.position.idxByteWidth];
 
-      gl.glGenBuffers(1, &DebugData.pickIBBuf);
-      gl.glBindBuffer(eGL_SHADER_STORAGE_BUFFER, DebugData.pickIBBuf);
-      gl.glNamedBufferStorageEXT(DebugData.pickIBBuf, cfg.position.numVerts * sizeof(uint32_t),
-                                 NULL, GL_DYNAMIC_STORAGE_BIT);
+      gl.glBindBuffer(eGL_COPY_READ_BUFFER, ib);
+      gl.glGetBufferSubData(eGL_COPY_READ_BUFFER, (GLintptr)cfg.position.idxoffs,
+                            cfg.position.numVerts * cfg.position.idxByteWidth, idxs);
 
-      DebugData.pickIBSize = cfg.position.numVerts * sizeof(uint32_t);
-    }
+      uint16_t *idxs16 = (uint16_t *)idxs;
+      uint32_t *idxs32 = (uint32_t *)idxs;
 
-    byte *idxs = new byte[cfg.position.numVerts * cfg.position.idxByteWidth];
-    uint32_t *outidxs = NULL;
+      indices.resize(cfg.position.numVerts);
 
-    if(cfg.position.idxByteWidth < 4)
-      outidxs = new uint32_t[cfg.position.numVerts];
+      if(cfg.position.idxByteWidth == 1)
+      {
+        for(uint32_t i = 0; i < cfg.position.numVerts; i++)
+          indices[i] = idxs[i];
+      }
+      else if(cfg.position.idxByteWidth == 2)
+      {
+        for(uint32_t i = 0; i < cfg.position.numVerts; i++)
+          indices[i] = idxs16[i];
+      }
+      else
+      {
+        for(uint32_t i = 0; i < cfg.position.numVerts; i++)
+          indices[i] = idxs32[i];
+      }
 
-    gl.glBindBuffer(eGL_COPY_READ_BUFFER, ib);
-    gl.glGetBufferSubData(eGL_COPY_READ_BUFFER, (GLintptr)cfg.position.idxoffs,
-                          cfg.position.numVerts * cfg.position.idxByteWidth, idxs);
+      delete[] idxs;
+    }
 
-    uint16_t *idxs16 = (uint16_t *)idxs;
+    // unpack and linearise the data
+    vector<byte> oldData;
+    GetBufferData(cfg.position.buf, cfg.position.offset, 0, oldData);
 
-    if(cfg.position.idxByteWidth == 1)
+    if(!oldData.empty())
     {
-      for(uint32_t i = 0; i < cfg.position.numVerts; i++)
-        outidxs[i] = idxs[i];
+      byte *data = &oldData[0];
+      byte *dataEnd = data + oldData.size();
 
-      gl.glBindBuffer(eGL_SHADER_STORAGE_BUFFER, DebugData.pickIBBuf);
-      gl.glBufferSubData(eGL_SHADER_STORAGE_BUFFER, 0, cfg.position.numVerts * sizeof(uint32_t),
-                         outidxs);
-    }
-    else if(cfg.position.idxByteWidth == 2)
-    {
-      for(uint32_t i = 0; i < cfg.position.numVerts; i++)
-        outidxs[i] = idxs16[i];
+      bool valid;
 
-      gl.glBindBuffer(eGL_SHADER_STORAGE_BUFFER, DebugData.pickIBBuf);
-      gl.glBufferSubData(eGL_SHADER_STORAGE_BUFFER, 0, cfg.position.numVerts * sizeof(uint32_t),
-                         outidxs);
+      positions.resize(cfg.position.numVerts);
+
+      for(uint32_t i = 0; i < cfg.position.numVerts; i++)
+        positions[i] = InterpretVertex(data, i, cfg, dataEnd, false, valid);
     }
-    else
+
+    m_MeshPickIndex.Build(eventID, cfg.position, positions, indices);
+    built = true;
+  }
+
+  // the GL pick shader has no unproject path, it always flips Y
+  uint32_t ret = m_MeshPickIndex.Pick(PickMVP, false, DebugData.outWidth, DebugData.outHeight,
+                                      float(x), float(y));
+
+#if !defined(RELEASE)
+  // check the first pick on each new mesh against the compute shader. They can legitimately
+  // disagree if the shader finds more than maxMeshPicks candidates
+  if(built)
+  {
+    uint32_t gpuRet = PickVertexGPU(cfg, PickMVP, x, y, positions, indices);
+
+    if(gpuRet != ret)
+      RDCWARN("CPU mesh pick found vertex %u, GPU mesh pick found %u", ret, gpuRet);
+  }
+#else
+  (void)built;
+#endif
+
+  return ret;
+}
+
+uint32_t GLReplay::PickVertexGPU(const MeshDisplay &cfg, const Matrix4f &PickMVP, uint32_t x,
+                                 uint32_t y, const vector<FloatVector> &positions,
+                                 const vector<uint32_t> &indices)
+{
+  WrappedOpenGL &gl = *m_pDriver;
+
+  gl.glUseProgram(DebugData.meshPickProgram);
+
+  GLint loc = gl.glGetUniformLocation(DebugData.meshPickProgram, "PickCoords");
+  gl.glUniform2f(loc, (float)x, (float)y);
+  loc = gl.glGetUniformLocation(DebugData.meshPickProgram, "PickViewport");
+  gl.glUniform2f(loc, DebugData.outWidth, DebugData.outHeight);
+  loc = gl.glGetUniformLocation(DebugData.meshPickProgram, "PickIdx");
+  gl.glUniform1ui(loc, indices.empty() ? 0U : 1U);
+  loc = gl.glGetUniformLocation(DebugData.meshPickProgram, "PickNumVerts");
+  gl.glUniform1ui(loc, positions.empty() ? 0U : cfg.position.numVerts);
+
+  loc = gl.glGetUniformLocation(DebugData.meshPickProgram, "PickMVP");
+  gl.glUniformMatrix4fv(loc, 1, GL_FALSE, PickMVP.Data());
+
+  // We copy into our own buffers as the target type (uint32/float4) that the shader expects.
+
+  if(!indices.empty())
+  {
+    // resize up on demand
+    if(DebugData.pickIBBuf == 0 || DebugData.pickIBSize < cfg.position.numVerts * sizeof(uint32_t))
     {
+      gl.glDeleteBuffers(1, &DebugData.pickIBBuf);
+
+      gl.glGenBuffers(1, &DebugData.pickIBBuf);
       gl.glBindBuffer(eGL_SHADER_STORAGE_BUFFER, DebugData.pickIBBuf);
-      gl.glBufferSubData(eGL_SHADER_STORAGE_BUFFER, 0, cfg.position.numVerts * sizeof(uint32_t),
-                         idxs);
+      gl.glNamedBufferStorageEXT(DebugData.pickIBBuf, cfg.position.numVerts * sizeof(uint32_t),
+                                 NULL, GL_DYNAMIC_STORAGE_BIT);
+
+      DebugData.pickIBSize = cfg.position.numVerts * sizeof(uint32_t);
     }
 
-    SAFE_DELETE_ARRAY(outidxs);
+    gl.glBindBuffer(eGL_SHADER_STORAGE_BUFFER, DebugData.pickIBBuf);
+    gl.glBufferSubData(eGL_SHADER_STORAGE_BUFFER, 0, indices.size() * sizeof(uint32_t),
+                       &indices[0]);
   }
 
   if(DebugData.pickVBBuf == 0 || DebugData.pickVBSize < cfg.position.numVerts * sizeof(Vec4f))
@@ -1121,25 +1164,11 @@ uint32_t GLReplay::PickVertex(uint32_t eventID, const MeshDisplay &cfg, uint32_t
     DebugData.pickVBSize = cfg.position.numVerts * sizeof(Vec4f);
   }
 
-  // unpack and linearise the data
+  if(!positions.empty())
   {
-    FloatVector *vbData = new FloatVector[cfg.position.numVerts];
-
-    vector<byte> oldData;
-    GetBufferData(cfg.position.buf, cfg.position.offset, 0, oldData);
-
-    byte *data = &oldData[0];
-    byte *dataEnd = data + oldData.size();
-
-    bool valid;
-
-    for(uint32_t i = 0; i < cfg.position.numVerts; i++)
-      vbData[i] = InterpretVertex(data, i, cfg, dataEnd, false, valid);
-
     gl.glBindBuffer(eGL_SHADER_STORAGE_BUFFER, DebugData.pickVBBuf);
-    gl.glBufferSubData(eGL_SHADER_STORAGE_BUFFER, 0, cfg.position.numVerts * sizeof(Vec4f), vbData);
-
-    delete[] vbData;
+    gl.glBufferSubData(eGL_SHADER_STORAGE_BUFFER, 0, positions.size() * sizeof(Vec4f),
+                       &positions[0]);
   }
 
   uint32_t reset = 0;
@@ -2426,6 +2426,8 @@ void WrappedOpenGL::StartFrameCapture(void *dev, void *wnd)
   if(m_State != WRITING_IDLE)
     return;
 
+  RDCPROFILE_SCOPE("WrappedOpenGL::StartFrameCapture");
+
   RenderDoc::Inst().SetCurrentDriver(RDC_OpenGL);
 
   m_State = WRITING_CAPFRAME;
@@ -2472,6 +2474,8 @@ bool WrappedOpenGL::EndFrameCapture(void *dev, void *wnd)
   if(m_State != WRITING_CAPFRAME)
     return true;
 
+  RDCPROFILE_SCOPE("WrappedOpenGL::EndFrameCapture");
+
   CaptureFailReason reason = CaptureSucceeded;
 
   GLWindowingData prevctx = m_ActiveContexts[Threading::GetCurrentID()];
@@ -2550,13 +2554,16 @@ bool WrappedOpenGL::EndFrameCapture(void *dev, void *wnd)
 
       RDCDEBUG("Accumulating context resource list");
 
-      map<int32_t, Chunk *> recordlist;
+      ChunkListMerger recordlist;
       record->Insert(recordlist);
 
-      RDCDEBUG("Flushing %u records to file serialiser", (uint32_t)recordlist.size());
+      vector<Chunk *> sortedChunks;
+      recordlist.Merge(sortedChunks);
 
-      for(auto it = recordlist.begin(); it != recordlist.end(); ++it)
-        m_pFileSerialiser->Insert(it->second);
+      RDCDEBUG("Flushing %u records to file serialiser", (uint32_t)sortedChunks.size());
+
+      for(size_t i = 0; i < sortedChunks.size(); i++)
+        m_pFileSerialiser->Insert(sortedChunks[i]);
 
       RDCDEBUG("Done");
     }
@@ -3156,6 +3163,9 @@ void WrappedOpenGL::ReadLogInitialisation()
 
     GLChunkType context = (GLChunkType)m_pSerialiser->PushContext(NULL, NULL, 1, false);
 
+    // chunk names are static strings so can be used directly as scope names
+    RDCPROFILE_SCOPE(GetChunkName(context));
+
     if(context == CAPTURE_SCOPE)
     {
       // immediately read rest of log into memory
@@ -3181,6 +3191,8 @@ void WrappedOpenGL::ReadLogInitialisation()
 
     uint64_t offset2 = m_pSerialiser->GetOffset();
 
+    RDCPROFILE_COUNTER(Profile_BytesSerialised, offset2 - offset);
+
     chunkInfos[context].total += timer.GetMilliseconds();
     chunkInfos[context].totalsize += offset2 - offset;
     chunkInfos[context].count++;
@@ -3667,6 +3679,8 @@ void WrappedOpenGL::ProcessChunk(uint64_t offset, GLChunkType context)
 void WrappedOpenGL::ContextReplayLog(LogState readType, uint32_t startEventID, uint32_t endEventID,
                                      bool partial)
 {
+  RDCPROFILE_SCOPE("WrappedOpenGL::ContextReplayLog");
+
   m_State = readType;
 
   m_DoStateVerify = true;
@@ -4215,6 +4229,8 @@ const FetchDrawcall *WrappedOpenGL::GetDrawcall(uint32_t eventID)
 
 void WrappedOpenGL::ReplayLog(uint32_t startEventID, uint32_t endEventID, ReplayLogType replayType)
 {
+  RDCPROFILE_SCOPE("WrappedOpenGL::ReplayLog");
+
   uint64_t offs = m_FrameRecord.frameInfo.fileOffset;
 
   m_pSerialiser->SetOffset(offs);
@@ -277,6 +277,7 @@ private:
     GLuint prog;
 
     void Compile(const GLHookSet &gl);
+    void Disassemble();
   };
 
   struct ProgramData
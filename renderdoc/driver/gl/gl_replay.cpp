@@ -822,10 +822,14 @@ ShaderReflection *GLReplay::GetShader(ResourceId shader, string entryPoint)
     return NULL;
   }
 
+  // compiling to SPIR-V and disassembling is deferred until the shader is first looked at
+  if(shaderDetails.reflection.Disassembly.count == 0)
+    shaderDetails.Disassemble();
+
   return &shaderDetails.reflection;
 }
 
-void GLReplay::SavePipelineState()
+uint32_t GLReplay::SavePipelineState()
 {
   GLPipelineState &pipe = m_CurPipelineState;
   WrappedOpenGL &gl = *m_pDriver;
@@ -1971,6 +1975,9 @@ void GLReplay::SavePipelineState()
 
   pipe.m_Hints.LineSmoothEnabled = rs.Enabled[GLRenderState::eEnabled_LineSmooth];
   pipe.m_Hints.PolySmoothEnabled = rs.Enabled[GLRenderState::eEnabled_PolySmooth];
+
+  // the state is fetched back from the context every time, so it's all considered changed
+  return ePipeChange_All;
 }
 
 void GLReplay::FillCBufferValue(WrappedOpenGL &gl, GLuint prog, bool bufferBacked, bool rowMajor,
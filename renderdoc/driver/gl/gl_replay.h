@@ -27,6 +27,7 @@
 
 #include "api/replay/renderdoc_replay.h"
 #include "core/core.h"
+#include "replay/mesh_pick.h"
 #include "replay/replay_driver.h"
 #include "gl_common.h"
 
@@ -100,10 +101,14 @@ public:
   vector<DebugMessage> GetDebugMessages();
 
   vector<EventUsage> GetUsage(ResourceId id);
+  vector<vector<EventUsage> > GetUsages(const vector<ResourceId> &ids)
+  {
+    return GetUsagesSerially(this, ids);
+  }
 
   FetchFrameRecord GetFrameRecord();
 
-  void SavePipelineState();
+  uint32_t SavePipelineState();
   D3D11PipelineState GetD3D11PipelineState() { return D3D11PipelineState(); }
   GLPipelineState GetGLPipelineState() { return m_CurPipelineState; }
   VulkanPipelineState GetVulkanPipelineState() { return VulkanPipelineState(); }
@@ -127,6 +132,7 @@ public:
 
   void InitPostVSBuffers(uint32_t eventID);
   void InitPostVSBuffers(const vector<uint32_t> &passEvents);
+  void PinPostVSBuffers(const vector<uint32_t> &events) {}
 
   ResourceId GetLiveID(ResourceId id);
 
@@ -140,6 +146,11 @@ public:
   void GetBufferData(ResourceId buff, uint64_t offset, uint64_t len, vector<byte> &ret);
   byte *GetTextureData(ResourceId tex, uint32_t arrayIdx, uint32_t mip, bool resolve,
                        bool forceRGBA8unorm, float blackPoint, float whitePoint, size_t &dataSize);
+  void GetTextureDataBatch(const vector<TextureDataRequest> &requests,
+                           TextureDataReceiver *receiver)
+  {
+    GetTextureDataSerially(this, requests, receiver);
+  }
 
   void ReplaceResource(ResourceId from, ResourceId to);
   void RemoveReplacement(ResourceId id);
@@ -335,6 +346,12 @@ private:
   FloatVector InterpretVertex(byte *data, uint32_t vert, const MeshDisplay &cfg, byte *end,
                               bool useidx, bool &valid);
 
+  uint32_t PickVertexGPU(const MeshDisplay &cfg, const Matrix4f &PickMVP, uint32_t x, uint32_t y,
+                         const vector<FloatVector> &positions, const vector<uint32_t> &indices);
+
+  // CPU-side index over the positions of the last picked mesh, built on its first pick
+  MeshPickIndex m_MeshPickIndex;
+
   // simple cache for when we need buffer data for highlighting
   // vertices, typical use will be lots of vertices in the same
   // mesh, not jumping back and forth much between meshes.
@@ -50,14 +50,7 @@ void WrappedOpenGL::ShaderData::Compile(const GLHookSet &gl)
     prog = sepProg;
     MakeShaderReflection(gl, type, sepProg, reflection, pointSizeUsed, clipDistanceUsed);
 
-    vector<uint32_t> spirvwords;
-
-    string s = CompileSPIRV(SPIRVShaderStage(ShaderIdx(type)), sources, spirvwords);
-    if(!spirvwords.empty())
-      ParseSPIRV(&spirvwords.front(), spirvwords.size(), spirv);
-
-    // for classic GL, entry point is always main
-    reflection.Disassembly = spirv.Disassemble("main");
+    // the SPIR-V disassembly is generated on first use, see Disassemble()
 
     create_array_uninit(reflection.DebugInfo.files, sources.size());
     for(size_t i = 0; i < sources.size(); i++)
@@ -68,6 +61,36 @@ void WrappedOpenGL::ShaderData::Compile(const GLHookSet &gl)
   }
 }
 
+void WrappedOpenGL::ShaderData::Disassemble()
+{
+  // key on the sources rather than the SPIR-V, so a cache hit doesn't need to compile at all
+  char typestr[2] = {'a', 0};
+  typestr[0] += (char)ShaderIdx(type);
+
+  uint64_t hash = strhash64(typestr);
+  for(size_t i = 0; i < sources.size(); i++)
+    hash = strhash64(sources[i].c_str(), hash);
+
+  string disasm;
+  if(!FindCachedSPIRVDisassembly(hash, disasm))
+  {
+    if(spirv.spirv.empty())
+    {
+      vector<uint32_t> spirvwords;
+
+      string s = CompileSPIRV(SPIRVShaderStage(ShaderIdx(type)), sources, spirvwords);
+      if(!spirvwords.empty())
+        ParseSPIRV(&spirvwords.front(), spirvwords.size(), spirv);
+    }
+
+    // for classic GL, entry point is always main
+    disasm = spirv.Disassemble("main");
+    CacheSPIRVDisassembly(hash, disasm);
+  }
+
+  reflection.Disassembly = disasm;
+}
+
 #pragma region Shaders
 
 bool WrappedOpenGL::Serialise_glCreateShader(GLuint shader, GLenum type)
@@ -23,6 +23,10 @@
  ******************************************************************************/
 
 #include "spirv_common.h"
+#include "common/common.h"
+#include "common/shader_cache.h"
+#include "common/threading.h"
+#include "serialise/string_utils.h"
 
 #undef min
 #undef max
@@ -43,6 +47,26 @@
 
 static bool inited = false;
 
+struct DisassemblyCacheCallbacks
+{
+  bool Create(uint32_t size, byte *data, string **ret) const
+  {
+    *ret = new string((const char *)data, (size_t)size);
+    return true;
+  }
+
+  void Destroy(string *disasm) const { delete disasm; }
+  uint32_t GetSize(string *disasm) const { return (uint32_t)disasm->size(); }
+  byte *GetData(string *disasm) const { return (byte *)&(*disasm)[0]; }
+} DisassemblyCallbacks;
+
+// bump the version whenever the disassembler's output changes
+static const uint32_t DisassemblyCacheMagic = 0xf00dd155;
+static const uint32_t DisassemblyCacheVersion = 1;
+
+static ShaderCache<string *, DisassemblyCacheCallbacks> *disassemblyCache = NULL;
+static Threading::CriticalSection disassemblyLock;
+
 void InitSPIRVCompiler()
 {
   if(!inited)
@@ -58,4 +82,96 @@ void ShutdownSPIRVCompiler()
   {
     glslang::FinalizeProcess();
   }
+
+  {
+    SCOPED_LOCK(disassemblyLock);
+    SAFE_DELETE(disassemblyCache);
+  }
+}
+
+SPVArena::SPVArena()
+{
+  m_Cur = NULL;
+  m_Remaining = 0;
+  m_Allocated = 0;
+}
+
+SPVArena::~SPVArena()
+{
+  // destroy in reverse order of creation, the same as if each had been deleted individually
+  for(size_t i = m_Destructors.size(); i > 0; i--)
+    m_Destructors[i - 1].destroy(m_Destructors[i - 1].obj);
+
+  for(size_t i = 0; i < m_Chunks.size(); i++)
+    delete[] m_Chunks[i];
+}
+
+void *SPVArena::Alloc(size_t size)
+{
+  size = AlignUp(size, Alignment);
+
+  if(size > m_Remaining)
+  {
+    // oversized allocations get a chunk to themselves, without abandoning the current chunk
+    if(size > ChunkSize / 4)
+    {
+      uint8_t *chunk = new uint8_t[size];
+      m_Chunks.push_back(chunk);
+      m_Allocated += size;
+      return chunk;
+    }
+
+    m_Cur = new uint8_t[ChunkSize];
+    m_Remaining = ChunkSize;
+    m_Chunks.push_back(m_Cur);
+  }
+
+  void *ret = m_Cur;
+  m_Cur += size;
+  m_Remaining -= size;
+  m_Allocated += size;
+
+  return ret;
+}
+
+uint64_t HashSPIRV(const vector<uint32_t> &spirv, const string &entryPoint)
+{
+  uint64_t hash = strhash64(entryPoint.c_str());
+
+  // 64-bit FNV-1a over the words, continuing from the entry point's hash
+  const byte *data = (const byte *)spirv.data();
+  for(size_t i = 0; i < spirv.size() * sizeof(uint32_t); i++)
+  {
+    hash ^= data[i];
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+bool FindCachedSPIRVDisassembly(uint64_t hash, string &disassembly)
+{
+  SCOPED_LOCK(disassemblyLock);
+
+  if(disassemblyCache == NULL)
+    disassemblyCache = new ShaderCache<string *, DisassemblyCacheCallbacks>(
+        "spvdisasm.cache", DisassemblyCacheMagic, DisassemblyCacheVersion, DisassemblyCallbacks);
+
+  string *cached = NULL;
+  if(!disassemblyCache->Find(hash, cached))
+    return false;
+
+  disassembly = *cached;
+  return true;
+}
+
+void CacheSPIRVDisassembly(uint64_t hash, const string &disassembly)
+{
+  if(disassembly.empty())
+    return;
+
+  SCOPED_LOCK(disassemblyLock);
+
+  if(disassemblyCache)
+    disassemblyCache->Add(hash, new string(disassembly));
 }
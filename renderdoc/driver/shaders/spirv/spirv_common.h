@@ -25,6 +25,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <new>
 #include <string>
 #include <vector>
 #include "3rdparty/glslang/SPIRV/spirv.hpp"
@@ -51,6 +52,51 @@ struct SPVInstruction;
 struct ShaderReflection;
 struct ShaderBindpointMapping;
 
+// Bump allocator for a module's instruction graph. Objects are packed into large chunks in the
+// order they're parsed, instead of being individually heap allocated, and are all destroyed
+// together with the arena.
+class SPVArena
+{
+public:
+  SPVArena();
+  ~SPVArena();
+
+  template <typename T>
+  T *New()
+  {
+    T *ret = new(Alloc(sizeof(T))) T();
+    Destructor d = {ret, &Destroy<T>};
+    m_Destructors.push_back(d);
+    return ret;
+  }
+
+  size_t GetAllocatedBytes() const { return m_Allocated; }
+private:
+  static const size_t ChunkSize = 64 * 1024;
+  static const size_t Alignment = 16;
+
+  template <typename T>
+  static void Destroy(void *obj)
+  {
+    ((T *)obj)->~T();
+  }
+
+  struct Destructor
+  {
+    void *obj;
+    void (*destroy)(void *);
+  };
+
+  void *Alloc(size_t size);
+
+  vector<uint8_t *> m_Chunks;
+  uint8_t *m_Cur;
+  size_t m_Remaining;
+  size_t m_Allocated;
+
+  vector<Destructor> m_Destructors;
+};
+
 struct SPVModule
 {
   SPVModule();
@@ -58,6 +104,9 @@ struct SPVModule
 
   vector<uint32_t> spirv;
 
+  // owns every SPVInstruction and the data hanging off it
+  SPVArena arena;
+
   struct
   {
     uint8_t major, minor;
@@ -93,3 +142,9 @@ struct SPVModule
 string CompileSPIRV(SPIRVShaderStage shadType, const vector<string> &sources,
                     vector<uint32_t> &spirv);
 void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module);
+
+// disassembly is kept in an on-disk cache between sessions, keyed by HashSPIRV() or any other
+// hash that uniquely identifies the disassembled shader (e.g. the sources it was compiled from)
+uint64_t HashSPIRV(const vector<uint32_t> &spirv, const string &entryPoint);
+bool FindCachedSPIRVDisassembly(uint64_t hash, string &disassembly);
+void CacheSPIRVDisassembly(uint64_t hash, const string &disassembly);
@@ -881,19 +881,6 @@ struct SPVInstruction
     source.col = source.line = 0;
   }
 
-  ~SPVInstruction()
-  {
-    SAFE_DELETE(ext);
-    SAFE_DELETE(entry);
-    SAFE_DELETE(op);
-    SAFE_DELETE(flow);
-    SAFE_DELETE(type);
-    SAFE_DELETE(func);
-    SAFE_DELETE(block);
-    SAFE_DELETE(constant);
-    SAFE_DELETE(var);
-  }
-
   spv::Op opcode;
   uint32_t id;
 
@@ -2087,8 +2074,7 @@ SPVModule::SPVModule()
 
 SPVModule::~SPVModule()
 {
-  for(size_t i = 0; i < operations.size(); i++)
-    delete operations[i];
+  // the instructions themselves are destroyed with the arena
   operations.clear();
 }
 
@@ -2101,7 +2087,7 @@ SPVInstruction *SPVModule::GetByID(uint32_t id)
   // an ID, it won't be in our list so we have to add a dummy instruction for it
   RDCWARN("Expected to find ID %u but didn't - returning dummy instruction", id);
 
-  operations.push_back(new SPVInstruction());
+  operations.push_back(arena.New<SPVInstruction>());
   SPVInstruction &op = *operations.back();
   op.opcode = spv::OpUnknown;
   op.id = id;
@@ -4396,12 +4382,20 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
   SPVFunction *curFunc = NULL;
   SPVBlock *curBlock = NULL;
 
+  // count the instructions up front so the operation list is only allocated once
+  size_t numOps = 0;
+  for(size_t w = 5; w < spirvLength && (spirv[w] >> spv::WordCountShift) > 0;
+      w += spirv[w] >> spv::WordCountShift)
+    numOps++;
+
+  module.operations.reserve(numOps);
+
   size_t it = 5;
   while(it < spirvLength)
   {
     uint16_t WordCount = spirv[it] >> spv::WordCountShift;
 
-    module.operations.push_back(new SPVInstruction());
+    module.operations.push_back(module.arena.New<SPVInstruction>());
     SPVInstruction &op = *module.operations.back();
 
     op.opcode = spv::Op(spirv[it] & spv::OpCodeMask);
@@ -4467,7 +4461,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpEntryPoint:
       {
-        op.entry = new SPVEntryPoint();
+        op.entry = module.arena.New<SPVEntryPoint>();
         op.entry->func = spirv[it + 2];
         op.entry->model = spv::ExecutionModel(spirv[it + 1]);
         op.entry->name = (const char *)&spirv[it + 3];
@@ -4501,7 +4495,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpExtInstImport:
       {
-        op.ext = new SPVExtInstSet();
+        op.ext = module.arena.New<SPVExtInstSet>();
         op.ext->setname = (const char *)&spirv[it + 2];
         op.ext->canonicalNames = NULL;
 
@@ -4527,7 +4521,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       // Type opcodes
       case spv::OpTypeVoid:
       {
-        op.type = new SPVTypeData();
+        op.type = module.arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eVoid;
 
         op.id = spirv[it + 1];
@@ -4536,7 +4530,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeBool:
       {
-        op.type = new SPVTypeData();
+        op.type = module.arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eBool;
 
         op.id = spirv[it + 1];
@@ -4545,7 +4539,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeInt:
       {
-        op.type = new SPVTypeData();
+        op.type = module.arena.New<SPVTypeData>();
         op.type->type = spirv[it + 3] ? SPVTypeData::eSInt : SPVTypeData::eUInt;
         op.type->bitCount = spirv[it + 2];
 
@@ -4555,7 +4549,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeFloat:
       {
-        op.type = new SPVTypeData();
+        op.type = module.arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eFloat;
         op.type->bitCount = spirv[it + 2];
 
@@ -4565,7 +4559,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeVector:
       {
-        op.type = new SPVTypeData();
+        op.type = module.arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eVector;
 
         SPVInstruction *baseTypeInst = module.GetByID(spirv[it + 2]);
@@ -4580,7 +4574,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeMatrix:
       {
-        op.type = new SPVTypeData();
+        op.type = module.arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eMatrix;
 
         SPVInstruction *baseTypeInst = module.GetByID(spirv[it + 2]);
@@ -4598,7 +4592,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeArray:
       {
-        op.type = new SPVTypeData();
+        op.type = module.arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eArray;
 
         SPVInstruction *baseTypeInst = module.GetByID(spirv[it + 2]);
@@ -4617,7 +4611,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeRuntimeArray:
       {
-        op.type = new SPVTypeData();
+        op.type = module.arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eArray;
 
         SPVInstruction *baseTypeInst = module.GetByID(spirv[it + 2]);
@@ -4632,7 +4626,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeStruct:
       {
-        op.type = new SPVTypeData();
+        op.type = module.arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eStruct;
 
         for(int i = 2; i < WordCount; i++)
@@ -4653,7 +4647,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypePointer:
       {
-        op.type = new SPVTypeData();
+        op.type = module.arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::ePointer;
 
         SPVInstruction *baseTypeInst = module.GetByID(spirv[it + 3]);
@@ -4668,7 +4662,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeImage:
       {
-        op.type = new SPVTypeData();
+        op.type = module.arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eImage;
 
         SPVInstruction *baseTypeInst = module.GetByID(spirv[it + 2]);
@@ -4691,7 +4685,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeSampler:
       {
-        op.type = new SPVTypeData();
+        op.type = module.arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eSampler;
 
         op.id = spirv[it + 1];
@@ -4700,7 +4694,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeSampledImage:
       {
-        op.type = new SPVTypeData();
+        op.type = module.arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eSampledImage;
 
         SPVInstruction *baseTypeInst = module.GetByID(spirv[it + 2]);
@@ -4714,7 +4708,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeFunction:
       {
-        op.type = new SPVTypeData();
+        op.type = module.arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eFunction;
 
         for(int i = 3; i < WordCount; i++)
@@ -4747,7 +4741,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.constant = new SPVConstant();
+        op.constant = module.arena.New<SPVConstant>();
         op.constant->specialized =
             (op.opcode == spv::OpSpecConstantTrue || op.opcode == spv::OpSpecConstantFalse);
         op.constant->type = typeInst->type;
@@ -4764,7 +4758,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.constant = new SPVConstant();
+        op.constant = module.arena.New<SPVConstant>();
         op.constant->type = typeInst->type;
 
         op.constant->u32 = 0;
@@ -4779,7 +4773,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.constant = new SPVConstant();
+        op.constant = module.arena.New<SPVConstant>();
         op.constant->specialized = op.opcode == spv::OpSpecConstant;
         op.constant->type = typeInst->type;
 
@@ -4806,7 +4800,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.constant = new SPVConstant();
+        op.constant = module.arena.New<SPVConstant>();
         op.constant->specialized = op.opcode == spv::OpSpecConstantComposite;
         op.constant->type = typeInst->type;
 
@@ -4828,7 +4822,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.constant = new SPVConstant();
+        op.constant = module.arena.New<SPVConstant>();
         op.constant->type = typeInst->type;
 
         op.constant->sampler.addressing = spv::SamplerAddressingMode(spirv[it + 3]);
@@ -4845,7 +4839,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.constant = new SPVConstant();
+        op.constant = module.arena.New<SPVConstant>();
         op.constant->specialized = true;
         op.constant->type = typeInst->type;
 
@@ -4874,7 +4868,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 4]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.func = new SPVFunction();
+        op.func = module.arena.New<SPVFunction>();
         op.func->retType = retTypeInst->type;
         op.func->funcType = typeInst->type;
         op.func->control = spv::FunctionControlMask(spirv[it + 3]);
@@ -4911,7 +4905,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.var = new SPVVariable();
+        op.var = module.arena.New<SPVVariable>();
         op.var->type = typeInst->type;
         op.var->storage = spv::StorageClass(spirv[it + 3]);
 
@@ -4936,7 +4930,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.var = new SPVVariable();
+        op.var = module.arena.New<SPVVariable>();
         op.var->type = typeInst->type;
         op.var->storage = spv::StorageClassFunction;
 
@@ -4951,7 +4945,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       // Branching/flow control
       case spv::OpLabel:
       {
-        op.block = new SPVBlock();
+        op.block = module.arena.New<SPVBlock>();
 
         RDCASSERT(curFunc);
 
@@ -4966,7 +4960,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       case spv::OpUnreachable:
       case spv::OpReturn:
       {
-        op.flow = new SPVFlowControl();
+        op.flow = module.arena.New<SPVFlowControl>();
 
         curBlock->exitFlow = &op;
         curBlock = NULL;
@@ -4974,7 +4968,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpReturnValue:
       {
-        op.flow = new SPVFlowControl();
+        op.flow = module.arena.New<SPVFlowControl>();
 
         op.flow->targets.push_back(spirv[it + 1]);
 
@@ -4984,7 +4978,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpBranch:
       {
-        op.flow = new SPVFlowControl();
+        op.flow = module.arena.New<SPVFlowControl>();
 
         op.flow->targets.push_back(spirv[it + 1]);
 
@@ -4994,7 +4988,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpBranchConditional:
       {
-        op.flow = new SPVFlowControl();
+        op.flow = module.arena.New<SPVFlowControl>();
 
         SPVInstruction *condInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(condInst);
@@ -5015,7 +5009,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpSwitch:
       {
-        op.flow = new SPVFlowControl();
+        op.flow = module.arena.New<SPVFlowControl>();
 
         SPVInstruction *condInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(condInst);
@@ -5042,7 +5036,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpSelectionMerge:
       {
-        op.flow = new SPVFlowControl();
+        op.flow = module.arena.New<SPVFlowControl>();
 
         op.flow->targets.push_back(spirv[it + 1]);
         op.flow->selControl = spv::SelectionControlMask(spirv[it + 2]);
@@ -5052,7 +5046,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpLoopMerge:
       {
-        op.flow = new SPVFlowControl();
+        op.flow = module.arena.New<SPVFlowControl>();
 
         op.flow->targets.push_back(spirv[it + 1]);
         op.flow->loopControl = spv::LoopControlMask(spirv[it + 2]);
@@ -5067,7 +5061,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.op = new SPVOperation();
+        op.op = module.arena.New<SPVOperation>();
         op.op->type = typeInst->type;
 
         SPVInstruction *ptrInst = module.GetByID(spirv[it + 3]);
@@ -5088,7 +5082,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       case spv::OpStore:
       case spv::OpCopyMemory:
       {
-        op.op = new SPVOperation();
+        op.op = module.arena.New<SPVOperation>();
         op.op->type = NULL;
 
         SPVInstruction *ptrInst = module.GetByID(spirv[it + 1]);
@@ -5112,7 +5106,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.op = new SPVOperation();
+        op.op = module.arena.New<SPVOperation>();
         op.op->type = typeInst->type;
 
         for(int i = 3; i < WordCount; i += 2)
@@ -5141,7 +5135,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.op = new SPVOperation();
+        op.op = module.arena.New<SPVOperation>();
         op.op->type = typeInst->type;
 
         SPVInstruction *imageInst = module.GetByID(spirv[it + 3]);
@@ -5248,7 +5242,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
           default: break;
         }
 
-        op.op = new SPVOperation();
+        op.op = module.arena.New<SPVOperation>();
 
         if(op.opcode != spv::OpImageWrite)
         {
@@ -5493,7 +5487,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
 
         word++;
 
-        op.op = new SPVOperation();
+        op.op = module.arena.New<SPVOperation>();
         op.op->type = typeInst->type;
         op.op->mathop = mathop;
 
@@ -5532,7 +5526,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       {
         // these don't emit an ID, don't take a type, they are just
         // single operations
-        op.op = new SPVOperation();
+        op.op = module.arena.New<SPVOperation>();
         op.op->type = NULL;
 
         curBlock->instructions.push_back(&op);
@@ -5542,7 +5536,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       case spv::OpMemoryBarrier:
       {
         // these don't emit an ID, just have some properties
-        op.op = new SPVOperation();
+        op.op = module.arena.New<SPVOperation>();
         op.op->type = NULL;
 
         int word = 1;
@@ -5586,7 +5580,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.op = new SPVOperation();
+        op.op = module.arena.New<SPVOperation>();
         op.op->type = typeInst->type;
 
         {
@@ -5617,7 +5611,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.op = new SPVOperation();
+        op.op = module.arena.New<SPVOperation>();
         op.op->type = typeInst->type;
 
         {
@@ -5652,7 +5646,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + word]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.op = new SPVOperation();
+        op.op = module.arena.New<SPVOperation>();
         op.op->type = typeInst->type;
 
         word++;
@@ -5705,7 +5699,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       {
         int word = 1;
 
-        op.op = new SPVOperation();
+        op.op = module.arena.New<SPVOperation>();
 
         // all atomic operations but store return a new ID of a given type
         if(op.opcode != spv::OpAtomicStore)
@@ -23,8 +23,7 @@
  ******************************************************************************/
 
 #include "vk_core.h"
-#include "jpeg-compressor/jpge.h"
-#include "maths/formatpacking.h"
+#include "core/capture_thumbnail.h"
 #include "serialise/string_utils.h"
 #include "vk_debug.h"
 
@@ -299,6 +298,7 @@ WrappedVulkan::WrappedVulkan(const char *logFilename) : m_RenderState(&m_Creatio
   m_RenderState.m_ResourceManager = GetResourceManager();
 
   m_HeaderChunk = NULL;
+  m_CaptureWrite = NULL;
 
   if(!RenderDoc::Inst().IsReplayApp())
   {
@@ -387,7 +387,7 @@ VkCommandBuffer WrappedVulkan::GetNextCmd()
   return ret;
 }
 
-void WrappedVulkan::SubmitCmds()
+void WrappedVulkan::SubmitCmds(VkFence fence)
 {
   // nothing to do
   if(m_InternalCmds.pendingcmds.empty())
@@ -414,7 +414,8 @@ void WrappedVulkan::SubmitCmds()
   // skip the submit
   if(m_Queue != VK_NULL_HANDLE)
   {
-    VkResult vkr = ObjDisp(m_Queue)->QueueSubmit(Unwrap(m_Queue), 1, &submitInfo, VK_NULL_HANDLE);
+    VkResult vkr = ObjDisp(m_Queue)->QueueSubmit(Unwrap(m_Queue), 1, &submitInfo,
+                                                 fence == VK_NULL_HANDLE ? fence : Unwrap(fence));
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
   }
 
@@ -469,6 +470,9 @@ void WrappedVulkan::SubmitSemaphores()
 
 void WrappedVulkan::FlushQ()
 {
+  RDCPROFILE_SCOPE("WrappedVulkan::FlushQ");
+  RDCPROFILE_COUNTER(Profile_GPUWaits, 1);
+
   // VKTODOLOW could do away with the need for this function by keeping
   // commands until N presents later, or something, or checking on fences.
   // If we do so, then check each use for FlushQ to see if it needs a
@@ -498,7 +502,7 @@ void WrappedVulkan::FlushQ()
   }
 }
 
-uint32_t WrappedVulkan::HandlePreCallback(VkCommandBuffer commandBuffer, bool dispatch)
+uint32_t WrappedVulkan::HandlePreCallback(VkCommandBuffer commandBuffer, DrawcallFlags type)
 {
   if(!m_DrawcallCallback)
     return 0;
@@ -520,14 +524,73 @@ uint32_t WrappedVulkan::HandlePreCallback(VkCommandBuffer commandBuffer, bool di
     ++it;
   }
 
-  if(dispatch)
+  if(type == eDraw_Drawcall)
+    m_DrawcallCallback->PreDraw(eventID, commandBuffer);
+  else if(type == eDraw_Dispatch)
     m_DrawcallCallback->PreDispatch(eventID, commandBuffer);
   else
-    m_DrawcallCallback->PreDraw(eventID, commandBuffer);
+    m_DrawcallCallback->PreMisc(eventID, type, commandBuffer);
 
   return eventID;
 }
 
+static bool RegionContains(const ImageRegionState &st, VkImageAspectFlags aspect, uint32_t mip,
+                           uint32_t slice)
+{
+  const VkImageSubresourceRange &r = st.subresourceRange;
+
+  if((r.aspectMask & aspect) == 0 || mip < r.baseMipLevel || slice < r.baseArrayLayer)
+    return false;
+
+  if(r.levelCount != VK_REMAINING_MIP_LEVELS && mip >= r.baseMipLevel + r.levelCount)
+    return false;
+
+  if(r.layerCount != VK_REMAINING_ARRAY_LAYERS && slice >= r.baseArrayLayer + r.layerCount)
+    return false;
+
+  return true;
+}
+
+VkImageLayout WrappedVulkan::GetImageLayout(VkCommandBuffer cmd, ResourceId image,
+                                            VkImageAspectFlags aspect, uint32_t mip, uint32_t slice)
+{
+  // barriers recorded so far into this command buffer haven't been applied to m_ImageLayouts yet
+  const vector<pair<ResourceId, ImageRegionState> > &barriers =
+      m_BakedCmdBufferInfo[GetResID(cmd)].imgbarriers;
+
+  for(size_t i = barriers.size(); i > 0; i--)
+    if(barriers[i - 1].first == image &&
+       RegionContains(barriers[i - 1].second, aspect, mip, slice))
+      return barriers[i - 1].second.newLayout;
+
+  SCOPED_LOCK(m_ImageLayoutsLock);
+
+  auto it = m_ImageLayouts.find(image);
+  if(it != m_ImageLayouts.end())
+  {
+    const vector<ImageRegionState> &states = it->second.subresourceStates;
+
+    // states are kept in disjoint layer bands sorted by layer, so skip straight to the first
+    // band that could contain slice
+    size_t begin = 0, end = states.size();
+    while(begin < end)
+    {
+      size_t mid = begin + (end - begin) / 2;
+      const VkImageSubresourceRange &r = states[mid].subresourceRange;
+      if(r.layerCount != VK_REMAINING_ARRAY_LAYERS && r.baseArrayLayer + r.layerCount <= slice)
+        begin = mid + 1;
+      else
+        end = mid;
+    }
+
+    for(size_t i = begin; i < states.size(); i++)
+      if(RegionContains(states[i], aspect, mip, slice))
+        return states[i].newLayout;
+  }
+
+  return VK_IMAGE_LAYOUT_GENERAL;
+}
+
 const char *WrappedVulkan::GetChunkName(uint32_t idx)
 {
   if(idx == CREATE_PARAMS)
@@ -969,6 +1032,11 @@ void WrappedVulkan::StartFrameCapture(void *dev, void *wnd)
   if(m_State != WRITING_IDLE)
     return;
 
+  RDCPROFILE_SCOPE("WrappedVulkan::StartFrameCapture");
+
+  // the previous capture's chunks must have been written before the frame record is reset
+  FinishCaptureWrite(true);
+
   RenderDoc::Inst().SetCurrentDriver(RDC_Vulkan);
 
   m_AppControlledCapture = true;
@@ -1003,11 +1071,41 @@ void WrappedVulkan::StartFrameCapture(void *dev, void *wnd)
   RDCLOG("Starting capture, frame %u", m_FrameCounter);
 }
 
+struct WrappedVulkan::CaptureWrite
+{
+  CaptureWrite()
+      : fileSerialiser(NULL),
+        readbackIm(VK_NULL_HANDLE),
+        readbackMem(VK_NULL_HANDLE),
+        headerChunk(NULL),
+        thread(0),
+        done(0)
+  {
+  }
+
+  Serialiser *fileSerialiser;
+  CaptureThumbnail thumbnail;
+
+  // the backbuffer readback that the thumbnail is encoded from, left mapped until it's done
+  VkImage readbackIm;
+  VkDeviceMemory readbackMem;
+
+  // everything the file serialiser's chunks point into, kept until the file has been written
+  Chunk *headerChunk;
+  vector<VkResourceRecord *> cmdBufferRecords;
+  vector<VkResourceRecord *> heldRecords;
+
+  Threading::ThreadHandle thread;
+  volatile int32_t done;
+};
+
 bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
 {
   if(m_State != WRITING_CAPFRAME)
     return true;
 
+  RDCPROFILE_SCOPE("WrappedVulkan::EndFrameCapture");
+
   VkSwapchainKHR swap = VK_NULL_HANDLE;
 
   if(wnd)
@@ -1075,14 +1173,16 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
     FinishCapture();
   }
 
-  byte *thpixels = NULL;
-  uint32_t thwidth = 0;
-  uint32_t thheight = 0;
+  CaptureWrite *pending = new CaptureWrite();
 
-  // gather backbuffer screenshot
-  const uint32_t maxSize = 1024;
+  // since these objects are very short lived (only until the thumbnail has been encoded from the
+  // mapped memory), we don't wrap them.
+  VkImage &readbackIm = pending->readbackIm;
+  VkDeviceMemory &readbackMem = pending->readbackMem;
 
-  if(swap != VK_NULL_HANDLE)
+  // gather backbuffer screenshot. Only a capture of a specific window gets a thumbnail, the last
+  // presented swapchain isn't read back when no window was given
+  if(wnd != NULL && swap != VK_NULL_HANDLE)
   {
     VkDevice device = GetDev();
     VkCommandBuffer cmd = GetNextCmd();
@@ -1093,11 +1193,6 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
 
     const SwapchainInfo &swapInfo = *swaprecord->swapInfo;
 
-    // since these objects are very short lived (only this scope), we
-    // don't wrap them.
-    VkImage readbackIm = VK_NULL_HANDLE;
-    VkDeviceMemory readbackMem = VK_NULL_HANDLE;
-
     VkResult vkr = VK_SUCCESS;
 
     // create identical image
@@ -1206,129 +1301,14 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
 
     RDCASSERT(pData != NULL);
 
-    // point sample info into raw buffer
-    {
-      ResourceFormat fmt = MakeResourceFormat(imInfo.format);
-
-      byte *data = (byte *)pData;
-
-      data += layout.offset;
-
-      float widthf = float(imInfo.extent.width);
-      float heightf = float(imInfo.extent.height);
-
-      float aspect = widthf / heightf;
-
-      thwidth = RDCMIN(maxSize, imInfo.extent.width);
-      thwidth &= ~0x7;    // align down to multiple of 8
-      thheight = uint32_t(float(thwidth) / aspect);
-
-      thpixels = new byte[3 * thwidth * thheight];
-
-      uint32_t stride = fmt.compByteWidth * fmt.compCount;
-
-      bool buf1010102 = false;
-      bool bufBGRA = (fmt.bgraOrder != false);
-
-      if(fmt.special && fmt.specialFormat == eSpecial_R10G10B10A2)
-      {
-        stride = 4;
-        buf1010102 = true;
-      }
-
-      byte *dst = thpixels;
-
-      for(uint32_t y = 0; y < thheight; y++)
-      {
-        for(uint32_t x = 0; x < thwidth; x++)
-        {
-          float xf = float(x) / float(thwidth);
-          float yf = float(y) / float(thheight);
-
-          byte *src =
-              &data[stride * uint32_t(xf * widthf) + layout.rowPitch * uint32_t(yf * heightf)];
-
-          if(buf1010102)
-          {
-            uint32_t *src1010102 = (uint32_t *)src;
-            Vec4f unorm = ConvertFromR10G10B10A2(*src1010102);
-            dst[0] = (byte)(unorm.x * 255.0f);
-            dst[1] = (byte)(unorm.y * 255.0f);
-            dst[2] = (byte)(unorm.z * 255.0f);
-          }
-          else if(bufBGRA)
-          {
-            dst[0] = src[2];
-            dst[1] = src[1];
-            dst[2] = src[0];
-          }
-          else if(fmt.compByteWidth == 2)    // R16G16B16A16 backbuffer
-          {
-            uint16_t *src16 = (uint16_t *)src;
-
-            float linearR = RDCCLAMP(ConvertFromHalf(src16[0]), 0.0f, 1.0f);
-            float linearG = RDCCLAMP(ConvertFromHalf(src16[1]), 0.0f, 1.0f);
-            float linearB = RDCCLAMP(ConvertFromHalf(src16[2]), 0.0f, 1.0f);
-
-            if(linearR < 0.0031308f)
-              dst[0] = byte(255.0f * (12.92f * linearR));
-            else
-              dst[0] = byte(255.0f * (1.055f * powf(linearR, 1.0f / 2.4f) - 0.055f));
-
-            if(linearG < 0.0031308f)
-              dst[1] = byte(255.0f * (12.92f * linearG));
-            else
-              dst[1] = byte(255.0f * (1.055f * powf(linearG, 1.0f / 2.4f) - 0.055f));
-
-            if(linearB < 0.0031308f)
-              dst[2] = byte(255.0f * (12.92f * linearB));
-            else
-              dst[2] = byte(255.0f * (1.055f * powf(linearB, 1.0f / 2.4f) - 0.055f));
-          }
-          else
-          {
-            dst[0] = src[0];
-            dst[1] = src[1];
-            dst[2] = src[2];
-          }
-
-          dst += 3;
-        }
-      }
-    }
-
-    vt->UnmapMemory(Unwrap(device), readbackMem);
-
-    // delete all
-    vt->DestroyImage(Unwrap(device), readbackIm, NULL);
-    vt->FreeMemory(Unwrap(device), readbackMem, NULL);
+    // the thumbnail is downsampled and compressed on a worker thread while the frame is
+    // serialised below, reading straight from the mapped memory
+    pending->thumbnail.Start(MakeResourceFormat(imInfo.format), pData + layout.offset,
+                             imInfo.extent.width, imInfo.extent.height, (size_t)layout.rowPitch);
   }
 
-  byte *jpgbuf = NULL;
-  int len = thwidth * thheight;
-
-  if(wnd)
-  {
-    jpgbuf = new byte[len];
-
-    jpge::params p;
-
-    p.m_quality = 40;
-
-    bool success =
-        jpge::compress_image_to_jpeg_file_in_memory(jpgbuf, len, thwidth, thheight, 3, thpixels, p);
-
-    if(!success)
-    {
-      RDCERR("Failed to compress to jpg");
-      SAFE_DELETE_ARRAY(jpgbuf);
-      thwidth = 0;
-      thheight = 0;
-    }
-  }
-
-  Serialiser *m_pFileSerialiser = RenderDoc::Inst().OpenWriteSerialiser(
-      m_FrameCounter, &m_InitParams, jpgbuf, len, thwidth, thheight);
+  Serialiser *m_pFileSerialiser =
+      RenderDoc::Inst().OpenWriteSerialiser(m_FrameCounter, &m_InitParams);
 
   {
     CACHE_THREAD_SERIALISER();
@@ -1340,7 +1320,9 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
 
   RDCDEBUG("Inserting Resource Serialisers");
 
-  GetResourceManager()->InsertReferencedChunks(m_pFileSerialiser);
+  // the capture is written after this function returns, so it holds on to the records it
+  // references in case the application destroys their resources in the meantime
+  GetResourceManager()->InsertReferencedChunks(m_pFileSerialiser, &pending->heldRecords);
 
   GetResourceManager()->InsertInitialContentsChunks(m_pFileSerialiser);
 
@@ -1366,7 +1348,7 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
     RDCDEBUG("Flushing %u command buffer records to file serialiser",
              (uint32_t)m_CmdBufferRecords.size());
 
-    map<int32_t, Chunk *> recordlist;
+    ChunkListMerger recordlist;
 
     // ensure all command buffer records within the frame evne if recorded before, but
     // otherwise order must be preserved (vs. queue submits and desc set updates)
@@ -1375,34 +1357,36 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
       m_CmdBufferRecords[i]->Insert(recordlist);
 
       RDCDEBUG("Adding %u chunks to file serialiser from command buffer %llu",
-               (uint32_t)recordlist.size(), m_CmdBufferRecords[i]->GetResourceID());
+               (uint32_t)recordlist.NumChunks(), m_CmdBufferRecords[i]->GetResourceID());
     }
 
     m_FrameCaptureRecord->Insert(recordlist);
 
+    vector<Chunk *> sortedChunks;
+    recordlist.Merge(sortedChunks);
+
     RDCDEBUG("Flushing %u chunks to file serialiser from context record",
-             (uint32_t)recordlist.size());
+             (uint32_t)sortedChunks.size());
 
-    for(auto it = recordlist.begin(); it != recordlist.end(); ++it)
-      m_pFileSerialiser->Insert(it->second);
+    for(size_t i = 0; i < sortedChunks.size(); i++)
+      m_pFileSerialiser->Insert(sortedChunks[i]);
 
     RDCDEBUG("Done");
   }
 
-  m_pFileSerialiser->FlushToDisk();
-
-  RenderDoc::Inst().SuccessfullyWrittenLog();
+  // waiting for the thumbnail, compressing the frame and writing it to disk all happen on a worker
+  // thread so the application can carry on. Anything the serialiser's chunks point into is handed
+  // over with it, and FinishCaptureWrite cleans it up once the file has been written
+  pending->fileSerialiser = m_pFileSerialiser;
+  pending->headerChunk = m_HeaderChunk;
+  pending->cmdBufferRecords.swap(m_CmdBufferRecords);
 
-  SAFE_DELETE(m_pFileSerialiser);
-  SAFE_DELETE(m_HeaderChunk);
+  m_HeaderChunk = NULL;
 
   m_State = WRITING_IDLE;
 
-  // delete cmd buffers now - had to keep them alive until after serialiser flush.
-  for(size_t i = 0; i < m_CmdBufferRecords.size(); i++)
-    m_CmdBufferRecords[i]->Delete(GetResourceManager());
-
-  m_CmdBufferRecords.clear();
+  m_CaptureWrite = pending;
+  pending->thread = Threading::CreateThread(&WrappedVulkan::CaptureWriteThread, pending);
 
   GetResourceManager()->MarkUnwrittenResources();
 
@@ -1415,6 +1399,64 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
   return true;
 }
 
+void WrappedVulkan::CaptureWriteThread(void *param)
+{
+  CaptureWrite *pending = (CaptureWrite *)param;
+
+  // the thumbnail goes at the start of the capture, so has to be ready before it's written out
+  pending->thumbnail.Finish();
+
+  RenderDoc::Inst().InsertThumbnail(pending->fileSerialiser, pending->thumbnail.GetJPEG(),
+                                    pending->thumbnail.GetJPEGSize(), pending->thumbnail.GetWidth(),
+                                    pending->thumbnail.GetHeight());
+
+  pending->fileSerialiser->FlushToDisk();
+
+  RenderDoc::Inst().SuccessfullyWrittenLog();
+
+  SAFE_DELETE(pending->fileSerialiser);
+
+  Atomic::Inc32(&pending->done);
+}
+
+void WrappedVulkan::FinishCaptureWrite(bool wait)
+{
+  CaptureWrite *pending = m_CaptureWrite;
+
+  if(pending == NULL)
+    return;
+
+  if(!wait && Atomic::CmpExch32(&pending->done, 0, 0) == 0)
+    return;
+
+  Threading::JoinThread(pending->thread);
+  Threading::CloseThread(pending->thread);
+
+  if(pending->readbackMem != VK_NULL_HANDLE)
+  {
+    VkDevice device = GetDev();
+    const VkLayerDispatchTable *vt = ObjDisp(device);
+
+    vt->UnmapMemory(Unwrap(device), pending->readbackMem);
+
+    // delete all
+    vt->DestroyImage(Unwrap(device), pending->readbackIm, NULL);
+    vt->FreeMemory(Unwrap(device), pending->readbackMem, NULL);
+  }
+
+  SAFE_DELETE(pending->headerChunk);
+
+  // delete cmd buffers now - had to keep them alive until after serialiser flush.
+  for(size_t i = 0; i < pending->cmdBufferRecords.size(); i++)
+    pending->cmdBufferRecords[i]->Delete(GetResourceManager());
+
+  // and release the references held on the records whose chunks were written
+  for(size_t i = 0; i < pending->heldRecords.size(); i++)
+    pending->heldRecords[i]->Delete(GetResourceManager());
+
+  SAFE_DELETE(m_CaptureWrite);
+}
+
 void WrappedVulkan::ReadLogInitialisation()
 {
   uint64_t lastFrame = 0;
@@ -1466,6 +1508,9 @@ void WrappedVulkan::ReadLogInitialisation()
 
     VulkanChunkType context = (VulkanChunkType)m_pSerialiser->PushContext(NULL, NULL, 1, false);
 
+    // chunk names are static strings so can be used directly as scope names
+    RDCPROFILE_SCOPE(GetChunkName(context));
+
     if(context == CAPTURE_SCOPE)
     {
       // immediately read rest of log into memory
@@ -1486,6 +1531,8 @@ void WrappedVulkan::ReadLogInitialisation()
 
     uint64_t offset2 = m_pSerialiser->GetOffset();
 
+    RDCPROFILE_COUNTER(Profile_BytesSerialised, offset2 - offset);
+
     chunkInfos[context].total += timer.GetMilliseconds();
     chunkInfos[context].totalsize += offset2 - offset;
     chunkInfos[context].count++;
@@ -1533,6 +1580,8 @@ void WrappedVulkan::ReadLogInitialisation()
 void WrappedVulkan::ContextReplayLog(LogState readType, uint32_t startEventID, uint32_t endEventID,
                                      bool partial)
 {
+  RDCPROFILE_SCOPE("WrappedVulkan::ContextReplayLog");
+
   m_State = readType;
 
   VulkanChunkType header = (VulkanChunkType)m_pSerialiser->PushContext(NULL, NULL, 1, false);
@@ -2114,6 +2163,8 @@ void WrappedVulkan::ProcessChunk(uint64_t offset, VulkanChunkType context)
 
 void WrappedVulkan::ReplayLog(uint32_t startEventID, uint32_t endEventID, ReplayLogType replayType)
 {
+  RDCPROFILE_SCOPE("WrappedVulkan::ReplayLog");
+
   uint64_t offs = m_FrameRecord.frameInfo.fileOffset;
 
   m_pSerialiser->SetOffset(offs);
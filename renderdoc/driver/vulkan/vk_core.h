@@ -126,6 +126,11 @@ struct DrawcallCallback
   virtual bool PostDispatch(uint32_t eid, VkCommandBuffer cmd) = 0;
   virtual void PostRedispatch(uint32_t eid, VkCommandBuffer cmd) = 0;
 
+  // called around any other event that writes to resources - clears, copies,
+  // blits and resolves. These can't be modified, so there is no re-issue.
+  virtual void PreMisc(uint32_t eid, DrawcallFlags flags, VkCommandBuffer cmd) = 0;
+  virtual void PostMisc(uint32_t eid, DrawcallFlags flags, VkCommandBuffer cmd) = 0;
+
   // should we re-record all command buffers? this needs to be true if the range
   // being replayed is larger than one command buffer (which usually means the
   // whole frame).
@@ -212,6 +217,10 @@ private:
   Threading::CriticalSection m_CmdBufferRecordsLock;
   vector<VkResourceRecord *> m_CmdBufferRecords;
 
+  // a finished capture while it's being written out on a worker thread, see EndFrameCapture
+  struct CaptureWrite;
+  CaptureWrite *m_CaptureWrite;
+
   VulkanResourceManager *m_ResourceManager;
   VulkanDebugManager *m_DebugManager;
 
@@ -220,8 +229,8 @@ private:
   DrawcallCallback *m_DrawcallCallback;
 
   // util function to handle fetching the right eventID, calling any
-  // aliases then calling PreDraw/PreDispatch.
-  uint32_t HandlePreCallback(VkCommandBuffer commandBuffer, bool dispatch = false);
+  // aliases then calling PreDraw/PreDispatch/PreMisc depending on type.
+  uint32_t HandlePreCallback(VkCommandBuffer commandBuffer, DrawcallFlags type = eDraw_Drawcall);
 
   uint32_t m_FrameCounter;
 
@@ -503,6 +512,11 @@ private:
   void StartFrameCapture(void *dev, void *wnd);
   bool EndFrameCapture(void *dev, void *wnd);
 
+  static void CaptureWriteThread(void *param);
+  // cleans up after a capture that was written on a worker thread. If wait is false and the write
+  // is still going, this returns immediately and leaves it for a later call
+  void FinishCaptureWrite(bool wait);
+
   bool Serialise_SetShaderDebugPath(Serialiser *localSerialiser, VkDevice device,
                                     VkDebugMarkerObjectTagInfoEXT *pTagInfo);
 
@@ -514,6 +528,8 @@ private:
                                           VulkanResourceManager::InitialContentData contents);
   bool Serialise_SparseImageInitialState(ResourceId id,
                                          VulkanResourceManager::InitialContentData contents);
+  void Serialise_InitialMemoryData(Serialiser *localSerialiser,
+                                   const VulkanResourceManager::InitialContentData &contents);
   bool Apply_SparseInitialState(WrappedVkBuffer *buf,
                                 VulkanResourceManager::InitialContentData contents);
   bool Apply_SparseInitialState(WrappedVkImage *im,
@@ -585,6 +601,9 @@ public:
   // replay interface
   bool Prepare_InitialState(WrappedVkRes *res);
   bool Serialise_InitialState(ResourceId resid, WrappedVkRes *res);
+  bool AllowParallel_InitialState(ResourceId id, WrappedVkRes *res);
+  void Serialise_InitialStateParallel(Serialiser *localSerialiser, ResourceId id, WrappedVkRes *res,
+                                      const VulkanResourceManager::InitialContentData &contents);
   void Create_InitialState(ResourceId id, WrappedVkRes *live, bool hasData);
   void Apply_InitialState(WrappedVkRes *live, VulkanResourceManager::InitialContentData initial);
 
@@ -624,12 +643,18 @@ public:
     return m_PhysicalDevice;
   }
   VkCommandBuffer GetNextCmd();
-  void SubmitCmds();
+  // fence, if set, is signalled when the submitted command buffers have completed
+  void SubmitCmds(VkFence fence = VK_NULL_HANDLE);
   VkSemaphore GetNextSemaphore();
   void SubmitSemaphores();
   void FlushQ();
 
   VulkanRenderState &GetRenderState() { return m_RenderState; }
+  bool IsRenderPassActive() { return m_PartialReplayData.renderPassActive; }
+  // the layout a subresource is in at the current point of a command buffer being re-recorded,
+  // taking into account any barriers already recorded into it
+  VkImageLayout GetImageLayout(VkCommandBuffer cmd, ResourceId image, VkImageAspectFlags aspect,
+                               uint32_t mip, uint32_t slice);
   void SetDrawcallCB(DrawcallCallback *cb) { m_DrawcallCallback = cb; }
   VkResult FilterDeviceExtensionProperties(VkPhysicalDevice physDev, uint32_t *pPropertyCount,
                                            VkExtensionProperties *pProperties);
@@ -42,12 +42,41 @@ void VulkanReplay::PostDeviceShutdownCounters()
 {
 }
 
+// each pipeline statistic that backs a counter. Results for a query come back with one value per
+// enabled statistic, in bit order
+static const struct
+{
+  uint32_t counterID;
+  VkQueryPipelineStatisticFlagBits stat;
+} pipeStatCounters[] = {
+    {eCounter_InputVerticesRead, VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT},
+    {eCounter_VSInvocations, VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT},
+    {eCounter_RasterizedPrimitives, VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT},
+    {eCounter_PSInvocations, VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT},
+};
+
 vector<uint32_t> VulkanReplay::EnumerateCounters()
 {
   vector<uint32_t> ret;
 
+  const VkPhysicalDeviceFeatures &features = m_pDriver->GetDeviceFeatures();
+
   ret.push_back(eCounter_EventGPUDuration);
 
+  if(features.pipelineStatisticsQuery)
+  {
+    ret.push_back(eCounter_InputVerticesRead);
+    ret.push_back(eCounter_VSInvocations);
+    ret.push_back(eCounter_PSInvocations);
+    ret.push_back(eCounter_RasterizedPrimitives);
+  }
+
+  // without precise queries the result is only zero or non-zero
+  if(features.occlusionQueryPrecise)
+    ret.push_back(eCounter_SamplesWritten);
+
+  ret.push_back(eCounter_EventCPUDuration);
+
   return ret;
 }
 
@@ -55,43 +84,112 @@ void VulkanReplay::DescribeCounter(uint32_t counterID, CounterDescription &desc)
 {
   desc.counterID = counterID;
 
-  if(counterID == eCounter_EventGPUDuration)
-  {
-    desc.name = "GPU Duration";
-    desc.description =
-        "Time taken for this event on the GPU, as measured by delta between two GPU timestamps, "
-        "top to bottom of the pipe.";
-    desc.resultByteWidth = 8;
-    desc.resultCompType = eCompType_Double;
-    desc.units = eUnits_Seconds;
-  }
-  else
+  // all the query counters are 64-bit counts
+  desc.resultByteWidth = 8;
+  desc.resultCompType = eCompType_UInt;
+  desc.units = eUnits_Absolute;
+
+  switch(counterID)
   {
-    desc.name = "Unknown";
-    desc.description = "Unknown counter ID";
-    desc.resultByteWidth = 0;
-    desc.resultCompType = eCompType_None;
-    desc.units = eUnits_Absolute;
+    case eCounter_EventGPUDuration:
+      desc.name = "GPU Duration";
+      desc.description =
+          "Time taken for this event on the GPU, as measured by delta between two GPU timestamps, "
+          "top to bottom of the pipe.";
+      desc.resultCompType = eCompType_Double;
+      desc.units = eUnits_Seconds;
+      break;
+    case eCounter_InputVerticesRead:
+      desc.name = "Input Vertices Read";
+      desc.description = "Number of vertices read by the input assembler.";
+      break;
+    case eCounter_VSInvocations:
+      desc.name = "VS Invocations";
+      desc.description = "Number of times a vertex shader was invoked.";
+      break;
+    case eCounter_PSInvocations:
+      desc.name = "FS Invocations";
+      desc.description = "Number of times a fragment shader was invoked.";
+      break;
+    case eCounter_RasterizedPrimitives:
+      desc.name = "Rasterized Primitives";
+      desc.description =
+          "Number of primitives that passed clipping and were sent to the rasterizer.";
+      break;
+    case eCounter_SamplesWritten:
+      desc.name = "Samples Written";
+      desc.description = "Number of samples that passed depth/stencil testing.";
+      break;
+    case eCounter_EventCPUDuration:
+      desc.name = "CPU Replay Duration";
+      desc.description =
+          "Time taken on the CPU to replay the API calls leading up to and including this event, "
+          "since the previous event.";
+      desc.resultCompType = eCompType_Double;
+      desc.units = eUnits_Seconds;
+      break;
+    default:
+      desc.name = "Unknown";
+      desc.description = "Unknown counter ID";
+      desc.resultByteWidth = 0;
+      desc.resultCompType = eCompType_None;
+      desc.units = eUnits_Absolute;
+      break;
   }
 }
-struct GPUTimerCallback : public DrawcallCallback
+
+// collects every requested counter in a single replay. Each event is bracketed by whichever of
+// the timestamp, pipeline statistics and occlusion queries the counters need.
+struct VulkanCounterCallback : public DrawcallCallback
 {
-  GPUTimerCallback(WrappedVulkan *vk, VulkanReplay *rp, VkQueryPool qp)
-      : m_pDriver(vk), m_pReplay(rp), m_QueryPool(qp)
+  VulkanCounterCallback(WrappedVulkan *vk, VkQueryPool timerPool, VkQueryPool statsPool,
+                        VkQueryPool occlusionPool)
+      : m_pDriver(vk),
+        m_TimerPool(timerPool),
+        m_StatsPool(statsPool),
+        m_OcclusionPool(occlusionPool)
   {
+    m_TickFrequency = Timing::GetTickFrequency();
+    m_LastEventEnd = Timing::GetTick();
     m_pDriver->SetDrawcallCB(this);
   }
-  ~GPUTimerCallback() { m_pDriver->SetDrawcallCB(NULL); }
+  ~VulkanCounterCallback() { m_pDriver->SetDrawcallCB(NULL); }
   void PreDraw(uint32_t eid, VkCommandBuffer cmd)
   {
-    ObjDisp(cmd)->CmdWriteTimestamp(Unwrap(cmd), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_QueryPool,
-                                    (uint32_t)(m_Results.size() * 2 + 0));
+    uint32_t idx = (uint32_t)m_Results.size();
+
+    if(m_TimerPool != VK_NULL_HANDLE)
+      ObjDisp(cmd)->CmdWriteTimestamp(Unwrap(cmd), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_TimerPool,
+                                      idx * 2 + 0);
+
+    if(m_StatsPool != VK_NULL_HANDLE)
+      ObjDisp(cmd)->CmdBeginQuery(Unwrap(cmd), m_StatsPool, idx, 0);
+
+    // occlusion queries are only used when precise queries are available
+    if(m_OcclusionPool != VK_NULL_HANDLE)
+      ObjDisp(cmd)->CmdBeginQuery(Unwrap(cmd), m_OcclusionPool, idx, VK_QUERY_CONTROL_PRECISE_BIT);
   }
 
   bool PostDraw(uint32_t eid, VkCommandBuffer cmd)
   {
-    ObjDisp(cmd)->CmdWriteTimestamp(Unwrap(cmd), VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                                    m_QueryPool, (uint32_t)(m_Results.size() * 2 + 1));
+    uint32_t idx = (uint32_t)m_Results.size();
+
+    if(m_OcclusionPool != VK_NULL_HANDLE)
+      ObjDisp(cmd)->CmdEndQuery(Unwrap(cmd), m_OcclusionPool, idx);
+
+    if(m_StatsPool != VK_NULL_HANDLE)
+      ObjDisp(cmd)->CmdEndQuery(Unwrap(cmd), m_StatsPool, idx);
+
+    if(m_TimerPool != VK_NULL_HANDLE)
+      ObjDisp(cmd)->CmdWriteTimestamp(Unwrap(cmd), VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                      m_TimerPool, idx * 2 + 1);
+
+    uint64_t now = Timing::GetTick();
+
+    // ticks are in milliseconds
+    m_CPUDurations.push_back(double(now - m_LastEventEnd) / (m_TickFrequency * 1000.0));
+    m_LastEventEnd = now;
+
     m_Results.push_back(eid);
     return false;
   }
@@ -101,6 +199,12 @@ struct GPUTimerCallback : public DrawcallCallback
   void PreDispatch(uint32_t eid, VkCommandBuffer cmd) { PreDraw(eid, cmd); }
   bool PostDispatch(uint32_t eid, VkCommandBuffer cmd) { return PostDraw(eid, cmd); }
   void PostRedispatch(uint32_t eid, VkCommandBuffer cmd) { PostRedraw(eid, cmd); }
+  // other events aren't measured, but their CPU time shouldn't be counted against the next draw
+  void PreMisc(uint32_t eid, DrawcallFlags flags, VkCommandBuffer cmd) {}
+  void PostMisc(uint32_t eid, DrawcallFlags flags, VkCommandBuffer cmd)
+  {
+    m_LastEventEnd = Timing::GetTick();
+  }
   bool RecordAllCmds() { return true; }
   void AliasEvent(uint32_t primary, uint32_t alias)
   {
@@ -108,9 +212,13 @@ struct GPUTimerCallback : public DrawcallCallback
   }
 
   WrappedVulkan *m_pDriver;
-  VulkanReplay *m_pReplay;
-  VkQueryPool m_QueryPool;
+  VkQueryPool m_TimerPool;
+  VkQueryPool m_StatsPool;
+  VkQueryPool m_OcclusionPool;
+  double m_TickFrequency;
+  uint64_t m_LastEventEnd;
   vector<uint32_t> m_Results;
+  vector<double> m_CPUDurations;
   // events which are the 'same' from being the same command buffer resubmitted
   // multiple times in the frame. We will only get the full callback when we're
   // recording the command buffer, and will be given the first EID. After that
@@ -120,84 +228,234 @@ struct GPUTimerCallback : public DrawcallCallback
 
 vector<CounterResult> VulkanReplay::FetchCounters(const vector<uint32_t> &counters)
 {
+  SCOPED_TIMER("VulkanReplay::FetchCounters");
+
+  vector<CounterResult> ret;
+
+  if(counters.empty())
+    return ret;
+
   uint32_t maxEID = m_pDriver->GetMaxEID();
 
   VkDevice dev = m_pDriver->GetDev();
+  const VkLayerDispatchTable *vt = ObjDisp(dev);
 
-  VkQueryPoolCreateInfo poolCreateInfo = {
-      VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, NULL, 0, VK_QUERY_TYPE_TIMESTAMP, maxEID * 2, 0};
+  const VkPhysicalDeviceFeatures &features = m_pDriver->GetDeviceFeatures();
 
-  VkQueryPool pool;
-  VkResult vkr = ObjDisp(dev)->CreateQueryPool(Unwrap(dev), &poolCreateInfo, NULL, &pool);
-  RDCASSERTEQUAL(vkr, VK_SUCCESS);
+  // work out which queries are needed to cover all the counters
+  bool timer = false, occlusion = false;
+  VkQueryPipelineStatisticFlags stats = 0;
+
+  for(size_t c = 0; c < counters.size(); c++)
+  {
+    if(counters[c] == eCounter_EventGPUDuration)
+      timer = true;
+    else if(counters[c] == eCounter_SamplesWritten && features.occlusionQueryPrecise)
+      occlusion = true;
+
+    for(size_t s = 0; s < ARRAY_COUNT(pipeStatCounters); s++)
+      if(counters[c] == pipeStatCounters[s].counterID && features.pipelineStatisticsQuery)
+        stats |= pipeStatCounters[s].stat;
+  }
+
+  // where each statistic lands in a query's results
+  uint32_t numStats = 0;
+  uint32_t statIndex[ARRAY_COUNT(pipeStatCounters)] = {};
+  for(uint32_t bit = 1; bit <= (uint32_t)VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+      bit <<= 1)
+  {
+    if((stats & bit) == 0)
+      continue;
+
+    for(size_t s = 0; s < ARRAY_COUNT(pipeStatCounters); s++)
+      if(pipeStatCounters[s].stat == bit)
+        statIndex[s] = numStats;
+
+    numStats++;
+  }
+
+  VkQueryPool timerPool = VK_NULL_HANDLE, statsPool = VK_NULL_HANDLE,
+              occlusionPool = VK_NULL_HANDLE;
+  VkResult vkr = VK_SUCCESS;
+
+  if(timer)
+  {
+    VkQueryPoolCreateInfo poolCreateInfo = {
+        VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, NULL, 0, VK_QUERY_TYPE_TIMESTAMP, maxEID * 2, 0};
+
+    vkr = vt->CreateQueryPool(Unwrap(dev), &poolCreateInfo, NULL, &timerPool);
+    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+  }
+
+  if(stats)
+  {
+    VkQueryPoolCreateInfo poolCreateInfo = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                                            NULL,
+                                            0,
+                                            VK_QUERY_TYPE_PIPELINE_STATISTICS,
+                                            maxEID,
+                                            stats};
+
+    vkr = vt->CreateQueryPool(Unwrap(dev), &poolCreateInfo, NULL, &statsPool);
+    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+  }
+
+  if(occlusion)
+  {
+    VkQueryPoolCreateInfo poolCreateInfo = {
+        VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, NULL, 0, VK_QUERY_TYPE_OCCLUSION, maxEID, 0};
+
+    vkr = vt->CreateQueryPool(Unwrap(dev), &poolCreateInfo, NULL, &occlusionPool);
+    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+  }
 
   VkCommandBuffer cmd = m_pDriver->GetNextCmd();
 
   VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
                                         VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
 
-  vkr = ObjDisp(dev)->BeginCommandBuffer(Unwrap(cmd), &beginInfo);
+  vkr = vt->BeginCommandBuffer(Unwrap(cmd), &beginInfo);
   RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
-  ObjDisp(dev)->CmdResetQueryPool(Unwrap(cmd), pool, 0, maxEID * 2);
+  if(timerPool != VK_NULL_HANDLE)
+    vt->CmdResetQueryPool(Unwrap(cmd), timerPool, 0, maxEID * 2);
+  if(statsPool != VK_NULL_HANDLE)
+    vt->CmdResetQueryPool(Unwrap(cmd), statsPool, 0, maxEID);
+  if(occlusionPool != VK_NULL_HANDLE)
+    vt->CmdResetQueryPool(Unwrap(cmd), occlusionPool, 0, maxEID);
 
-  vkr = ObjDisp(dev)->EndCommandBuffer(Unwrap(cmd));
+  vkr = vt->EndCommandBuffer(Unwrap(cmd));
   RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
 #if defined(SINGLE_FLUSH_VALIDATE)
   m_pDriver->SubmitCmds();
 #endif
 
-  GPUTimerCallback cb(m_pDriver, this, pool);
+  VulkanCounterCallback cb(m_pDriver, timerPool, statsPool, occlusionPool);
 
-  // replay the events to perform all the queries
+  // replay the events once to perform all the queries
   m_pDriver->ReplayLog(0, maxEID, eReplay_Full);
 
-  vector<uint64_t> m_Data;
-  m_Data.resize(cb.m_Results.size() * 2);
+  uint32_t numEvents = (uint32_t)cb.m_Results.size();
 
-  vkr = ObjDisp(dev)->GetQueryPoolResults(
-      Unwrap(dev), pool, 0, (uint32_t)m_Data.size(), sizeof(uint64_t) * m_Data.size(), &m_Data[0],
-      sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
-  RDCASSERTEQUAL(vkr, VK_SUCCESS);
+  vector<uint64_t> timerData, statsData, occlusionData;
+
+  if(timerPool != VK_NULL_HANDLE && numEvents > 0)
+  {
+    timerData.resize(numEvents * 2);
 
-  ObjDisp(dev)->DestroyQueryPool(Unwrap(dev), pool, NULL);
+    vkr = vt->GetQueryPoolResults(
+        Unwrap(dev), timerPool, 0, numEvents * 2, sizeof(uint64_t) * timerData.size(),
+        &timerData[0], sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+  }
 
-  vector<CounterResult> ret;
+  if(statsPool != VK_NULL_HANDLE && numEvents > 0)
+  {
+    statsData.resize(numEvents * numStats);
 
-  for(size_t i = 0; i < cb.m_Results.size(); i++)
+    vkr = vt->GetQueryPoolResults(Unwrap(dev), statsPool, 0, numEvents,
+                                  sizeof(uint64_t) * statsData.size(), &statsData[0],
+                                  sizeof(uint64_t) * numStats,
+                                  VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+  }
+
+  if(occlusionPool != VK_NULL_HANDLE && numEvents > 0)
   {
-    CounterResult result;
+    occlusionData.resize(numEvents);
+
+    vkr = vt->GetQueryPoolResults(
+        Unwrap(dev), occlusionPool, 0, numEvents, sizeof(uint64_t) * occlusionData.size(),
+        &occlusionData[0], sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+  }
 
-    uint64_t delta = m_Data[i * 2 + 1] - m_Data[i * 2 + 0];
+  if(timerPool != VK_NULL_HANDLE)
+    vt->DestroyQueryPool(Unwrap(dev), timerPool, NULL);
+  if(statsPool != VK_NULL_HANDLE)
+    vt->DestroyQueryPool(Unwrap(dev), statsPool, NULL);
+  if(occlusionPool != VK_NULL_HANDLE)
+    vt->DestroyQueryPool(Unwrap(dev), occlusionPool, NULL);
 
-    result.eventID = cb.m_Results[i];
-    result.counterID = eCounter_EventGPUDuration;
-    result.value.d =
-        (double(m_pDriver->GetDeviceProps().limits.timestampPeriod) * double(delta))    // nanoseconds
-        / (1000.0 * 1000.0 * 1000.0);    // to seconds
+  // nanoseconds per tick, to seconds
+  double timestampScale =
+      double(m_pDriver->GetDeviceProps().limits.timestampPeriod) / (1000.0 * 1000.0 * 1000.0);
 
-    ret.push_back(result);
+  for(size_t c = 0; c < counters.size(); c++)
+  {
+    uint32_t counterID = counters[c];
+
+    for(uint32_t i = 0; i < numEvents; i++)
+    {
+      CounterResult result;
+
+      result.eventID = cb.m_Results[i];
+      result.counterID = counterID;
+
+      if(counterID == eCounter_EventGPUDuration)
+      {
+        result.value.d = timestampScale * double(timerData[i * 2 + 1] - timerData[i * 2 + 0]);
+      }
+      else if(counterID == eCounter_EventCPUDuration)
+      {
+        result.value.d = cb.m_CPUDurations[i];
+      }
+      else if(counterID == eCounter_SamplesWritten)
+      {
+        if(occlusionData.empty())
+          break;
+
+        result.value.u64 = occlusionData[i];
+      }
+      else
+      {
+        size_t s = 0;
+        for(; s < ARRAY_COUNT(pipeStatCounters); s++)
+          if(pipeStatCounters[s].counterID == counterID)
+            break;
+
+        // unknown or unsupported counter
+        if(s == ARRAY_COUNT(pipeStatCounters) || statsData.empty())
+          break;
+
+        result.value.u64 = statsData[i * numStats + statIndex[s]];
+      }
+
+      ret.push_back(result);
+    }
   }
 
+  // results are sorted by event then counter, so aliases can be looked up with a binary search
+  std::sort(ret.begin(), ret.end());
+
+  vector<CounterResult> aliases;
+
   for(size_t i = 0; i < cb.m_AliasEvents.size(); i++)
   {
     CounterResult search;
-    search.counterID = eCounter_EventGPUDuration;
     search.eventID = cb.m_AliasEvents[i].first;
 
-    // find the result we're aliasing
-    auto it = std::find(ret.begin(), ret.end(), search);
-    RDCASSERT(it != ret.end());
-
-    // duplicate the result and append
-    CounterResult aliased = *it;
-    aliased.eventID = cb.m_AliasEvents[i].second;
-    ret.push_back(aliased);
+    // find the results we're aliasing
+    auto it = std::lower_bound(ret.begin(), ret.end(), search);
+    RDCASSERT(it != ret.end() && it->eventID == search.eventID);
+
+    // duplicate the results
+    for(; it != ret.end() && it->eventID == search.eventID; ++it)
+    {
+      CounterResult aliased = *it;
+      aliased.eventID = cb.m_AliasEvents[i].second;
+      aliases.push_back(aliased);
+    }
   }
 
-  // sort so that the alias results appear in the right places
-  std::sort(ret.begin(), ret.end());
+  if(!aliases.empty())
+  {
+    ret.insert(ret.end(), aliases.begin(), aliases.end());
+
+    // sort so that the alias results appear in the right places
+    std::sort(ret.begin(), ret.end());
+  }
 
   return ret;
 }
@@ -173,19 +173,16 @@ string VulkanDebugManager::GetSPIRVBlob(SPIRVShaderStage shadType,
 {
   RDCASSERT(sources.size() > 0);
 
-  uint32_t hash = strhash(sources[0].c_str());
+  uint64_t hash = strhash64(sources[0].c_str());
   for(size_t i = 1; i < sources.size(); i++)
-    hash = strhash(sources[i].c_str(), hash);
+    hash = strhash64(sources[i].c_str(), hash);
 
   char typestr[2] = {'a', 0};
   typestr[0] += (char)shadType;
-  hash = strhash(typestr, hash);
+  hash = strhash64(typestr, hash);
 
-  if(m_ShaderCache.find(hash) != m_ShaderCache.end())
-  {
-    *outBlob = m_ShaderCache[hash];
+  if(m_ShaderCache->Find(hash, *outBlob))
     return "";
-  }
 
   vector<uint32_t> *spirv = new vector<uint32_t>();
   string errors = CompileSPIRV(shadType, sources, *spirv);
@@ -206,12 +203,220 @@ string VulkanDebugManager::GetSPIRVBlob(SPIRVShaderStage shadType,
   *outBlob = spirv;
 
   if(m_CacheShaders)
+    m_ShaderCache->Add(hash, spirv);
+
+  return errors;
+}
+
+// header for vkpipeline.cache. The driver validates its own data as well, but we check the
+// device and driver ourselves rather than relying on every driver rejecting foreign data.
+struct PipelineCacheFileHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vendorID;
+  uint32_t deviceID;
+  uint32_t driverVersion;
+  uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+  uint32_t dataSize;
+};
+
+static void FillPipelineCacheHeader(PipelineCacheFileHeader &header,
+                                    const VkPhysicalDeviceProperties &props, uint32_t magic,
+                                    uint32_t version, uint32_t dataSize)
+{
+  header.magic = magic;
+  header.version = version;
+  header.vendorID = props.vendorID;
+  header.deviceID = props.deviceID;
+  header.driverVersion = props.driverVersion;
+  memcpy(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+  header.dataSize = dataSize;
+}
+
+void VulkanDebugManager::CreatePipelineCache()
+{
+  PipelineCacheFileHeader expected;
+  FillPipelineCacheHeader(expected, m_pDriver->GetDeviceProps(), m_PipelineCacheMagic,
+                          m_PipelineCacheVersion, 0);
+
+  vector<byte> initialData;
+
+  string filename = FileIO::GetAppFolderFilename("vkpipeline.cache");
+
+  FILE *f = FileIO::fopen(filename.c_str(), "rb");
+
+  if(f)
   {
-    m_ShaderCache[hash] = spirv;
-    m_ShaderCacheDirty = true;
+    PipelineCacheFileHeader header;
+    size_t read = FileIO::fread(&header, 1, sizeof(header), f);
+
+    // compare everything but the data size
+    if(read == sizeof(header) &&
+       memcmp(&header, &expected, offsetof(PipelineCacheFileHeader, dataSize)) == 0)
+    {
+      initialData.resize(header.dataSize);
+
+      size_t dataRead = 0;
+      if(header.dataSize > 0)
+        dataRead = FileIO::fread(&initialData[0], 1, header.dataSize, f);
+
+      if(dataRead != header.dataSize)
+      {
+        RDCWARN("Pipeline cache is truncated, ignoring");
+        initialData.clear();
+      }
+    }
+    else
+    {
+      RDCDEBUG("Pipeline cache is out of date or from a different device, ignoring");
+    }
+
+    FileIO::fclose(f);
   }
 
-  return errors;
+  VkPipelineCacheCreateInfo cacheInfo = {
+      VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO, NULL, 0, initialData.size(),
+      initialData.empty() ? NULL : &initialData[0],
+  };
+
+  VkResult vkr = m_pDriver->vkCreatePipelineCache(m_Device, &cacheInfo, NULL, &m_PipelineCache);
+
+  if(vkr != VK_SUCCESS && !initialData.empty())
+  {
+    RDCWARN("Couldn't create pipeline cache from %llu bytes of data, starting empty",
+            (uint64_t)initialData.size());
+
+    initialData.clear();
+    cacheInfo.initialDataSize = 0;
+    cacheInfo.pInitialData = NULL;
+
+    vkr = m_pDriver->vkCreatePipelineCache(m_Device, &cacheInfo, NULL, &m_PipelineCache);
+  }
+
+  if(vkr != VK_SUCCESS)
+  {
+    RDCERR("Couldn't create pipeline cache: %d", vkr);
+    m_PipelineCache = VK_NULL_HANDLE;
+    return;
+  }
+
+  m_PipelineCacheLoadedSize = initialData.size();
+
+  if(m_PipelineCacheLoadedSize > 0)
+    RDCDEBUG("Loaded %llu bytes of pipeline cache", (uint64_t)m_PipelineCacheLoadedSize);
+}
+
+void VulkanDebugManager::SavePipelineCache()
+{
+  if(m_PipelineCache == VK_NULL_HANDLE)
+    return;
+
+  VkDevice dev = m_Device;
+
+  size_t size = 0;
+  VkResult vkr =
+      ObjDisp(dev)->GetPipelineCacheData(Unwrap(dev), Unwrap(m_PipelineCache), &size, NULL);
+
+  // if the size hasn't changed, nothing new was compiled and the file is already up to date
+  if(vkr != VK_SUCCESS || size == 0 || size == m_PipelineCacheLoadedSize)
+    return;
+
+  vector<byte> data(size);
+  vkr = ObjDisp(dev)->GetPipelineCacheData(Unwrap(dev), Unwrap(m_PipelineCache), &size, &data[0]);
+
+  if(vkr != VK_SUCCESS)
+  {
+    RDCERR("Couldn't fetch pipeline cache data: %d", vkr);
+    return;
+  }
+
+  string filename = FileIO::GetAppFolderFilename("vkpipeline.cache");
+
+  // several replay sessions in one process - or several processes - can save at once. Each
+  // writes its own file and renames it over the cache, so a reader only ever sees a whole one
+  static volatile int32_t saveCounter = 0;
+  string tmpFilename = StringFormat::Fmt("%s.%u.%d", filename.c_str(), Process::GetCurrentPID(),
+                                         Atomic::Inc32(&saveCounter));
+
+  FILE *f = FileIO::fopen(tmpFilename.c_str(), "wb");
+
+  if(!f)
+  {
+    RDCERR("Error opening pipeline cache for write");
+    return;
+  }
+
+  PipelineCacheFileHeader header;
+  FillPipelineCacheHeader(header, m_pDriver->GetDeviceProps(), m_PipelineCacheMagic,
+                          m_PipelineCacheVersion, (uint32_t)size);
+
+  bool success = FileIO::fwrite(&header, 1, sizeof(header), f) == sizeof(header) &&
+                 FileIO::fwrite(&data[0], 1, size, f) == size;
+
+  success = (FileIO::fclose(f) == 0) && success;
+
+  if(!success || !FileIO::Move(tmpFilename.c_str(), filename.c_str(), true))
+  {
+    RDCERR("Error writing pipeline cache");
+    FileIO::Delete(tmpFilename.c_str());
+    return;
+  }
+
+  RDCDEBUG("Wrote %llu bytes of pipeline cache", (uint64_t)size);
+}
+
+void VulkanDebugManager::CreateComputePipelinesThread(void *param)
+{
+  ComputePipelineJob *job = (ComputePipelineJob *)param;
+
+  job->result = ObjDisp(job->dev)->CreateComputePipelines(
+      Unwrap(job->dev), job->cache, (uint32_t)job->infos.size(), &job->infos[0], NULL,
+      &job->pipes[0]);
+}
+
+void VulkanDebugManager::FinishComputePipelines()
+{
+  if(m_ComputePipelineJobs.empty())
+    return;
+
+  for(size_t j = 0; j < m_ComputePipelineJobs.size(); j++)
+  {
+    ComputePipelineJob *job = m_ComputePipelineJobs[j];
+
+    Threading::JoinThread(job->thread);
+    Threading::CloseThread(job->thread);
+
+    if(job->result != VK_SUCCESS)
+    {
+      RDCERR("Failed to create min/max and histogram pipelines: %d", job->result);
+      delete job;
+      continue;
+    }
+
+    // wrap the pipelines the same way vkCreateComputePipelines would have
+    for(size_t i = 0; i < job->pipes.size(); i++)
+    {
+      VkPipeline pipe = job->pipes[i];
+
+      ResourceId id = GetResourceManager()->WrapResource(Unwrap(m_Device), pipe);
+      GetResourceManager()->AddLiveResource(id, pipe);
+
+      m_pDriver->m_CreationInfo.m_Pipeline[id].Init(GetResourceManager(), m_pDriver->m_CreationInfo,
+                                                    &job->infos[i]);
+
+      *job->dests[i] = pipe;
+    }
+
+    delete job;
+  }
+
+  m_ComputePipelineJobs.clear();
+
+  for(size_t i = 0; i < m_ComputePipelineModules.size(); i++)
+    m_pDriver->vkDestroyShaderModule(m_Device, m_ComputePipelineModules[i], NULL);
+
+  m_ComputePipelineModules.clear();
 }
 
 VulkanDebugManager::VulkanDebugManager(WrappedVulkan *driver, VkDevice dev)
@@ -311,7 +516,13 @@ VulkanDebugManager::VulkanDebugManager(WrappedVulkan *driver, VkDevice dev)
   RDCEraseEl(m_OutlinePipeline);
 
   m_MeshFetchDescSetLayout = VK_NULL_HANDLE;
-  m_MeshFetchDescSet = VK_NULL_HANDLE;
+  RDCEraseEl(m_MeshFetchDescSet);
+
+  m_PostVSNextBlock = 0;
+  m_PostVSUseStamp = 0;
+  m_PostVSBatch.active = false;
+  m_PostVSBatch.numDraws = 0;
+  m_PostVSBatch.readbackUsed = 0;
 
   m_MeshPickDescSetLayout = VK_NULL_HANDLE;
   m_MeshPickDescSet = VK_NULL_HANDLE;
@@ -323,17 +534,17 @@ VulkanDebugManager::VulkanDebugManager(WrappedVulkan *driver, VkDevice dev)
 
   m_FixedColSPIRV = NULL;
 
+  m_PipelineCache = VK_NULL_HANDLE;
+  m_PipelineCacheLoadedSize = 0;
+
   m_Device = dev;
 
   //////////////////////////////////////////////////////////////////////////////////////////////////
   // Do some work that's needed both during capture and during replay
 
-  // Load shader cache, if present
-  bool success = LoadShaderCache("vkshaders.cache", m_ShaderCacheMagic, m_ShaderCacheVersion,
-                                 m_ShaderCache, ShaderCacheCallbacks);
-
-  // if we failed to load from the cache
-  m_ShaderCacheDirty = !success;
+  // Open the shader cache. Blobs are only read from disk the first time they're looked up
+  m_ShaderCache = new ShaderCache<vector<uint32_t> *, VulkanBlobShaderCallbacks>(
+      "vkshaders.cache", m_ShaderCacheMagic, m_ShaderCacheVersion, ShaderCacheCallbacks);
 
   VkResult vkr = VK_SUCCESS;
 
@@ -362,6 +573,11 @@ VulkanDebugManager::VulkanDebugManager(WrappedVulkan *driver, VkDevice dev)
   vkr = m_pDriver->vkCreateSampler(dev, &sampInfo, NULL, &m_LinearSampler);
   RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
+  // the pipeline cache is only used on replay. It's created before any pipelines, including the
+  // text renderer's which is also needed during capture, so that all of them go through it
+  if(m_State < WRITING)
+    CreatePipelineCache();
+
   VkDescriptorPoolSize captureDescPoolTypes[] = {
       {
           VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2,
@@ -385,7 +601,7 @@ VulkanDebugManager::VulkanDebugManager(WrappedVulkan *driver, VkDevice dev)
           VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 320,
       },
       {
-          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 32,
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 64,
       },
       {
           VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 32,
@@ -396,7 +612,7 @@ VulkanDebugManager::VulkanDebugManager(WrappedVulkan *driver, VkDevice dev)
       VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
       NULL,
       0,
-      9 + ARRAY_COUNT(m_TexDisplayDescSet),
+      8 + ARRAY_COUNT(m_TexDisplayDescSet) + ARRAY_COUNT(m_MeshFetchDescSet),
       ARRAY_COUNT(replayDescPoolTypes),
       &replayDescPoolTypes[0],
   };
@@ -734,7 +950,7 @@ VulkanDebugManager::VulkanDebugManager(WrappedVulkan *driver, VkDevice dev)
 
     pipeInfo.layout = m_TextPipeLayout;
 
-    vkr = m_pDriver->vkCreateGraphicsPipelines(dev, VK_NULL_HANDLE, 1, &pipeInfo, NULL,
+    vkr = m_pDriver->vkCreateGraphicsPipelines(dev, m_PipelineCache, 1, &pipeInfo, NULL,
                                                &m_TextPipeline);
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
@@ -1270,8 +1486,11 @@ VulkanDebugManager::VulkanDebugManager(WrappedVulkan *driver, VkDevice dev)
   RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
   descSetAllocInfo.pSetLayouts = &m_MeshFetchDescSetLayout;
-  vkr = m_pDriver->vkAllocateDescriptorSets(dev, &descSetAllocInfo, &m_MeshFetchDescSet);
-  RDCASSERTEQUAL(vkr, VK_SUCCESS);
+  for(size_t i = 0; i < ARRAY_COUNT(m_MeshFetchDescSet); i++)
+  {
+    vkr = m_pDriver->vkAllocateDescriptorSets(dev, &descSetAllocInfo, &m_MeshFetchDescSet[i]);
+    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+  }
 
   descSetAllocInfo.pSetLayouts = &m_MeshPickDescSetLayout;
   vkr = m_pDriver->vkAllocateDescriptorSets(dev, &descSetAllocInfo, &m_MeshPickDescSet);
@@ -1290,7 +1509,20 @@ VulkanDebugManager::VulkanDebugManager(WrappedVulkan *driver, VkDevice dev)
                           GPUBuffer::eGPUBufferGPULocal | GPUBuffer::eGPUBufferSSBO);
   m_MeshPickResultReadback.Create(driver, dev, meshPickResultSize, 1, GPUBuffer::eGPUBufferReadback);
 
-  m_ReadbackWindow.Create(driver, dev, STAGE_BUFFER_BYTE_SIZE, 1, GPUBuffer::eGPUBufferReadback);
+  for(uint32_t i = 0; i < NumReadbackWindows; i++)
+  {
+    ReadbackWindow &window = m_ReadbackWindows[i];
+
+    window.buf.Create(driver, dev, STAGE_BUFFER_BYTE_SIZE, 1, GPUBuffer::eGPUBufferReadback);
+    window.data = (byte *)window.buf.Map();
+    window.srcOffset = 0;
+    window.size = 0;
+
+    VkFenceCreateInfo fenceInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, NULL, 0};
+
+    vkr = m_pDriver->vkCreateFence(dev, &fenceInfo, NULL, &window.fence);
+    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+  }
 
   m_OutlineUBO.Create(driver, dev, 128, 10, 0);
   RDCCOMPILE_ASSERT(sizeof(OutlineUBOData) <= 128, "outline UBO size");
@@ -1460,14 +1692,14 @@ VulkanDebugManager::VulkanDebugManager(WrappedVulkan *driver, VkDevice dev)
   stages[0].module = module[BLITVS];
   stages[1].module = module[CHECKERBOARDFS];
 
-  vkr = m_pDriver->vkCreateGraphicsPipelines(dev, VK_NULL_HANDLE, 1, &pipeInfo, NULL,
+  vkr = m_pDriver->vkCreateGraphicsPipelines(dev, m_PipelineCache, 1, &pipeInfo, NULL,
                                              &m_CheckerboardPipeline);
   RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
   msaa.rasterizationSamples = VULKAN_MESH_VIEW_SAMPLES;
   pipeInfo.renderPass = RGBA8MSRP;
 
-  vkr = m_pDriver->vkCreateGraphicsPipelines(dev, VK_NULL_HANDLE, 1, &pipeInfo, NULL,
+  vkr = m_pDriver->vkCreateGraphicsPipelines(dev, m_PipelineCache, 1, &pipeInfo, NULL,
                                              &m_CheckerboardMSAAPipeline);
   RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
@@ -1479,13 +1711,13 @@ VulkanDebugManager::VulkanDebugManager(WrappedVulkan *driver, VkDevice dev)
 
   pipeInfo.layout = m_TexDisplayPipeLayout;
 
-  vkr = m_pDriver->vkCreateGraphicsPipelines(dev, VK_NULL_HANDLE, 1, &pipeInfo, NULL,
+  vkr = m_pDriver->vkCreateGraphicsPipelines(dev, m_PipelineCache, 1, &pipeInfo, NULL,
                                              &m_TexDisplayPipeline);
   RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
   pipeInfo.renderPass = RGBA32RP;
 
-  vkr = m_pDriver->vkCreateGraphicsPipelines(dev, VK_NULL_HANDLE, 1, &pipeInfo, NULL,
+  vkr = m_pDriver->vkCreateGraphicsPipelines(dev, m_PipelineCache, 1, &pipeInfo, NULL,
                                              &m_TexDisplayF32Pipeline);
   RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
@@ -1495,7 +1727,7 @@ VulkanDebugManager::VulkanDebugManager(WrappedVulkan *driver, VkDevice dev)
   attState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
   attState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
 
-  vkr = m_pDriver->vkCreateGraphicsPipelines(dev, VK_NULL_HANDLE, 1, &pipeInfo, NULL,
+  vkr = m_pDriver->vkCreateGraphicsPipelines(dev, m_PipelineCache, 1, &pipeInfo, NULL,
                                              &m_TexDisplayBlendPipeline);
   RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
@@ -1517,7 +1749,7 @@ VulkanDebugManager::VulkanDebugManager(WrappedVulkan *driver, VkDevice dev)
 
     msaa.rasterizationSamples = VkSampleCountFlagBits(1 << i);
 
-    vkr = m_pDriver->vkCreateGraphicsPipelines(dev, VK_NULL_HANDLE, 1, &pipeInfo, NULL,
+    vkr = m_pDriver->vkCreateGraphicsPipelines(dev, m_PipelineCache, 1, &pipeInfo, NULL,
                                                &m_OutlinePipeline[i]);
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
   }
@@ -1538,7 +1770,7 @@ VulkanDebugManager::VulkanDebugManager(WrappedVulkan *driver, VkDevice dev)
 
     msaa.rasterizationSamples = VkSampleCountFlagBits(1 << i);
 
-    vkr = m_pDriver->vkCreateGraphicsPipelines(dev, VK_NULL_HANDLE, 1, &pipeInfo, NULL,
+    vkr = m_pDriver->vkCreateGraphicsPipelines(dev, m_PipelineCache, 1, &pipeInfo, NULL,
                                                &m_QuadResolvePipeline[i]);
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
   }
@@ -1565,6 +1797,11 @@ VulkanDebugManager::VulkanDebugManager(WrappedVulkan *driver, VkDevice dev)
 
   for(size_t t = eTexType_1D; t < eTexType_Max; t++)
   {
+    ComputePipelineJob *job = new ComputePipelineJob();
+    job->dev = dev;
+    job->cache = Unwrap(m_PipelineCache);
+    job->result = VK_SUCCESS;
+
     for(size_t f = 0; f < 3; f++)
     {
       VkShaderModule minmaxtile = VK_NULL_HANDLE;
@@ -1616,39 +1853,43 @@ VulkanDebugManager::VulkanDebugManager(WrappedVulkan *driver, VkDevice dev)
         RDCASSERTEQUAL(vkr, VK_SUCCESS);
       }
 
-      compPipeInfo.stage.module = minmaxtile;
+      // the pipelines themselves are created on a worker thread per texture type, see
+      // FinishComputePipelines
+      VkComputePipelineCreateInfo unwrappedInfo = compPipeInfo;
+      unwrappedInfo.layout = Unwrap(m_HistogramPipeLayout);
 
-      vkr = m_pDriver->vkCreateComputePipelines(dev, VK_NULL_HANDLE, 1, &compPipeInfo, NULL,
-                                                &m_MinMaxTilePipe[t][f]);
-      RDCASSERTEQUAL(vkr, VK_SUCCESS);
+      unwrappedInfo.stage.module = Unwrap(minmaxtile);
+      job->infos.push_back(unwrappedInfo);
+      job->dests.push_back(&m_MinMaxTilePipe[t][f]);
 
-      compPipeInfo.stage.module = histogram;
+      unwrappedInfo.stage.module = Unwrap(histogram);
+      job->infos.push_back(unwrappedInfo);
+      job->dests.push_back(&m_HistogramPipe[t][f]);
 
-      vkr = m_pDriver->vkCreateComputePipelines(dev, VK_NULL_HANDLE, 1, &compPipeInfo, NULL,
-                                                &m_HistogramPipe[t][f]);
-      RDCASSERTEQUAL(vkr, VK_SUCCESS);
+      m_ComputePipelineModules.push_back(histogram);
+      m_ComputePipelineModules.push_back(minmaxtile);
 
       if(t == 1)
       {
-        compPipeInfo.stage.module = minmaxresult;
+        unwrappedInfo.stage.module = Unwrap(minmaxresult);
+        job->infos.push_back(unwrappedInfo);
+        job->dests.push_back(&m_MinMaxResultPipe[f]);
 
-        vkr = m_pDriver->vkCreateComputePipelines(dev, VK_NULL_HANDLE, 1, &compPipeInfo, NULL,
-                                                  &m_MinMaxResultPipe[f]);
-        RDCASSERTEQUAL(vkr, VK_SUCCESS);
+        m_ComputePipelineModules.push_back(minmaxresult);
       }
-
-      m_pDriver->vkDestroyShaderModule(dev, histogram, NULL);
-      m_pDriver->vkDestroyShaderModule(dev, minmaxtile, NULL);
-      if(t == 1)
-        m_pDriver->vkDestroyShaderModule(dev, minmaxresult, NULL);
     }
+
+    job->pipes.resize(job->infos.size());
+    job->thread = Threading::CreateThread(&CreateComputePipelinesThread, job);
+
+    m_ComputePipelineJobs.push_back(job);
   }
 
   {
     compPipeInfo.stage.module = module[MESHCS];
     compPipeInfo.layout = m_MeshPickLayout;
 
-    vkr = m_pDriver->vkCreateComputePipelines(dev, VK_NULL_HANDLE, 1, &compPipeInfo, NULL,
+    vkr = m_pDriver->vkCreateComputePipelines(dev, m_PipelineCache, 1, &compPipeInfo, NULL,
                                               &m_MeshPickPipeline);
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
   }
@@ -2085,27 +2326,34 @@ VulkanDebugManager::~VulkanDebugManager()
 {
   VkDevice dev = m_Device;
 
-  if(m_ShaderCacheDirty)
-  {
-    SaveShaderCache("vkshaders.cache", m_ShaderCacheMagic, m_ShaderCacheVersion, m_ShaderCache,
-                    ShaderCacheCallbacks);
-  }
-  else
-  {
-    for(auto it = m_ShaderCache.begin(); it != m_ShaderCache.end(); ++it)
-      ShaderCacheCallbacks.Destroy(it->second);
-  }
+  // make sure any pipelines still being created are finished and wrapped, so they're destroyed
+  // below along with everything else
+  FinishComputePipelines();
+
+  SavePipelineCache();
+
+  // writes out any new shaders and frees the cached blobs
+  SAFE_DELETE(m_ShaderCache);
 
   for(auto it = m_PostVSData.begin(); it != m_PostVSData.end(); ++it)
   {
-    m_pDriver->vkDestroyBuffer(dev, it->second.vsout.buf, NULL);
     m_pDriver->vkDestroyBuffer(dev, it->second.vsout.idxBuf, NULL);
-    m_pDriver->vkFreeMemory(dev, it->second.vsout.bufmem, NULL);
     m_pDriver->vkFreeMemory(dev, it->second.vsout.idxBufMem, NULL);
   }
 
   m_PostVSData.clear();
 
+  for(auto it = m_PostVSBlocks.begin(); it != m_PostVSBlocks.end(); ++it)
+  {
+    m_pDriver->vkDestroyBuffer(dev, it->second.buf, NULL);
+    m_pDriver->vkFreeMemory(dev, it->second.mem, NULL);
+  }
+
+  m_PostVSBlocks.clear();
+
+  if(m_PostVSReadback.buf != VK_NULL_HANDLE)
+    m_PostVSReadback.Destroy();
+
   // since we don't have properly registered resources, releasing our descriptor
   // pool here won't remove the descriptor sets, so we need to free our own
   // tracking data (not the API objects) for descriptor sets.
@@ -2119,6 +2367,8 @@ VulkanDebugManager::~VulkanDebugManager()
 
   m_pDriver->vkDestroyDescriptorPool(dev, m_DescriptorPool, NULL);
 
+  m_pDriver->vkDestroyPipelineCache(dev, m_PipelineCache, NULL);
+
   m_pDriver->vkDestroySampler(dev, m_LinearSampler, NULL);
   m_pDriver->vkDestroySampler(dev, m_PointSampler, NULL);
 
@@ -2200,7 +2450,12 @@ VulkanDebugManager::~VulkanDebugManager()
     }
   }
 
-  m_ReadbackWindow.Destroy();
+  for(uint32_t i = 0; i < NumReadbackWindows; i++)
+  {
+    m_ReadbackWindows[i].buf.Unmap();
+    m_ReadbackWindows[i].buf.Destroy();
+    m_pDriver->vkDestroyFence(dev, m_ReadbackWindows[i].fence, NULL);
+  }
 
   m_MinMaxTileResult.Destroy();
   m_MinMaxResult.Destroy();
@@ -2725,7 +2980,7 @@ void VulkanDebugManager::CreateCustomShaderPipeline(ResourceId shader)
       -1,                // base pipeline index
   };
 
-  VkResult vkr = m_pDriver->vkCreateGraphicsPipelines(dev, VK_NULL_HANDLE, 1, &pipeInfo, NULL,
+  VkResult vkr = m_pDriver->vkCreateGraphicsPipelines(dev, m_PipelineCache, 1, &pipeInfo, NULL,
                                                       &m_CustomTexPipeline);
   RDCASSERTEQUAL(vkr, VK_SUCCESS);
 }
@@ -2804,9 +3059,6 @@ FloatVector VulkanDebugManager::InterpretVertex(byte *data, uint32_t vert, const
 uint32_t VulkanDebugManager::PickVertex(uint32_t eventID, const MeshDisplay &cfg, uint32_t x,
                                         uint32_t y, uint32_t w, uint32_t h)
 {
-  VkDevice dev = m_pDriver->GetDev();
-  const VkLayerDispatchTable *vt = ObjDisp(dev);
-
   Matrix4f projMat = Matrix4f::Perspective(90.0f, 0.1f, 100000.0f, float(w) / float(h));
 
   Matrix4f camMat = cfg.cam ? cfg.cam->GetMatrix() : Matrix4f::Identity();
@@ -2836,6 +3088,105 @@ uint32_t VulkanDebugManager::PickVertex(uint32_t eventID, const MeshDisplay &cfg
     PickMVP = projMat.Mul(camMat.Mul(guessProj.Inverse()));
   }
 
+  vector<FloatVector> positions;
+  vector<uint32_t> indices;
+
+  // picking runs on the CPU against an index over the mesh's positions, so the only GPU work is
+  // reading the mesh back the first time it's picked
+  bool built = false;
+
+  if(!m_MeshPickIndex.IsBuiltFor(eventID, cfg.position))
+  {
+    vector<byte> idxs;
+
+    if(cfg.position.idxByteWidth && cfg.position.idxbuf != ResourceId())
+    {
+      VkDeviceSize idxSize = m_pDriver->m_CreationInfo.m_Buffer[cfg.position.idxbuf].size;
+      VkDeviceSize idxLen = VkDeviceSize(cfg.position.numVerts) * cfg.position.idxByteWidth;
+
+      if(cfg.position.idxoffs < idxSize)
+        GetBufferData(cfg.position.idxbuf, cfg.position.idxoffs,
+                      RDCMIN(idxLen, idxSize - cfg.position.idxoffs), idxs);
+    }
+
+    // promote indices to 32-bit, only reading as many as are available
+    if(!idxs.empty())
+    {
+      uint32_t numIndices =
+          RDCMIN(cfg.position.numVerts, uint32_t(idxs.size() / cfg.position.idxByteWidth));
+
+      indices.resize(numIndices);
+
+      uint16_t *idxs16 = (uint16_t *)&idxs[0];
+      uint32_t *idxs32 = (uint32_t *)&idxs[0];
+
+      if(cfg.position.idxByteWidth == 2)
+      {
+        for(uint32_t i = 0; i < numIndices; i++)
+          indices[i] = idxs16[i];
+      }
+      else
+      {
+        memcpy(&indices[0], idxs32, numIndices * sizeof(uint32_t));
+      }
+    }
+
+    // only read the vertices that can be picked, the buffer may hold far more than this mesh
+    VkDeviceSize bufSize = m_pDriver->m_CreationInfo.m_Buffer[cfg.position.buf].size;
+    VkDeviceSize len = VkDeviceSize(cfg.position.numVerts) * cfg.position.stride;
+    len = RDCMAX(len, VkDeviceSize(16));
+
+    if(cfg.position.offset < bufSize)
+    {
+      len = RDCMIN(len, bufSize - cfg.position.offset);
+
+      vector<byte> oldData;
+      GetBufferData(cfg.position.buf, cfg.position.offset, len, oldData);
+
+      byte *data = &oldData[0];
+      byte *dataEnd = data + oldData.size();
+
+      bool valid = true;
+
+      positions.resize(cfg.position.numVerts);
+
+      // unpack and linearise the data
+      for(uint32_t i = 0; i < cfg.position.numVerts; i++)
+        positions[i] = InterpretVertex(data, i, cfg, dataEnd, valid);
+    }
+
+    m_MeshPickIndex.Build(eventID, cfg.position, positions, indices);
+    built = true;
+  }
+
+  uint32_t ret = m_MeshPickIndex.Pick(PickMVP, cfg.position.unproject != 0, float(w), float(h),
+                                      float(x), float(y));
+
+#if !defined(RELEASE)
+  // check the first pick on each new mesh against the compute shader. They can legitimately
+  // disagree if the shader finds more than maxMeshPicks candidates
+  if(built)
+  {
+    uint32_t gpuRet = PickVertexGPU(cfg, PickMVP, x, y, w, h, positions, indices);
+
+    if(gpuRet != ret)
+      RDCWARN("CPU mesh pick found vertex %u, GPU mesh pick found %u", ret, gpuRet);
+  }
+#else
+  (void)built;
+#endif
+
+  return ret;
+}
+
+uint32_t VulkanDebugManager::PickVertexGPU(const MeshDisplay &cfg, const Matrix4f &PickMVP,
+                                           uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                                           const vector<FloatVector> &positions,
+                                           const vector<uint32_t> &indices)
+{
+  VkDevice dev = m_pDriver->GetDev();
+  const VkLayerDispatchTable *vt = ObjDisp(dev);
+
   MeshPickUBOData *ubo = (MeshPickUBOData *)m_MeshPickUBO.Map();
 
   ubo->coords.x = (float)x;
@@ -2843,21 +3194,16 @@ uint32_t VulkanDebugManager::PickVertex(uint32_t eventID, const MeshDisplay &cfg
   ubo->viewport.x = (float)w;
   ubo->viewport.y = (float)h;
   ubo->mvp = PickMVP;
-  ubo->use_indices = cfg.position.idxByteWidth ? 1U : 0U;
-  ubo->numVerts = cfg.position.numVerts;
+  ubo->use_indices = indices.empty() ? 0U : 1U;
+  ubo->numVerts = positions.empty() ? 0 : cfg.position.numVerts;
   ubo->unproject = cfg.position.unproject;
 
   m_MeshPickUBO.Unmap();
 
-  vector<byte> idxs;
-
-  if(cfg.position.idxByteWidth && cfg.position.idxbuf != ResourceId())
-    GetBufferData(cfg.position.idxbuf, cfg.position.idxoffs, 0, idxs);
-
   // We copy into our own buffers to promote to the target type (uint32) that the
   // shader expects. Most IBs will be 16-bit indices, most VBs will not be float4.
 
-  if(!idxs.empty())
+  if(!indices.empty())
   {
     // resize up on demand
     if(m_MeshPickIBSize < cfg.position.numVerts * sizeof(uint32_t))
@@ -2877,20 +3223,7 @@ uint32_t VulkanDebugManager::PickVertex(uint32_t eventID, const MeshDisplay &cfg
 
     uint32_t *outidxs = (uint32_t *)m_MeshPickIBUpload.Map();
 
-    uint16_t *idxs16 = (uint16_t *)&idxs[0];
-    uint32_t *idxs32 = (uint32_t *)&idxs[0];
-
-    // if indices are 16-bit, manually upcast them so the shader only
-    // has to deal with one type
-    if(cfg.position.idxByteWidth == 2)
-    {
-      for(uint32_t i = 0; i < cfg.position.numVerts; i++)
-        outidxs[i] = idxs16[i];
-    }
-    else
-    {
-      memcpy(outidxs, idxs32, cfg.position.numVerts * sizeof(uint32_t));
-    }
+    memcpy(outidxs, &indices[0], indices.size() * sizeof(uint32_t));
 
     m_MeshPickIBUpload.Unmap();
   }
@@ -2912,18 +3245,10 @@ uint32_t VulkanDebugManager::PickVertex(uint32_t eventID, const MeshDisplay &cfg
 
   // unpack and linearise the data
   {
-    vector<byte> oldData;
-    GetBufferData(cfg.position.buf, cfg.position.offset, 0, oldData);
-
-    byte *data = &oldData[0];
-    byte *dataEnd = data + oldData.size();
-
-    bool valid = true;
-
     FloatVector *vbData = (FloatVector *)m_MeshPickVBUpload.Map();
 
-    for(uint32_t i = 0; i < cfg.position.numVerts; i++)
-      vbData[i] = InterpretVertex(data, i, cfg, dataEnd, valid);
+    if(!positions.empty())
+      memcpy(vbData, &positions[0], positions.size() * sizeof(FloatVector));
 
     m_MeshPickVBUpload.Unmap();
   }
@@ -2941,7 +3266,7 @@ uint32_t VulkanDebugManager::PickVertex(uint32_t eventID, const MeshDisplay &cfg
        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, NULL, &ibInfo, NULL},
   };
 
-  if(!idxs.empty())
+  if(!indices.empty())
     vt->UpdateDescriptorSets(Unwrap(m_Device), 2, writes, 0, NULL);
   else
     vt->UpdateDescriptorSets(Unwrap(m_Device), 1, writes, 0, NULL);
@@ -2974,7 +3299,7 @@ uint32_t VulkanDebugManager::PickVertex(uint32_t eventID, const MeshDisplay &cfg
   DoPipelineBarrier(cmd, 1, &bufBarrier);
 
   // copy uploaded VB and if needed IB
-  if(!idxs.empty())
+  if(!indices.empty())
   {
     // wait for writes
     bufBarrier.buffer = Unwrap(m_MeshPickIBUpload.buf);
@@ -3122,10 +3447,6 @@ void VulkanDebugManager::GetBufferData(ResourceId buff, uint64_t offset, uint64_
 
   ret.resize((size_t)len);
 
-  VkDeviceSize srcoffset = (VkDeviceSize)offset;
-  size_t dstoffset = 0;
-  VkDeviceSize sizeRemaining = (VkDeviceSize)len;
-
   VkCommandBuffer cmd = m_pDriver->GetNextCmd();
 
   VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
@@ -3137,17 +3458,15 @@ void VulkanDebugManager::GetBufferData(ResourceId buff, uint64_t offset, uint64_
   VkBufferMemoryBarrier bufBarrier = {
       VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
       NULL,
-      0,
+      VK_ACCESS_ALL_WRITE_BITS,
       VK_ACCESS_TRANSFER_READ_BIT,
       VK_QUEUE_FAMILY_IGNORED,
       VK_QUEUE_FAMILY_IGNORED,
       Unwrap(srcBuf),
-      srcoffset,
-      sizeRemaining,
+      (VkDeviceSize)offset,
+      (VkDeviceSize)len,
   };
 
-  bufBarrier.srcAccessMask = VK_ACCESS_ALL_WRITE_BITS;
-
   // wait for previous writes to happen before we copy to our window buffer
   DoPipelineBarrier(cmd, 1, &bufBarrier);
 
@@ -3158,20 +3477,77 @@ void VulkanDebugManager::GetBufferData(ResourceId buff, uint64_t offset, uint64_
   m_pDriver->SubmitCmds();
 #endif
 
-  while(sizeRemaining > 0)
+  if(len > 0)
+    ReadbackBuffer(Unwrap(srcBuf), (VkDeviceSize)offset, (VkDeviceSize)len, &ret[0]);
+}
+
+void VulkanDebugManager::ReadbackBuffer(VkBuffer srcBuf, VkDeviceSize offset, VkDeviceSize len,
+                                        byte *dest)
+{
+  vector<ReadbackRange> ranges(1);
+  ranges[0].offset = offset;
+  ranges[0].size = len;
+  ranges[0].dest = dest;
+
+  ReadbackBufferRanges(srcBuf, ranges, NULL);
+}
+
+void VulkanDebugManager::ReadbackBufferRanges(VkBuffer srcBuf, const vector<ReadbackRange> &ranges,
+                                              ReadbackListener *listener)
+{
+  RDCPROFILE_SCOPE("VulkanDebugManager::ReadbackBuffer");
+
+  if(ranges.empty())
+    return;
+
+  VkDevice dev = m_pDriver->GetDev();
+  const VkLayerDispatchTable *vt = ObjDisp(dev);
+
+  PerformanceTimer timer;
+
+  VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+                                        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+
+  VkBufferMemoryBarrier bufBarrier = {
+      VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+      NULL,
+      VK_ACCESS_TRANSFER_WRITE_BIT,
+      VK_ACCESS_HOST_READ_BIT,
+      VK_QUEUE_FAMILY_IGNORED,
+      VK_QUEUE_FAMILY_IGNORED,
+      VK_NULL_HANDLE,
+      0,
+      0,
+  };
+
+  ReadbackStream stream = {&ranges, 0, listener};
+
+  // any gaps between the ranges are read too, they're only alignment padding
+  VkDeviceSize readOffset = ranges.front().offset;
+  VkDeviceSize end = ranges.back().offset + ranges.back().size;
+
+  uint32_t w = 0;
+
+  while(readOffset < end)
   {
-    VkDeviceSize chunkSize = RDCMIN(sizeRemaining, STAGE_BUFFER_BYTE_SIZE);
+    ReadbackWindow &window = m_ReadbackWindows[w];
+    w = (w + 1) % NumReadbackWindows;
 
-    vkr = vt->BeginCommandBuffer(Unwrap(cmd), &beginInfo);
+    // if the window still holds an earlier part, wait for it and copy it out before reusing it.
+    // The other window's copy keeps the GPU busy meanwhile.
+    FinishReadbackWindow(window, stream);
+
+    VkDeviceSize chunkSize = RDCMIN(end - readOffset, STAGE_BUFFER_BYTE_SIZE);
+
+    VkCommandBuffer cmd = m_pDriver->GetNextCmd();
+
+    VkResult vkr = vt->BeginCommandBuffer(Unwrap(cmd), &beginInfo);
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
-    VkBufferCopy region = {srcoffset, 0, chunkSize};
-    vt->CmdCopyBuffer(Unwrap(cmd), Unwrap(srcBuf), Unwrap(m_ReadbackWindow.buf), 1, &region);
+    VkBufferCopy region = {readOffset, 0, chunkSize};
+    vt->CmdCopyBuffer(Unwrap(cmd), srcBuf, Unwrap(window.buf.buf), 1, &region);
 
-    bufBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    bufBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
-    bufBarrier.buffer = Unwrap(m_ReadbackWindow.buf);
-    bufBarrier.offset = 0;
+    bufBarrier.buffer = Unwrap(window.buf.buf);
     bufBarrier.size = chunkSize;
 
     // wait for transfer to happen before we read
@@ -3180,39 +3556,102 @@ void VulkanDebugManager::GetBufferData(ResourceId buff, uint64_t offset, uint64_
     vkr = vt->EndCommandBuffer(Unwrap(cmd));
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
-    m_pDriver->SubmitCmds();
-    m_pDriver->FlushQ();
+    m_pDriver->SubmitCmds(window.fence);
 
-    byte *pData = NULL;
-    vkr = vt->MapMemory(Unwrap(dev), Unwrap(m_ReadbackWindow.mem), 0, VK_WHOLE_SIZE, 0,
-                        (void **)&pData);
-    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+    window.srcOffset = readOffset;
+    window.size = chunkSize;
 
-    RDCASSERT(pData != NULL);
-    memcpy(&ret[dstoffset], pData, (size_t)chunkSize);
+    readOffset += chunkSize;
+  }
 
-    dstoffset += (size_t)chunkSize;
-    sizeRemaining -= chunkSize;
+  // copy out whatever is still in flight, oldest first
+  for(uint32_t i = 0; i < NumReadbackWindows; i++)
+    FinishReadbackWindow(m_ReadbackWindows[(w + i) % NumReadbackWindows], stream);
 
-    vt->UnmapMemory(Unwrap(dev), Unwrap(m_ReadbackWindow.mem));
-  }
+  // only empty ranges at the very end can be left, they have nothing to wait for
+  for(; stream.nextRange < ranges.size(); stream.nextRange++)
+    if(listener)
+      listener->RangeArrived(stream.nextRange);
 
-  vt->DeviceWaitIdle(Unwrap(dev));
+  // everything has completed by now, this just recycles the command buffers
+  m_pDriver->FlushQ();
+
+  VkDeviceSize len = end - ranges.front().offset;
+
+  RDCPROFILE_COUNTER(Profile_ReadbackBytes, len);
+
+  double ms = timer.GetMilliseconds();
+  if(len >= STAGE_BUFFER_BYTE_SIZE * 4 && ms > 0.0)
+    RDCDEBUG("Read back %llu MB in %.2f ms (%.1f MB/s)", len / (1024 * 1024), ms,
+             (double(len) / (1024.0 * 1024.0)) / (ms / 1000.0));
 }
 
-void VulkanDebugManager::MakeGraphicsPipelineInfo(VkGraphicsPipelineCreateInfo &pipeCreateInfo,
-                                                  ResourceId pipeline)
+void VulkanDebugManager::FinishReadbackWindow(ReadbackWindow &window, ReadbackStream &stream)
 {
-  VulkanCreationInfo::Pipeline &pipeInfo = m_pDriver->m_CreationInfo.m_Pipeline[pipeline];
+  if(window.size == 0)
+    return;
 
-  static VkPipelineShaderStageCreateInfo stages[6];
-  static VkSpecializationInfo specInfo[6];
-  static vector<VkSpecializationMapEntry> specMapEntries;
+  VkDevice dev = m_pDriver->GetDev();
+  const VkLayerDispatchTable *vt = ObjDisp(dev);
 
-  size_t specEntries = 0;
+  VkFence fence = Unwrap(window.fence);
 
-  for(uint32_t i = 0; i < 6; i++)
-    if(pipeInfo.shaders[i].module != ResourceId())
+  VkResult vkr = vt->WaitForFences(Unwrap(dev), 1, &fence, VK_TRUE, ~0ULL);
+  RDCASSERTEQUAL(vkr, VK_SUCCESS);
+
+  vkr = vt->ResetFences(Unwrap(dev), 1, &fence);
+  RDCASSERTEQUAL(vkr, VK_SUCCESS);
+
+  // readback memory might not be coherent
+  VkMappedMemoryRange range = {
+      VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, NULL, Unwrap(window.buf.mem), 0, VK_WHOLE_SIZE,
+  };
+
+  vkr = vt->InvalidateMappedMemoryRanges(Unwrap(dev), 1, &range);
+  RDCASSERTEQUAL(vkr, VK_SUCCESS);
+
+  const vector<ReadbackRange> &ranges = *stream.ranges;
+  VkDeviceSize windowEnd = window.srcOffset + window.size;
+
+  // copy out the part of each range that's in this window
+  for(size_t r = stream.nextRange; r < ranges.size() && ranges[r].offset < windowEnd; r++)
+  {
+    const ReadbackRange &dst = ranges[r];
+
+    VkDeviceSize start = RDCMAX(dst.offset, window.srcOffset);
+    VkDeviceSize rangeEnd = dst.offset + dst.size;
+    VkDeviceSize copyEnd = RDCMIN(rangeEnd, windowEnd);
+
+    if(copyEnd > start)
+      memcpy(dst.dest + (start - dst.offset), window.data + (start - window.srcOffset),
+             (size_t)(copyEnd - start));
+
+    if(rangeEnd <= windowEnd)
+    {
+      stream.nextRange = r + 1;
+
+      if(stream.listener)
+        stream.listener->RangeArrived(r);
+    }
+  }
+
+  window.srcOffset = 0;
+  window.size = 0;
+}
+
+void VulkanDebugManager::MakeGraphicsPipelineInfo(VkGraphicsPipelineCreateInfo &pipeCreateInfo,
+                                                  ResourceId pipeline)
+{
+  VulkanCreationInfo::Pipeline &pipeInfo = m_pDriver->m_CreationInfo.m_Pipeline[pipeline];
+
+  static VkPipelineShaderStageCreateInfo stages[6];
+  static VkSpecializationInfo specInfo[6];
+  static vector<VkSpecializationMapEntry> specMapEntries;
+
+  size_t specEntries = 0;
+
+  for(uint32_t i = 0; i < 6; i++)
+    if(pipeInfo.shaders[i].module != ResourceId())
       if(!pipeInfo.shaders[i].specialization.empty())
         specEntries += pipeInfo.shaders[i].specialization.size();
 
@@ -3688,6 +4127,8 @@ struct QuadOverdrawCallback : public DrawcallCallback
   void PreDispatch(uint32_t eid, VkCommandBuffer cmd) {}
   bool PostDispatch(uint32_t eid, VkCommandBuffer cmd) { return false; }
   void PostRedispatch(uint32_t eid, VkCommandBuffer cmd) {}
+  void PreMisc(uint32_t eid, DrawcallFlags flags, VkCommandBuffer cmd) {}
+  void PostMisc(uint32_t eid, DrawcallFlags flags, VkCommandBuffer cmd) {}
   bool RecordAllCmds() { return false; }
   void AliasEvent(uint32_t primary, uint32_t alias)
   {
@@ -4064,7 +4505,7 @@ ResourceId VulkanDebugManager::RenderOverlay(ResourceId texid, TextureDisplayOve
 
     VkPipeline pipe = VK_NULL_HANDLE;
 
-    vkr = m_pDriver->vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &pipeCreateInfo, NULL,
+    vkr = m_pDriver->vkCreateGraphicsPipelines(m_Device, m_PipelineCache, 1, &pipeCreateInfo, NULL,
                                                &pipe);
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
@@ -4341,14 +4782,14 @@ ResourceId VulkanDebugManager::RenderOverlay(ResourceId texid, TextureDisplayOve
     vkr = vt->EndCommandBuffer(Unwrap(cmd));
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
-    vkr = m_pDriver->vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &pipeCreateInfo, NULL,
+    vkr = m_pDriver->vkCreateGraphicsPipelines(m_Device, m_PipelineCache, 1, &pipeCreateInfo, NULL,
                                                &pipe[0]);
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
     fragShader->module = mod[1];
     rs->cullMode = origCullMode;
 
-    vkr = m_pDriver->vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &pipeCreateInfo, NULL,
+    vkr = m_pDriver->vkCreateGraphicsPipelines(m_Device, m_PipelineCache, 1, &pipeCreateInfo, NULL,
                                                &pipe[1]);
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
@@ -4600,7 +5041,7 @@ ResourceId VulkanDebugManager::RenderOverlay(ResourceId texid, TextureDisplayOve
     vkr = vt->EndCommandBuffer(Unwrap(cmd));
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
-    vkr = m_pDriver->vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &pipeCreateInfo, NULL,
+    vkr = m_pDriver->vkCreateGraphicsPipelines(m_Device, m_PipelineCache, 1, &pipeCreateInfo, NULL,
                                                &pipe[0]);
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
@@ -4615,7 +5056,7 @@ ResourceId VulkanDebugManager::RenderOverlay(ResourceId texid, TextureDisplayOve
       pipeCreateInfo.renderPass = depthRP;
     }
 
-    vkr = m_pDriver->vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &pipeCreateInfo, NULL,
+    vkr = m_pDriver->vkCreateGraphicsPipelines(m_Device, m_PipelineCache, 1, &pipeCreateInfo, NULL,
                                                &pipe[1]);
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
@@ -5280,13 +5721,13 @@ MeshDisplayPipelines VulkanDebugManager::CacheMeshDisplayPipelines(const MeshFor
   rs.lineWidth = 1.0f;
   ds.depthTestEnable = false;
 
-  vkr = vt->CreateGraphicsPipelines(Unwrap(m_Device), VK_NULL_HANDLE, 1, &pipeInfo, NULL,
+  vkr = vt->CreateGraphicsPipelines(Unwrap(m_Device), Unwrap(m_PipelineCache), 1, &pipeInfo, NULL,
                                     &cache.pipes[MeshDisplayPipelines::ePipe_Wire]);
   RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
   ds.depthTestEnable = true;
 
-  vkr = vt->CreateGraphicsPipelines(Unwrap(m_Device), VK_NULL_HANDLE, 1, &pipeInfo, NULL,
+  vkr = vt->CreateGraphicsPipelines(Unwrap(m_Device), Unwrap(m_PipelineCache), 1, &pipeInfo, NULL,
                                     &cache.pipes[MeshDisplayPipelines::ePipe_WireDepth]);
   RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
@@ -5294,13 +5735,13 @@ MeshDisplayPipelines VulkanDebugManager::CacheMeshDisplayPipelines(const MeshFor
   rs.polygonMode = VK_POLYGON_MODE_FILL;
   ds.depthTestEnable = false;
 
-  vkr = vt->CreateGraphicsPipelines(Unwrap(m_Device), VK_NULL_HANDLE, 1, &pipeInfo, NULL,
+  vkr = vt->CreateGraphicsPipelines(Unwrap(m_Device), Unwrap(m_PipelineCache), 1, &pipeInfo, NULL,
                                     &cache.pipes[MeshDisplayPipelines::ePipe_Solid]);
   RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
   ds.depthTestEnable = true;
 
-  vkr = vt->CreateGraphicsPipelines(Unwrap(m_Device), VK_NULL_HANDLE, 1, &pipeInfo, NULL,
+  vkr = vt->CreateGraphicsPipelines(Unwrap(m_Device), Unwrap(m_PipelineCache), 1, &pipeInfo, NULL,
                                     &cache.pipes[MeshDisplayPipelines::ePipe_SolidDepth]);
   RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
@@ -5313,7 +5754,7 @@ MeshDisplayPipelines VulkanDebugManager::CacheMeshDisplayPipelines(const MeshFor
 
     vi.vertexBindingDescriptionCount = 2;
 
-    vkr = vt->CreateGraphicsPipelines(Unwrap(m_Device), VK_NULL_HANDLE, 1, &pipeInfo, NULL,
+    vkr = vt->CreateGraphicsPipelines(Unwrap(m_Device), Unwrap(m_PipelineCache), 1, &pipeInfo, NULL,
                                       &cache.pipes[MeshDisplayPipelines::ePipe_Secondary]);
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
   }
@@ -5330,7 +5771,7 @@ MeshDisplayPipelines VulkanDebugManager::CacheMeshDisplayPipelines(const MeshFor
   stages[2].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
   pipeInfo.stageCount = 3;
 
-  vkr = vt->CreateGraphicsPipelines(Unwrap(m_Device), VK_NULL_HANDLE, 1, &pipeInfo, NULL,
+  vkr = vt->CreateGraphicsPipelines(Unwrap(m_Device), Unwrap(m_PipelineCache), 1, &pipeInfo, NULL,
                                     &cache.pipes[MeshDisplayPipelines::ePipe_Lit]);
   RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
@@ -6097,14 +6538,331 @@ static void AddOutputDumping(const ShaderReflection &refl, const char *entryName
   spirv[3] = idBound;
 }
 
+// derive near/far from the post-transform positions of a draw's first instance
+static void DerivePostVSNearFar(const byte *data, uint32_t numVerts, uint32_t stride, float &nearp,
+                                float &farp)
+{
+  nearp = 0.1f;
+  farp = 100.0f;
+
+  const Vec4f *pos0 = (const Vec4f *)data;
+
+  bool found = false;
+
+  // expect position at the start of the buffer, as system values are sorted first
+  // and position is the first value
+
+  for(uint32_t i = 1; i < numVerts; i++)
+  {
+    //////////////////////////////////////////////////////////////////////////////////
+    // derive near/far, assuming a standard perspective matrix
+    //
+    // the transformation from from pre-projection {Z,W} to post-projection {Z,W}
+    // is linear. So we can say Zpost = Zpre*m + c . Here we assume Wpre = 1
+    // and we know Wpost = Zpre from the perspective matrix.
+    // we can then see from the perspective matrix that
+    // m = F/(F-N)
+    // c = -(F*N)/(F-N)
+    //
+    // with re-arranging and substitution, we then get:
+    // N = -c/m
+    // F = c/(1-m)
+    //
+    // so if we can derive m and c then we can determine N and F. We can do this with
+    // two points, and we pick them reasonably distinct on z to reduce floating-point
+    // error
+
+    const Vec4f *pos = (const Vec4f *)(data + i * stride);
+
+    // skip invalid vertices (w=0)
+    if(pos->w != 0.0f && fabs(pos->w - pos0->w) > 0.01f && fabs(pos->z - pos0->z) > 0.01f)
+    {
+      Vec2f A(pos0->w, pos0->z);
+      Vec2f B(pos->w, pos->z);
+
+      float m = (B.y - A.y) / (B.x - A.x);
+      float c = B.y - B.x * m;
+
+      if(m == 1.0f)
+        continue;
+
+      if(-c / m <= 0.000001f)
+        continue;
+
+      nearp = -c / m;
+      farp = c / (1 - m);
+
+      found = true;
+
+      break;
+    }
+  }
+
+  // if we didn't find anything, all z's and w's were identical.
+  // If the z is positive and w greater for the first element then
+  // we detect this projection as reversed z with infinite far plane
+  if(!found && pos0->z > 0.0f && pos0->w > pos0->z)
+  {
+    nearp = pos0->z;
+    farp = FLT_MAX;
+  }
+}
+
+void VulkanDebugManager::BeginPostVSBatch()
+{
+  RDCASSERT(!m_PostVSBatch.active);
+
+  m_PostVSBatch.active = true;
+  m_PostVSBatch.numDraws = 0;
+  m_PostVSBatch.timer.Restart();
+
+  // anything used from here until the end of the batch is safe from eviction
+  m_PostVSUseStamp++;
+}
+
+void VulkanDebugManager::EndPostVSBatch()
+{
+  if(!m_PostVSBatch.active)
+    return;
+
+  FlushPostVSBatch();
+
+  m_PostVSBatch.indexData.clear();
+  m_PostVSBatch.active = false;
+
+  EvictPostVSData();
+
+  if(m_PostVSBatch.numDraws > 1)
+  {
+    double ms = m_PostVSBatch.timer.GetMilliseconds();
+
+    double drawsPerSec = ms > 0.0 ? double(m_PostVSBatch.numDraws) * 1000.0 / ms : 0.0;
+
+    RDCLOG("Fetched post-transform data for %u draws in %.2f ms (%.0f draws/sec)",
+           m_PostVSBatch.numDraws, ms, drawsPerSec);
+  }
+}
+
+void VulkanDebugManager::FlushPostVSBatch()
+{
+  PostVSBatch &batch = m_PostVSBatch;
+
+  if(batch.draws.empty())
+    return;
+
+  // one submit and one wait for every draw recorded since the last flush
+  m_pDriver->SubmitCmds();
+  m_pDriver->FlushQ();
+
+  if(batch.readbackUsed > 0)
+  {
+    byte *data = (byte *)m_PostVSReadback.Map(NULL, batch.readbackUsed);
+
+    for(size_t i = 0; i < batch.draws.size(); i++)
+    {
+      const PostVSBatch::PendingDraw &draw = batch.draws[i];
+
+      if(!draw.hasPosOut)
+        continue;
+
+      VulkanPostVSData::StageData &vsout = m_PostVSData[draw.eventID].vsout;
+
+      DerivePostVSNearFar(data + draw.readbackOffset, draw.numVerts, draw.vertStride,
+                          vsout.nearPlane, vsout.farPlane);
+    }
+
+    m_PostVSReadback.Unmap();
+  }
+
+  VkDevice dev = m_Device;
+
+  for(size_t i = 0; i < batch.pipes.size(); i++)
+    m_pDriver->vkDestroyPipeline(dev, batch.pipes[i], NULL);
+  for(size_t i = 0; i < batch.pipeLayouts.size(); i++)
+    m_pDriver->vkDestroyPipelineLayout(dev, batch.pipeLayouts[i], NULL);
+  for(size_t i = 0; i < batch.modules.size(); i++)
+    m_pDriver->vkDestroyShaderModule(dev, batch.modules[i], NULL);
+  for(size_t i = 0; i < batch.bufs.size(); i++)
+    m_pDriver->vkDestroyBuffer(dev, batch.bufs[i], NULL);
+  for(size_t i = 0; i < batch.mems.size(); i++)
+    m_pDriver->vkFreeMemory(dev, batch.mems[i], NULL);
+
+  batch.draws.clear();
+  batch.pipes.clear();
+  batch.pipeLayouts.clear();
+  batch.modules.clear();
+  batch.bufs.clear();
+  batch.mems.clear();
+  batch.readbackUsed = 0;
+}
+
+void VulkanDebugManager::AllocPostVSData(uint32_t eventID, VkDeviceSize size, VkBuffer &buf,
+                                         VkDeviceSize &offset)
+{
+  VkDeviceSize align = m_pDriver->GetDeviceProps().limits.minStorageBufferOffsetAlignment;
+  align = RDCMAX(align, (VkDeviceSize)16);
+
+  size = AlignUp(RDCMAX(size, (VkDeviceSize)4), (VkDeviceSize)4);
+
+  PostVSBlock *block = NULL;
+
+  if(!m_PostVSBlocks.empty())
+  {
+    block = &m_PostVSBlocks.rbegin()->second;
+
+    if(AlignUp(block->used, align) + size > block->size)
+      block = NULL;
+  }
+
+  if(block == NULL)
+  {
+    block = &m_PostVSBlocks[m_PostVSNextBlock++];
+    block->size = RDCMAX(size, PostVSBlockSize);
+    block->used = 0;
+
+    VkBufferCreateInfo bufInfo = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, NULL, 0, block->size, 0,
+    };
+
+    bufInfo.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufInfo.usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufInfo.usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufInfo.usage |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+
+    VkResult vkr = m_pDriver->vkCreateBuffer(m_Device, &bufInfo, NULL, &block->buf);
+    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+
+    VkMemoryRequirements mrq = {0};
+    m_pDriver->vkGetBufferMemoryRequirements(m_Device, block->buf, &mrq);
+
+    VkMemoryAllocateInfo allocInfo = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, mrq.size,
+        m_pDriver->GetGPULocalMemoryIndex(mrq.memoryTypeBits),
+    };
+
+    vkr = m_pDriver->vkAllocateMemory(m_Device, &allocInfo, NULL, &block->mem);
+    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+
+    vkr = m_pDriver->vkBindBufferMemory(m_Device, block->buf, block->mem, 0);
+    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+  }
+
+  offset = AlignUp(block->used, align);
+  buf = block->buf;
+
+  block->used = offset + size;
+  block->lastUse = m_PostVSUseStamp;
+  block->events.push_back(eventID);
+}
+
+void VulkanDebugManager::TouchPostVSData(uint32_t eventID)
+{
+  auto it = m_PostVSData.find(eventID);
+
+  if(it == m_PostVSData.end() || it->second.vsout.buf == VK_NULL_HANDLE)
+    return;
+
+  for(auto b = m_PostVSBlocks.begin(); b != m_PostVSBlocks.end(); ++b)
+  {
+    if(b->second.buf == it->second.vsout.buf)
+    {
+      b->second.lastUse = m_PostVSUseStamp;
+      return;
+    }
+  }
+}
+
+void VulkanDebugManager::EvictPostVSData()
+{
+  VkDeviceSize total = 0;
+  for(auto it = m_PostVSBlocks.begin(); it != m_PostVSBlocks.end(); ++it)
+    total += it->second.size;
+
+  if(total <= PostVSMemoryCap)
+    return;
+
+  // pinned events are stored under the event they alias, if any
+  set<uint32_t> pinned;
+  for(size_t i = 0; i < m_PostVSPinned.size(); i++)
+  {
+    auto alias = m_PostVSAlias.find(m_PostVSPinned[i]);
+    pinned.insert(alias != m_PostVSAlias.end() ? alias->second : m_PostVSPinned[i]);
+  }
+
+  while(total > PostVSMemoryCap)
+  {
+    // find the least recently used block, never evicting anything used in the current batch or
+    // anything pinned
+    auto lru = m_PostVSBlocks.end();
+
+    for(auto it = m_PostVSBlocks.begin(); it != m_PostVSBlocks.end(); ++it)
+    {
+      if(it->second.lastUse == m_PostVSUseStamp)
+        continue;
+
+      bool isPinned = false;
+      for(size_t i = 0; !isPinned && i < it->second.events.size(); i++)
+        isPinned = pinned.find(it->second.events[i]) != pinned.end();
+
+      if(isPinned)
+        continue;
+
+      if(lru == m_PostVSBlocks.end() || it->second.lastUse < lru->second.lastUse)
+        lru = it;
+    }
+
+    if(lru == m_PostVSBlocks.end())
+      break;
+
+    PostVSBlock &block = lru->second;
+
+    for(size_t i = 0; i < block.events.size(); i++)
+    {
+      auto it = m_PostVSData.find(block.events[i]);
+
+      if(it == m_PostVSData.end())
+        continue;
+
+      m_pDriver->vkDestroyBuffer(m_Device, it->second.vsout.idxBuf, NULL);
+      m_pDriver->vkFreeMemory(m_Device, it->second.vsout.idxBufMem, NULL);
+
+      m_PostVSData.erase(it);
+    }
+
+    m_pDriver->vkDestroyBuffer(m_Device, block.buf, NULL);
+    m_pDriver->vkFreeMemory(m_Device, block.mem, NULL);
+
+    total -= block.size;
+
+    m_PostVSBlocks.erase(lru);
+  }
+}
+
 void VulkanDebugManager::InitPostVSBuffers(uint32_t eventID)
+{
+  // a fetch on its own is a batch of one
+  if(m_PostVSBatch.active)
+  {
+    FetchPostVSBuffers(eventID);
+    return;
+  }
+
+  BeginPostVSBatch();
+  FetchPostVSBuffers(eventID);
+  EndPostVSBatch();
+}
+
+void VulkanDebugManager::FetchPostVSBuffers(uint32_t eventID)
 {
   // go through any aliasing
   if(m_PostVSAlias.find(eventID) != m_PostVSAlias.end())
     eventID = m_PostVSAlias[eventID];
 
   if(m_PostVSData.find(eventID) != m_PostVSData.end())
+  {
+    TouchPostVSData(eventID);
     return;
+  }
 
   if(!m_pDriver->GetDeviceFeatures().vertexPipelineStoresAndAtomics)
     return;
@@ -6229,8 +6987,7 @@ void VulkanDebugManager::InitPostVSBuffers(uint32_t eventID)
       (VkPipelineRasterizationStateCreateInfo *)pipeCreateInfo.pRasterizationState;
   rs->rasterizerDiscardEnable = true;
 
-  VkBuffer meshBuffer = VK_NULL_HANDLE, readbackBuffer = VK_NULL_HANDLE;
-  VkDeviceMemory meshMem = VK_NULL_HANDLE, readbackMem = VK_NULL_HANDLE;
+  VkBuffer meshBuffer = VK_NULL_HANDLE;
 
   VkBuffer idxBuf = VK_NULL_HANDLE, uniqIdxBuf = VK_NULL_HANDLE;
   VkDeviceMemory idxBufMem = VK_NULL_HANDLE, uniqIdxBufMem = VK_NULL_HANDLE;
@@ -6252,9 +7009,29 @@ void VulkanDebugManager::InitPostVSBuffers(uint32_t eventID)
 
   if((drawcall->flags & eDraw_UseIBuffer) != 0)
   {
-    // fetch ibuffer
-    GetBufferData(state.ibuffer.buf, state.ibuffer.offs + drawcall->indexOffset * idxsize,
-                  drawcall->numIndices * idxsize, idxdata);
+    // fetch ibuffer. Index buffers that aren't too large are read back whole, once per batch, so
+    // the draws that share them don't each need their own readback
+    VkDeviceSize idxoffs = state.ibuffer.offs + drawcall->indexOffset * idxsize;
+    VkDeviceSize idxlen = drawcall->numIndices * idxsize;
+
+    if(creationInfo.m_Buffer[state.ibuffer.buf].size <= PostVSBlockSize)
+    {
+      map<ResourceId, vector<byte> > &cache = m_PostVSBatch.indexData;
+
+      if(cache.find(state.ibuffer.buf) == cache.end())
+        GetBufferData(state.ibuffer.buf, 0, 0, cache[state.ibuffer.buf]);
+
+      const vector<byte> &whole = cache[state.ibuffer.buf];
+
+      VkDeviceSize idxend = RDCMIN(idxoffs + idxlen, (VkDeviceSize)whole.size());
+
+      if(idxoffs < idxend)
+        idxdata.assign(whole.begin() + (size_t)idxoffs, whole.begin() + (size_t)idxend);
+    }
+    else
+    {
+      GetBufferData(state.ibuffer.buf, idxoffs, idxlen, idxdata);
+    }
 
     // figure out what the maximum index could be, so we can clamp our index buffer to something
     // sane
@@ -6395,6 +7172,32 @@ void VulkanDebugManager::InitPostVSBuffers(uint32_t eventID)
   AddOutputDumping(*refl, pipeInfo.shaders[0].entryPoint.c_str(), descSet, vertexIndexOffset,
                    drawcall->instanceOffset, numVerts, modSpirv, bufStride);
 
+  bool hasPosOut = refl->OutputSig[0].systemValue == eAttr_Position;
+
+  // only the first instance's positions are read back, for the near/far calculation
+  VkDeviceSize readbackSize = 0;
+  if(hasPosOut)
+    readbackSize = AlignUp(VkDeviceSize(numVerts) * bufStride, (VkDeviceSize)16);
+
+  // make room in the batch for this draw, if it's out of descriptor sets or readback space
+  if(m_PostVSBatch.draws.size() >= ARRAY_COUNT(m_MeshFetchDescSet) ||
+     m_PostVSBatch.readbackUsed + readbackSize > m_PostVSReadback.sz)
+    FlushPostVSBatch();
+
+  if(readbackSize > m_PostVSReadback.sz)
+  {
+    if(m_PostVSReadback.buf != VK_NULL_HANDLE)
+      m_PostVSReadback.Destroy();
+
+    m_PostVSReadback.Create(m_pDriver, dev, AlignUp(readbackSize, PostVSReadbackSize), 1,
+                            GPUBuffer::eGPUBufferReadback);
+  }
+
+  VkDescriptorSet fetchDescSet = m_MeshFetchDescSet[m_PostVSBatch.draws.size()];
+
+  VkDeviceSize readbackOffset = m_PostVSBatch.readbackUsed;
+  m_PostVSBatch.readbackUsed += readbackSize;
+
   // create vertex shader with modified code
   VkShaderModuleCreateInfo moduleCreateInfo = {
       VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, NULL,         0,
@@ -6435,67 +7238,43 @@ void VulkanDebugManager::InitPostVSBuffers(uint32_t eventID)
   // after any the application used. So there might be more bound, but we want to ensure to
   // bind to the slot we're using
   modifiedstate.graphics.descSets.resize(descSet + 1);
-  modifiedstate.graphics.descSets[descSet].descSet = GetResID(m_MeshFetchDescSet);
-
-  if((drawcall->flags & eDraw_UseIBuffer) == 0)
-  {
-    // create buffer of sufficient size (num indices * bufStride)
-    VkBufferCreateInfo bufInfo = {
-        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        NULL,
-        0,
-        drawcall->numIndices * RDCMAX(1U, drawcall->numInstances) * bufStride,
-        0,
-    };
-
-    bufSize = bufInfo.size;
-
-    bufInfo.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufInfo.usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    bufInfo.usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-    bufInfo.usage |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-
-    vkr = m_pDriver->vkCreateBuffer(dev, &bufInfo, NULL, &meshBuffer);
-    RDCASSERTEQUAL(vkr, VK_SUCCESS);
-
-    bufInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  modifiedstate.graphics.descSets[descSet].descSet = GetResID(fetchDescSet);
 
-    vkr = m_pDriver->vkCreateBuffer(dev, &bufInfo, NULL, &readbackBuffer);
-    RDCASSERTEQUAL(vkr, VK_SUCCESS);
-
-    VkMemoryRequirements mrq = {0};
-    m_pDriver->vkGetBufferMemoryRequirements(dev, meshBuffer, &mrq);
-
-    VkMemoryAllocateInfo allocInfo = {
-        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, mrq.size,
-        m_pDriver->GetGPULocalMemoryIndex(mrq.memoryTypeBits),
-    };
-
-    vkr = m_pDriver->vkAllocateMemory(dev, &allocInfo, NULL, &meshMem);
-    RDCASSERTEQUAL(vkr, VK_SUCCESS);
-
-    vkr = m_pDriver->vkBindBufferMemory(dev, meshBuffer, meshMem, 0);
-    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+  VkBufferMemoryBarrier readbackbarrier = {
+      VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+      NULL,
+      VK_ACCESS_TRANSFER_WRITE_BIT,
+      VK_ACCESS_HOST_READ_BIT,
+      VK_QUEUE_FAMILY_IGNORED,
+      VK_QUEUE_FAMILY_IGNORED,
+      Unwrap(m_PostVSReadback.buf),
+      readbackOffset,
+      readbackSize,
+  };
 
-    m_pDriver->vkGetBufferMemoryRequirements(dev, readbackBuffer, &mrq);
+  VkBufferCopy bufcopy = {
+      0, readbackOffset, readbackSize,
+  };
 
-    allocInfo.memoryTypeIndex = m_pDriver->GetReadbackMemoryIndex(mrq.memoryTypeBits);
+  if((drawcall->flags & eDraw_UseIBuffer) == 0)
+  {
+    // allocate space of sufficient size (num indices * bufStride)
+    bufSize = drawcall->numIndices * RDCMAX(1U, drawcall->numInstances) * bufStride;
 
-    vkr = m_pDriver->vkAllocateMemory(dev, &allocInfo, NULL, &readbackMem);
-    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+    VkDeviceSize meshOffset = 0;
+    AllocPostVSData(eventID, bufSize, meshBuffer, meshOffset);
 
-    vkr = m_pDriver->vkBindBufferMemory(dev, readbackBuffer, readbackMem, 0);
-    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+    bufcopy.srcOffset = meshOffset;
 
     // vkUpdateDescriptorSet desc set to point to buffer
     VkDescriptorBufferInfo fetchdesc = {0};
     fetchdesc.buffer = meshBuffer;
-    fetchdesc.offset = 0;
-    fetchdesc.range = bufInfo.size;
+    fetchdesc.offset = meshOffset;
+    fetchdesc.range = bufSize;
 
     VkWriteDescriptorSet write = {
-        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, m_MeshFetchDescSet, 0,   0, 1,
-        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,      NULL, &fetchdesc,         NULL};
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, fetchDescSet, 0,   0, 1,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,      NULL, &fetchdesc,   NULL};
     m_pDriver->vkUpdateDescriptorSets(dev, 1, &write, 0, NULL);
 
     VkCommandBuffer cmd = m_pDriver->GetNextCmd();
@@ -6520,85 +7299,41 @@ void VulkanDebugManager::InitPostVSBuffers(uint32_t eventID)
         VK_QUEUE_FAMILY_IGNORED,
         VK_QUEUE_FAMILY_IGNORED,
         Unwrap(meshBuffer),
-        0,
-        bufInfo.size,
+        meshOffset,
+        bufSize,
     };
 
     // wait for writing to finish
     DoPipelineBarrier(cmd, 1, &meshbufbarrier);
 
-    VkBufferCopy bufcopy = {
-        0, 0, bufInfo.size,
-    };
-
-    // copy to readback buffer
-    ObjDisp(dev)->CmdCopyBuffer(Unwrap(cmd), Unwrap(meshBuffer), Unwrap(readbackBuffer), 1, &bufcopy);
-
-    meshbufbarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    meshbufbarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
-    meshbufbarrier.buffer = Unwrap(readbackBuffer);
+    if(readbackSize > 0)
+    {
+      // copy to readback buffer
+      ObjDisp(dev)->CmdCopyBuffer(Unwrap(cmd), Unwrap(meshBuffer), Unwrap(m_PostVSReadback.buf),
+                                  1, &bufcopy);
 
-    // wait for copy to finish
-    DoPipelineBarrier(cmd, 1, &meshbufbarrier);
+      // wait for copy to finish
+      DoPipelineBarrier(cmd, 1, &readbackbarrier);
+    }
 
     vkr = ObjDisp(dev)->EndCommandBuffer(Unwrap(cmd));
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
-    // submit & flush so that we don't have to keep pipeline around for a while
-    m_pDriver->SubmitCmds();
-    m_pDriver->FlushQ();
+    // no submit here, the command buffer goes out with the rest of the batch
   }
   else
   {
-    // create buffer of sufficient size
+    // allocate space of sufficient size
     // this can't just be bufStride * num unique indices per instance, as we don't
     // have a compact 0-based index to index into the buffer. We must use
     // index-minIndex which is 0-based but potentially sparse, so this buffer may
     // be more or less wasteful
-    VkBufferCreateInfo bufInfo = {
-        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        NULL,
-        0,
-        numVerts * RDCMAX(1U, drawcall->numInstances) * bufStride,
-        0,
-    };
-
-    bufInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufInfo.usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    bufInfo.usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-    bufInfo.usage |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-
-    vkr = m_pDriver->vkCreateBuffer(dev, &bufInfo, NULL, &meshBuffer);
-    RDCASSERTEQUAL(vkr, VK_SUCCESS);
-
-    bufInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-
-    vkr = m_pDriver->vkCreateBuffer(dev, &bufInfo, NULL, &readbackBuffer);
-    RDCASSERTEQUAL(vkr, VK_SUCCESS);
-
-    VkMemoryRequirements mrq = {0};
-    m_pDriver->vkGetBufferMemoryRequirements(dev, meshBuffer, &mrq);
-
-    VkMemoryAllocateInfo allocInfo = {
-        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, mrq.size,
-        m_pDriver->GetGPULocalMemoryIndex(mrq.memoryTypeBits),
-    };
-
-    vkr = m_pDriver->vkAllocateMemory(dev, &allocInfo, NULL, &meshMem);
-    RDCASSERTEQUAL(vkr, VK_SUCCESS);
-
-    vkr = m_pDriver->vkBindBufferMemory(dev, meshBuffer, meshMem, 0);
-    RDCASSERTEQUAL(vkr, VK_SUCCESS);
-
-    m_pDriver->vkGetBufferMemoryRequirements(dev, readbackBuffer, &mrq);
-
-    allocInfo.memoryTypeIndex = m_pDriver->GetReadbackMemoryIndex(mrq.memoryTypeBits);
+    bufSize = numVerts * RDCMAX(1U, drawcall->numInstances) * bufStride;
 
-    vkr = m_pDriver->vkAllocateMemory(dev, &allocInfo, NULL, &readbackMem);
-    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+    VkDeviceSize meshOffset = 0;
+    AllocPostVSData(eventID, bufSize, meshBuffer, meshOffset);
 
-    vkr = m_pDriver->vkBindBufferMemory(dev, readbackBuffer, readbackMem, 0);
-    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+    bufcopy.srcOffset = meshOffset;
 
     VkBufferMemoryBarrier meshbufbarrier = {
         VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
@@ -6624,16 +7359,15 @@ void VulkanDebugManager::InitPostVSBuffers(uint32_t eventID)
     DoPipelineBarrier(cmd, 1, &meshbufbarrier);
 
     // fill destination buffer with 0s to ensure unwritten vertices have sane data
-    ObjDisp(dev)->CmdFillBuffer(Unwrap(cmd), Unwrap(meshBuffer), 0, bufInfo.size, 0);
+    ObjDisp(dev)->CmdFillBuffer(Unwrap(cmd), Unwrap(meshBuffer), meshOffset,
+                                AlignUp(bufSize, (VkDeviceSize)4), 0);
 
     // wait to finish
     meshbufbarrier.buffer = Unwrap(meshBuffer);
-    meshbufbarrier.size = bufInfo.size;
+    meshbufbarrier.offset = meshOffset;
+    meshbufbarrier.size = bufSize;
     DoPipelineBarrier(cmd, 1, &meshbufbarrier);
 
-    // set bufSize
-    bufSize = numVerts * RDCMAX(1U, drawcall->numInstances) * bufStride;
-
     // bind unique'd ibuffer
     modifiedstate.ibuffer.bytewidth = 4;
     modifiedstate.ibuffer.offs = 0;
@@ -6642,12 +7376,12 @@ void VulkanDebugManager::InitPostVSBuffers(uint32_t eventID)
     // vkUpdateDescriptorSet desc set to point to buffer
     VkDescriptorBufferInfo fetchdesc = {0};
     fetchdesc.buffer = meshBuffer;
-    fetchdesc.offset = 0;
-    fetchdesc.range = bufInfo.size;
+    fetchdesc.offset = meshOffset;
+    fetchdesc.range = bufSize;
 
     VkWriteDescriptorSet write = {
-        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, m_MeshFetchDescSet, 0,   0, 1,
-        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,      NULL, &fetchdesc,         NULL};
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, fetchDescSet, 0,   0, 1,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,      NULL, &fetchdesc,   NULL};
     m_pDriver->vkUpdateDescriptorSets(dev, 1, &write, 0, NULL);
 
     // do single draw
@@ -6687,6 +7421,7 @@ void VulkanDebugManager::InitPostVSBuffers(uint32_t eventID)
     m_pDriver->vkUnmapMemory(m_Device, idxBufMem);
 
     meshbufbarrier.buffer = Unwrap(idxBuf);
+    meshbufbarrier.offset = 0;
     meshbufbarrier.size = numIndices * idxsize;
 
     // wait for upload to finish
@@ -6694,126 +7429,54 @@ void VulkanDebugManager::InitPostVSBuffers(uint32_t eventID)
 
     // wait for mesh output writing to finish
     meshbufbarrier.buffer = Unwrap(meshBuffer);
+    meshbufbarrier.offset = meshOffset;
     meshbufbarrier.size = bufSize;
     meshbufbarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
     meshbufbarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
     DoPipelineBarrier(cmd, 1, &meshbufbarrier);
 
-    VkBufferCopy bufcopy = {
-        0, 0, bufInfo.size,
-    };
-
-    // copy to readback buffer
-    ObjDisp(dev)->CmdCopyBuffer(Unwrap(cmd), Unwrap(meshBuffer), Unwrap(readbackBuffer), 1, &bufcopy);
-
-    meshbufbarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    meshbufbarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
-    meshbufbarrier.buffer = Unwrap(readbackBuffer);
+    if(readbackSize > 0)
+    {
+      // copy to readback buffer
+      ObjDisp(dev)->CmdCopyBuffer(Unwrap(cmd), Unwrap(meshBuffer), Unwrap(m_PostVSReadback.buf),
+                                  1, &bufcopy);
 
-    // wait for copy to finish
-    DoPipelineBarrier(cmd, 1, &meshbufbarrier);
+      // wait for copy to finish
+      DoPipelineBarrier(cmd, 1, &readbackbarrier);
+    }
 
     vkr = ObjDisp(dev)->EndCommandBuffer(Unwrap(cmd));
     RDCASSERTEQUAL(vkr, VK_SUCCESS);
 
-    // submit & flush so that we don't have to keep pipeline around for a while
-    m_pDriver->SubmitCmds();
-    m_pDriver->FlushQ();
-  }
-
-  // readback mesh data
-  byte *byteData = NULL;
-  vkr = m_pDriver->vkMapMemory(m_Device, readbackMem, 0, VK_WHOLE_SIZE, 0, (void **)&byteData);
-
-  // do near/far calculations
-
-  float nearp = 0.1f;
-  float farp = 100.0f;
-
-  Vec4f *pos0 = (Vec4f *)byteData;
-
-  bool found = false;
-
-  // expect position at the start of the buffer, as system values are sorted first
-  // and position is the first value
-
-  for(uint32_t i = 1; refl->OutputSig[0].systemValue == eAttr_Position && i < numVerts; i++)
-  {
-    //////////////////////////////////////////////////////////////////////////////////
-    // derive near/far, assuming a standard perspective matrix
-    //
-    // the transformation from from pre-projection {Z,W} to post-projection {Z,W}
-    // is linear. So we can say Zpost = Zpre*m + c . Here we assume Wpre = 1
-    // and we know Wpost = Zpre from the perspective matrix.
-    // we can then see from the perspective matrix that
-    // m = F/(F-N)
-    // c = -(F*N)/(F-N)
-    //
-    // with re-arranging and substitution, we then get:
-    // N = -c/m
-    // F = c/(1-m)
-    //
-    // so if we can derive m and c then we can determine N and F. We can do this with
-    // two points, and we pick them reasonably distinct on z to reduce floating-point
-    // error
-
-    Vec4f *pos = (Vec4f *)(byteData + i * bufStride);
-
-    // skip invalid vertices (w=0)
-    if(pos->w != 0.0f && fabs(pos->w - pos0->w) > 0.01f && fabs(pos->z - pos0->z) > 0.01f)
-    {
-      Vec2f A(pos0->w, pos0->z);
-      Vec2f B(pos->w, pos->z);
-
-      float m = (B.y - A.y) / (B.x - A.x);
-      float c = B.y - B.x * m;
-
-      if(m == 1.0f)
-        continue;
-
-      if(-c / m <= 0.000001f)
-        continue;
-
-      nearp = -c / m;
-      farp = c / (1 - m);
-
-      found = true;
-
-      break;
-    }
+    // no submit here, the command buffer goes out with the rest of the batch
   }
 
-  // if we didn't find anything, all z's and w's were identical.
-  // If the z is positive and w greater for the first element then
-  // we detect this projection as reversed z with infinite far plane
-  if(!found && pos0->z > 0.0f && pos0->w > pos0->z)
-  {
-    nearp = pos0->z;
-    farp = FLT_MAX;
-  }
+  // the near/far planes are filled in when the batch is flushed and the positions are read back
+  PostVSBatch::PendingDraw pending = {eventID, hasPosOut, readbackOffset, numVerts, bufStride};
+  m_PostVSBatch.draws.push_back(pending);
+  m_PostVSBatch.numDraws++;
 
-  m_pDriver->vkUnmapMemory(m_Device, readbackMem);
-
-  // clean up temporary memories
-  m_pDriver->vkDestroyBuffer(m_Device, readbackBuffer, NULL);
-  m_pDriver->vkFreeMemory(m_Device, readbackMem, NULL);
+  // everything the recorded commands use has to stay alive until the batch is flushed
+  m_PostVSBatch.pipes.push_back(pipe);
+  m_PostVSBatch.pipeLayouts.push_back(pipeLayout);
+  m_PostVSBatch.modules.push_back(module);
 
   if(uniqIdxBuf != VK_NULL_HANDLE)
   {
-    m_pDriver->vkDestroyBuffer(m_Device, uniqIdxBuf, NULL);
-    m_pDriver->vkFreeMemory(m_Device, uniqIdxBufMem, NULL);
+    m_PostVSBatch.bufs.push_back(uniqIdxBuf);
+    m_PostVSBatch.mems.push_back(uniqIdxBufMem);
   }
 
   // fill out m_PostVSData
   m_PostVSData[eventID].vsin.topo = topo;
   m_PostVSData[eventID].vsout.topo = topo;
   m_PostVSData[eventID].vsout.buf = meshBuffer;
-  m_PostVSData[eventID].vsout.bufmem = meshMem;
+  m_PostVSData[eventID].vsout.bufOffset = bufcopy.srcOffset;
 
   m_PostVSData[eventID].vsout.vertStride = bufStride;
-  m_PostVSData[eventID].vsout.nearPlane = nearp;
-  m_PostVSData[eventID].vsout.farPlane = farp;
+  m_PostVSData[eventID].vsout.nearPlane = 0.1f;
+  m_PostVSData[eventID].vsout.farPlane = 100.0f;
 
   m_PostVSData[eventID].vsout.useIndices = (drawcall->flags & eDraw_UseIBuffer) > 0;
   m_PostVSData[eventID].vsout.numVerts = drawcall->numIndices;
@@ -6831,16 +7494,7 @@ void VulkanDebugManager::InitPostVSBuffers(uint32_t eventID)
         state.ibuffer.bytewidth == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
   }
 
-  m_PostVSData[eventID].vsout.hasPosOut = refl->OutputSig[0].systemValue == eAttr_Position;
-
-  // delete pipeline layout
-  m_pDriver->vkDestroyPipelineLayout(dev, pipeLayout, NULL);
-
-  // delete pipeline
-  m_pDriver->vkDestroyPipeline(dev, pipe, NULL);
-
-  // delete shader/shader module
-  m_pDriver->vkDestroyShaderModule(dev, module, NULL);
+  m_PostVSData[eventID].vsout.hasPosOut = hasPosOut;
 }
 
 MeshFormat VulkanDebugManager::GetPostVSBuffers(uint32_t eventID, uint32_t instID, MeshDataStage stage)
@@ -6853,7 +7507,10 @@ MeshFormat VulkanDebugManager::GetPostVSBuffers(uint32_t eventID, uint32_t instI
   RDCEraseEl(postvs);
 
   if(m_PostVSData.find(eventID) != m_PostVSData.end())
+  {
     postvs = m_PostVSData[eventID];
+    TouchPostVSData(eventID);
+  }
 
   VulkanPostVSData::StageData s = postvs.GetStage(stage);
 
@@ -6877,7 +7534,7 @@ MeshFormat VulkanDebugManager::GetPostVSBuffers(uint32_t eventID, uint32_t instI
   else
     ret.buf = ResourceId();
 
-  ret.offset = s.instStride * instID;
+  ret.offset = s.bufOffset + s.instStride * instID;
   ret.stride = s.vertStride;
 
   ret.compCount = 4;
@@ -26,6 +26,7 @@
 
 #include "api/replay/renderdoc_replay.h"
 #include "core/core.h"
+#include "replay/mesh_pick.h"
 #include "replay/replay_driver.h"
 #include "vk_common.h"
 #include "vk_core.h"
@@ -58,8 +59,9 @@ struct VulkanPostVSData
 {
   struct StageData
   {
+    // buf is one of the shared post-transform blocks, and the data starts at bufOffset
     VkBuffer buf;
-    VkDeviceMemory bufmem;
+    VkDeviceSize bufOffset;
     VkPrimitiveTopology topo;
 
     uint32_t numVerts;
@@ -99,6 +101,10 @@ struct VulkanPostVSData
 
 class VulkanResourceManager;
 
+template <typename ResultType, typename ShaderCallbacks>
+class ShaderCache;
+struct VulkanBlobShaderCallbacks;
+
 class VulkanDebugManager
 {
 public:
@@ -114,11 +120,42 @@ public:
 
   void InitPostVSBuffers(uint32_t eventID);
 
+  // fetches between a begin/end pair are recorded but not submitted. Everything is submitted and
+  // read back together at the end of the batch, or earlier if the batch runs out of room.
+  void BeginPostVSBatch();
+  void EndPostVSBatch();
+
   // indicates that EID alias is the same as eventID
   void AliasPostVSBuffers(uint32_t eventID, uint32_t alias) { m_PostVSAlias[alias] = eventID; }
+  void PinPostVSBuffers(const vector<uint32_t> &events) { m_PostVSPinned = events; }
   MeshFormat GetPostVSBuffers(uint32_t eventID, uint32_t instID, MeshDataStage stage);
   void GetBufferData(ResourceId buff, uint64_t offset, uint64_t len, vector<byte> &ret);
 
+  // reads back a range of an (unwrapped) buffer that's ready to be read by transfers. Any pending
+  // internal command buffers are submitted first, and the queue is idle on return.
+  void ReadbackBuffer(VkBuffer srcBuf, VkDeviceSize offset, VkDeviceSize len, byte *dest);
+
+  struct ReadbackRange
+  {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    byte *dest;
+  };
+
+  class ReadbackListener
+  {
+  public:
+    virtual ~ReadbackListener() {}
+    // called, in order, as soon as all of a range has been copied to its destination
+    virtual void RangeArrived(size_t rangeIdx) = 0;
+  };
+
+  // as ReadbackBuffer, for several ranges in increasing order that don't overlap. Everything from
+  // the start of the first to the end of the last streams through the readback windows once, and
+  // the listener (if any) can use each range while the rest is still in flight.
+  void ReadbackBufferRanges(VkBuffer srcBuf, const vector<ReadbackRange> &ranges,
+                            ReadbackListener *listener);
+
   FloatVector InterpretVertex(byte *data, uint32_t vert, const MeshDisplay &cfg, byte *end,
                               bool &valid);
 
@@ -280,6 +317,11 @@ public:
   VkPipeline m_MinMaxTilePipe[eTexType_Max][3];    // float, uint, sint
   VkPipeline m_MinMaxResultPipe[3];                // float, uint, sint
 
+  // the min/max and histogram pipelines aren't needed until the first GetMinMax/GetHistogram, so
+  // the driver compiles them on worker threads after startup. This must be called before using
+  // any of the pipelines above.
+  void FinishComputePipelines();
+
   static const int maxMeshPicks = 500;
 
   GPUBuffer m_MeshPickUBO;
@@ -292,16 +334,46 @@ public:
   VkPipelineLayout m_MeshPickLayout;
   VkPipeline m_MeshPickPipeline;
 
+  // CPU-side index over the positions of the last picked mesh, built on its first pick
+  MeshPickIndex m_MeshPickIndex;
+
   VkDescriptorSetLayout m_OutlineDescSetLayout;
   VkPipelineLayout m_OutlinePipeLayout;
   VkDescriptorSet m_OutlineDescSet;
   VkPipeline m_OutlinePipeline[8];
   GPUBuffer m_OutlineUBO;
 
-  GPUBuffer m_ReadbackWindow;
+  // readbacks stream through this ring of persistently mapped windows. Each window has its own
+  // fence, so the GPU can copy into the next window while the CPU copies out of the previous.
+  static const uint32_t NumReadbackWindows = 2;
+
+  struct ReadbackWindow
+  {
+    GPUBuffer buf;
+    VkFence fence;
+    byte *data;
+
+    // the part of the source buffer the window holds once the fence is signalled. size is 0 if
+    // it's idle
+    VkDeviceSize srcOffset;
+    VkDeviceSize size;
+  };
+
+  ReadbackWindow m_ReadbackWindows[NumReadbackWindows];
+
+  // the ranges a readback is copying out to. Windows finish in order, so every range before
+  // nextRange is complete
+  struct ReadbackStream
+  {
+    const vector<ReadbackRange> *ranges;
+    size_t nextRange;
+    ReadbackListener *listener;
+  };
+
+  void FinishReadbackWindow(ReadbackWindow &window, ReadbackStream &stream);
 
   VkDescriptorSetLayout m_MeshFetchDescSetLayout;
-  VkDescriptorSet m_MeshFetchDescSet;
+  VkDescriptorSet m_MeshFetchDescSet[32];    // one per draw in a post-transform batch
 
   MeshDisplayPipelines CacheMeshDisplayPipelines(const MeshFormat &primary,
                                                  const MeshFormat &secondary);
@@ -313,10 +385,39 @@ private:
 
   VulkanResourceManager *GetResourceManager() { return m_ResourceManager; }
   static const uint32_t m_ShaderCacheMagic = 0xf00d00d5;
-  static const uint32_t m_ShaderCacheVersion = 1;
+  static const uint32_t m_ShaderCacheVersion = 2;
+
+  bool m_CacheShaders;
+  ShaderCache<vector<uint32_t> *, VulkanBlobShaderCallbacks> *m_ShaderCache;
 
-  bool m_ShaderCacheDirty, m_CacheShaders;
-  map<uint32_t, vector<uint32_t> *> m_ShaderCache;
+  // all of our replay pipelines are created against this cache, which is saved to disk on
+  // shutdown. The file is only used if it came from the same driver and device.
+  static const uint32_t m_PipelineCacheMagic = 0xf00dcace;
+  static const uint32_t m_PipelineCacheVersion = 1;
+
+  VkPipelineCache m_PipelineCache;
+  size_t m_PipelineCacheLoadedSize;
+
+  void CreatePipelineCache();
+  void SavePipelineCache();
+
+  // a set of compute pipelines being created on a worker thread, straight against the driver.
+  // The results are wrapped on the main thread in FinishComputePipelines
+  struct ComputePipelineJob
+  {
+    VkDevice dev;
+    VkPipelineCache cache;
+    vector<VkComputePipelineCreateInfo> infos;
+    vector<VkPipeline> pipes;
+    vector<VkPipeline *> dests;
+    VkResult result;
+    Threading::ThreadHandle thread;
+  };
+
+  static void CreateComputePipelinesThread(void *job);
+
+  vector<ComputePipelineJob *> m_ComputePipelineJobs;
+  vector<VkShaderModule> m_ComputePipelineModules;
 
   string GetSPIRVBlob(SPIRVShaderStage shadType, const std::vector<std::string> &sources,
                       vector<uint32_t> **outBlob);
@@ -324,6 +425,10 @@ private:
   void PatchFixedColShader(VkShaderModule &mod, float col[4]);
 
   void RenderTextInternal(const TextPrintState &textstate, float x, float y, const char *text);
+
+  uint32_t PickVertexGPU(const MeshDisplay &cfg, const Matrix4f &PickMVP, uint32_t x, uint32_t y,
+                         uint32_t w, uint32_t h, const vector<FloatVector> &positions,
+                         const vector<uint32_t> &indices);
   static const uint32_t FONT_TEX_WIDTH = 256;
   static const uint32_t FONT_TEX_HEIGHT = 128;
 
@@ -339,6 +444,71 @@ private:
   map<uint32_t, VulkanPostVSData> m_PostVSData;
   map<uint32_t, uint32_t> m_PostVSAlias;
 
+  // blocks holding any of these events' data are never evicted
+  vector<uint32_t> m_PostVSPinned;
+
+  void FetchPostVSBuffers(uint32_t eventID);
+  void FlushPostVSBatch();
+  void AllocPostVSData(uint32_t eventID, VkDeviceSize size, VkBuffer &buf, VkDeviceSize &offset);
+  void TouchPostVSData(uint32_t eventID);
+  void EvictPostVSData();
+
+  // post-transform data is suballocated from these shared GPU-local blocks. Once the blocks add up
+  // to more than PostVSMemoryCap, whole blocks are evicted least-recently-used first along with the
+  // events stored in them, which are then re-fetched if they're needed again. Blocks used in the
+  // current batch or holding a pinned event are kept, even if that leaves the blocks over the cap.
+  static const VkDeviceSize PostVSBlockSize = 16 * 1024 * 1024;
+  static const VkDeviceSize PostVSMemoryCap = 256 * 1024 * 1024;
+
+  struct PostVSBlock
+  {
+    VkBuffer buf;
+    VkDeviceMemory mem;
+    VkDeviceSize size;
+    VkDeviceSize used;
+    uint64_t lastUse;
+    vector<uint32_t> events;
+  };
+
+  // keyed by creation order, so the last block is the one being filled
+  map<uint32_t, PostVSBlock> m_PostVSBlocks;
+  uint32_t m_PostVSNextBlock;
+  uint64_t m_PostVSUseStamp;
+
+  // positions are copied here for the near/far calculation. It grows if a single draw needs more
+  static const VkDeviceSize PostVSReadbackSize = 8 * 1024 * 1024;
+  GPUBuffer m_PostVSReadback;
+
+  struct PostVSBatch
+  {
+    bool active;
+    uint32_t numDraws;
+    PerformanceTimer timer;
+
+    // draws recorded but not yet submitted, each one uses the m_MeshFetchDescSet at its index
+    struct PendingDraw
+    {
+      uint32_t eventID;
+      bool hasPosOut;
+      VkDeviceSize readbackOffset;
+      uint32_t numVerts;
+      uint32_t vertStride;
+    };
+
+    vector<PendingDraw> draws;
+    VkDeviceSize readbackUsed;
+
+    // objects the pending draws use, destroyed once they've executed
+    vector<VkPipeline> pipes;
+    vector<VkPipelineLayout> pipeLayouts;
+    vector<VkShaderModule> modules;
+    vector<VkBuffer> bufs;
+    vector<VkDeviceMemory> mems;
+
+    // index buffer contents read back so far in this batch, so each buffer is only read once
+    map<ResourceId, vector<byte> > indexData;
+  } m_PostVSBatch;
+
   WrappedVulkan *m_pDriver;
   VulkanResourceManager *m_ResourceManager;
 
@@ -409,6 +409,12 @@ void VulkanCreationInfo::RenderPass::Init(VulkanResourceManager *resourceMan,
     a.storeOp = pCreateInfo->pAttachments[i].storeOp;
     a.stencilLoadOp = pCreateInfo->pAttachments[i].stencilLoadOp;
     a.stencilStoreOp = pCreateInfo->pAttachments[i].stencilStoreOp;
+    a.initialLayout = pCreateInfo->pAttachments[i].initialLayout;
+    a.finalLayout = pCreateInfo->pAttachments[i].finalLayout;
+
+    // renderpass can't start or end in presentable layout on replay
+    ReplacePresentableImageLayout(a.initialLayout);
+    ReplacePresentableImageLayout(a.finalLayout);
     attachments.push_back(a);
   }
 
@@ -203,6 +203,8 @@ struct VulkanCreationInfo
       VkAttachmentStoreOp storeOp;
       VkAttachmentLoadOp stencilLoadOp;
       VkAttachmentStoreOp stencilStoreOp;
+      VkImageLayout initialLayout;
+      VkImageLayout finalLayout;
     };
     vector<Attachment> attachments;
 
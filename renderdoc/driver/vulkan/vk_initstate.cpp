@@ -1279,6 +1279,56 @@ bool WrappedVulkan::Prepare_InitialState(WrappedVkRes *res)
   return false;
 }
 
+void WrappedVulkan::Serialise_InitialMemoryData(
+    Serialiser *localSerialiser, const VulkanResourceManager::InitialContentData &contents)
+{
+  VkDevice d = GetDev();
+
+  byte *ptr = NULL;
+  ObjDisp(d)->MapMemory(Unwrap(d), ToHandle<VkDeviceMemory>(contents.resource), 0, VK_WHOLE_SIZE,
+                        0, (void **)&ptr);
+
+  uint32_t dataSize = contents.num;
+  size_t bufSize = (size_t)dataSize;
+
+  localSerialiser->Serialise("dataSize", dataSize);
+  localSerialiser->SerialiseBuffer("data", ptr, bufSize);
+
+  ObjDisp(d)->UnmapMemory(Unwrap(d), ToHandle<VkDeviceMemory>(contents.resource));
+}
+
+bool WrappedVulkan::AllowParallel_InitialState(ResourceId id, WrappedVkRes *res)
+{
+  // only non-sparse images and memory, which are just a copy out of their readback memory. The
+  // readbacks were all completed when the frame ended, and each has its own memory to map.
+  if(res == NULL)
+    return false;
+
+  VkResourceType type = IdentifyTypeByPtr(res);
+
+  if(type != eResDeviceMemory && type != eResImage)
+    return false;
+
+  VulkanResourceManager::InitialContentData contents = GetResourceManager()->GetInitialContents(id);
+
+  return contents.blob == NULL && contents.resource != NULL;
+}
+
+void WrappedVulkan::Serialise_InitialStateParallel(
+    Serialiser *localSerialiser, ResourceId id, WrappedVkRes *res,
+    const VulkanResourceManager::InitialContentData &contents)
+{
+  // must match what Serialise_InitialState writes for the same resource
+  VkResourceType type = IdentifyTypeByPtr(res);
+  bool isSparse = false;
+
+  localSerialiser->Serialise("type", type);
+  localSerialiser->Serialise("id", id);
+  localSerialiser->Serialise("isSparse", isSparse);
+
+  Serialise_InitialMemoryData(localSerialiser, contents);
+}
+
 // second parameter isn't used, as we might be serialising init state for a deleted resource
 bool WrappedVulkan::Serialise_InitialState(ResourceId resid, WrappedVkRes *)
 {
@@ -1319,8 +1369,6 @@ bool WrappedVulkan::Serialise_InitialState(ResourceId resid, WrappedVkRes *)
     else if(type == eResDeviceMemory || type == eResImage)
     {
       // both image and memory are serialised as a whole hunk of data
-      VkDevice d = GetDev();
-
       bool isSparse = (initContents.blob != NULL);
       m_pSerialiser->Serialise("isSparse", isSparse);
 
@@ -1331,16 +1379,7 @@ bool WrappedVulkan::Serialise_InitialState(ResourceId resid, WrappedVkRes *)
         return Serialise_SparseImageInitialState(id, initContents);
       }
 
-      byte *ptr = NULL;
-      ObjDisp(d)->MapMemory(Unwrap(d), ToHandle<VkDeviceMemory>(initContents.resource), 0,
-                            VK_WHOLE_SIZE, 0, (void **)&ptr);
-
-      size_t dataSize = (size_t)initContents.num;
-
-      m_pSerialiser->Serialise("dataSize", initContents.num);
-      m_pSerialiser->SerialiseBuffer("data", ptr, dataSize);
-
-      ObjDisp(d)->UnmapMemory(Unwrap(d), ToHandle<VkDeviceMemory>(initContents.resource));
+      Serialise_InitialMemoryData(m_pSerialiser, initContents);
     }
     else
     {
@@ -49,153 +49,374 @@ bool VulkanResourceManager::SerialisableResource(ResourceId id, VkResourceRecord
 #define TRDBG(...)
 #endif
 
-template <typename SrcBarrierType>
-void VulkanResourceManager::RecordSingleBarrier(vector<pair<ResourceId, ImageRegionState> > &dststates,
-                                                ResourceId id, const SrcBarrierType &t,
-                                                uint32_t nummips, uint32_t numslices)
+// Image subresource states are tracked as layer/mip intervals. The states for one image are a
+// run of entries grouped into layer bands: every entry in a band covers the same array layers,
+// bands are disjoint and sorted by baseArrayLayer, and within a band the entries cover disjoint
+// mip ranges sorted by baseMipLevel. The ImageLayouts for an image and the run of one ResourceId
+// in a command buffer's barrier list both keep this layout, so finding the entries a barrier
+// overlaps is a pair of binary searches and a barrier only ever splits entries at its own edges,
+// instead of splitting the whole image into one entry per subresource. Neighbouring entries that
+// end up with identical layouts are merged back together so the lists stay short.
+
+static ImageRegionState &RegionState(ImageRegionState &s)
+{
+  return s;
+}
+
+static ImageRegionState &RegionState(pair<ResourceId, ImageRegionState> &s)
+{
+  return s.second;
+}
+
+static uint32_t LayerBegin(const ImageRegionState &s)
+{
+  return s.subresourceRange.baseArrayLayer;
+}
+
+static uint32_t LayerEnd(const ImageRegionState &s)
+{
+  return s.subresourceRange.baseArrayLayer + s.subresourceRange.layerCount;
+}
+
+static uint32_t MipBegin(const ImageRegionState &s)
+{
+  return s.subresourceRange.baseMipLevel;
+}
+
+static uint32_t MipEnd(const ImageRegionState &s)
+{
+  return s.subresourceRange.baseMipLevel + s.subresourceRange.levelCount;
+}
+
+static bool SameLayouts(const ImageRegionState &a, const ImageRegionState &b)
+{
+  return a.oldLayout == b.oldLayout && a.newLayout == b.newLayout;
+}
+
+template <typename StateType>
+struct SubresourceIntervals
 {
-  bool done = false;
+  // [first, last) is the run of entries for one image in states
+  SubresourceIntervals(vector<StateType> &s, size_t f, size_t l) : states(s), first(f), last(l) {}
+  vector<StateType> &states;
+  size_t first, last;
+
+  ImageRegionState &At(size_t i) { return RegionState(states[i]); }
+
+  // the first entry in [begin, end) whose layers end after layer. Since bands are disjoint this
+  // is always the start of a band
+  size_t FindLayer(size_t begin, size_t end, uint32_t layer)
+  {
+    while(begin < end)
+    {
+      size_t mid = begin + (end - begin) / 2;
+      if(LayerEnd(At(mid)) <= layer)
+        begin = mid + 1;
+      else
+        end = mid;
+    }
+    return begin;
+  }
 
-  auto it = dststates.begin();
-  for(; it != dststates.end(); ++it)
+  // the first entry in the band [begin, end) whose mips end after mip
+  size_t FindMip(size_t begin, size_t end, uint32_t mip)
   {
-    // image barriers are handled by initially inserting one subresource range for each aspect,
-    // and whenever we need more fine-grained detail we split it immediately for one range for
-    // each subresource in that aspect. Thereafter if a barrier comes in that covers multiple
-    // subresources, we update all matching ranges.
+    while(begin < end)
+    {
+      size_t mid = begin + (end - begin) / 2;
+      if(MipEnd(At(mid)) <= mip)
+        begin = mid + 1;
+      else
+        end = mid;
+    }
+    return begin;
+  }
 
-    // find the states matching this id
-    if(it->first < id)
-      continue;
-    if(it->first != id)
-      break;
+  size_t BandEnd(size_t band)
+  {
+    uint32_t layer = LayerBegin(At(band));
+    size_t end = band + 1;
+    while(end < last && LayerBegin(At(end)) == layer)
+      end++;
+    return end;
+  }
 
+  void Insert(size_t idx, const StateType &s)
+  {
+    states.insert(states.begin() + idx, s);
+    last++;
+  }
+
+  // split the band straddling layer (if any) into two bands either side of it
+  void SplitLayers(uint32_t layer)
+  {
+    size_t band = FindLayer(first, last, layer);
+    if(band == last || LayerBegin(At(band)) >= layer)
+      return;
+
+    size_t end = BandEnd(band);
+    uint32_t layerEnd = LayerEnd(At(band));
+
+    vector<StateType> upper(states.begin() + band, states.begin() + end);
+    for(size_t i = 0; i < upper.size(); i++)
+    {
+      RegionState(upper[i]).subresourceRange.baseArrayLayer = layer;
+      RegionState(upper[i]).subresourceRange.layerCount = layerEnd - layer;
+      At(band + i).subresourceRange.layerCount = layer - LayerBegin(At(band + i));
+    }
+
+    states.insert(states.begin() + end, upper.begin(), upper.end());
+    last += upper.size();
+  }
+
+  // split the entry straddling mip (if any) in the band [band, end). Returns the new band end
+  size_t SplitMips(size_t band, size_t end, uint32_t mip)
+  {
+    size_t i = FindMip(band, end, mip);
+    if(i == end || MipBegin(At(i)) >= mip)
+      return end;
+
+    StateType upper = states[i];
+    RegionState(upper).subresourceRange.baseMipLevel = mip;
+    RegionState(upper).subresourceRange.levelCount = MipEnd(At(i)) - mip;
+    At(i).subresourceRange.levelCount = mip - MipBegin(At(i));
+
+    Insert(i + 1, upper);
+    return end + 1;
+  }
+
+  // transitions every entry inside the given layers and mips to newLayout, and sets oldLayout on
+  // entries that don't have one yet unless keepOldLayout is set. If fill is non-NULL,
+  // any part of the range that has no entry gets a copy of fill covering it. If the range was
+  // entirely in one layout beforehand, it's returned in prevLayout. Returns how many existing
+  // entries were transitioned.
+  size_t Update(uint32_t baseLayer, uint32_t numLayers, uint32_t baseMip, uint32_t numMips,
+              VkImageLayout oldLayout, VkImageLayout newLayout, bool keepOldLayout,
+              const StateType *fill, VkImageLayout *prevLayout)
+  {
+    if(numLayers == 0 || numMips == 0)
+      return 0;
+
+    uint32_t layerEnd = baseLayer + numLayers;
+    uint32_t mipEnd = baseMip + numMips;
+
+    SplitLayers(baseLayer);
+    SplitLayers(layerEnd);
+
+    bool uniform = true;
+    VkImageLayout prev = UNKNOWN_PREV_IMG_LAYOUT;
+    size_t touched = 0;
+
+    size_t band = FindLayer(first, last, baseLayer);
+    uint32_t layer = baseLayer;
+    while(layer < layerEnd)
     {
-      // we've found a range that completely matches our region, doesn't matter if that's
-      // a whole image and the barrier is the whole image, or it's one subresource.
-      // note that for images with only one array/mip slice (e.g. render targets) we'll never
-      // really have to worry about the else{} branch
-      if(it->second.subresourceRange.baseMipLevel == t.subresourceRange.baseMipLevel &&
-         it->second.subresourceRange.levelCount == nummips &&
-         it->second.subresourceRange.baseArrayLayer == t.subresourceRange.baseArrayLayer &&
-         it->second.subresourceRange.layerCount == numslices)
+      // no band covers the layers up to the next band
+      if(band == last || LayerBegin(At(band)) > layer)
       {
-        // verify
-        // RDCASSERT(it->second.newLayout == t.oldLayout);
+        uint32_t gapEnd = layerEnd;
+        if(band < last)
+          gapEnd = RDCMIN(gapEnd, LayerBegin(At(band)));
 
-        // apply it (prevstate is from the start of all barriers accumulated, so only set once)
-        if(it->second.oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
-          it->second.oldLayout = t.oldLayout;
-        it->second.newLayout = t.newLayout;
+        if(fill)
+        {
+          StateType s = *fill;
+          RegionState(s).subresourceRange.baseArrayLayer = layer;
+          RegionState(s).subresourceRange.layerCount = gapEnd - layer;
+          RegionState(s).subresourceRange.baseMipLevel = baseMip;
+          RegionState(s).subresourceRange.levelCount = numMips;
+          Insert(band, s);
+          band++;
+        }
 
-        done = true;
-        break;
+        layer = gapEnd;
+        continue;
       }
-      else
+
+      // since we split at the edges, this band lies entirely inside the range
+      uint32_t bandLayer = LayerBegin(At(band));
+      uint32_t bandLayers = At(band).subresourceRange.layerCount;
+
+      size_t end = BandEnd(band);
+      end = SplitMips(band, end, baseMip);
+      end = SplitMips(band, end, mipEnd);
+
+      size_t i = FindMip(band, end, baseMip);
+      uint32_t mip = baseMip;
+      while(mip < mipEnd)
       {
-        // this handles the case where the barrier covers a number of subresources and we need
-        // to update each matching subresource. If the barrier was only one mip & array slice
-        // it would have hit the case above. Find each subresource within the range, update it,
-        // and continue (marking as done so whenever we stop finding matching ranges, we are
-        // satisfied.
-        //
-        // note that regardless of how we lay out our subresources (slice-major or mip-major) the
-        // new
-        // range could be sparse, but that's OK as we only break out of the loop once we go past the
-        // whole
-        // aspect. Any subresources that don't match the range, after the split, will fail to meet
-        // any
-        // of the handled cases, so we'll just continue processing.
-        if(it->second.subresourceRange.levelCount == 1 &&
-           it->second.subresourceRange.layerCount == 1 &&
-           it->second.subresourceRange.baseMipLevel >= t.subresourceRange.baseMipLevel &&
-           it->second.subresourceRange.baseMipLevel < t.subresourceRange.baseMipLevel + nummips &&
-           it->second.subresourceRange.baseArrayLayer >= t.subresourceRange.baseArrayLayer &&
-           it->second.subresourceRange.baseArrayLayer < t.subresourceRange.baseArrayLayer + numslices)
+        if(i == end || MipBegin(At(i)) > mip)
         {
-          // apply it (prevstate is from the start of all barriers accumulated, so only set once)
-          if(it->second.oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
-            it->second.oldLayout = t.oldLayout;
-          it->second.newLayout = t.newLayout;
+          uint32_t gapEnd = mipEnd;
+          if(i < end)
+            gapEnd = RDCMIN(gapEnd, MipBegin(At(i)));
 
-          // continue as there might be more, but we're done
-          done = true;
+          if(fill)
+          {
+            StateType s = *fill;
+            RegionState(s).subresourceRange.baseArrayLayer = bandLayer;
+            RegionState(s).subresourceRange.layerCount = bandLayers;
+            RegionState(s).subresourceRange.baseMipLevel = mip;
+            RegionState(s).subresourceRange.levelCount = gapEnd - mip;
+            Insert(i, s);
+            i++;
+            end++;
+          }
+
+          mip = gapEnd;
           continue;
         }
-        // finally handle the case where we have a range that covers a whole image but we need to
-        // split it. If the barrier covered the whole image too it would have hit the very first
-        // case, so we know that the barrier doesn't cover the whole range.
-        // Also, if we've already done the split this case won't be hit and we'll either fall into
-        // the case above, or we'll finish as we've covered the whole barrier.
-        else if(it->second.subresourceRange.levelCount > 1 ||
-                it->second.subresourceRange.layerCount > 1)
-        {
-          pair<ResourceId, ImageRegionState> existing = *it;
 
-          // remember where we were in the array, as after this iterators will be
-          // invalidated.
-          size_t offs = it - dststates.begin();
-          size_t count =
-              it->second.subresourceRange.levelCount * it->second.subresourceRange.layerCount;
+        ImageRegionState &s = At(i);
 
-          // only insert count-1 as we want count entries total - one per subresource
-          dststates.insert(it, count - 1, existing);
+        if(touched++ == 0)
+          prev = s.newLayout;
+        else if(prev != s.newLayout)
+          uniform = false;
 
-          // it now points at the first subresource, but we need to modify the ranges
-          // to be valid
-          it = dststates.begin() + offs;
+        // prevstate is from the start of all barriers accumulated, so only set once
+        if(!keepOldLayout && s.oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
+          s.oldLayout = oldLayout;
+        s.newLayout = newLayout;
 
-          for(size_t i = 0; i < count; i++)
-          {
-            it->second.subresourceRange.levelCount = 1;
-            it->second.subresourceRange.layerCount = 1;
-
-            // slice-major
-            it->second.subresourceRange.baseArrayLayer =
-                uint32_t(i / existing.second.subresourceRange.levelCount);
-            it->second.subresourceRange.baseMipLevel =
-                uint32_t(i % existing.second.subresourceRange.levelCount);
-            it++;
-          }
+        mip = MipEnd(s);
+        i++;
+      }
 
-          // reset the iterator to point to the first subresource
-          it = dststates.begin() + offs;
+      layer = bandLayer + bandLayers;
+      band = end;
+    }
 
-          // the loop will continue after this point and look at the next subresources
-          // so we need to check to see if the first subresource lies in the range here
-          if(it->second.subresourceRange.baseMipLevel >= t.subresourceRange.baseMipLevel &&
-             it->second.subresourceRange.baseMipLevel < t.subresourceRange.baseMipLevel + nummips &&
-             it->second.subresourceRange.baseArrayLayer >= t.subresourceRange.baseArrayLayer &&
-             it->second.subresourceRange.baseArrayLayer <
-                 t.subresourceRange.baseArrayLayer + numslices)
-          {
-            // apply it (prevstate is from the start of all barriers accumulated, so only set once)
-            if(it->second.oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
-              it->second.oldLayout = t.oldLayout;
-            it->second.newLayout = t.newLayout;
+    if(prevLayout && touched > 0 && uniform)
+      *prevLayout = prev;
 
-            // continue as there might be more, but we're done
-            done = true;
-          }
+    return touched;
+  }
 
-          // continue processing from here
-          continue;
-        }
+  // merge neighbouring entries with identical layouts, first within each band then whole bands
+  // whose entries all match. Returns the number of entries removed from states
+  size_t Merge()
+  {
+    size_t origLast = last;
+
+    size_t w = first;
+    for(size_t r = first; r < last; r++)
+    {
+      if(w > first && LayerBegin(At(w - 1)) == LayerBegin(At(r)) &&
+         MipEnd(At(w - 1)) == MipBegin(At(r)) && SameLayouts(At(w - 1), At(r)))
+      {
+        At(w - 1).subresourceRange.levelCount += At(r).subresourceRange.levelCount;
+        continue;
+      }
+
+      if(w != r)
+        states[w] = states[r];
+      w++;
+    }
+
+    last = w;
+
+    w = first;
+    size_t prevBand = first;
+    for(size_t band = first; band < last;)
+    {
+      size_t end = BandEnd(band);
+      size_t count = end - band;
+
+      bool match = w > first && w - prevBand == count &&
+                   LayerEnd(At(prevBand)) == LayerBegin(At(band));
+
+      for(size_t i = 0; match && i < count; i++)
+      {
+        const ImageRegionState &a = At(prevBand + i);
+        const ImageRegionState &b = At(band + i);
+        match = MipBegin(a) == MipBegin(b) && MipEnd(a) == MipEnd(b) && SameLayouts(a, b);
+      }
+
+      if(match)
+      {
+        for(size_t i = 0; i < count; i++)
+          At(prevBand + i).subresourceRange.layerCount += At(band + i).subresourceRange.layerCount;
       }
+      else
+      {
+        prevBand = w;
+        for(size_t i = 0; i < count; i++, w++)
+          if(w != band + i)
+            states[w] = states[band + i];
+      }
+
+      band = end;
     }
 
-    // otherwise continue to try and find the subresource range
+    states.erase(states.begin() + w, states.begin() + origLast);
+    last = w;
+
+    return origLast - w;
   }
+};
 
-  if(done)
-    return;
+// finds the run of entries for id in a barrier list sorted by ResourceId
+static void FindImageRun(vector<pair<ResourceId, ImageRegionState> > &states, ResourceId id,
+                         size_t &first, size_t &last)
+{
+  size_t begin = 0, end = states.size();
+  while(begin < end)
+  {
+    size_t mid = begin + (end - begin) / 2;
+    if(states[mid].first < id)
+      begin = mid + 1;
+    else
+      end = mid;
+  }
+
+  first = begin;
+
+  end = states.size();
+  while(begin < end)
+  {
+    size_t mid = begin + (end - begin) / 2;
+    if(id < states[mid].first)
+      end = mid;
+    else
+      begin = mid + 1;
+  }
+
+  last = begin;
+}
+
+// merge the intervals of each image touched by a batch of barriers, once per image
+static void MergeImageRuns(vector<pair<ResourceId, ImageRegionState> > &states,
+                           vector<ResourceId> &ids)
+{
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+  for(size_t i = 0; i < ids.size(); i++)
+  {
+    size_t first = 0, last = 0;
+    FindImageRun(states, ids[i], first, last);
+
+    SubresourceIntervals<pair<ResourceId, ImageRegionState> > intervals(states, first, last);
+    intervals.Merge();
+  }
+}
+
+template <typename SrcBarrierType>
+void VulkanResourceManager::RecordSingleBarrier(vector<pair<ResourceId, ImageRegionState> > &dststates,
+                                                ResourceId id, const SrcBarrierType &t,
+                                                uint32_t nummips, uint32_t numslices)
+{
+  size_t first = 0, last = 0;
+  FindImageRun(dststates, id, first, last);
+
+  // any part of the barrier that we don't have a state for yet gets a new one
+  pair<ResourceId, ImageRegionState> fill =
+      std::make_pair(id, ImageRegionState(t.subresourceRange, t.oldLayout, t.newLayout));
 
-  // we don't have an existing barrier for this memory region, insert into place. it points to
-  // where it should be inserted
-  VkImageSubresourceRange subRange = t.subresourceRange;
-  subRange.levelCount = nummips;
-  subRange.layerCount = numslices;
-  dststates.insert(it, std::make_pair(id, ImageRegionState(subRange, t.oldLayout, t.newLayout)));
+  SubresourceIntervals<pair<ResourceId, ImageRegionState> > intervals(dststates, first, last);
+  intervals.Update(t.subresourceRange.baseArrayLayer, numslices, t.subresourceRange.baseMipLevel,
+                   nummips, t.oldLayout, t.newLayout, false, &fill, NULL);
 }
 
 void VulkanResourceManager::RecordBarriers(vector<pair<ResourceId, ImageRegionState> > &states,
@@ -204,6 +425,9 @@ void VulkanResourceManager::RecordBarriers(vector<pair<ResourceId, ImageRegionSt
 {
   TRDBG("Recording %u barriers", numBarriers);
 
+  vector<ResourceId> touched;
+  touched.reserve(numBarriers);
+
   for(uint32_t ti = 0; ti < numBarriers; ti++)
   {
     const VkImageMemoryBarrier &t = barriers[ti];
@@ -224,8 +448,11 @@ void VulkanResourceManager::RecordBarriers(vector<pair<ResourceId, ImageRegionSt
       numslices = layouts[id].layerCount - t.subresourceRange.baseArrayLayer;
 
     RecordSingleBarrier(states, id, t, nummips, numslices);
+    touched.push_back(id);
   }
 
+  MergeImageRuns(states, touched);
+
   TRDBG("Post-record, there are %u states", (uint32_t)states.size());
 }
 
@@ -234,13 +461,19 @@ void VulkanResourceManager::MergeBarriers(vector<pair<ResourceId, ImageRegionSta
 {
   TRDBG("Merging %u states", (uint32_t)srcstates.size());
 
+  vector<ResourceId> touched;
+  touched.reserve(srcstates.size());
+
   for(size_t ti = 0; ti < srcstates.size(); ti++)
   {
     const ImageRegionState &t = srcstates[ti].second;
     RecordSingleBarrier(dststates, srcstates[ti].first, t, t.subresourceRange.levelCount,
                         t.subresourceRange.layerCount);
+    touched.push_back(srcstates[ti].first);
   }
 
+  MergeImageRuns(dststates, touched);
+
   TRDBG("Post-merge, there are %u states", (uint32_t)dststates.size());
 }
 
@@ -334,182 +567,73 @@ void VulkanResourceManager::ApplyBarriers(vector<pair<ResourceId, ImageRegionSta
 {
   TRDBG("Applying %u barriers", (uint32_t)states.size());
 
-  for(size_t ti = 0; ti < states.size(); ti++)
+  // barrier lists are grouped by image, so each image is looked up once and has all of its
+  // transitions applied to its intervals before they're merged, rather than after every barrier.
+  for(size_t ti = 0; ti < states.size();)
   {
     ResourceId id = states[ti].first;
-    ImageRegionState &t = states[ti].second;
 
-    TRDBG("Applying barrier to %llu", GetOriginalID(id));
+    size_t end = ti + 1;
+    while(end < states.size() && states[end].first == id)
+      end++;
+
+    TRDBG("Applying %u barriers to %llu", uint32_t(end - ti), GetOriginalID(id));
 
     auto stit = layouts.find(id);
 
     if(stit == layouts.end())
     {
       TRDBG("Didn't find ID in image layouts");
+      ti = end;
       continue;
     }
 
-    uint32_t nummips = t.subresourceRange.levelCount;
-    uint32_t numslices = t.subresourceRange.layerCount;
-    if(nummips == VK_REMAINING_MIP_LEVELS)
-      nummips = layouts[id].levelCount;
-    if(numslices == VK_REMAINING_ARRAY_LAYERS)
-      numslices = layouts[id].layerCount;
-
-    if(nummips == 0)
-      nummips = 1;
-    if(numslices == 0)
-      numslices = 1;
-
-    if(t.oldLayout == t.newLayout)
-      continue;
+    ImageLayouts &layout = stit->second;
 
-    TRDBG("Barrier of %s (%u->%u, %u->%u) from %s to %s",
-          ToStr::Get(t.subresourceRange.aspect).c_str(), t.subresourceRange.baseMipLevel,
-          t.subresourceRange.levelCount, t.subresourceRange.baseArrayLayer,
-          t.subresourceRange.layerCount, ToStr::Get(t.oldLayout).c_str(),
-          ToStr::Get(t.newLayout).c_str());
+    TRDBG("Matching image has %u subresource states", (uint32_t)layout.subresourceStates.size());
 
-    bool done = false;
+    SubresourceIntervals<ImageRegionState> intervals(layout.subresourceStates, 0,
+                                                     layout.subresourceStates.size());
 
-    TRDBG("Matching image has %u subresource states", stit->second.subresourceStates.size());
-
-    auto it = stit->second.subresourceStates.begin();
-    for(; it != stit->second.subresourceStates.end(); ++it)
+    for(; ti < end; ti++)
     {
-      TRDBG(".. state %s (%u->%u, %u->%u) from %s to %s",
-            ToStr::Get(it->subresourceRange.aspect).c_str(), it->range.baseMipLevel,
-            it->range.levelCount, it->range.baseArrayLayer, it->range.layerCount,
-            ToStr::Get(it->oldLayout).c_str(), ToStr::Get(it->newLayout).c_str());
-
-      // image barriers are handled by initially inserting one subresource range for the whole
-      // object,
-      // and whenever we need more fine-grained detail we split it immediately.
-      // Thereafter if a barrier comes in that covers multiple subresources, we update all matching
-      // ranges.
-      // NOTE: Depth-stencil images must always be trasnsitioned together for both aspects, so we
-      // don't
-      // have to worry about different aspects being in different states and can in fact ignore the
-      // aspect
-      // for the purpose of this case.
-
-      {
-        // we've found a range that completely matches our region, doesn't matter if that's
-        // a whole image and the barrier is the whole image, or it's one subresource.
-        // note that for images with only one array/mip slice (e.g. render targets) we'll never
-        // really have to worry about the else{} branch
-        if(it->subresourceRange.baseMipLevel == t.subresourceRange.baseMipLevel &&
-           it->subresourceRange.levelCount == nummips &&
-           it->subresourceRange.baseArrayLayer == t.subresourceRange.baseArrayLayer &&
-           it->subresourceRange.layerCount == numslices)
-        {
-          /*
-          RDCASSERT(t.oldLayout == UNKNOWN_PREV_IMG_LAYOUT || it->newLayout ==
-          UNKNOWN_PREV_IMG_LAYOUT || // renderdoc untracked/ignored
-                    it->newLayout == t.oldLayout || // valid barrier
-                    t.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED); // can barrier from UNDEFINED to any
-          state
-          */
-          t.oldLayout = it->newLayout;
-          it->newLayout = t.newLayout;
-
-          done = true;
-          break;
-        }
-        else
-        {
-          // this handles the case where the barrier covers a number of subresources and we need
-          // to update each matching subresource. If the barrier was only one mip & array slice
-          // it would have hit the case above. Find each subresource within the range, update it,
-          // and continue (marking as done so whenever we stop finding matching ranges, we are
-          // satisfied.
-          //
-          // note that regardless of how we lay out our subresources (slice-major or mip-major) the
-          // new
-          // range could be sparse, but that's OK as we only break out of the loop once we go past
-          // the whole
-          // aspect. Any subresources that don't match the range, after the split, will fail to meet
-          // any
-          // of the handled cases, so we'll just continue processing.
-          if(it->subresourceRange.levelCount == 1 && it->subresourceRange.layerCount == 1 &&
-             it->subresourceRange.baseMipLevel >= t.subresourceRange.baseMipLevel &&
-             it->subresourceRange.baseMipLevel < t.subresourceRange.baseMipLevel + nummips &&
-             it->subresourceRange.baseArrayLayer >= t.subresourceRange.baseArrayLayer &&
-             it->subresourceRange.baseArrayLayer < t.subresourceRange.baseArrayLayer + numslices)
-          {
-            // apply it (prevstate is from the start of all barriers accumulated, so only set once)
-            if(it->oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
-              it->oldLayout = t.oldLayout;
-            it->newLayout = t.newLayout;
-
-            // continue as there might be more, but we're done
-            done = true;
-            continue;
-          }
-          // finally handle the case where we have a range that covers a whole image but we need to
-          // split it. If the barrier covered the whole image too it would have hit the very first
-          // case, so we know that the barrier doesn't cover the whole range.
-          // Also, if we've already done the split this case won't be hit and we'll either fall into
-          // the case above, or we'll finish as we've covered the whole barrier.
-          else if(it->subresourceRange.levelCount > 1 || it->subresourceRange.layerCount > 1)
-          {
-            ImageRegionState existing = *it;
-
-            // remember where we were in the array, as after this iterators will be
-            // invalidated.
-            size_t offs = it - stit->second.subresourceStates.begin();
-            size_t count = it->subresourceRange.levelCount * it->subresourceRange.layerCount;
-
-            // only insert count-1 as we want count entries total - one per subresource
-            stit->second.subresourceStates.insert(it, count - 1, existing);
-
-            // it now points at the first subresource, but we need to modify the ranges
-            // to be valid
-            it = stit->second.subresourceStates.begin() + offs;
-
-            for(size_t i = 0; i < count; i++)
-            {
-              it->subresourceRange.levelCount = 1;
-              it->subresourceRange.layerCount = 1;
-
-              // slice-major
-              it->subresourceRange.baseArrayLayer =
-                  uint32_t(i / existing.subresourceRange.levelCount);
-              it->subresourceRange.baseMipLevel = uint32_t(i % existing.subresourceRange.levelCount);
-              it++;
-            }
-
-            // reset the iterator to point to the first subresource
-            it = stit->second.subresourceStates.begin() + offs;
-
-            // the loop will continue after this point and look at the next subresources
-            // so we need to check to see if the first subresource lies in the range here
-            if(it->subresourceRange.baseMipLevel >= t.subresourceRange.baseMipLevel &&
-               it->subresourceRange.baseMipLevel < t.subresourceRange.baseMipLevel + nummips &&
-               it->subresourceRange.baseArrayLayer >= t.subresourceRange.baseArrayLayer &&
-               it->subresourceRange.baseArrayLayer < t.subresourceRange.baseArrayLayer + numslices)
-            {
-              // apply it (prevstate is from the start of all barriers accumulated, so only set
-              // once)
-              if(it->oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
-                it->oldLayout = t.oldLayout;
-              it->newLayout = t.newLayout;
-
-              // continue as there might be more, but we're done
-              done = true;
-            }
-
-            // continue processing from here
-            continue;
-          }
-        }
-      }
-
-      // otherwise continue to try and find the subresource range
+      ImageRegionState &t = states[ti].second;
+
+      uint32_t nummips = t.subresourceRange.levelCount;
+      uint32_t numslices = t.subresourceRange.layerCount;
+      if(nummips == VK_REMAINING_MIP_LEVELS)
+        nummips = uint32_t(layout.levelCount) -
+                  RDCMIN(t.subresourceRange.baseMipLevel, uint32_t(layout.levelCount));
+      if(numslices == VK_REMAINING_ARRAY_LAYERS)
+        numslices = uint32_t(layout.layerCount) -
+                    RDCMIN(t.subresourceRange.baseArrayLayer, uint32_t(layout.layerCount));
+
+      if(nummips == 0)
+        nummips = 1;
+      if(numslices == 0)
+        numslices = 1;
+
+      if(t.oldLayout == t.newLayout)
+        continue;
+
+      TRDBG("Barrier of %s (%u->%u, %u->%u) from %s to %s",
+            ToStr::Get(t.subresourceRange.aspectMask).c_str(), t.subresourceRange.baseMipLevel,
+            nummips, t.subresourceRange.baseArrayLayer, numslices,
+            ToStr::Get(t.oldLayout).c_str(), ToStr::Get(t.newLayout).c_str());
+
+      // NOTE: Depth-stencil images must always be transitioned together for both aspects, so we
+      // don't have to worry about different aspects being in different states and can ignore the
+      // aspect here. The previous layout is handed back in t.oldLayout when the whole range was
+      // in one layout.
+      size_t touched = intervals.Update(t.subresourceRange.baseArrayLayer, numslices,
+                                        t.subresourceRange.baseMipLevel, nummips, t.oldLayout,
+                                        t.newLayout, true, NULL, &t.oldLayout);
+
+      if(touched == 0)
+        RDCERR("Couldn't find subresource range to apply barrier to - invalid!");
     }
 
-    if(!done)
-      RDCERR("Couldn't find subresource range to apply barrier to - invalid!");
+    intervals.Merge();
   }
 }
 
@@ -533,6 +657,18 @@ bool VulkanResourceManager::Serialise_InitialState(ResourceId resid, WrappedVkRe
   return m_Core->Serialise_InitialState(resid, res);
 }
 
+bool VulkanResourceManager::AllowParallel_InitialState(ResourceId id, WrappedVkRes *res)
+{
+  return m_Core->AllowParallel_InitialState(id, res);
+}
+
+void VulkanResourceManager::Serialise_InitialStateParallel(Serialiser *ser, ResourceId id,
+                                                           WrappedVkRes *res,
+                                                           const InitialContentData &contents)
+{
+  m_Core->Serialise_InitialStateParallel(ser, id, res, contents);
+}
+
 void VulkanResourceManager::Create_InitialState(ResourceId id, WrappedVkRes *live, bool hasData)
 {
   return m_Core->Create_InitialState(id, live, hasData);
@@ -257,6 +257,9 @@ private:
   bool Need_InitialStateChunk(WrappedVkRes *res);
   bool Prepare_InitialState(WrappedVkRes *res);
   bool Serialise_InitialState(ResourceId resid, WrappedVkRes *res);
+  bool AllowParallel_InitialState(ResourceId id, WrappedVkRes *res);
+  void Serialise_InitialStateParallel(Serialiser *ser, ResourceId id, WrappedVkRes *res,
+                                      const InitialContentData &contents);
   void Create_InitialState(ResourceId id, WrappedVkRes *live, bool hasData);
   void Apply_InitialState(WrappedVkRes *live, InitialContentData initial);
 
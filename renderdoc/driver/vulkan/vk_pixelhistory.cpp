@@ -0,0 +1,935 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "vk_replay.h"
+#include "maths/formatpacking.h"
+#include "vk_core.h"
+#include "vk_debug.h"
+#include "vk_resources.h"
+
+// Pixel history is gathered with a few whole-frame replays instead of one replay per candidate
+// event. Each replay wraps every candidate draw in an occlusion query, counted on a copy of the
+// draw's pipeline that is scissored to the pixel, writes nothing, and has one more of the
+// original fixed-function tests switched back on than the replay before. Comparing counts
+// between consecutive passes says which test rejected the draw. The first pass also copies the
+// pixel before and after every candidate event into a single readback buffer. Draws that only
+// write the target through a storage image aren't queried, they just have their values fetched.
+enum PixelHistoryPass
+{
+  // everything disabled but the pixel scissor and the vertex pipeline
+  ePixelHistory_Coverage = 0,
+  // + original cull mode
+  ePixelHistory_Culling,
+  // + original depth clamp setting
+  ePixelHistory_DepthClip,
+  // + original stencil test
+  ePixelHistory_StencilTest,
+  // + original depth test and depth bounds test
+  ePixelHistory_DepthTest,
+  // + original fragment shader, to catch discards
+  ePixelHistory_Shader,
+  ePixelHistory_Count,
+};
+
+// value of the pixel, and the depth/stencil at the same location, copied straight from the images
+struct PixelHistoryValue
+{
+  byte colour[16];
+  uint32_t depth;
+  uint32_t stencil;
+  uint32_t padding[6];
+};
+
+// one per candidate event. The stride is a multiple of every texel size we could copy (up to 12
+// and 16 byte formats), as copy destinations must be aligned to the texel size.
+struct PixelHistorySlot
+{
+  PixelHistoryValue preMod;
+  PixelHistoryValue postMod;
+};
+
+struct PixelHistoryEvent
+{
+  PixelHistoryEvent()
+  {
+    eventID = 0;
+    draw = bound = valuesFetched = scissorClipped = false;
+    uavWrite = storageWrite = false;
+    depthFormat = VK_FORMAT_UNDEFINED;
+    RDCEraseEl(needsPass);
+    RDCEraseEl(counts);
+  }
+
+  uint32_t eventID;
+
+  // draws are occlusion queried, everything else only has its values fetched
+  bool draw;
+
+  // any of the event's usages of the target writes to it other than as an attachment
+  bool uavWrite;
+  // a draw that didn't have the target bound as an attachment, but can write to it as a storage
+  // image. Its values are fetched like a dispatch's
+  bool storageWrite;
+
+  // whether the target subresource was bound as an attachment when this draw happened
+  bool bound;
+
+  bool valuesFetched;
+
+  // the pixel is outside the original scissor
+  bool scissorClipped;
+
+  // format of the depth attachment bound with a colour target, or UNDEFINED if none
+  VkFormat depthFormat;
+
+  // which passes re-enable some state the draw actually uses
+  bool needsPass[ePixelHistory_Count];
+
+  uint64_t counts[ePixelHistory_Count];
+};
+
+struct PixelHistoryCallback : public DrawcallCallback
+{
+  PixelHistoryCallback(WrappedVulkan *vk, VulkanCreationInfo &creationInfo,
+                       const VkPhysicalDeviceFeatures &features, ResourceId target, uint32_t x,
+                       uint32_t y, uint32_t slice, uint32_t mip, uint32_t sampleIdx,
+                       vector<PixelHistoryEvent> &events, VkQueryPool queryPool, VkBuffer readback)
+      : m_pDriver(vk),
+        m_pDebug(vk->GetDebugManager()),
+        m_CreationInfo(creationInfo),
+        m_Target(target),
+        m_X(x),
+        m_Y(y),
+        m_Slice(slice),
+        m_Mip(mip),
+        m_Events(events),
+        m_QueryPool(queryPool),
+        m_Readback(readback),
+        m_Pass(ePixelHistory_Coverage),
+        m_ActiveEvent(NULL),
+        m_StorageEvent(NULL),
+        m_PrevState(&creationInfo)
+  {
+    m_pDriver->SetDrawcallCB(this);
+
+    for(size_t i = 0; i < m_Events.size(); i++)
+      m_EventIndex[m_Events[i].eventID] = i;
+
+    const VulkanCreationInfo::Image &iminfo = m_CreationInfo.m_Image[target];
+
+    m_Image = m_pDriver->GetResourceManager()->GetCurrentHandle<VkImage>(target);
+    m_Format = iminfo.format;
+    m_3D = (iminfo.type == VK_IMAGE_TYPE_3D);
+    m_Multisampled = (iminfo.samples != VK_SAMPLE_COUNT_1_BIT);
+
+    m_SampleMask = ~0U;
+    if(m_Multisampled && sampleIdx < 32)
+      m_SampleMask = 1U << sampleIdx;
+
+    m_Precise = (features.occlusionQueryPrecise != VK_FALSE);
+    m_DepthClamp = (features.depthClamp != VK_FALSE);
+  }
+
+  ~PixelHistoryCallback()
+  {
+    m_pDriver->SetDrawcallCB(NULL);
+
+    for(size_t p = 0; p < ARRAY_COUNT(m_Pipelines); p++)
+      for(auto it = m_Pipelines[p].begin(); it != m_Pipelines[p].end(); ++it)
+        m_pDriver->vkDestroyPipeline(m_pDriver->GetDev(), it->second, NULL);
+  }
+
+  void SetPass(PixelHistoryPass pass) { m_Pass = pass; }
+  // queries are laid out pass-major, so each pass's results can be fetched in one go
+  uint32_t QueryIndex(const PixelHistoryEvent *ev, PixelHistoryPass pass)
+  {
+    return uint32_t(pass * m_Events.size() + (ev - &m_Events[0]));
+  }
+
+  PixelHistoryEvent *FindEvent(uint32_t eid)
+  {
+    auto it = m_EventIndex.find(eid);
+    if(it == m_EventIndex.end())
+      return NULL;
+    return &m_Events[it->second];
+  }
+
+  void PreDraw(uint32_t eid, VkCommandBuffer cmd)
+  {
+    PixelHistoryEvent *ev = FindEvent(eid);
+
+    if(ev == NULL)
+      return;
+
+    if(m_Pass == ePixelHistory_Coverage)
+    {
+      ev->draw = true;
+
+      if(!InspectDraw(*ev))
+      {
+        // a draw writing through a storage image gets the values around it, like a dispatch
+        if(ev->uavWrite)
+        {
+          ev->storageWrite = ev->bound = true;
+          FetchValues(cmd, *ev, false);
+          m_StorageEvent = ev;
+        }
+        return;
+      }
+
+      FetchValues(cmd, *ev, false);
+    }
+    else if(!ev->needsPass[m_Pass] || ev->counts[m_Pass - 1] == 0)
+    {
+      return;
+    }
+
+    VulkanRenderState &state = m_pDriver->GetRenderState();
+
+    m_PrevState = state;
+
+    const VulkanCreationInfo::Pipeline &p = m_CreationInfo.m_Pipeline[state.graphics.pipeline];
+
+    state.graphics.pipeline = GetResID(GetPipeline(state.graphics.pipeline));
+
+    // dynamic state is re-applied when binding, so override it the same way as the static state
+    if(p.dynamicStates[VK_DYNAMIC_STATE_SCISSOR])
+    {
+      VkRect2D pixel = {{(int32_t)m_X, (int32_t)m_Y}, {1, 1}};
+      for(size_t i = 0; i < state.scissors.size(); i++)
+        state.scissors[i] = pixel;
+    }
+
+    if(p.dynamicStates[VK_DYNAMIC_STATE_STENCIL_WRITE_MASK])
+      state.front.write = state.back.write = 0;
+
+    state.BindPipeline(cmd);
+
+    ObjDisp(cmd)->CmdBeginQuery(Unwrap(cmd), m_QueryPool, QueryIndex(ev, m_Pass),
+                                m_Precise ? VK_QUERY_CONTROL_PRECISE_BIT : 0);
+
+    m_ActiveEvent = ev;
+  }
+
+  bool PostDraw(uint32_t eid, VkCommandBuffer cmd)
+  {
+    if(m_StorageEvent)
+    {
+      FetchValues(cmd, *m_StorageEvent, true);
+      m_StorageEvent = NULL;
+      return false;
+    }
+
+    if(m_ActiveEvent == NULL)
+      return false;
+
+    ObjDisp(cmd)->CmdEndQuery(Unwrap(cmd), m_QueryPool, QueryIndex(m_ActiveEvent, m_Pass));
+
+    m_ActiveEvent = NULL;
+
+    // restore the original state and let the real draw happen so later events see the right
+    // contents
+    m_pDriver->GetRenderState() = m_PrevState;
+    m_pDriver->GetRenderState().BindPipeline(cmd);
+
+    return true;
+  }
+
+  void PostRedraw(uint32_t eid, VkCommandBuffer cmd)
+  {
+    if(m_Pass != ePixelHistory_Coverage)
+      return;
+
+    PixelHistoryEvent *ev = FindEvent(eid);
+
+    if(ev && ev->bound)
+      FetchValues(cmd, *ev, true);
+  }
+
+  // dispatches and other events can only write through storage images or transfers, so we just
+  // fetch the values before and after
+  void PreDispatch(uint32_t eid, VkCommandBuffer cmd) { PreMisc(eid, eDraw_Dispatch, cmd); }
+  bool PostDispatch(uint32_t eid, VkCommandBuffer cmd)
+  {
+    PostMisc(eid, eDraw_Dispatch, cmd);
+    return false;
+  }
+  void PostRedispatch(uint32_t eid, VkCommandBuffer cmd) {}
+  void PreMisc(uint32_t eid, DrawcallFlags flags, VkCommandBuffer cmd)
+  {
+    PixelHistoryEvent *ev = FindEvent(eid);
+
+    if(ev == NULL || m_Pass != ePixelHistory_Coverage)
+      return;
+
+    ev->bound = true;
+
+    FetchValues(cmd, *ev, false);
+  }
+
+  void PostMisc(uint32_t eid, DrawcallFlags flags, VkCommandBuffer cmd)
+  {
+    PixelHistoryEvent *ev = FindEvent(eid);
+
+    if(ev == NULL || m_Pass != ePixelHistory_Coverage)
+      return;
+
+    FetchValues(cmd, *ev, true);
+  }
+
+  bool RecordAllCmds() { return true; }
+  void AliasEvent(uint32_t primary, uint32_t alias)
+  {
+    // a resubmitted command buffer is only recorded once, so aliased events aren't queried
+  }
+
+private:
+  // look up whether the target is bound at this draw, and which passes the draw needs
+  bool InspectDraw(PixelHistoryEvent &ev)
+  {
+    VulkanRenderState &state = m_pDriver->GetRenderState();
+    VulkanCreationInfo &c = m_CreationInfo;
+
+    const VulkanCreationInfo::RenderPass &rp = c.m_RenderPass[state.renderPass];
+    const VulkanCreationInfo::Framebuffer &fb = c.m_Framebuffer[state.framebuffer];
+    const VulkanCreationInfo::RenderPass::Subpass &sub = rp.subpasses[state.subpass];
+
+    vector<uint32_t> atts = sub.colorAttachments;
+    if(sub.depthstencilAttachment >= 0)
+      atts.push_back((uint32_t)sub.depthstencilAttachment);
+
+    ev.bound = false;
+
+    for(size_t i = 0; i < atts.size(); i++)
+    {
+      if(atts[i] == VK_ATTACHMENT_UNUSED)
+        continue;
+
+      const VulkanCreationInfo::ImageView &view = c.m_ImageView[fb.attachments[atts[i]].view];
+
+      if(view.image != m_Target || view.range.baseMipLevel != m_Mip)
+        continue;
+
+      if(!m_3D && (m_Slice < view.range.baseArrayLayer ||
+                   m_Slice >= view.range.baseArrayLayer + view.range.layerCount))
+        continue;
+
+      ev.bound = true;
+    }
+
+    if(!ev.bound)
+      return false;
+
+    if(sub.depthstencilAttachment >= 0 && !IsDepthStencilFormat(m_Format))
+      ev.depthFormat = fb.attachments[sub.depthstencilAttachment].format;
+
+    const VulkanCreationInfo::Pipeline &p = c.m_Pipeline[state.graphics.pipeline];
+
+    const vector<VkRect2D> &scissors =
+        p.dynamicStates[VK_DYNAMIC_STATE_SCISSOR] ? state.scissors : p.scissors;
+
+    ev.scissorClipped = !scissors.empty();
+    for(size_t i = 0; i < scissors.size(); i++)
+    {
+      const VkRect2D &s = scissors[i];
+      if(int64_t(m_X) >= s.offset.x && int64_t(m_Y) >= s.offset.y &&
+         int64_t(m_X) < int64_t(s.offset.x) + s.extent.width &&
+         int64_t(m_Y) < int64_t(s.offset.y) + s.extent.height)
+        ev.scissorClipped = false;
+    }
+
+    ev.needsPass[ePixelHistory_Coverage] = true;
+    ev.needsPass[ePixelHistory_Culling] = (p.cullMode != VK_CULL_MODE_NONE);
+    ev.needsPass[ePixelHistory_DepthClip] = m_DepthClamp && !p.depthClampEnable;
+    ev.needsPass[ePixelHistory_StencilTest] = p.stencilTestEnable;
+    ev.needsPass[ePixelHistory_DepthTest] = p.depthTestEnable || p.depthBoundsEnable;
+    ev.needsPass[ePixelHistory_Shader] = (p.shaders[4].module != ResourceId());
+
+    return true;
+  }
+
+  // fetch (or create) the variant of pipeline for the current pass
+  VkPipeline GetPipeline(ResourceId pipeline)
+  {
+    VkPipeline &ret = m_Pipelines[m_Pass][pipeline];
+
+    if(ret != VK_NULL_HANDLE)
+      return ret;
+
+    const VulkanCreationInfo::Pipeline &p = m_CreationInfo.m_Pipeline[pipeline];
+
+    VkGraphicsPipelineCreateInfo pipeCreateInfo;
+    m_pDebug->MakeGraphicsPipelineInfo(pipeCreateInfo, pipeline);
+
+    // only rasterize to our pixel
+    VkPipelineViewportStateCreateInfo *vp =
+        (VkPipelineViewportStateCreateInfo *)pipeCreateInfo.pViewportState;
+    for(uint32_t i = 0; i < vp->scissorCount; i++)
+    {
+      VkRect2D &s = (VkRect2D &)vp->pScissors[i];
+      s.offset.x = (int32_t)m_X;
+      s.offset.y = (int32_t)m_Y;
+      s.extent.width = s.extent.height = 1;
+    }
+
+    VkPipelineRasterizationStateCreateInfo *rs =
+        (VkPipelineRasterizationStateCreateInfo *)pipeCreateInfo.pRasterizationState;
+    if(m_Pass < ePixelHistory_Culling)
+      rs->cullMode = VK_CULL_MODE_NONE;
+    if(m_Pass < ePixelHistory_DepthClip && m_DepthClamp)
+      rs->depthClampEnable = VK_TRUE;
+
+    VkPipelineMultisampleStateCreateInfo *ms =
+        (VkPipelineMultisampleStateCreateInfo *)pipeCreateInfo.pMultisampleState;
+    VkSampleMask sampleMask = p.sampleMask & m_SampleMask;
+    ms->pSampleMask = &sampleMask;
+    if(m_Pass < ePixelHistory_Shader)
+      ms->alphaToCoverageEnable = VK_FALSE;
+
+    // tests are enabled as the passes go on, but nothing is ever written
+    VkPipelineDepthStencilStateCreateInfo *ds =
+        (VkPipelineDepthStencilStateCreateInfo *)pipeCreateInfo.pDepthStencilState;
+    ds->depthWriteEnable = VK_FALSE;
+    ds->front.writeMask = ds->back.writeMask = 0;
+    if(m_Pass < ePixelHistory_StencilTest)
+      ds->stencilTestEnable = VK_FALSE;
+    if(m_Pass < ePixelHistory_DepthTest)
+      ds->depthTestEnable = ds->depthBoundsTestEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo *cb =
+        (VkPipelineColorBlendStateCreateInfo *)pipeCreateInfo.pColorBlendState;
+    cb->logicOpEnable = VK_FALSE;
+    for(uint32_t i = 0; i < cb->attachmentCount; i++)
+    {
+      VkPipelineColorBlendAttachmentState &att =
+          (VkPipelineColorBlendAttachmentState &)cb->pAttachments[i];
+      att.blendEnable = VK_FALSE;
+      att.colorWriteMask = 0;
+    }
+
+    // until the last pass, drop the fragment shader so discards don't affect the counts
+    if(m_Pass < ePixelHistory_Shader)
+    {
+      VkPipelineShaderStageCreateInfo *stages =
+          (VkPipelineShaderStageCreateInfo *)pipeCreateInfo.pStages;
+
+      uint32_t stageCount = 0;
+      for(uint32_t i = 0; i < pipeCreateInfo.stageCount; i++)
+        if(stages[i].stage != VK_SHADER_STAGE_FRAGMENT_BIT)
+          stages[stageCount++] = stages[i];
+
+      pipeCreateInfo.stageCount = stageCount;
+    }
+
+    VkResult vkr = m_pDriver->vkCreateGraphicsPipelines(m_pDriver->GetDev(), VK_NULL_HANDLE, 1,
+                                                        &pipeCreateInfo, NULL, &ret);
+    RDCASSERTEQUAL(vkr, VK_SUCCESS);
+
+    return ret;
+  }
+
+  void CopyPixel(VkCommandBuffer cmd, VkImage image, VkFormat fmt, VkImageAspectFlags aspect,
+                 VkImageLayout layout, VkImageLayout restoreLayout, uint32_t mip, uint32_t slice,
+                 VkDeviceSize offset)
+  {
+    VkImageAspectFlags fullAspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    if(IsStencilOnlyFormat(fmt))
+      fullAspect = VK_IMAGE_ASPECT_STENCIL_BIT;
+    else if(IsDepthOnlyFormat(fmt))
+      fullAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    else if(IsDepthStencilFormat(fmt))
+      fullAspect = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+
+    VkImageMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        NULL,
+        MakeAccessMask(layout),
+        VK_ACCESS_TRANSFER_READ_BIT,
+        layout,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        Unwrap(image),
+        {fullAspect, mip, 1, m_3D ? 0 : slice, 1},
+    };
+
+    DoPipelineBarrier(cmd, 1, &barrier);
+
+    VkBufferImageCopy region = {
+        offset,
+        0,
+        0,
+        {aspect, mip, m_3D ? 0 : slice, 1},
+        {(int32_t)m_X, (int32_t)m_Y, m_3D ? (int32_t)slice : 0},
+        {1, 1, 1},
+    };
+
+    ObjDisp(cmd)->CmdCopyImageToBuffer(Unwrap(cmd), Unwrap(image),
+                                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_Readback, 1,
+                                       &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = MakeAccessMask(restoreLayout);
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = restoreLayout;
+
+    DoPipelineBarrier(cmd, 1, &barrier);
+  }
+
+  void CopyValue(VkCommandBuffer cmd, VkImage image, VkFormat fmt, VkImageLayout layout,
+                 VkImageLayout restoreLayout, uint32_t mip, uint32_t slice, VkDeviceSize offset)
+  {
+    if(IsDepthStencilFormat(fmt))
+    {
+      if(!IsStencilOnlyFormat(fmt))
+        CopyPixel(cmd, image, fmt, VK_IMAGE_ASPECT_DEPTH_BIT, layout, restoreLayout, mip, slice,
+                  offset + offsetof(PixelHistoryValue, depth));
+      if(IsStencilFormat(fmt))
+        CopyPixel(cmd, image, fmt, VK_IMAGE_ASPECT_STENCIL_BIT, layout, restoreLayout, mip, slice,
+                  offset + offsetof(PixelHistoryValue, stencil));
+    }
+    else
+    {
+      CopyPixel(cmd, image, fmt, VK_IMAGE_ASPECT_COLOR_BIT, layout, restoreLayout, mip, slice,
+                offset + offsetof(PixelHistoryValue, colour));
+    }
+  }
+
+  void FetchValues(VkCommandBuffer cmd, PixelHistoryEvent &ev, bool post)
+  {
+    // multisampled images can't be copied to buffers
+    if(m_Multisampled)
+      return;
+
+    ev.valuesFetched = true;
+
+    VkDeviceSize offset = (&ev - &m_Events[0]) * sizeof(PixelHistorySlot);
+    offset += post ? offsetof(PixelHistorySlot, postMod) : offsetof(PixelHistorySlot, preMod);
+
+    if(!m_pDriver->IsRenderPassActive())
+    {
+      VkImageAspectFlags aspect = IsDepthStencilFormat(m_Format)
+                                      ? VkImageAspectFlags(VK_IMAGE_ASPECT_DEPTH_BIT |
+                                                           VK_IMAGE_ASPECT_STENCIL_BIT)
+                                      : VkImageAspectFlags(VK_IMAGE_ASPECT_COLOR_BIT);
+      VkImageLayout layout = m_pDriver->GetImageLayout(cmd, m_Target, aspect, m_Mip, m_Slice);
+      CopyValue(cmd, m_Image, m_Format, layout, layout, m_Mip, m_Slice, offset);
+      return;
+    }
+
+    // can't copy inside a render pass, so end it, copy, and resume with the loading version of
+    // the render pass. Every attachment needs to go back to the layout the render pass expects.
+    VulkanRenderState &state = m_pDriver->GetRenderState();
+    VulkanCreationInfo &c = m_CreationInfo;
+
+    const VulkanCreationInfo::RenderPass &rp = c.m_RenderPass[state.renderPass];
+    const VulkanCreationInfo::Framebuffer &fb = c.m_Framebuffer[state.framebuffer];
+
+    state.EndRenderPass(cmd);
+
+    bool targetCopied = false;
+
+    for(size_t i = 0; i < fb.attachments.size() && i < rp.attachments.size(); i++)
+    {
+      const VulkanCreationInfo::ImageView &view = c.m_ImageView[fb.attachments[i].view];
+      const VulkanCreationInfo::RenderPass::Attachment &att = rp.attachments[i];
+
+      VkImage image = m_pDriver->GetResourceManager()->GetCurrentHandle<VkImage>(view.image);
+
+      VkImageLayout restoreLayout = att.initialLayout;
+      if(restoreLayout == VK_IMAGE_LAYOUT_UNDEFINED)
+        restoreLayout = att.finalLayout;
+
+      bool isTarget = (view.image == m_Target && view.range.baseMipLevel == m_Mip);
+      bool isDepth = (ev.depthFormat != VK_FORMAT_UNDEFINED &&
+                      IsDepthStencilFormat(fb.attachments[i].format));
+
+      if(isTarget)
+      {
+        CopyValue(cmd, m_Image, m_Format, att.finalLayout, restoreLayout, m_Mip, m_Slice, offset);
+        targetCopied = true;
+      }
+      else if(isDepth)
+      {
+        CopyValue(cmd, image, fb.attachments[i].format, att.finalLayout, restoreLayout,
+                  view.range.baseMipLevel, view.range.baseArrayLayer, offset);
+      }
+      else if(restoreLayout != att.finalLayout)
+      {
+        VkImageMemoryBarrier barrier = {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            NULL,
+            MakeAccessMask(att.finalLayout),
+            MakeAccessMask(restoreLayout),
+            att.finalLayout,
+            restoreLayout,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            Unwrap(image),
+            view.range,
+        };
+
+        DoPipelineBarrier(cmd, 1, &barrier);
+      }
+    }
+
+    // a storage image written by the draw isn't an attachment, it's in whatever layout it was
+    // last transitioned to
+    if(!targetCopied)
+    {
+      VkImageAspectFlags aspect = IsDepthStencilFormat(m_Format)
+                                      ? VkImageAspectFlags(VK_IMAGE_ASPECT_DEPTH_BIT |
+                                                           VK_IMAGE_ASPECT_STENCIL_BIT)
+                                      : VkImageAspectFlags(VK_IMAGE_ASPECT_COLOR_BIT);
+      VkImageLayout layout = m_pDriver->GetImageLayout(cmd, m_Target, aspect, m_Mip, m_Slice);
+      CopyValue(cmd, m_Image, m_Format, layout, layout, m_Mip, m_Slice, offset);
+    }
+
+    state.BeginRenderPassAndApplyState(cmd);
+  }
+
+  WrappedVulkan *m_pDriver;
+  VulkanDebugManager *m_pDebug;
+  VulkanCreationInfo &m_CreationInfo;
+
+  ResourceId m_Target;
+  VkImage m_Image;
+  VkFormat m_Format;
+  bool m_3D, m_Multisampled;
+  uint32_t m_X, m_Y, m_Slice, m_Mip;
+
+  VkSampleMask m_SampleMask;
+  bool m_Precise, m_DepthClamp;
+
+  vector<PixelHistoryEvent> &m_Events;
+  map<uint32_t, size_t> m_EventIndex;
+
+  VkQueryPool m_QueryPool;
+  VkBuffer m_Readback;
+
+  PixelHistoryPass m_Pass;
+  PixelHistoryEvent *m_ActiveEvent;
+  PixelHistoryEvent *m_StorageEvent;
+  VulkanRenderState m_PrevState;
+
+  // modified pipelines, per pass
+  map<ResourceId, VkPipeline> m_Pipelines[ePixelHistory_Count];
+};
+
+static float DecodeDepth(VkFormat fmt, uint32_t data)
+{
+  switch(fmt)
+  {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_D16_UNORM_S8_UINT: return float(data & 0xffff) / 65535.0f;
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D24_UNORM_S8_UINT: return float(data & 0xffffff) / 16777215.0f;
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+    {
+      float f = 0.0f;
+      memcpy(&f, &data, sizeof(f));
+      return f;
+    }
+    default: break;
+  }
+
+  return -1.0f;
+}
+
+static void DecodeColour(const ResourceFormat &fmt, const PixelHistoryValue &val, PixelValue &col)
+{
+  byte colour[sizeof(val.colour)];
+  memcpy(colour, val.colour, sizeof(colour));
+
+  if(fmt.special)
+  {
+    uint32_t packed = 0;
+    memcpy(&packed, colour, sizeof(packed));
+
+    Vec4f v;
+    if(fmt.specialFormat == eSpecial_R10G10B10A2)
+    {
+      v = ConvertFromR10G10B10A2(packed);
+    }
+    else if(fmt.specialFormat == eSpecial_R11G11B10)
+    {
+      Vec3f v3 = ConvertFromR11G11B10(packed);
+      v = Vec4f(v3.x, v3.y, v3.z);
+    }
+    else
+    {
+      RDCWARN("need to fetch pixel values from special formats");
+      return;
+    }
+
+    memcpy(&col.value_f[0], &v, sizeof(float) * 4);
+    return;
+  }
+
+  for(uint32_t c = 0; c < fmt.compCount && c < 4; c++)
+  {
+    byte *data = colour + fmt.compByteWidth * c;
+
+    if(fmt.compType == eCompType_UInt)
+    {
+      memcpy(&col.value_u[c], data, fmt.compByteWidth);
+    }
+    else if(fmt.compType == eCompType_SInt)
+    {
+      // need to get correct sign, but otherwise just copy
+      if(fmt.compByteWidth == 1)
+        col.value_i[c] = *(int8_t *)data;
+      else if(fmt.compByteWidth == 2)
+        col.value_i[c] = *(int16_t *)data;
+      else if(fmt.compByteWidth == 4)
+        col.value_i[c] = *(int32_t *)data;
+    }
+    else
+    {
+      col.value_f[c] = ConvertComponent(fmt, data);
+    }
+  }
+
+  if(fmt.bgraOrder)
+    std::swap(col.value_u[0], col.value_u[2]);
+}
+
+static void DecodeValue(const ResourceFormat &fmt, VkFormat targetFormat, VkFormat depthFormat,
+                        const PixelHistoryValue &val, ModificationValue &mod)
+{
+  if(IsDepthStencilFormat(targetFormat))
+    depthFormat = targetFormat;
+  else
+    DecodeColour(fmt, val, mod.col);
+
+  // -1 marks depth and stencil that aren't bound
+  mod.depth = -1.0f;
+  mod.stencil = -1;
+
+  if(depthFormat == VK_FORMAT_UNDEFINED)
+    return;
+
+  if(!IsStencilOnlyFormat(depthFormat))
+    mod.depth = DecodeDepth(depthFormat, val.depth);
+
+  if(IsStencilFormat(depthFormat))
+    mod.stencil = int32_t(val.stencil & 0xff);
+}
+
+vector<PixelModification> VulkanReplay::PixelHistory(vector<EventUsage> events, ResourceId target,
+                                                     uint32_t x, uint32_t y, uint32_t slice,
+                                                     uint32_t mip, uint32_t sampleIdx)
+{
+  vector<PixelModification> history;
+
+  if(events.empty())
+    return history;
+
+  SCOPED_TIMER("VulkanReplay::PixelHistory");
+
+  RDCDEBUG("Checking Pixel History on %llu (%u, %u) with %u possible events", target, x, y,
+           (uint32_t)events.size());
+
+  VkDevice dev = m_pDriver->GetDev();
+  const VkLayerDispatchTable *vt = ObjDisp(dev);
+
+  const VulkanCreationInfo::Image &iminfo = m_pDriver->m_CreationInfo.m_Image[target];
+
+  if(iminfo.samples != VK_SAMPLE_COUNT_1_BIT)
+    RDCWARN("Can't fetch pixel values from multisampled images, only test results are available");
+
+  // an event can use the target more than once, e.g. as a copy source and destination. Each event
+  // is only looked at once, with everything it does to the target merged together
+  vector<PixelHistoryEvent> evs;
+  map<uint32_t, size_t> evIndex;
+
+  for(size_t i = 0; i < events.size(); i++)
+  {
+    auto it = evIndex.find(events[i].eventID);
+
+    if(it == evIndex.end())
+    {
+      it = evIndex.insert(std::make_pair(events[i].eventID, evs.size())).first;
+      evs.push_back(PixelHistoryEvent());
+      evs.back().eventID = events[i].eventID;
+    }
+
+    ResourceUsage usage = events[i].usage;
+
+    if((usage >= eUsage_VS_RWResource && usage <= eUsage_CS_RWResource) ||
+       usage == eUsage_CopyDst || usage == eUsage_Copy || usage == eUsage_Resolve ||
+       usage == eUsage_ResolveDst || usage == eUsage_GenMips)
+      evs[it->second].uavWrite = true;
+  }
+
+  const uint32_t numQueries = uint32_t(evs.size() * ePixelHistory_Count);
+
+  VkQueryPoolCreateInfo poolCreateInfo = {
+      VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, NULL, 0, VK_QUERY_TYPE_OCCLUSION, numQueries, 0};
+
+  VkQueryPool pool;
+  VkResult vkr = vt->CreateQueryPool(Unwrap(dev), &poolCreateInfo, NULL, &pool);
+  RDCASSERTEQUAL(vkr, VK_SUCCESS);
+
+  VulkanDebugManager::GPUBuffer readback;
+  readback.Create(m_pDriver, dev, evs.size() * sizeof(PixelHistorySlot), 1,
+                  VulkanDebugManager::GPUBuffer::eGPUBufferReadback);
+
+  VkCommandBuffer cmd = m_pDriver->GetNextCmd();
+
+  VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+                                        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+
+  vkr = vt->BeginCommandBuffer(Unwrap(cmd), &beginInfo);
+  RDCASSERTEQUAL(vkr, VK_SUCCESS);
+
+  vt->CmdResetQueryPool(Unwrap(cmd), pool, 0, numQueries);
+  vt->CmdFillBuffer(Unwrap(cmd), Unwrap(readback.buf), 0, VK_WHOLE_SIZE, 0);
+
+  vkr = vt->EndCommandBuffer(Unwrap(cmd));
+  RDCASSERTEQUAL(vkr, VK_SUCCESS);
+
+#if defined(SINGLE_FLUSH_VALIDATE)
+  m_pDriver->SubmitCmds();
+#endif
+
+  {
+    PixelHistoryCallback cb(m_pDriver, m_pDriver->m_CreationInfo, m_pDriver->GetDeviceFeatures(),
+                            target, x, y, slice, mip, sampleIdx, evs, pool, Unwrap(readback.buf));
+
+    // each query result is followed by its availability, so queries that weren't issued in a pass
+    // can be told apart without waiting on them
+    vector<uint64_t> results(evs.size() * 2);
+
+    for(int p = 0; p < ePixelHistory_Count; p++)
+    {
+      PixelHistoryPass pass = (PixelHistoryPass)p;
+
+      // only replay if some draw that passed so far uses the state this pass turns back on
+      bool needed = (pass == ePixelHistory_Coverage);
+      for(size_t i = 0; !needed && i < evs.size(); i++)
+        needed = evs[i].draw && evs[i].needsPass[pass] && evs[i].counts[pass - 1] > 0;
+
+      if(needed)
+      {
+        cb.SetPass(pass);
+
+        m_pDriver->ReplayLog(0, events.back().eventID, eReplay_Full);
+        m_pDriver->FlushQ();
+
+        vkr = vt->GetQueryPoolResults(
+            Unwrap(dev), pool, uint32_t(pass * evs.size()), (uint32_t)evs.size(),
+            sizeof(uint64_t) * results.size(), &results[0], sizeof(uint64_t) * 2,
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        RDCASSERT(vkr == VK_SUCCESS || vkr == VK_NOT_READY);
+      }
+
+      for(size_t i = 0; i < evs.size(); i++)
+      {
+        if(needed && results[i * 2 + 1] != 0)
+          evs[i].counts[pass] = results[i * 2 + 0];
+        else if(pass > ePixelHistory_Coverage)
+          evs[i].counts[pass] = evs[i].counts[pass - 1];
+      }
+    }
+  }
+
+  vt->DestroyQueryPool(Unwrap(dev), pool, NULL);
+
+  byte *data = NULL;
+  vkr = vt->MapMemory(Unwrap(dev), Unwrap(readback.mem), 0, VK_WHOLE_SIZE, 0, (void **)&data);
+  RDCASSERTEQUAL(vkr, VK_SUCCESS);
+
+  // readback memory might not be coherent
+  VkMappedMemoryRange range = {
+      VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, NULL, Unwrap(readback.mem), 0, VK_WHOLE_SIZE,
+  };
+
+  vkr = vt->InvalidateMappedMemoryRanges(Unwrap(dev), 1, &range);
+  RDCASSERTEQUAL(vkr, VK_SUCCESS);
+
+  const PixelHistorySlot *slots = (const PixelHistorySlot *)data;
+
+  ResourceFormat fmt = MakeResourceFormat(iminfo.format);
+
+  for(size_t i = 0; i < evs.size(); i++)
+  {
+    const PixelHistoryEvent &ev = evs[i];
+
+    // draws that didn't touch this pixel (or didn't have this subresource bound) aren't reported
+    if(ev.draw && !ev.storageWrite && (!ev.bound || ev.counts[ePixelHistory_Coverage] == 0))
+      continue;
+
+    // events that weren't reached on replay at all
+    if(!ev.draw && !ev.bound)
+      continue;
+
+    PixelModification mod;
+    RDCEraseEl(mod);
+
+    mod.eventID = ev.eventID;
+    mod.uavWrite = ev.uavWrite;
+
+    // storage writes aren't queried, so there are no test results
+    if(ev.draw && !ev.storageWrite)
+    {
+      const uint64_t *counts = ev.counts;
+
+      mod.scissorClipped = ev.scissorClipped;
+      mod.backfaceCulled = (counts[ePixelHistory_Culling] == 0);
+      mod.depthClipped = !mod.backfaceCulled && counts[ePixelHistory_DepthClip] == 0;
+      mod.stencilTestFailed =
+          counts[ePixelHistory_DepthClip] > 0 && counts[ePixelHistory_StencilTest] == 0;
+      mod.depthTestFailed =
+          counts[ePixelHistory_StencilTest] > 0 && counts[ePixelHistory_DepthTest] == 0;
+      mod.shaderDiscarded =
+          counts[ePixelHistory_DepthTest] > 0 && counts[ePixelHistory_Shader] == 0;
+    }
+
+    if(ev.valuesFetched)
+    {
+      DecodeValue(fmt, iminfo.format, ev.depthFormat, slots[i].preMod, mod.preMod);
+      DecodeValue(fmt, iminfo.format, ev.depthFormat, slots[i].postMod, mod.postMod);
+    }
+    else
+    {
+      // -2 marks values that couldn't be fetched
+      mod.preMod.depth = mod.postMod.depth = -2.0f;
+      mod.preMod.stencil = mod.postMod.stencil = -2;
+    }
+
+    // individual fragment outputs aren't captured, so the shader output is the value the event
+    // left behind. This is exact for a single unblended fragment.
+    mod.shaderOut = mod.postMod;
+
+    history.push_back(mod);
+  }
+
+  vt->UnmapMemory(Unwrap(dev), Unwrap(readback.mem));
+
+  readback.Destroy();
+
+  return history;
+}
@@ -896,12 +896,24 @@ ShaderReflection *VulkanReplay::GetShader(ResourceId shader, string entryPoint)
     return NULL;
   }
 
-  // disassemble lazily on demand
-  if(shad->second.m_Reflections[entryPoint].refl.Disassembly.count == 0)
-    shad->second.m_Reflections[entryPoint].refl.Disassembly =
-        shad->second.spirv.Disassemble(entryPoint);
+  ShaderReflection &refl = shad->second.m_Reflections[entryPoint].refl;
 
-  return &shad->second.m_Reflections[entryPoint].refl;
+  // disassemble lazily on demand, reusing an earlier session's disassembly where we can
+  if(refl.Disassembly.count == 0)
+  {
+    uint64_t hash = HashSPIRV(shad->second.spirv.spirv, entryPoint);
+
+    string disasm;
+    if(!FindCachedSPIRVDisassembly(hash, disasm))
+    {
+      disasm = shad->second.spirv.Disassemble(entryPoint);
+      CacheSPIRVDisassembly(hash, disasm);
+    }
+
+    refl.Disassembly = disasm;
+  }
+
+  return &refl;
 }
 
 void VulkanReplay::PickPixel(ResourceId texture, uint32_t x, uint32_t y, uint32_t sliceFace,
@@ -3104,545 +3116,759 @@ void VulkanReplay::FileChanged()
 {
 }
 
-void VulkanReplay::SavePipelineState()
+template <typename T>
+static bool EqualPOD(const vector<T> &a, const vector<T> &b)
 {
-  {
-    const VulkanRenderState &state = m_pDriver->m_RenderState;
-    VulkanCreationInfo &c = m_pDriver->m_CreationInfo;
+  return a.size() == b.size() && (a.empty() || memcmp(&a[0], &b[0], sizeof(T) * a.size()) == 0);
+}
 
-    VulkanResourceManager *rm = m_pDriver->GetResourceManager();
+static bool EqualDescSets(const vector<VulkanRenderState::Pipeline::DescriptorAndOffsets> &a,
+                          const vector<VulkanRenderState::Pipeline::DescriptorAndOffsets> &b)
+{
+  if(a.size() != b.size())
+    return false;
 
-    m_VulkanPipelineState = VulkanPipelineState();
+  for(size_t i = 0; i < a.size(); i++)
+    if(a[i].descSet != b[i].descSet || a[i].offsets != b[i].offsets)
+      return false;
 
-    // General pipeline properties
-    m_VulkanPipelineState.compute.obj = rm->GetOriginalID(state.compute.pipeline);
-    m_VulkanPipelineState.graphics.obj = rm->GetOriginalID(state.graphics.pipeline);
+  return true;
+}
 
-    if(state.compute.pipeline != ResourceId())
-    {
-      const VulkanCreationInfo::Pipeline &p = c.m_Pipeline[state.compute.pipeline];
+static bool EqualSlot(const DescriptorSetSlot &a, const DescriptorSetSlot &b)
+{
+  return a.bufferInfo.buffer == b.bufferInfo.buffer && a.bufferInfo.offset == b.bufferInfo.offset &&
+         a.bufferInfo.range == b.bufferInfo.range && a.imageInfo.sampler == b.imageInfo.sampler &&
+         a.imageInfo.imageView == b.imageInfo.imageView &&
+         a.imageInfo.imageLayout == b.imageInfo.imageLayout &&
+         a.texelBufferView == b.texelBufferView;
+}
 
-      m_VulkanPipelineState.compute.flags = p.flags;
+bool VulkanReplay::UpdateDescriptorSource(PipelineStateSource &src)
+{
+  const VulkanRenderState &state = m_pDriver->m_RenderState;
+  VulkanCreationInfo &c = m_pDriver->m_CreationInfo;
 
-      VulkanPipelineState::ShaderStage &stage = m_VulkanPipelineState.CS;
+  const vector<VulkanRenderState::Pipeline::DescriptorAndOffsets> *sets[] = {
+      &state.graphics.descSets, &state.compute.descSets,
+  };
 
-      int i = 5;    // 5 is the CS idx (VS, TCS, TES, GS, FS, CS)
-      {
-        stage.Shader = rm->GetOriginalID(p.shaders[i].module);
-        stage.entryPoint = p.shaders[i].entryPoint;
-        stage.ShaderDetails = NULL;
+  size_t idx = 0;
+  bool changed = false;
+
+  for(size_t p = 0; p < ARRAY_COUNT(sets); p++)
+  {
+    for(size_t i = 0; i < sets[p]->size(); i++)
+    {
+      const WrappedVulkan::DescriptorSetInfo &info =
+          m_pDriver->m_DescriptorSetState[(*sets[p])[i].descSet];
+      const DescSetLayout &layout = c.m_DescSetLayout[info.layout];
 
-        stage.customName = true;
-        stage.ShaderName = m_pDriver->m_CreationInfo.m_Names[p.shaders[i].module];
-        if(stage.ShaderName.count == 0)
+      for(size_t b = 0; b < info.currentBindings.size() && b < layout.bindings.size(); b++)
+      {
+        for(uint32_t a = 0; a < layout.bindings[b].descriptorCount; a++, idx++)
         {
-          stage.customName = false;
-          stage.ShaderName = StringFormat::Fmt("Shader %llu", stage.Shader);
-        }
+          const DescriptorSetSlot &slot = info.currentBindings[b][a];
 
-        stage.stage = eShaderStage_Compute;
-        if(p.shaders[i].mapping)
-          stage.BindpointMapping = *p.shaders[i].mapping;
+          if(!changed && idx < src.descriptors.size() && EqualSlot(slot, src.descriptors[idx]))
+            continue;
 
-        create_array_uninit(stage.specialization, p.shaders[i].specialization.size());
-        for(size_t s = 0; s < p.shaders[i].specialization.size(); s++)
-        {
-          stage.specialization[s].specID = p.shaders[i].specialization[s].specID;
-          create_array_init(stage.specialization[s].data, p.shaders[i].specialization[s].size,
-                            p.shaders[i].specialization[s].data);
+          // from the first difference on, the rest of the contents are stored fresh
+          if(!changed)
+            src.descriptors.resize(idx);
+          changed = true;
+
+          src.descriptors.push_back(slot);
         }
       }
     }
+  }
 
-    if(state.graphics.pipeline != ResourceId())
-    {
-      const VulkanCreationInfo::Pipeline &p = c.m_Pipeline[state.graphics.pipeline];
+  if(idx != src.descriptors.size())
+  {
+    src.descriptors.resize(idx);
+    changed = true;
+  }
 
-      m_VulkanPipelineState.graphics.flags = p.flags;
+  return changed;
+}
 
-      // Input Assembly
-      m_VulkanPipelineState.IA.ibuffer.buf = rm->GetOriginalID(state.ibuffer.buf);
-      m_VulkanPipelineState.IA.ibuffer.offs = state.ibuffer.offs;
-      m_VulkanPipelineState.IA.primitiveRestartEnable = p.primitiveRestartEnable;
+bool VulkanReplay::UpdateImageLayoutSource(PipelineStateSource &src)
+{
+  const map<ResourceId, ImageLayouts> &layouts = m_pDriver->m_ImageLayouts;
 
-      // Vertex Input
-      create_array_uninit(m_VulkanPipelineState.VI.attrs, p.vertexAttrs.size());
-      for(size_t i = 0; i < p.vertexAttrs.size(); i++)
-      {
-        m_VulkanPipelineState.VI.attrs[i].location = p.vertexAttrs[i].location;
-        m_VulkanPipelineState.VI.attrs[i].binding = p.vertexAttrs[i].binding;
-        m_VulkanPipelineState.VI.attrs[i].byteoffset = p.vertexAttrs[i].byteoffset;
-        m_VulkanPipelineState.VI.attrs[i].format = MakeResourceFormat(p.vertexAttrs[i].format);
-      }
+  bool changed = (layouts.size() != src.images.size());
 
-      create_array_uninit(m_VulkanPipelineState.VI.binds, p.vertexBindings.size());
-      for(size_t i = 0; i < p.vertexBindings.size(); i++)
-      {
-        m_VulkanPipelineState.VI.binds[i].bytestride = p.vertexBindings[i].bytestride;
-        m_VulkanPipelineState.VI.binds[i].vbufferBinding = p.vertexBindings[i].vbufferBinding;
-        m_VulkanPipelineState.VI.binds[i].perInstance = p.vertexBindings[i].perInstance;
-      }
+  size_t img = 0, st = 0;
+  for(auto it = layouts.begin(); !changed && it != layouts.end(); ++it, img++)
+  {
+    const vector<ImageRegionState> &states = it->second.subresourceStates;
 
-      create_array_uninit(m_VulkanPipelineState.VI.vbuffers, state.vbuffers.size());
-      for(size_t i = 0; i < state.vbuffers.size(); i++)
+    if(src.images[img].first != it->first || src.images[img].second != states.size() ||
+       st + states.size() > src.imageStates.size())
+    {
+      changed = true;
+      break;
+    }
+
+    // only the current layout of each range is displayed, so that's all that's compared
+    for(size_t i = 0; i < states.size(); i++, st++)
+    {
+      if(states[i].newLayout != src.imageStates[st].newLayout ||
+         memcmp(&states[i].subresourceRange, &src.imageStates[st].subresourceRange,
+                sizeof(VkImageSubresourceRange)))
       {
-        m_VulkanPipelineState.VI.vbuffers[i].buffer = rm->GetOriginalID(state.vbuffers[i].buf);
-        m_VulkanPipelineState.VI.vbuffers[i].offset = state.vbuffers[i].offs;
+        changed = true;
+        break;
       }
+    }
+  }
 
-      // Shader Stages
-      VulkanPipelineState::ShaderStage *stages[] = {
-          &m_VulkanPipelineState.VS, &m_VulkanPipelineState.TCS, &m_VulkanPipelineState.TES,
-          &m_VulkanPipelineState.GS, &m_VulkanPipelineState.FS,
-      };
+  if(!changed)
+    return false;
 
-      for(size_t i = 0; i < ARRAY_COUNT(stages); i++)
-      {
-        stages[i]->Shader = rm->GetOriginalID(p.shaders[i].module);
-        stages[i]->entryPoint = p.shaders[i].entryPoint;
-        stages[i]->ShaderDetails = NULL;
+  src.images.clear();
+  src.imageStates.clear();
 
-        stages[i]->customName = true;
-        stages[i]->ShaderName = m_pDriver->m_CreationInfo.m_Names[p.shaders[i].module];
-        if(stages[i]->ShaderName.count == 0)
-        {
-          stages[i]->customName = false;
-          stages[i]->ShaderName = StringFormat::Fmt("Shader %llu", stages[i]->Shader);
-        }
+  for(auto it = layouts.begin(); it != layouts.end(); ++it)
+  {
+    const vector<ImageRegionState> &states = it->second.subresourceStates;
 
-        stages[i]->stage = ShaderStageType(eShaderStage_Vertex + i);
-        if(p.shaders[i].mapping)
-          stages[i]->BindpointMapping = *p.shaders[i].mapping;
+    src.images.push_back(std::make_pair(it->first, states.size()));
+    src.imageStates.insert(src.imageStates.end(), states.begin(), states.end());
+  }
 
-        create_array_uninit(stages[i]->specialization, p.shaders[i].specialization.size());
-        for(size_t s = 0; s < p.shaders[i].specialization.size(); s++)
-        {
-          stages[i]->specialization[s].specID = p.shaders[i].specialization[s].specID;
-          create_array_init(stages[i]->specialization[s].data, p.shaders[i].specialization[s].size,
-                            p.shaders[i].specialization[s].data);
-        }
-      }
+  return true;
+}
 
-      // Tessellation
-      m_VulkanPipelineState.Tess.numControlPoints = p.patchControlPoints;
+uint32_t VulkanReplay::SavePipelineState()
+{
+  RDCPROFILE_SCOPE("VulkanReplay::SavePipelineState");
+
+  const VulkanRenderState &state = m_pDriver->m_RenderState;
+
+  PipelineStateSource &src = m_PipelineStateSource;
+
+  uint32_t changes = src.valid ? ePipeChange_None : ePipeChange_All;
+
+  if(state.compute.pipeline != src.renderState.compute.pipeline)
+    changes |= ePipeChange_Compute;
+
+  if(state.graphics.pipeline != src.renderState.graphics.pipeline)
+    changes |= ePipeChange_Graphics | ePipeChange_DynamicState | ePipeChange_Pass;
+
+  if(!EqualPOD(state.views, src.renderState.views) ||
+     !EqualPOD(state.scissors, src.renderState.scissors) ||
+     !EqualPOD(state.vbuffers, src.renderState.vbuffers) ||
+     state.ibuffer.buf != src.renderState.ibuffer.buf ||
+     state.ibuffer.offs != src.renderState.ibuffer.offs ||
+     state.lineWidth != src.renderState.lineWidth ||
+     memcmp(&state.bias, &src.renderState.bias, sizeof(state.bias)) ||
+     memcmp(state.blendConst, src.renderState.blendConst, sizeof(state.blendConst)) ||
+     state.mindepth != src.renderState.mindepth || state.maxdepth != src.renderState.maxdepth ||
+     memcmp(&state.front, &src.renderState.front, sizeof(state.front)) ||
+     memcmp(&state.back, &src.renderState.back, sizeof(state.back)))
+    changes |= ePipeChange_DynamicState;
+
+  if(state.renderPass != src.renderState.renderPass ||
+     state.subpass != src.renderState.subpass ||
+     state.framebuffer != src.renderState.framebuffer ||
+     memcmp(&state.renderArea, &src.renderState.renderArea, sizeof(state.renderArea)))
+    changes |= ePipeChange_Pass;
+
+  // descriptor sets can be updated between events without the bindings changing, so the contents
+  // are compared as well as which sets are bound
+  if(!EqualDescSets(state.graphics.descSets, src.renderState.graphics.descSets) ||
+     !EqualDescSets(state.compute.descSets, src.renderState.compute.descSets))
+    changes |= ePipeChange_Descriptors;
+
+  if(UpdateDescriptorSource(src))
+    changes |= ePipeChange_Descriptors;
+
+  if(UpdateImageLayoutSource(src))
+    changes |= ePipeChange_ImageLayouts;
+
+  if(changes & ePipeChange_Compute)
+    SaveComputeState();
+  if(changes & ePipeChange_Graphics)
+    SaveGraphicsState();
+  if(changes & ePipeChange_DynamicState)
+    SaveDynamicState();
+  if(changes & ePipeChange_Pass)
+    SavePassState();
+  if(changes & ePipeChange_Descriptors)
+    SaveDescriptorState();
+  if(changes & ePipeChange_ImageLayouts)
+    SaveImageLayoutState();
+
+  src.renderState = state;
+  src.valid = true;
+
+  return changes;
+}
 
-      // Viewport/Scissors
-      size_t numViewScissors = p.viewportCount;
-      create_array_uninit(m_VulkanPipelineState.VP.viewportScissors, numViewScissors);
-      for(size_t i = 0; i < numViewScissors; i++)
-      {
-        if(i < state.views.size())
-        {
-          m_VulkanPipelineState.VP.viewportScissors[i].vp.x = state.views[i].x;
-          m_VulkanPipelineState.VP.viewportScissors[i].vp.y = state.views[i].y;
-          m_VulkanPipelineState.VP.viewportScissors[i].vp.width = state.views[i].width;
-          m_VulkanPipelineState.VP.viewportScissors[i].vp.height = state.views[i].height;
-          m_VulkanPipelineState.VP.viewportScissors[i].vp.minDepth = state.views[i].minDepth;
-          m_VulkanPipelineState.VP.viewportScissors[i].vp.maxDepth = state.views[i].maxDepth;
-        }
-        else
-        {
-          RDCEraseEl(m_VulkanPipelineState.VP.viewportScissors[i].vp);
-        }
+void VulkanReplay::SaveComputeState()
+{
+  const VulkanRenderState &state = m_pDriver->m_RenderState;
+  VulkanCreationInfo &c = m_pDriver->m_CreationInfo;
 
-        if(i < state.scissors.size())
-        {
-          m_VulkanPipelineState.VP.viewportScissors[i].scissor.x = state.scissors[i].offset.x;
-          m_VulkanPipelineState.VP.viewportScissors[i].scissor.y = state.scissors[i].offset.y;
-          m_VulkanPipelineState.VP.viewportScissors[i].scissor.width = state.scissors[i].extent.width;
-          m_VulkanPipelineState.VP.viewportScissors[i].scissor.height =
-              state.scissors[i].extent.height;
-        }
-        else
-        {
-          RDCEraseEl(m_VulkanPipelineState.VP.viewportScissors[i].scissor);
-        }
-      }
+  VulkanResourceManager *rm = m_pDriver->GetResourceManager();
 
-      // Rasterizer
-      m_VulkanPipelineState.RS.depthClampEnable = p.depthClampEnable;
-      m_VulkanPipelineState.RS.rasterizerDiscardEnable = p.rasterizerDiscardEnable;
-      m_VulkanPipelineState.RS.FrontCCW = p.frontFace == VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  m_VulkanPipelineState.compute.obj = rm->GetOriginalID(state.compute.pipeline);
+  m_VulkanPipelineState.compute.flags = 0;
+  m_VulkanPipelineState.CS = VulkanPipelineState::ShaderStage();
 
-      switch(p.polygonMode)
-      {
-        case VK_POLYGON_MODE_POINT: m_VulkanPipelineState.RS.FillMode = eFill_Point; break;
-        case VK_POLYGON_MODE_LINE: m_VulkanPipelineState.RS.FillMode = eFill_Wireframe; break;
-        case VK_POLYGON_MODE_FILL: m_VulkanPipelineState.RS.FillMode = eFill_Solid; break;
-        default:
-          m_VulkanPipelineState.RS.FillMode = eFill_Solid;
-          RDCERR("Unexpected value for FillMode %x", p.polygonMode);
-          break;
-      }
+  if(state.compute.pipeline == ResourceId())
+    return;
 
-      switch(p.cullMode)
-      {
-        case VK_CULL_MODE_NONE: m_VulkanPipelineState.RS.CullMode = eCull_None; break;
-        case VK_CULL_MODE_FRONT_BIT: m_VulkanPipelineState.RS.CullMode = eCull_Front; break;
-        case VK_CULL_MODE_BACK_BIT: m_VulkanPipelineState.RS.CullMode = eCull_Back; break;
-        case VK_CULL_MODE_FRONT_AND_BACK:
-          m_VulkanPipelineState.RS.CullMode = eCull_FrontAndBack;
-          break;
-        default:
-          m_VulkanPipelineState.RS.CullMode = eCull_None;
-          RDCERR("Unexpected value for CullMode %x", p.cullMode);
-          break;
-      }
+  const VulkanCreationInfo::Pipeline &p = c.m_Pipeline[state.compute.pipeline];
 
-      m_VulkanPipelineState.RS.depthBias = state.bias.depth;
-      m_VulkanPipelineState.RS.depthBiasClamp = state.bias.biasclamp;
-      m_VulkanPipelineState.RS.slopeScaledDepthBias = state.bias.slope;
-      m_VulkanPipelineState.RS.lineWidth = state.lineWidth;
-
-      // MSAA
-      m_VulkanPipelineState.MSAA.rasterSamples = p.rasterizationSamples;
-      m_VulkanPipelineState.MSAA.sampleShadingEnable = p.sampleShadingEnable;
-      m_VulkanPipelineState.MSAA.minSampleShading = p.minSampleShading;
-      m_VulkanPipelineState.MSAA.sampleMask = p.sampleMask;
-
-      // Color Blend
-      m_VulkanPipelineState.CB.logicOpEnable = p.logicOpEnable;
-      m_VulkanPipelineState.CB.alphaToCoverageEnable = p.alphaToCoverageEnable;
-      m_VulkanPipelineState.CB.alphaToOneEnable = p.alphaToOneEnable;
-      m_VulkanPipelineState.CB.logicOp = ToStr::Get(p.logicOp);
-
-      create_array_uninit(m_VulkanPipelineState.CB.attachments, p.attachments.size());
-      for(size_t i = 0; i < p.attachments.size(); i++)
-      {
-        m_VulkanPipelineState.CB.attachments[i].blendEnable = p.attachments[i].blendEnable;
-
-        m_VulkanPipelineState.CB.attachments[i].blend.Source =
-            ToStr::Get(p.attachments[i].blend.Source);
-        m_VulkanPipelineState.CB.attachments[i].blend.Destination =
-            ToStr::Get(p.attachments[i].blend.Destination);
-        m_VulkanPipelineState.CB.attachments[i].blend.Operation =
-            ToStr::Get(p.attachments[i].blend.Operation);
-
-        m_VulkanPipelineState.CB.attachments[i].alphaBlend.Source =
-            ToStr::Get(p.attachments[i].alphaBlend.Source);
-        m_VulkanPipelineState.CB.attachments[i].alphaBlend.Destination =
-            ToStr::Get(p.attachments[i].alphaBlend.Destination);
-        m_VulkanPipelineState.CB.attachments[i].alphaBlend.Operation =
-            ToStr::Get(p.attachments[i].alphaBlend.Operation);
-
-        m_VulkanPipelineState.CB.attachments[i].writeMask = p.attachments[i].channelWriteMask;
-      }
+  m_VulkanPipelineState.compute.flags = p.flags;
 
-      memcpy(m_VulkanPipelineState.CB.blendConst, state.blendConst, sizeof(float) * 4);
+  VulkanPipelineState::ShaderStage &stage = m_VulkanPipelineState.CS;
 
-      // Depth Stencil
-      m_VulkanPipelineState.DS.depthTestEnable = p.depthTestEnable;
-      m_VulkanPipelineState.DS.depthWriteEnable = p.depthWriteEnable;
-      m_VulkanPipelineState.DS.depthBoundsEnable = p.depthBoundsEnable;
-      m_VulkanPipelineState.DS.depthCompareOp = ToStr::Get(p.depthCompareOp);
-      m_VulkanPipelineState.DS.stencilTestEnable = p.stencilTestEnable;
+  int i = 5;    // 5 is the CS idx (VS, TCS, TES, GS, FS, CS)
+  {
+    stage.Shader = rm->GetOriginalID(p.shaders[i].module);
+    stage.entryPoint = p.shaders[i].entryPoint;
+    stage.ShaderDetails = NULL;
 
-      m_VulkanPipelineState.DS.front.passOp = ToStr::Get(p.front.passOp);
-      m_VulkanPipelineState.DS.front.failOp = ToStr::Get(p.front.failOp);
-      m_VulkanPipelineState.DS.front.depthFailOp = ToStr::Get(p.front.depthFailOp);
-      m_VulkanPipelineState.DS.front.func = ToStr::Get(p.front.compareOp);
+    stage.customName = true;
+    stage.ShaderName = m_pDriver->m_CreationInfo.m_Names[p.shaders[i].module];
+    if(stage.ShaderName.count == 0)
+    {
+      stage.customName = false;
+      stage.ShaderName = StringFormat::Fmt("Shader %llu", stage.Shader);
+    }
 
-      m_VulkanPipelineState.DS.back.passOp = ToStr::Get(p.back.passOp);
-      m_VulkanPipelineState.DS.back.failOp = ToStr::Get(p.back.failOp);
-      m_VulkanPipelineState.DS.back.depthFailOp = ToStr::Get(p.back.depthFailOp);
-      m_VulkanPipelineState.DS.back.func = ToStr::Get(p.back.compareOp);
+    stage.stage = eShaderStage_Compute;
+    if(p.shaders[i].mapping)
+      stage.BindpointMapping = *p.shaders[i].mapping;
 
-      m_VulkanPipelineState.DS.minDepthBounds = state.mindepth;
-      m_VulkanPipelineState.DS.maxDepthBounds = state.maxdepth;
+    create_array_uninit(stage.specialization, p.shaders[i].specialization.size());
+    for(size_t s = 0; s < p.shaders[i].specialization.size(); s++)
+    {
+      stage.specialization[s].specID = p.shaders[i].specialization[s].specID;
+      create_array_init(stage.specialization[s].data, p.shaders[i].specialization[s].size,
+                        p.shaders[i].specialization[s].data);
+    }
+  }
+}
 
-      m_VulkanPipelineState.DS.front.ref = state.front.ref;
-      m_VulkanPipelineState.DS.front.compareMask = state.front.compare;
-      m_VulkanPipelineState.DS.front.writeMask = state.front.write;
+void VulkanReplay::SaveGraphicsState()
+{
+  const VulkanRenderState &state = m_pDriver->m_RenderState;
+  VulkanCreationInfo &c = m_pDriver->m_CreationInfo;
+
+  VulkanResourceManager *rm = m_pDriver->GetResourceManager();
+
+  m_VulkanPipelineState.graphics.obj = rm->GetOriginalID(state.graphics.pipeline);
+  m_VulkanPipelineState.graphics.flags = 0;
+
+  m_VulkanPipelineState.IA = VulkanPipelineState::InputAssembly();
+  m_VulkanPipelineState.VI = VulkanPipelineState::VertexInput();
+  m_VulkanPipelineState.VS = m_VulkanPipelineState.TCS = m_VulkanPipelineState.TES =
+      m_VulkanPipelineState.GS = m_VulkanPipelineState.FS = VulkanPipelineState::ShaderStage();
+  m_VulkanPipelineState.Tess = VulkanPipelineState::Tessellation();
+  m_VulkanPipelineState.VP = VulkanPipelineState::ViewState();
+  m_VulkanPipelineState.RS = VulkanPipelineState::Raster();
+  m_VulkanPipelineState.MSAA = VulkanPipelineState::MultiSample();
+  m_VulkanPipelineState.CB = VulkanPipelineState::ColorBlend();
+  m_VulkanPipelineState.DS = VulkanPipelineState::DepthStencil();
+
+  if(state.graphics.pipeline == ResourceId())
+    return;
 
-      m_VulkanPipelineState.DS.back.ref = state.back.ref;
-      m_VulkanPipelineState.DS.back.compareMask = state.back.compare;
-      m_VulkanPipelineState.DS.back.writeMask = state.back.write;
+  const VulkanCreationInfo::Pipeline &p = c.m_Pipeline[state.graphics.pipeline];
 
-      // Renderpass
-      m_VulkanPipelineState.Pass.renderpass.obj = rm->GetOriginalID(state.renderPass);
-      if(state.renderPass != ResourceId())
-      {
-        m_VulkanPipelineState.Pass.renderpass.inputAttachments =
-            c.m_RenderPass[state.renderPass].subpasses[state.subpass].inputAttachments;
-        m_VulkanPipelineState.Pass.renderpass.colorAttachments =
-            c.m_RenderPass[state.renderPass].subpasses[state.subpass].colorAttachments;
-        m_VulkanPipelineState.Pass.renderpass.depthstencilAttachment =
-            c.m_RenderPass[state.renderPass].subpasses[state.subpass].depthstencilAttachment;
-      }
+  m_VulkanPipelineState.graphics.flags = p.flags;
 
-      m_VulkanPipelineState.Pass.framebuffer.obj = rm->GetOriginalID(state.framebuffer);
+  // Input Assembly
+  m_VulkanPipelineState.IA.primitiveRestartEnable = p.primitiveRestartEnable;
 
-      if(state.framebuffer != ResourceId())
-      {
-        m_VulkanPipelineState.Pass.framebuffer.width = c.m_Framebuffer[state.framebuffer].width;
-        m_VulkanPipelineState.Pass.framebuffer.height = c.m_Framebuffer[state.framebuffer].height;
-        m_VulkanPipelineState.Pass.framebuffer.layers = c.m_Framebuffer[state.framebuffer].layers;
+  // Vertex Input
+  create_array_uninit(m_VulkanPipelineState.VI.attrs, p.vertexAttrs.size());
+  for(size_t i = 0; i < p.vertexAttrs.size(); i++)
+  {
+    m_VulkanPipelineState.VI.attrs[i].location = p.vertexAttrs[i].location;
+    m_VulkanPipelineState.VI.attrs[i].binding = p.vertexAttrs[i].binding;
+    m_VulkanPipelineState.VI.attrs[i].byteoffset = p.vertexAttrs[i].byteoffset;
+    m_VulkanPipelineState.VI.attrs[i].format = MakeResourceFormat(p.vertexAttrs[i].format);
+  }
 
-        create_array_uninit(m_VulkanPipelineState.Pass.framebuffer.attachments,
-                            c.m_Framebuffer[state.framebuffer].attachments.size());
-        for(size_t i = 0; i < c.m_Framebuffer[state.framebuffer].attachments.size(); i++)
-        {
-          ResourceId viewid = c.m_Framebuffer[state.framebuffer].attachments[i].view;
+  create_array_uninit(m_VulkanPipelineState.VI.binds, p.vertexBindings.size());
+  for(size_t i = 0; i < p.vertexBindings.size(); i++)
+  {
+    m_VulkanPipelineState.VI.binds[i].bytestride = p.vertexBindings[i].bytestride;
+    m_VulkanPipelineState.VI.binds[i].vbufferBinding = p.vertexBindings[i].vbufferBinding;
+    m_VulkanPipelineState.VI.binds[i].perInstance = p.vertexBindings[i].perInstance;
+  }
 
-          if(viewid != ResourceId())
-          {
-            m_VulkanPipelineState.Pass.framebuffer.attachments[i].view = rm->GetOriginalID(viewid);
-            m_VulkanPipelineState.Pass.framebuffer.attachments[i].img =
-                rm->GetOriginalID(c.m_ImageView[viewid].image);
-
-            m_VulkanPipelineState.Pass.framebuffer.attachments[i].viewfmt =
-                MakeResourceFormat(c.m_ImageView[viewid].format);
-            m_VulkanPipelineState.Pass.framebuffer.attachments[i].baseMip =
-                c.m_ImageView[viewid].range.baseMipLevel;
-            m_VulkanPipelineState.Pass.framebuffer.attachments[i].baseLayer =
-                c.m_ImageView[viewid].range.baseArrayLayer;
-            m_VulkanPipelineState.Pass.framebuffer.attachments[i].numMip =
-                c.m_ImageView[viewid].range.levelCount;
-            m_VulkanPipelineState.Pass.framebuffer.attachments[i].numLayer =
-                c.m_ImageView[viewid].range.layerCount;
-
-            memcpy(m_VulkanPipelineState.Pass.framebuffer.attachments[i].swizzle,
-                   c.m_ImageView[viewid].swizzle, sizeof(TextureSwizzle) * 4);
-          }
-          else
-          {
-            m_VulkanPipelineState.Pass.framebuffer.attachments[i].view = ResourceId();
-            m_VulkanPipelineState.Pass.framebuffer.attachments[i].img = ResourceId();
+  // Shader Stages
+  VulkanPipelineState::ShaderStage *stages[] = {
+      &m_VulkanPipelineState.VS, &m_VulkanPipelineState.TCS, &m_VulkanPipelineState.TES,
+      &m_VulkanPipelineState.GS, &m_VulkanPipelineState.FS,
+  };
 
-            m_VulkanPipelineState.Pass.framebuffer.attachments[i].baseMip = 0;
-            m_VulkanPipelineState.Pass.framebuffer.attachments[i].baseLayer = 0;
-            m_VulkanPipelineState.Pass.framebuffer.attachments[i].numMip = 1;
-            m_VulkanPipelineState.Pass.framebuffer.attachments[i].numLayer = 1;
-          }
-        }
-      }
-      else
-      {
-        m_VulkanPipelineState.Pass.framebuffer.width = 0;
-        m_VulkanPipelineState.Pass.framebuffer.height = 0;
-        m_VulkanPipelineState.Pass.framebuffer.layers = 0;
-      }
+  for(size_t i = 0; i < ARRAY_COUNT(stages); i++)
+  {
+    stages[i]->Shader = rm->GetOriginalID(p.shaders[i].module);
+    stages[i]->entryPoint = p.shaders[i].entryPoint;
+    stages[i]->ShaderDetails = NULL;
 
-      m_VulkanPipelineState.Pass.renderArea.x = state.renderArea.offset.x;
-      m_VulkanPipelineState.Pass.renderArea.y = state.renderArea.offset.y;
-      m_VulkanPipelineState.Pass.renderArea.width = state.renderArea.extent.width;
-      m_VulkanPipelineState.Pass.renderArea.height = state.renderArea.extent.height;
+    stages[i]->customName = true;
+    stages[i]->ShaderName = m_pDriver->m_CreationInfo.m_Names[p.shaders[i].module];
+    if(stages[i]->ShaderName.count == 0)
+    {
+      stages[i]->customName = false;
+      stages[i]->ShaderName = StringFormat::Fmt("Shader %llu", stages[i]->Shader);
     }
 
-    // Descriptor sets
-    create_array_uninit(m_VulkanPipelineState.graphics.DescSets, state.graphics.descSets.size());
-    create_array_uninit(m_VulkanPipelineState.compute.DescSets, state.compute.descSets.size());
+    stages[i]->stage = ShaderStageType(eShaderStage_Vertex + i);
+    if(p.shaders[i].mapping)
+      stages[i]->BindpointMapping = *p.shaders[i].mapping;
 
+    create_array_uninit(stages[i]->specialization, p.shaders[i].specialization.size());
+    for(size_t s = 0; s < p.shaders[i].specialization.size(); s++)
     {
-      rdctype::array<VulkanPipelineState::Pipeline::DescriptorSet> *dsts[] = {
-          &m_VulkanPipelineState.graphics.DescSets, &m_VulkanPipelineState.compute.DescSets,
-      };
+      stages[i]->specialization[s].specID = p.shaders[i].specialization[s].specID;
+      create_array_init(stages[i]->specialization[s].data, p.shaders[i].specialization[s].size,
+                        p.shaders[i].specialization[s].data);
+    }
+  }
 
-      const vector<VulkanRenderState::Pipeline::DescriptorAndOffsets> *srcs[] = {
-          &state.graphics.descSets, &state.compute.descSets,
-      };
+  // Tessellation
+  m_VulkanPipelineState.Tess.numControlPoints = p.patchControlPoints;
+
+  // Rasterizer
+  m_VulkanPipelineState.RS.depthClampEnable = p.depthClampEnable;
+  m_VulkanPipelineState.RS.rasterizerDiscardEnable = p.rasterizerDiscardEnable;
+  m_VulkanPipelineState.RS.FrontCCW = p.frontFace == VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+  switch(p.polygonMode)
+  {
+    case VK_POLYGON_MODE_POINT: m_VulkanPipelineState.RS.FillMode = eFill_Point; break;
+    case VK_POLYGON_MODE_LINE: m_VulkanPipelineState.RS.FillMode = eFill_Wireframe; break;
+    case VK_POLYGON_MODE_FILL: m_VulkanPipelineState.RS.FillMode = eFill_Solid; break;
+    default:
+      m_VulkanPipelineState.RS.FillMode = eFill_Solid;
+      RDCERR("Unexpected value for FillMode %x", p.polygonMode);
+      break;
+  }
+
+  switch(p.cullMode)
+  {
+    case VK_CULL_MODE_NONE: m_VulkanPipelineState.RS.CullMode = eCull_None; break;
+    case VK_CULL_MODE_FRONT_BIT: m_VulkanPipelineState.RS.CullMode = eCull_Front; break;
+    case VK_CULL_MODE_BACK_BIT: m_VulkanPipelineState.RS.CullMode = eCull_Back; break;
+    case VK_CULL_MODE_FRONT_AND_BACK:
+      m_VulkanPipelineState.RS.CullMode = eCull_FrontAndBack;
+      break;
+    default:
+      m_VulkanPipelineState.RS.CullMode = eCull_None;
+      RDCERR("Unexpected value for CullMode %x", p.cullMode);
+      break;
+  }
+
+  // MSAA
+  m_VulkanPipelineState.MSAA.rasterSamples = p.rasterizationSamples;
+  m_VulkanPipelineState.MSAA.sampleShadingEnable = p.sampleShadingEnable;
+  m_VulkanPipelineState.MSAA.minSampleShading = p.minSampleShading;
+  m_VulkanPipelineState.MSAA.sampleMask = p.sampleMask;
+
+  // Color Blend
+  m_VulkanPipelineState.CB.logicOpEnable = p.logicOpEnable;
+  m_VulkanPipelineState.CB.alphaToCoverageEnable = p.alphaToCoverageEnable;
+  m_VulkanPipelineState.CB.alphaToOneEnable = p.alphaToOneEnable;
+  m_VulkanPipelineState.CB.logicOp = ToStr::Get(p.logicOp);
+
+  create_array_uninit(m_VulkanPipelineState.CB.attachments, p.attachments.size());
+  for(size_t i = 0; i < p.attachments.size(); i++)
+  {
+    m_VulkanPipelineState.CB.attachments[i].blendEnable = p.attachments[i].blendEnable;
+
+    m_VulkanPipelineState.CB.attachments[i].blend.Source =
+        ToStr::Get(p.attachments[i].blend.Source);
+    m_VulkanPipelineState.CB.attachments[i].blend.Destination =
+        ToStr::Get(p.attachments[i].blend.Destination);
+    m_VulkanPipelineState.CB.attachments[i].blend.Operation =
+        ToStr::Get(p.attachments[i].blend.Operation);
+
+    m_VulkanPipelineState.CB.attachments[i].alphaBlend.Source =
+        ToStr::Get(p.attachments[i].alphaBlend.Source);
+    m_VulkanPipelineState.CB.attachments[i].alphaBlend.Destination =
+        ToStr::Get(p.attachments[i].alphaBlend.Destination);
+    m_VulkanPipelineState.CB.attachments[i].alphaBlend.Operation =
+        ToStr::Get(p.attachments[i].alphaBlend.Operation);
+
+    m_VulkanPipelineState.CB.attachments[i].writeMask = p.attachments[i].channelWriteMask;
+  }
+
+  // Depth Stencil
+  m_VulkanPipelineState.DS.depthTestEnable = p.depthTestEnable;
+  m_VulkanPipelineState.DS.depthWriteEnable = p.depthWriteEnable;
+  m_VulkanPipelineState.DS.depthBoundsEnable = p.depthBoundsEnable;
+  m_VulkanPipelineState.DS.depthCompareOp = ToStr::Get(p.depthCompareOp);
+  m_VulkanPipelineState.DS.stencilTestEnable = p.stencilTestEnable;
+
+  m_VulkanPipelineState.DS.front.passOp = ToStr::Get(p.front.passOp);
+  m_VulkanPipelineState.DS.front.failOp = ToStr::Get(p.front.failOp);
+  m_VulkanPipelineState.DS.front.depthFailOp = ToStr::Get(p.front.depthFailOp);
+  m_VulkanPipelineState.DS.front.func = ToStr::Get(p.front.compareOp);
+
+  m_VulkanPipelineState.DS.back.passOp = ToStr::Get(p.back.passOp);
+  m_VulkanPipelineState.DS.back.failOp = ToStr::Get(p.back.failOp);
+  m_VulkanPipelineState.DS.back.depthFailOp = ToStr::Get(p.back.depthFailOp);
+  m_VulkanPipelineState.DS.back.func = ToStr::Get(p.back.compareOp);
+}
+
+void VulkanReplay::SaveDynamicState()
+{
+  const VulkanRenderState &state = m_pDriver->m_RenderState;
+  VulkanCreationInfo &c = m_pDriver->m_CreationInfo;
+
+  VulkanResourceManager *rm = m_pDriver->GetResourceManager();
+
+  // the graphics state is all default when there's no pipeline bound
+  if(state.graphics.pipeline == ResourceId())
+    return;
+
+  const VulkanCreationInfo::Pipeline &p = c.m_Pipeline[state.graphics.pipeline];
+
+  // Input Assembly
+  m_VulkanPipelineState.IA.ibuffer.buf = rm->GetOriginalID(state.ibuffer.buf);
+  m_VulkanPipelineState.IA.ibuffer.offs = state.ibuffer.offs;
+
+  // Vertex Input
+  create_array_uninit(m_VulkanPipelineState.VI.vbuffers, state.vbuffers.size());
+  for(size_t i = 0; i < state.vbuffers.size(); i++)
+  {
+    m_VulkanPipelineState.VI.vbuffers[i].buffer = rm->GetOriginalID(state.vbuffers[i].buf);
+    m_VulkanPipelineState.VI.vbuffers[i].offset = state.vbuffers[i].offs;
+  }
+
+  // Viewport/Scissors
+  size_t numViewScissors = p.viewportCount;
+  create_array_uninit(m_VulkanPipelineState.VP.viewportScissors, numViewScissors);
+  for(size_t i = 0; i < numViewScissors; i++)
+  {
+    if(i < state.views.size())
+    {
+      m_VulkanPipelineState.VP.viewportScissors[i].vp.x = state.views[i].x;
+      m_VulkanPipelineState.VP.viewportScissors[i].vp.y = state.views[i].y;
+      m_VulkanPipelineState.VP.viewportScissors[i].vp.width = state.views[i].width;
+      m_VulkanPipelineState.VP.viewportScissors[i].vp.height = state.views[i].height;
+      m_VulkanPipelineState.VP.viewportScissors[i].vp.minDepth = state.views[i].minDepth;
+      m_VulkanPipelineState.VP.viewportScissors[i].vp.maxDepth = state.views[i].maxDepth;
+    }
+    else
+    {
+      RDCEraseEl(m_VulkanPipelineState.VP.viewportScissors[i].vp);
+    }
+
+    if(i < state.scissors.size())
+    {
+      m_VulkanPipelineState.VP.viewportScissors[i].scissor.x = state.scissors[i].offset.x;
+      m_VulkanPipelineState.VP.viewportScissors[i].scissor.y = state.scissors[i].offset.y;
+      m_VulkanPipelineState.VP.viewportScissors[i].scissor.width = state.scissors[i].extent.width;
+      m_VulkanPipelineState.VP.viewportScissors[i].scissor.height =
+          state.scissors[i].extent.height;
+    }
+    else
+    {
+      RDCEraseEl(m_VulkanPipelineState.VP.viewportScissors[i].scissor);
+    }
+  }
+
+  // Rasterizer
+  m_VulkanPipelineState.RS.depthBias = state.bias.depth;
+  m_VulkanPipelineState.RS.depthBiasClamp = state.bias.biasclamp;
+  m_VulkanPipelineState.RS.slopeScaledDepthBias = state.bias.slope;
+  m_VulkanPipelineState.RS.lineWidth = state.lineWidth;
+
+  // Color Blend
+  memcpy(m_VulkanPipelineState.CB.blendConst, state.blendConst, sizeof(float) * 4);
+
+  // Depth Stencil
+  m_VulkanPipelineState.DS.minDepthBounds = state.mindepth;
+  m_VulkanPipelineState.DS.maxDepthBounds = state.maxdepth;
+
+  m_VulkanPipelineState.DS.front.ref = state.front.ref;
+  m_VulkanPipelineState.DS.front.compareMask = state.front.compare;
+  m_VulkanPipelineState.DS.front.writeMask = state.front.write;
+
+  m_VulkanPipelineState.DS.back.ref = state.back.ref;
+  m_VulkanPipelineState.DS.back.compareMask = state.back.compare;
+  m_VulkanPipelineState.DS.back.writeMask = state.back.write;
+}
+
+void VulkanReplay::SavePassState()
+{
+  const VulkanRenderState &state = m_pDriver->m_RenderState;
+  VulkanCreationInfo &c = m_pDriver->m_CreationInfo;
+
+  VulkanResourceManager *rm = m_pDriver->GetResourceManager();
+
+  m_VulkanPipelineState.Pass = VulkanPipelineState::CurrentPass();
+
+  // only filled out while a graphics pipeline is bound
+  if(state.graphics.pipeline == ResourceId())
+    return;
+
+  // Renderpass
+  m_VulkanPipelineState.Pass.renderpass.obj = rm->GetOriginalID(state.renderPass);
+  if(state.renderPass != ResourceId())
+  {
+    m_VulkanPipelineState.Pass.renderpass.inputAttachments =
+        c.m_RenderPass[state.renderPass].subpasses[state.subpass].inputAttachments;
+    m_VulkanPipelineState.Pass.renderpass.colorAttachments =
+        c.m_RenderPass[state.renderPass].subpasses[state.subpass].colorAttachments;
+    m_VulkanPipelineState.Pass.renderpass.depthstencilAttachment =
+        c.m_RenderPass[state.renderPass].subpasses[state.subpass].depthstencilAttachment;
+  }
+
+  m_VulkanPipelineState.Pass.framebuffer.obj = rm->GetOriginalID(state.framebuffer);
+
+  if(state.framebuffer != ResourceId())
+  {
+    m_VulkanPipelineState.Pass.framebuffer.width = c.m_Framebuffer[state.framebuffer].width;
+    m_VulkanPipelineState.Pass.framebuffer.height = c.m_Framebuffer[state.framebuffer].height;
+    m_VulkanPipelineState.Pass.framebuffer.layers = c.m_Framebuffer[state.framebuffer].layers;
+
+    create_array_uninit(m_VulkanPipelineState.Pass.framebuffer.attachments,
+                        c.m_Framebuffer[state.framebuffer].attachments.size());
+    for(size_t i = 0; i < c.m_Framebuffer[state.framebuffer].attachments.size(); i++)
+    {
+      ResourceId viewid = c.m_Framebuffer[state.framebuffer].attachments[i].view;
 
-      for(size_t p = 0; p < ARRAY_COUNT(srcs); p++)
+      if(viewid != ResourceId())
       {
-        for(size_t i = 0; i < srcs[p]->size(); i++)
-        {
-          ResourceId src = (*srcs[p])[i].descSet;
-          VulkanPipelineState::Pipeline::DescriptorSet &dst = (*dsts[p])[i];
+        m_VulkanPipelineState.Pass.framebuffer.attachments[i].view = rm->GetOriginalID(viewid);
+        m_VulkanPipelineState.Pass.framebuffer.attachments[i].img =
+            rm->GetOriginalID(c.m_ImageView[viewid].image);
+
+        m_VulkanPipelineState.Pass.framebuffer.attachments[i].viewfmt =
+            MakeResourceFormat(c.m_ImageView[viewid].format);
+        m_VulkanPipelineState.Pass.framebuffer.attachments[i].baseMip =
+            c.m_ImageView[viewid].range.baseMipLevel;
+        m_VulkanPipelineState.Pass.framebuffer.attachments[i].baseLayer =
+            c.m_ImageView[viewid].range.baseArrayLayer;
+        m_VulkanPipelineState.Pass.framebuffer.attachments[i].numMip =
+            c.m_ImageView[viewid].range.levelCount;
+        m_VulkanPipelineState.Pass.framebuffer.attachments[i].numLayer =
+            c.m_ImageView[viewid].range.layerCount;
+
+        memcpy(m_VulkanPipelineState.Pass.framebuffer.attachments[i].swizzle,
+               c.m_ImageView[viewid].swizzle, sizeof(TextureSwizzle) * 4);
+      }
+      else
+      {
+        m_VulkanPipelineState.Pass.framebuffer.attachments[i].view = ResourceId();
+        m_VulkanPipelineState.Pass.framebuffer.attachments[i].img = ResourceId();
 
-          ResourceId layoutId = m_pDriver->m_DescriptorSetState[src].layout;
+        m_VulkanPipelineState.Pass.framebuffer.attachments[i].baseMip = 0;
+        m_VulkanPipelineState.Pass.framebuffer.attachments[i].baseLayer = 0;
+        m_VulkanPipelineState.Pass.framebuffer.attachments[i].numMip = 1;
+        m_VulkanPipelineState.Pass.framebuffer.attachments[i].numLayer = 1;
+      }
+    }
+  }
+  else
+  {
+    m_VulkanPipelineState.Pass.framebuffer.width = 0;
+    m_VulkanPipelineState.Pass.framebuffer.height = 0;
+    m_VulkanPipelineState.Pass.framebuffer.layers = 0;
+  }
 
-          dst.descset = rm->GetOriginalID(src);
-          dst.layout = rm->GetOriginalID(layoutId);
-          create_array_uninit(dst.bindings,
-                              m_pDriver->m_DescriptorSetState[src].currentBindings.size());
-          for(size_t b = 0; b < m_pDriver->m_DescriptorSetState[src].currentBindings.size(); b++)
-          {
-            DescriptorSetSlot *info = m_pDriver->m_DescriptorSetState[src].currentBindings[b];
-            const DescSetLayout::Binding &layoutBind = c.m_DescSetLayout[layoutId].bindings[b];
+  m_VulkanPipelineState.Pass.renderArea.x = state.renderArea.offset.x;
+  m_VulkanPipelineState.Pass.renderArea.y = state.renderArea.offset.y;
+  m_VulkanPipelineState.Pass.renderArea.width = state.renderArea.extent.width;
+  m_VulkanPipelineState.Pass.renderArea.height = state.renderArea.extent.height;
+}
 
-            bool dynamicOffset = false;
+void VulkanReplay::SaveDescriptorState()
+{
+  const VulkanRenderState &state = m_pDriver->m_RenderState;
+  VulkanCreationInfo &c = m_pDriver->m_CreationInfo;
 
-            dst.bindings[b].descriptorCount = layoutBind.descriptorCount;
-            dst.bindings[b].stageFlags = (ShaderStageBits)layoutBind.stageFlags;
-            switch(layoutBind.descriptorType)
-            {
-              case VK_DESCRIPTOR_TYPE_SAMPLER: dst.bindings[b].type = eBindType_Sampler; break;
-              case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
-                dst.bindings[b].type = eBindType_ImageSampler;
-                break;
-              case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
-                dst.bindings[b].type = eBindType_ReadOnlyImage;
-                break;
-              case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
-                dst.bindings[b].type = eBindType_ReadWriteImage;
-                break;
-              case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
-                dst.bindings[b].type = eBindType_ReadOnlyTBuffer;
-                break;
-              case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
-                dst.bindings[b].type = eBindType_ReadWriteTBuffer;
-                break;
-              case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
-                dst.bindings[b].type = eBindType_ReadOnlyBuffer;
-                break;
-              case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
-                dst.bindings[b].type = eBindType_ReadWriteBuffer;
-                break;
-              case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
-                dst.bindings[b].type = eBindType_ReadOnlyBuffer;
-                dynamicOffset = true;
-                break;
-              case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
-                dst.bindings[b].type = eBindType_ReadWriteBuffer;
-                dynamicOffset = true;
-                break;
-              case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
-                dst.bindings[b].type = eBindType_InputAttachment;
-                break;
-              default:
-                dst.bindings[b].type = eBindType_Unknown;
-                RDCERR("Unexpected descriptor type");
-            }
+  VulkanResourceManager *rm = m_pDriver->GetResourceManager();
 
-            create_array_uninit(dst.bindings[b].binds, layoutBind.descriptorCount);
-            for(uint32_t a = 0; a < layoutBind.descriptorCount; a++)
-            {
-              if(layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER ||
-                 layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
-              {
-                if(layoutBind.immutableSampler)
-                {
-                  dst.bindings[b].binds[a].sampler = layoutBind.immutableSampler[a];
-                  dst.bindings[b].binds[a].immutableSampler = true;
-                }
-                else if(info[a].imageInfo.sampler != VK_NULL_HANDLE)
-                {
-                  dst.bindings[b].binds[a].sampler =
-                      rm->GetNonDispWrapper(info[a].imageInfo.sampler)->id;
-                }
+  create_array_uninit(m_VulkanPipelineState.graphics.DescSets, state.graphics.descSets.size());
+  create_array_uninit(m_VulkanPipelineState.compute.DescSets, state.compute.descSets.size());
 
-                if(dst.bindings[b].binds[a].sampler != ResourceId())
-                {
-                  VulkanPipelineState::Pipeline::DescriptorSet::DescriptorBinding::BindingElement &el =
-                      dst.bindings[b].binds[a];
-                  const VulkanCreationInfo::Sampler &sampl = c.m_Sampler[el.sampler];
+  {
+    rdctype::array<VulkanPipelineState::Pipeline::DescriptorSet> *dsts[] = {
+        &m_VulkanPipelineState.graphics.DescSets, &m_VulkanPipelineState.compute.DescSets,
+    };
+
+    const vector<VulkanRenderState::Pipeline::DescriptorAndOffsets> *srcs[] = {
+        &state.graphics.descSets, &state.compute.descSets,
+    };
 
-                  ResourceId liveId = el.sampler;
+    for(size_t p = 0; p < ARRAY_COUNT(srcs); p++)
+    {
+      for(size_t i = 0; i < srcs[p]->size(); i++)
+      {
+        ResourceId src = (*srcs[p])[i].descSet;
+        VulkanPipelineState::Pipeline::DescriptorSet &dst = (*dsts[p])[i];
 
-                  el.sampler = rm->GetOriginalID(el.sampler);
+        ResourceId layoutId = m_pDriver->m_DescriptorSetState[src].layout;
 
-                  el.customSamplerName = true;
-                  el.SamplerName = m_pDriver->m_CreationInfo.m_Names[liveId];
-                  if(el.SamplerName.count == 0)
-                  {
-                    el.customSamplerName = false;
-                    el.SamplerName = StringFormat::Fmt("Sampler %llu", el.sampler);
-                  }
-
-                  // sampler info
-                  el.mag = ToStr::Get(sampl.magFilter);
-                  el.min = ToStr::Get(sampl.minFilter);
-                  el.mip = ToStr::Get(sampl.mipmapMode);
-                  el.addrU = ToStr::Get(sampl.address[0]);
-                  el.addrV = ToStr::Get(sampl.address[1]);
-                  el.addrW = ToStr::Get(sampl.address[2]);
-                  el.mipBias = sampl.mipLodBias;
-                  el.maxAniso = sampl.maxAnisotropy;
-                  el.compareEnable = sampl.compareEnable;
-                  el.comparison = ToStr::Get(sampl.compareOp);
-                  el.minlod = sampl.minLod;
-                  el.maxlod = sampl.maxLod;
-                  el.borderEnable = false;
-                  if(sampl.address[0] == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER ||
-                     sampl.address[1] == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER ||
-                     sampl.address[2] == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER)
-                    el.borderEnable = true;
-                  el.border = ToStr::Get(sampl.borderColor);
-                  el.unnormalized = sampl.unnormalizedCoordinates;
-                }
-              }
+        dst.descset = rm->GetOriginalID(src);
+        dst.layout = rm->GetOriginalID(layoutId);
+        create_array_uninit(dst.bindings,
+                            m_pDriver->m_DescriptorSetState[src].currentBindings.size());
+        for(size_t b = 0; b < m_pDriver->m_DescriptorSetState[src].currentBindings.size(); b++)
+        {
+          DescriptorSetSlot *info = m_pDriver->m_DescriptorSetState[src].currentBindings[b];
+          const DescSetLayout::Binding &layoutBind = c.m_DescSetLayout[layoutId].bindings[b];
 
-              if(layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
-                 layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
-                 layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT ||
-                 layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)
-              {
-                VkImageView view = info[a].imageInfo.imageView;
+          bool dynamicOffset = false;
 
-                if(view != VK_NULL_HANDLE)
-                {
-                  ResourceId viewid = rm->GetNonDispWrapper(view)->id;
-
-                  dst.bindings[b].binds[a].view = rm->GetOriginalID(viewid);
-                  dst.bindings[b].binds[a].res = rm->GetOriginalID(c.m_ImageView[viewid].image);
-                  dst.bindings[b].binds[a].viewfmt = MakeResourceFormat(c.m_ImageView[viewid].format);
-
-                  memcpy(dst.bindings[b].binds[a].swizzle, c.m_ImageView[viewid].swizzle,
-                         sizeof(TextureSwizzle) * 4);
-                  dst.bindings[b].binds[a].baseMip = c.m_ImageView[viewid].range.baseMipLevel;
-                  dst.bindings[b].binds[a].baseLayer = c.m_ImageView[viewid].range.baseArrayLayer;
-                  dst.bindings[b].binds[a].numMip = c.m_ImageView[viewid].range.levelCount;
-                  dst.bindings[b].binds[a].numLayer = c.m_ImageView[viewid].range.layerCount;
-                }
-                else
-                {
-                  dst.bindings[b].binds[a].view = ResourceId();
-                  dst.bindings[b].binds[a].res = ResourceId();
-                  dst.bindings[b].binds[a].baseMip = 0;
-                  dst.bindings[b].binds[a].baseLayer = 0;
-                  dst.bindings[b].binds[a].numMip = 1;
-                  dst.bindings[b].binds[a].numLayer = 1;
-                }
+          dst.bindings[b].descriptorCount = layoutBind.descriptorCount;
+          dst.bindings[b].stageFlags = (ShaderStageBits)layoutBind.stageFlags;
+          switch(layoutBind.descriptorType)
+          {
+            case VK_DESCRIPTOR_TYPE_SAMPLER: dst.bindings[b].type = eBindType_Sampler; break;
+            case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+              dst.bindings[b].type = eBindType_ImageSampler;
+              break;
+            case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+              dst.bindings[b].type = eBindType_ReadOnlyImage;
+              break;
+            case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+              dst.bindings[b].type = eBindType_ReadWriteImage;
+              break;
+            case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+              dst.bindings[b].type = eBindType_ReadOnlyTBuffer;
+              break;
+            case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+              dst.bindings[b].type = eBindType_ReadWriteTBuffer;
+              break;
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+              dst.bindings[b].type = eBindType_ReadOnlyBuffer;
+              break;
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+              dst.bindings[b].type = eBindType_ReadWriteBuffer;
+              break;
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+              dst.bindings[b].type = eBindType_ReadOnlyBuffer;
+              dynamicOffset = true;
+              break;
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+              dst.bindings[b].type = eBindType_ReadWriteBuffer;
+              dynamicOffset = true;
+              break;
+            case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+              dst.bindings[b].type = eBindType_InputAttachment;
+              break;
+            default:
+              dst.bindings[b].type = eBindType_Unknown;
+              RDCERR("Unexpected descriptor type");
+          }
+
+          create_array_uninit(dst.bindings[b].binds, layoutBind.descriptorCount);
+          for(uint32_t a = 0; a < layoutBind.descriptorCount; a++)
+          {
+            if(layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER ||
+               layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
+            {
+              if(layoutBind.immutableSampler)
+              {
+                dst.bindings[b].binds[a].sampler = layoutBind.immutableSampler[a];
+                dst.bindings[b].binds[a].immutableSampler = true;
               }
-              if(layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER ||
-                 layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER)
+              else if(info[a].imageInfo.sampler != VK_NULL_HANDLE)
               {
-                VkBufferView view = info[a].texelBufferView;
-
-                if(view != VK_NULL_HANDLE)
-                {
-                  ResourceId viewid = rm->GetNonDispWrapper(view)->id;
+                dst.bindings[b].binds[a].sampler =
+                    rm->GetNonDispWrapper(info[a].imageInfo.sampler)->id;
+              }
 
-                  dst.bindings[b].binds[a].view = rm->GetOriginalID(viewid);
-                  dst.bindings[b].binds[a].res = rm->GetOriginalID(c.m_BufferView[viewid].buffer);
-                  dst.bindings[b].binds[a].offset = c.m_BufferView[viewid].offset;
-                  if(dynamicOffset)
-                  {
-                    union
-                    {
-                      VkImageLayout l;
-                      uint32_t u;
-                    } offs;
+              if(dst.bindings[b].binds[a].sampler != ResourceId())
+              {
+                VulkanPipelineState::Pipeline::DescriptorSet::DescriptorBinding::BindingElement &el =
+                    dst.bindings[b].binds[a];
+                const VulkanCreationInfo::Sampler &sampl = c.m_Sampler[el.sampler];
 
-                    RDCCOMPILE_ASSERT(sizeof(VkImageLayout) == sizeof(uint32_t),
-                                      "VkImageLayout isn't 32-bit sized");
+                ResourceId liveId = el.sampler;
 
-                    offs.l = info[a].imageInfo.imageLayout;
+                el.sampler = rm->GetOriginalID(el.sampler);
 
-                    dst.bindings[b].binds[a].offset += offs.u;
-                  }
-                  dst.bindings[b].binds[a].size = c.m_BufferView[viewid].size;
-                }
-                else
+                el.customSamplerName = true;
+                el.SamplerName = m_pDriver->m_CreationInfo.m_Names[liveId];
+                if(el.SamplerName.count == 0)
                 {
-                  dst.bindings[b].binds[a].view = ResourceId();
-                  dst.bindings[b].binds[a].res = ResourceId();
-                  dst.bindings[b].binds[a].offset = 0;
-                  dst.bindings[b].binds[a].size = 0;
+                  el.customSamplerName = false;
+                  el.SamplerName = StringFormat::Fmt("Sampler %llu", el.sampler);
                 }
+
+                // sampler info
+                el.mag = ToStr::Get(sampl.magFilter);
+                el.min = ToStr::Get(sampl.minFilter);
+                el.mip = ToStr::Get(sampl.mipmapMode);
+                el.addrU = ToStr::Get(sampl.address[0]);
+                el.addrV = ToStr::Get(sampl.address[1]);
+                el.addrW = ToStr::Get(sampl.address[2]);
+                el.mipBias = sampl.mipLodBias;
+                el.maxAniso = sampl.maxAnisotropy;
+                el.compareEnable = sampl.compareEnable;
+                el.comparison = ToStr::Get(sampl.compareOp);
+                el.minlod = sampl.minLod;
+                el.maxlod = sampl.maxLod;
+                el.borderEnable = false;
+                if(sampl.address[0] == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER ||
+                   sampl.address[1] == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER ||
+                   sampl.address[2] == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER)
+                  el.borderEnable = true;
+                el.border = ToStr::Get(sampl.borderColor);
+                el.unnormalized = sampl.unnormalizedCoordinates;
               }
-              if(layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER ||
-                 layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC ||
-                 layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ||
-                 layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
+            }
+
+            if(layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+               layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+               layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT ||
+               layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)
+            {
+              VkImageView view = info[a].imageInfo.imageView;
+
+              if(view != VK_NULL_HANDLE)
+              {
+                ResourceId viewid = rm->GetNonDispWrapper(view)->id;
+
+                dst.bindings[b].binds[a].view = rm->GetOriginalID(viewid);
+                dst.bindings[b].binds[a].res = rm->GetOriginalID(c.m_ImageView[viewid].image);
+                dst.bindings[b].binds[a].viewfmt = MakeResourceFormat(c.m_ImageView[viewid].format);
+
+                memcpy(dst.bindings[b].binds[a].swizzle, c.m_ImageView[viewid].swizzle,
+                       sizeof(TextureSwizzle) * 4);
+                dst.bindings[b].binds[a].baseMip = c.m_ImageView[viewid].range.baseMipLevel;
+                dst.bindings[b].binds[a].baseLayer = c.m_ImageView[viewid].range.baseArrayLayer;
+                dst.bindings[b].binds[a].numMip = c.m_ImageView[viewid].range.levelCount;
+                dst.bindings[b].binds[a].numLayer = c.m_ImageView[viewid].range.layerCount;
+              }
+              else
               {
                 dst.bindings[b].binds[a].view = ResourceId();
+                dst.bindings[b].binds[a].res = ResourceId();
+                dst.bindings[b].binds[a].baseMip = 0;
+                dst.bindings[b].binds[a].baseLayer = 0;
+                dst.bindings[b].binds[a].numMip = 1;
+                dst.bindings[b].binds[a].numLayer = 1;
+              }
+            }
+            if(layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER ||
+               layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER)
+            {
+              VkBufferView view = info[a].texelBufferView;
 
-                if(info[a].bufferInfo.buffer != VK_NULL_HANDLE)
-                  dst.bindings[b].binds[a].res =
-                      rm->GetOriginalID(rm->GetNonDispWrapper(info[a].bufferInfo.buffer)->id);
+              if(view != VK_NULL_HANDLE)
+              {
+                ResourceId viewid = rm->GetNonDispWrapper(view)->id;
 
-                dst.bindings[b].binds[a].offset = info[a].bufferInfo.offset;
+                dst.bindings[b].binds[a].view = rm->GetOriginalID(viewid);
+                dst.bindings[b].binds[a].res = rm->GetOriginalID(c.m_BufferView[viewid].buffer);
+                dst.bindings[b].binds[a].offset = c.m_BufferView[viewid].offset;
                 if(dynamicOffset)
                 {
                   union
@@ -3658,38 +3884,76 @@ void VulkanReplay::SavePipelineState()
 
                   dst.bindings[b].binds[a].offset += offs.u;
                 }
+                dst.bindings[b].binds[a].size = c.m_BufferView[viewid].size;
+              }
+              else
+              {
+                dst.bindings[b].binds[a].view = ResourceId();
+                dst.bindings[b].binds[a].res = ResourceId();
+                dst.bindings[b].binds[a].offset = 0;
+                dst.bindings[b].binds[a].size = 0;
+              }
+            }
+            if(layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER ||
+               layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC ||
+               layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ||
+               layoutBind.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
+            {
+              dst.bindings[b].binds[a].view = ResourceId();
 
-                dst.bindings[b].binds[a].size = info[a].bufferInfo.range;
+              if(info[a].bufferInfo.buffer != VK_NULL_HANDLE)
+                dst.bindings[b].binds[a].res =
+                    rm->GetOriginalID(rm->GetNonDispWrapper(info[a].bufferInfo.buffer)->id);
+
+              dst.bindings[b].binds[a].offset = info[a].bufferInfo.offset;
+              if(dynamicOffset)
+              {
+                union
+                {
+                  VkImageLayout l;
+                  uint32_t u;
+                } offs;
+
+                RDCCOMPILE_ASSERT(sizeof(VkImageLayout) == sizeof(uint32_t),
+                                  "VkImageLayout isn't 32-bit sized");
+
+                offs.l = info[a].imageInfo.imageLayout;
+
+                dst.bindings[b].binds[a].offset += offs.u;
               }
+
+              dst.bindings[b].binds[a].size = info[a].bufferInfo.range;
             }
           }
         }
       }
     }
+  }
+}
 
-    // image layouts
-    {
-      create_array_uninit(m_VulkanPipelineState.images, m_pDriver->m_ImageLayouts.size());
-      size_t i = 0;
-      for(auto it = m_pDriver->m_ImageLayouts.begin(); it != m_pDriver->m_ImageLayouts.end(); ++it)
-      {
-        VulkanPipelineState::ImageData &img = m_VulkanPipelineState.images[i];
+void VulkanReplay::SaveImageLayoutState()
+{
+  VulkanResourceManager *rm = m_pDriver->GetResourceManager();
 
-        img.image = rm->GetOriginalID(it->first);
+  create_array_uninit(m_VulkanPipelineState.images, m_pDriver->m_ImageLayouts.size());
+  size_t i = 0;
+  for(auto it = m_pDriver->m_ImageLayouts.begin(); it != m_pDriver->m_ImageLayouts.end(); ++it)
+  {
+    VulkanPipelineState::ImageData &img = m_VulkanPipelineState.images[i];
 
-        create_array_uninit(img.layouts, it->second.subresourceStates.size());
-        for(size_t l = 0; l < it->second.subresourceStates.size(); l++)
-        {
-          img.layouts[l].name = ToStr::Get(it->second.subresourceStates[l].newLayout);
-          img.layouts[l].baseMip = it->second.subresourceStates[l].subresourceRange.baseMipLevel;
-          img.layouts[l].baseLayer = it->second.subresourceStates[l].subresourceRange.baseArrayLayer;
-          img.layouts[l].numLayer = it->second.subresourceStates[l].subresourceRange.layerCount;
-          img.layouts[l].numMip = it->second.subresourceStates[l].subresourceRange.levelCount;
-        }
+    img.image = rm->GetOriginalID(it->first);
 
-        i++;
-      }
+    create_array_uninit(img.layouts, it->second.subresourceStates.size());
+    for(size_t l = 0; l < it->second.subresourceStates.size(); l++)
+    {
+      img.layouts[l].name = ToStr::Get(it->second.subresourceStates[l].newLayout);
+      img.layouts[l].baseMip = it->second.subresourceStates[l].subresourceRange.baseMipLevel;
+      img.layouts[l].baseLayer = it->second.subresourceStates[l].subresourceRange.baseArrayLayer;
+      img.layouts[l].numLayer = it->second.subresourceStates[l].subresourceRange.layerCount;
+      img.layouts[l].numMip = it->second.subresourceStates[l].subresourceRange.levelCount;
     }
+
+    i++;
   }
 }
 
@@ -3973,6 +4237,8 @@ void VulkanReplay::FillCBufferVariables(ResourceId shader, string entryPoint, ui
 bool VulkanReplay::GetMinMax(ResourceId texid, uint32_t sliceFace, uint32_t mip, uint32_t sample,
                              float *minval, float *maxval)
 {
+  GetDebugManager()->FinishComputePipelines();
+
   VkDevice dev = m_pDriver->GetDev();
   VkCommandBuffer cmd = m_pDriver->GetNextCmd();
   const VkLayerDispatchTable *vt = ObjDisp(dev);
@@ -4224,6 +4490,8 @@ bool VulkanReplay::GetHistogram(ResourceId texid, uint32_t sliceFace, uint32_t m
   if(minval >= maxval)
     return false;
 
+  GetDebugManager()->FinishComputePipelines();
+
   VkDevice dev = m_pDriver->GetDev();
   VkCommandBuffer cmd = m_pDriver->GetNextCmd();
   const VkLayerDispatchTable *vt = ObjDisp(dev);
@@ -4455,9 +4723,21 @@ void VulkanReplay::InitPostVSBuffers(uint32_t eventID)
 struct InitPostVSCallback : public DrawcallCallback
 {
   InitPostVSCallback(WrappedVulkan *vk, const vector<uint32_t> &events)
-      : m_pDriver(vk), m_Events(events)
+      : m_pDriver(vk), m_Events(events), m_LastDraw(0)
   {
     m_pDriver->SetDrawcallCB(this);
+
+    // pass boundaries can be included in the events, find the last actual draw
+    for(size_t i = m_Events.size(); i > 0; i--)
+    {
+      const FetchDrawcall *draw = m_pDriver->GetDrawcall(m_Events[i - 1]);
+
+      if(draw && (draw->flags & eDraw_Drawcall))
+      {
+        m_LastDraw = m_Events[i - 1];
+        break;
+      }
+    }
   }
   ~InitPostVSCallback() { m_pDriver->SetDrawcallCB(NULL); }
   void PreDraw(uint32_t eid, VkCommandBuffer cmd)
@@ -4466,12 +4746,23 @@ struct InitPostVSCallback : public DrawcallCallback
       m_pDriver->GetDebugManager()->InitPostVSBuffers(eid);
   }
 
-  bool PostDraw(uint32_t eid, VkCommandBuffer cmd) { return false; }
+  bool PostDraw(uint32_t eid, VkCommandBuffer cmd)
+  {
+    // the fetches must run before the pass is submitted, so that they see the same state as the
+    // original draws did. Finish the batch as soon as the last draw has been recorded
+    if(eid == m_LastDraw)
+      m_pDriver->GetDebugManager()->EndPostVSBatch();
+
+    return false;
+  }
+
   void PostRedraw(uint32_t eid, VkCommandBuffer cmd) {}
   // Dispatches don't rasterize, so do nothing
   void PreDispatch(uint32_t eid, VkCommandBuffer cmd) {}
   bool PostDispatch(uint32_t eid, VkCommandBuffer cmd) { return false; }
   void PostRedispatch(uint32_t eid, VkCommandBuffer cmd) {}
+  void PreMisc(uint32_t eid, DrawcallFlags flags, VkCommandBuffer cmd) {}
+  void PostMisc(uint32_t eid, DrawcallFlags flags, VkCommandBuffer cmd) {}
   bool RecordAllCmds() { return false; }
   void AliasEvent(uint32_t primary, uint32_t alias)
   {
@@ -4481,6 +4772,7 @@ struct InitPostVSCallback : public DrawcallCallback
 
   WrappedVulkan *m_pDriver;
   const vector<uint32_t> &m_Events;
+  uint32_t m_LastDraw;
 };
 
 void VulkanReplay::InitPostVSBuffers(const vector<uint32_t> &events)
@@ -4492,10 +4784,22 @@ void VulkanReplay::InitPostVSBuffers(const vector<uint32_t> &events)
 
   InitPostVSCallback cb(m_pDriver, events);
 
+  // every draw in the pass is fetched in one batch, with a single submit and wait at the end
+  // instead of one per draw
+  GetDebugManager()->BeginPostVSBatch();
+
   // now we replay the events, which are guaranteed (because we generated them in
   // GetPassEvents above) to come from the same command buffer, so the event IDs are
   // still locally continuous, even if we jump into replaying.
   m_pDriver->ReplayLog(events.front(), events.back(), eReplay_Full);
+
+  // normally the callback has already ended the batch, this catches the last draw being skipped
+  GetDebugManager()->EndPostVSBatch();
+}
+
+void VulkanReplay::PinPostVSBuffers(const vector<uint32_t> &events)
+{
+  GetDebugManager()->PinPostVSBuffers(events);
 }
 
 vector<EventUsage> VulkanReplay::GetUsage(ResourceId id)
@@ -4953,9 +5257,11 @@ byte *VulkanReplay::GetTextureData(ResourceId tex, uint32_t arrayIdx, uint32_t m
 
   vt->GetBufferMemoryRequirements(Unwrap(dev), readbackBuf, &mrq);
 
+  // the subresource is copied to a GPU-side buffer first, then streamed back through the debug
+  // manager's readback windows
   VkMemoryAllocateInfo allocInfo = {
-      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, sublayout.size,
-      m_pDriver->GetReadbackMemoryIndex(mrq.memoryTypeBits),
+      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, mrq.size,
+      m_pDriver->GetGPULocalMemoryIndex(mrq.memoryTypeBits),
   };
 
   VkDeviceMemory readbackMem = VK_NULL_HANDLE;
@@ -4985,7 +5291,7 @@ byte *VulkanReplay::GetTextureData(ResourceId tex, uint32_t arrayIdx, uint32_t m
       VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
       NULL,
       VK_ACCESS_TRANSFER_WRITE_BIT,
-      VK_ACCESS_HOST_READ_BIT,
+      VK_ACCESS_TRANSFER_READ_BIT,
       VK_QUEUE_FAMILY_IGNORED,
       VK_QUEUE_FAMILY_IGNORED,
       readbackBuf,
@@ -4993,27 +5299,18 @@ byte *VulkanReplay::GetTextureData(ResourceId tex, uint32_t arrayIdx, uint32_t m
       sublayout.size,
   };
 
-  // wait for copy to finish before reading back to host
+  // wait for copy to finish before reading back
   DoPipelineBarrier(cmd, 1, &bufBarrier);
 
   vt->EndCommandBuffer(Unwrap(cmd));
 
-  m_pDriver->SubmitCmds();
-  m_pDriver->FlushQ();
-
-  // map the buffer and copy to return buffer
-  byte *pData = NULL;
-  vkr = vt->MapMemory(Unwrap(dev), readbackMem, 0, VK_WHOLE_SIZE, 0, (void **)&pData);
-  RDCASSERTEQUAL(vkr, VK_SUCCESS);
-
-  RDCASSERT(pData != NULL);
-
   dataSize = GetByteSize(imInfo.extent.width, imInfo.extent.height, imInfo.extent.depth,
                          imCreateInfo.format, mip);
   byte *ret = new byte[dataSize];
-  memcpy(ret, pData, dataSize);
 
-  vt->UnmapMemory(Unwrap(dev), readbackMem);
+  // submits the copy above along with the readback
+  GetDebugManager()->ReadbackBuffer(readbackBuf, 0, RDCMIN((VkDeviceSize)dataSize, sublayout.size),
+                                    ret);
 
   // clean up temporary objects
   vt->DestroyBuffer(Unwrap(dev), readbackBuf, NULL);
@@ -5040,6 +5337,272 @@ byte *VulkanReplay::GetTextureData(ResourceId tex, uint32_t arrayIdx, uint32_t m
   return ret;
 }
 
+bool VulkanReplay::CanBatchTextureData(const TextureDataRequest &req)
+{
+  auto it = m_pDriver->m_CreationInfo.m_Image.find(req.tex);
+
+  // anything that needs rendering or resolving goes through GetTextureData
+  return it != m_pDriver->m_CreationInfo.m_Image.end() && !req.forceRGBA8unorm &&
+         it->second.samples == VK_SAMPLE_COUNT_1_BIT;
+}
+
+static VkDeviceSize TextureBatchSize(const VulkanCreationInfo::Image &imInfo, uint32_t mip,
+                                     VkDeviceSize &alignment)
+{
+  // buffer offsets for image copies must be a multiple of both 4 and the texel/block size
+  alignment = 4 * GetByteSize(1, 1, 1, imInfo.format, 0);
+
+  return GetByteSize(imInfo.extent.width, imInfo.extent.height, imInfo.extent.depth, imInfo.format,
+                     mip);
+}
+
+void VulkanReplay::GetTextureDataBatch(const vector<TextureDataRequest> &requests,
+                                       TextureDataReceiver *receiver)
+{
+  size_t i = 0;
+
+  while(i < requests.size())
+  {
+    const TextureDataRequest &req = requests[i];
+
+    if(!CanBatchTextureData(req))
+    {
+      size_t dataSize = 0;
+      byte *data = GetTextureData(req.tex, req.arrayIdx, req.mip, req.resolve, req.forceRGBA8unorm,
+                                  req.blackPoint, req.whitePoint, dataSize);
+      receiver->ReceiveTextureData(i, data, dataSize);
+      i++;
+      continue;
+    }
+
+    // gather up the following plain copies, as many as fit in a batch
+    size_t count = 0;
+    VkDeviceSize batchSize = 0;
+
+    while(i + count < requests.size() && CanBatchTextureData(requests[i + count]))
+    {
+      const TextureDataRequest &next = requests[i + count];
+
+      VkDeviceSize alignment = 0;
+      VkDeviceSize size =
+          TextureBatchSize(m_pDriver->m_CreationInfo.m_Image[next.tex], next.mip, alignment);
+
+      // always take at least one, even if it's bigger than a batch on its own
+      if(count > 0 && batchSize + alignment + size > MaxTextureBatchSize)
+        break;
+
+      batchSize += alignment + size;
+      count++;
+    }
+
+    ReadbackTextureBatch(requests, i, count, receiver);
+
+    i += count;
+  }
+}
+
+// passes each subresource of a batch on to the receiver as soon as it's read back
+class TextureBatchListener : public VulkanDebugManager::ReadbackListener
+{
+public:
+  TextureBatchListener(const vector<VulkanDebugManager::ReadbackRange> &r, size_t firstReq,
+                       TextureDataReceiver *recv)
+      : ranges(r), first(firstReq), receiver(recv)
+  {
+  }
+
+  void RangeArrived(size_t rangeIdx)
+  {
+    receiver->ReceiveTextureData(first + rangeIdx, ranges[rangeIdx].dest,
+                                 (size_t)ranges[rangeIdx].size);
+  }
+
+private:
+  TextureBatchListener &operator=(const TextureBatchListener &other);
+
+  const vector<VulkanDebugManager::ReadbackRange> &ranges;
+  size_t first;
+  TextureDataReceiver *receiver;
+};
+
+void VulkanReplay::ReadbackTextureBatch(const vector<TextureDataRequest> &requests, size_t first,
+                                        size_t count, TextureDataReceiver *receiver)
+{
+  VkDevice dev = m_pDriver->GetDev();
+  const VkLayerDispatchTable *vt = ObjDisp(dev);
+
+  // lay out every subresource in one GPU-side buffer
+  vector<VkDeviceSize> offsets(count);
+  vector<VkDeviceSize> sizes(count);
+  VkDeviceSize totalSize = 0;
+
+  // textures in the batch, each one transitioned once around all of its copies
+  vector<ResourceId> textures;
+
+  for(size_t i = 0; i < count; i++)
+  {
+    const TextureDataRequest &req = requests[first + i];
+
+    VkDeviceSize alignment = 0;
+    sizes[i] = TextureBatchSize(m_pDriver->m_CreationInfo.m_Image[req.tex], req.mip, alignment);
+
+    totalSize = ((totalSize + alignment - 1) / alignment) * alignment;
+    offsets[i] = totalSize;
+    totalSize += sizes[i];
+
+    if(std::find(textures.begin(), textures.end(), req.tex) == textures.end())
+      textures.push_back(req.tex);
+  }
+
+  VkBufferCreateInfo bufInfo = {
+      VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      NULL,
+      0,
+      totalSize,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+  };
+
+  VkBuffer readbackBuf = VK_NULL_HANDLE;
+  VkResult vkr = vt->CreateBuffer(Unwrap(dev), &bufInfo, NULL, &readbackBuf);
+  RDCASSERTEQUAL(vkr, VK_SUCCESS);
+
+  VkMemoryRequirements mrq = {0};
+
+  vt->GetBufferMemoryRequirements(Unwrap(dev), readbackBuf, &mrq);
+
+  VkMemoryAllocateInfo allocInfo = {
+      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, mrq.size,
+      m_pDriver->GetGPULocalMemoryIndex(mrq.memoryTypeBits),
+  };
+
+  VkDeviceMemory readbackMem = VK_NULL_HANDLE;
+  vkr = vt->AllocateMemory(Unwrap(dev), &allocInfo, NULL, &readbackMem);
+  RDCASSERTEQUAL(vkr, VK_SUCCESS);
+
+  vkr = vt->BindBufferMemory(Unwrap(dev), readbackBuf, readbackMem, 0);
+  RDCASSERTEQUAL(vkr, VK_SUCCESS);
+
+  VkCommandBuffer cmd = m_pDriver->GetNextCmd();
+
+  VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+                                        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+
+  vkr = vt->BeginCommandBuffer(Unwrap(cmd), &beginInfo);
+  RDCASSERTEQUAL(vkr, VK_SUCCESS);
+
+  VkImageMemoryBarrier srcimBarrier = {
+      VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      NULL,
+      VK_ACCESS_ALL_WRITE_BITS,
+      VK_ACCESS_TRANSFER_READ_BIT,
+      VK_IMAGE_LAYOUT_UNDEFINED,
+      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      VK_QUEUE_FAMILY_IGNORED,
+      VK_QUEUE_FAMILY_IGNORED,
+      VK_NULL_HANDLE,
+      {0, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS}};
+
+  // ensure all previous writes have completed before we copy
+  for(size_t t = 0; t < textures.size(); t++)
+  {
+    ImageLayouts &layouts = m_pDriver->m_ImageLayouts[textures[t]];
+
+    srcimBarrier.image = Unwrap(GetResourceManager()->GetCurrentHandle<VkImage>(textures[t]));
+
+    for(size_t si = 0; si < layouts.subresourceStates.size(); si++)
+    {
+      srcimBarrier.subresourceRange = layouts.subresourceStates[si].subresourceRange;
+      srcimBarrier.oldLayout = layouts.subresourceStates[si].newLayout;
+      DoPipelineBarrier(cmd, 1, &srcimBarrier);
+    }
+  }
+
+  for(size_t i = 0; i < count; i++)
+  {
+    const TextureDataRequest &req = requests[first + i];
+    VulkanCreationInfo::Image &imInfo = m_pDriver->m_CreationInfo.m_Image[req.tex];
+    ImageLayouts &layouts = m_pDriver->m_ImageLayouts[req.tex];
+
+    bool isDepth =
+        (layouts.subresourceStates[0].subresourceRange.aspectMask & VK_IMAGE_ASPECT_DEPTH_BIT) != 0;
+    bool is3D = (imInfo.type == VK_IMAGE_TYPE_3D);
+
+    // 3D textures are fetched a whole mip at a time, same as GetTextureData
+    VkBufferImageCopy copyregion = {
+        offsets[i],
+        0,
+        0,
+        {VkImageAspectFlags(isDepth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT),
+         req.mip, is3D ? 0 : req.arrayIdx, 1},
+        {
+            0, 0, 0,
+        },
+        {
+            RDCMAX(1U, imInfo.extent.width >> req.mip), RDCMAX(1U, imInfo.extent.height >> req.mip),
+            RDCMAX(1U, imInfo.extent.depth >> req.mip),
+        },
+    };
+
+    VkImage srcImage = Unwrap(GetResourceManager()->GetCurrentHandle<VkImage>(req.tex));
+
+    vt->CmdCopyImageToBuffer(Unwrap(cmd), srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                             readbackBuf, 1, &copyregion);
+  }
+
+  srcimBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  srcimBarrier.srcAccessMask = 0;
+  srcimBarrier.dstAccessMask = 0;
+
+  // image layouts back to normal
+  for(size_t t = 0; t < textures.size(); t++)
+  {
+    ImageLayouts &layouts = m_pDriver->m_ImageLayouts[textures[t]];
+
+    srcimBarrier.image = Unwrap(GetResourceManager()->GetCurrentHandle<VkImage>(textures[t]));
+
+    for(size_t si = 0; si < layouts.subresourceStates.size(); si++)
+    {
+      srcimBarrier.subresourceRange = layouts.subresourceStates[si].subresourceRange;
+      srcimBarrier.newLayout = layouts.subresourceStates[si].newLayout;
+      DoPipelineBarrier(cmd, 1, &srcimBarrier);
+    }
+  }
+
+  VkBufferMemoryBarrier bufBarrier = {
+      VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+      NULL,
+      VK_ACCESS_TRANSFER_WRITE_BIT,
+      VK_ACCESS_TRANSFER_READ_BIT,
+      VK_QUEUE_FAMILY_IGNORED,
+      VK_QUEUE_FAMILY_IGNORED,
+      readbackBuf,
+      0,
+      totalSize,
+  };
+
+  // wait for the copies to finish before reading back
+  DoPipelineBarrier(cmd, 1, &bufBarrier);
+
+  vt->EndCommandBuffer(Unwrap(cmd));
+
+  vector<VulkanDebugManager::ReadbackRange> ranges(count);
+
+  for(size_t i = 0; i < count; i++)
+  {
+    ranges[i].offset = offsets[i];
+    ranges[i].size = sizes[i];
+    ranges[i].dest = new byte[(size_t)sizes[i]];
+  }
+
+  // this submits all of the copies above, then the whole batch streams back in one go and each
+  // subresource is handed over as soon as it has arrived
+  TextureBatchListener listener(ranges, first, receiver);
+  GetDebugManager()->ReadbackBufferRanges(readbackBuf, ranges, &listener);
+
+  vt->DestroyBuffer(Unwrap(dev), readbackBuf, NULL);
+  vt->FreeMemory(Unwrap(dev), readbackMem, NULL);
+}
+
 void VulkanReplay::BuildCustomShader(string source, string entry, const uint32_t compileFlags,
                                      ShaderStageType type, ResourceId *id, string *errors)
 {
@@ -5200,11 +5763,16 @@ void VulkanReplay::BuildTargetShader(string source, string entry, const uint32_t
 void VulkanReplay::ReplaceResource(ResourceId from, ResourceId to)
 {
   GetDebugManager()->ReplaceResource(from, to);
+
+  // the bound objects' IDs don't change when they're replaced, so rebuild everything next time
+  m_PipelineStateSource.valid = false;
 }
 
 void VulkanReplay::RemoveReplacement(ResourceId id)
 {
   GetDebugManager()->RemoveReplacement(id);
+
+  m_PipelineStateSource.valid = false;
 }
 
 void VulkanReplay::FreeTargetResource(ResourceId id)
@@ -5215,14 +5783,6 @@ void VulkanReplay::FreeTargetResource(ResourceId id)
   m_pDriver->ReleaseResource(GetResourceManager()->GetCurrentResource(id));
 }
 
-vector<PixelModification> VulkanReplay::PixelHistory(vector<EventUsage> events, ResourceId target,
-                                                     uint32_t x, uint32_t y, uint32_t slice,
-                                                     uint32_t mip, uint32_t sampleIdx)
-{
-  VULKANNOTIMP("PixelHistory");
-  return vector<PixelModification>();
-}
-
 ShaderDebugTrace VulkanReplay::DebugVertex(uint32_t eventID, uint32_t vertid, uint32_t instid,
                                            uint32_t idx, uint32_t instOffset, uint32_t vertOffset)
 {
@@ -29,6 +29,7 @@
 #include "replay/replay_driver.h"
 #include "vk_common.h"
 #include "vk_info.h"
+#include "vk_state.h"
 
 #if defined(RENDERDOC_PLATFORM_WIN32)
 
@@ -103,11 +104,15 @@ public:
   ShaderReflection *GetShader(ResourceId shader, string entryPoint);
 
   vector<EventUsage> GetUsage(ResourceId id);
+  vector<vector<EventUsage> > GetUsages(const vector<ResourceId> &ids)
+  {
+    return GetUsagesSerially(this, ids);
+  }
 
   FetchFrameRecord GetFrameRecord();
   vector<DebugMessage> GetDebugMessages();
 
-  void SavePipelineState();
+  uint32_t SavePipelineState();
   D3D11PipelineState GetD3D11PipelineState() { return m_D3D11PipelineState; }
   GLPipelineState GetGLPipelineState() { return GLPipelineState(); }
   VulkanPipelineState GetVulkanPipelineState() { return m_VulkanPipelineState; }
@@ -131,6 +136,7 @@ public:
 
   void InitPostVSBuffers(uint32_t eventID);
   void InitPostVSBuffers(const vector<uint32_t> &passEvents);
+  void PinPostVSBuffers(const vector<uint32_t> &events);
 
   ResourceId GetLiveID(ResourceId id);
 
@@ -148,6 +154,8 @@ public:
   void GetBufferData(ResourceId buff, uint64_t offset, uint64_t len, vector<byte> &retData);
   byte *GetTextureData(ResourceId tex, uint32_t arrayIdx, uint32_t mip, bool resolve,
                        bool forceRGBA8unorm, float blackPoint, float whitePoint, size_t &dataSize);
+  void GetTextureDataBatch(const vector<TextureDataRequest> &requests,
+                           TextureDataReceiver *receiver);
 
   void ReplaceResource(ResourceId from, ResourceId to);
   void RemoveReplacement(ResourceId id);
@@ -258,6 +266,32 @@ private:
   VulkanPipelineState m_VulkanPipelineState;
   D3D11PipelineState m_D3D11PipelineState;
 
+  // what m_VulkanPipelineState was last built from, so that stepping between events only rebuilds
+  // the sections that changed
+  struct PipelineStateSource
+  {
+    PipelineStateSource() : valid(false), renderState(NULL) {}
+    bool valid;
+    VulkanRenderState renderState;
+
+    // contents of the bound descriptor sets, in binding order
+    vector<DescriptorSetSlot> descriptors;
+
+    // each image with its number of subresource states, and the states themselves
+    vector<pair<ResourceId, size_t> > images;
+    vector<ImageRegionState> imageStates;
+  } m_PipelineStateSource;
+
+  bool UpdateDescriptorSource(PipelineStateSource &src);
+  bool UpdateImageLayoutSource(PipelineStateSource &src);
+
+  void SaveComputeState();
+  void SaveGraphicsState();
+  void SaveDynamicState();
+  void SavePassState();
+  void SaveDescriptorState();
+  void SaveImageLayoutState();
+
   map<uint64_t, OutputWindow> m_OutputWindows;
   uint64_t m_OutputWinID;
   uint64_t m_ActiveWinID;
@@ -289,6 +323,13 @@ private:
 
   bool RenderTextureInternal(TextureDisplay cfg, VkRenderPassBeginInfo rpbegin, bool f32render);
 
+  // GetTextureDataBatch copies plain subresources in batches of up to this many bytes
+  static const VkDeviceSize MaxTextureBatchSize = 256 * 1024 * 1024ULL;
+
+  bool CanBatchTextureData(const TextureDataRequest &req);
+  void ReadbackTextureBatch(const vector<TextureDataRequest> &requests, size_t first,
+                            size_t count, TextureDataReceiver *receiver);
+
   void CreateTexImageView(VkImageAspectFlags aspectFlags, VkImage liveIm,
                           VulkanCreationInfo::Image &iminfo);
 
@@ -743,6 +743,21 @@ bool WrappedVulkan::Serialise_vkCreateDevice(Serialiser *localSerialiser,
     else
       RDCWARN("vertexPipelineStoresAndAtomics = false, output mesh data will not be available");
 
+    if(availFeatures.occlusionQueryPrecise)
+      enabledFeatures.occlusionQueryPrecise = true;
+    else
+      RDCWARN("occlusionQueryPrecise = false, pixel history can't count fragments");
+
+    if(availFeatures.depthClamp)
+      enabledFeatures.depthClamp = true;
+    else
+      RDCWARN("depthClamp = false, pixel history can't detect depth clipping");
+
+    if(availFeatures.pipelineStatisticsQuery)
+      enabledFeatures.pipelineStatisticsQuery = true;
+    else
+      RDCWARN("pipelineStatisticsQuery = false, pipeline statistics counters aren't available");
+
     uint32_t numExts = 0;
 
     VkResult vkr =
@@ -1073,6 +1088,9 @@ void WrappedVulkan::vkDestroyDevice(VkDevice device, const VkAllocationCallbacks
   SubmitSemaphores();
   FlushQ();
 
+  // a capture still being written needs the device to free its readback
+  FinishCaptureWrite(true);
+
   // MULTIDEVICE this function will need to check if the device is the one we
   // used for debugmanager/cmd pool etc, and only remove child queues and
   // resources (instead of doing full resource manager shutdown).
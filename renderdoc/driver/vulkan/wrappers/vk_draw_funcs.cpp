@@ -439,7 +439,7 @@ bool WrappedVulkan::Serialise_vkCmdDispatch(Serialiser *localSerialiser,
     {
       commandBuffer = RerecordCmdBuf(cmdid);
 
-      uint32_t eventID = HandlePreCallback(commandBuffer, true);
+      uint32_t eventID = HandlePreCallback(commandBuffer, eDraw_Dispatch);
 
       ObjDisp(commandBuffer)->CmdDispatch(Unwrap(commandBuffer), X, Y, Z);
 
@@ -518,7 +518,7 @@ bool WrappedVulkan::Serialise_vkCmdDispatchIndirect(Serialiser *localSerialiser,
     {
       commandBuffer = RerecordCmdBuf(cmdid);
 
-      uint32_t eventID = HandlePreCallback(commandBuffer, true);
+      uint32_t eventID = HandlePreCallback(commandBuffer, eDraw_Dispatch);
 
       ObjDisp(commandBuffer)->CmdDispatchIndirect(Unwrap(commandBuffer), Unwrap(buffer), offs);
 
@@ -625,9 +625,15 @@ bool WrappedVulkan::Serialise_vkCmdBlitImage(Serialiser *localSerialiser,
     if(ShouldRerecordCmd(cmdid) && InRerecordRange())
     {
       commandBuffer = RerecordCmdBuf(cmdid);
+
+      uint32_t eventID = HandlePreCallback(commandBuffer, eDraw_Resolve);
+
       ObjDisp(commandBuffer)
           ->CmdBlitImage(Unwrap(commandBuffer), Unwrap(srcImage), srclayout, Unwrap(destImage),
                          dstlayout, count, regions, f);
+
+      if(eventID)
+        m_DrawcallCallback->PostMisc(eventID, eDraw_Resolve, commandBuffer);
     }
   }
   else if(m_State == READING)
@@ -740,9 +746,15 @@ bool WrappedVulkan::Serialise_vkCmdResolveImage(Serialiser *localSerialiser,
     if(ShouldRerecordCmd(cmdid) && InRerecordRange())
     {
       commandBuffer = RerecordCmdBuf(cmdid);
+
+      uint32_t eventID = HandlePreCallback(commandBuffer, eDraw_Resolve);
+
       ObjDisp(commandBuffer)
           ->CmdResolveImage(Unwrap(commandBuffer), Unwrap(srcImage), srclayout, Unwrap(destImage),
                             dstlayout, count, regions);
+
+      if(eventID)
+        m_DrawcallCallback->PostMisc(eventID, eDraw_Resolve, commandBuffer);
     }
   }
   else if(m_State == READING)
@@ -855,9 +867,15 @@ bool WrappedVulkan::Serialise_vkCmdCopyImage(Serialiser *localSerialiser,
     if(ShouldRerecordCmd(cmdid) && InRerecordRange())
     {
       commandBuffer = RerecordCmdBuf(cmdid);
+
+      uint32_t eventID = HandlePreCallback(commandBuffer, eDraw_Copy);
+
       ObjDisp(commandBuffer)
           ->CmdCopyImage(Unwrap(commandBuffer), Unwrap(srcImage), srclayout, Unwrap(destImage),
                          dstlayout, count, regions);
+
+      if(eventID)
+        m_DrawcallCallback->PostMisc(eventID, eDraw_Copy, commandBuffer);
     }
   }
   else if(m_State == READING)
@@ -970,9 +988,15 @@ bool WrappedVulkan::Serialise_vkCmdCopyBufferToImage(Serialiser *localSerialiser
     if(ShouldRerecordCmd(cmdid) && InRerecordRange())
     {
       commandBuffer = RerecordCmdBuf(cmdid);
+
+      uint32_t eventID = HandlePreCallback(commandBuffer, eDraw_Copy);
+
       ObjDisp(commandBuffer)
           ->CmdCopyBufferToImage(Unwrap(commandBuffer), Unwrap(srcBuffer), Unwrap(destImage),
                                  layout, count, regions);
+
+      if(eventID)
+        m_DrawcallCallback->PostMisc(eventID, eDraw_Copy, commandBuffer);
     }
   }
   else if(m_State == READING)
@@ -1076,9 +1100,15 @@ bool WrappedVulkan::Serialise_vkCmdCopyImageToBuffer(Serialiser *localSerialiser
     if(ShouldRerecordCmd(cmdid) && InRerecordRange())
     {
       commandBuffer = RerecordCmdBuf(cmdid);
+
+      uint32_t eventID = HandlePreCallback(commandBuffer, eDraw_Copy);
+
       ObjDisp(commandBuffer)
           ->CmdCopyImageToBuffer(Unwrap(commandBuffer), Unwrap(srcImage), layout,
                                  Unwrap(destBuffer), count, regions);
+
+      if(eventID)
+        m_DrawcallCallback->PostMisc(eventID, eDraw_Copy, commandBuffer);
     }
   }
   else if(m_State == READING)
@@ -1183,9 +1213,15 @@ bool WrappedVulkan::Serialise_vkCmdCopyBuffer(Serialiser *localSerialiser,
     if(ShouldRerecordCmd(cmdid) && InRerecordRange())
     {
       commandBuffer = RerecordCmdBuf(cmdid);
+
+      uint32_t eventID = HandlePreCallback(commandBuffer, eDraw_Copy);
+
       ObjDisp(commandBuffer)
           ->CmdCopyBuffer(Unwrap(commandBuffer), Unwrap(srcBuffer), Unwrap(destBuffer), count,
                           regions);
+
+      if(eventID)
+        m_DrawcallCallback->PostMisc(eventID, eDraw_Copy, commandBuffer);
     }
   }
   else if(m_State == READING)
@@ -1299,8 +1335,14 @@ bool WrappedVulkan::Serialise_vkCmdClearColorImage(Serialiser *localSerialiser,
     if(ShouldRerecordCmd(cmdid) && InRerecordRange())
     {
       commandBuffer = RerecordCmdBuf(cmdid);
+
+      uint32_t eventID = HandlePreCallback(commandBuffer, eDraw_Clear);
+
       ObjDisp(commandBuffer)
           ->CmdClearColorImage(Unwrap(commandBuffer), Unwrap(image), layout, &col, count, ranges);
+
+      if(eventID)
+        m_DrawcallCallback->PostMisc(eventID, eDraw_Clear, commandBuffer);
     }
   }
   else if(m_State == READING)
@@ -1387,8 +1429,14 @@ bool WrappedVulkan::Serialise_vkCmdClearDepthStencilImage(
     if(ShouldRerecordCmd(cmdid) && InRerecordRange())
     {
       commandBuffer = RerecordCmdBuf(cmdid);
+
+      uint32_t eventID = HandlePreCallback(commandBuffer, eDraw_Clear);
+
       ObjDisp(commandBuffer)
           ->CmdClearDepthStencilImage(Unwrap(commandBuffer), Unwrap(image), l, &ds, count, ranges);
+
+      if(eventID)
+        m_DrawcallCallback->PostMisc(eventID, eDraw_Clear, commandBuffer);
     }
   }
   else if(m_State == READING)
@@ -1478,7 +1526,13 @@ bool WrappedVulkan::Serialise_vkCmdClearAttachments(Serialiser *localSerialiser,
     if(ShouldRerecordCmd(cmdid) && InRerecordRange())
     {
       commandBuffer = RerecordCmdBuf(cmdid);
+
+      uint32_t eventID = HandlePreCallback(commandBuffer, eDraw_Clear);
+
       ObjDisp(commandBuffer)->CmdClearAttachments(Unwrap(commandBuffer), acount, atts, rcount, rects);
+
+      if(eventID)
+        m_DrawcallCallback->PostMisc(eventID, eDraw_Clear, commandBuffer);
     }
   }
   else if(m_State == READING)
@@ -490,6 +490,9 @@ VkResult WrappedVulkan::vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR
     RenderDoc::Inst().Tick();
 
     GetResourceManager()->FlushPendingDirty();
+
+    // clean up after the last capture once it's been written, without waiting for it
+    FinishCaptureWrite(false);
   }
 
   m_FrameCounter++;    // first present becomes frame #1, this function is at the end of the frame
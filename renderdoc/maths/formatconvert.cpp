@@ -0,0 +1,677 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "formatconvert.h"
+#include <string.h>
+#include <algorithm>
+#include "api/replay/renderdoc_replay.h"
+#include "common/common.h"
+#include "formatpacking.h"
+
+#if defined(RDC_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if defined(RDC_SSE2)
+static inline __m128i Select(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// four halves in the low 16 bits of each lane, to float bits
+static inline __m128i HalfToFloatBits(__m128i h)
+{
+  const __m128i signBit = _mm_set1_epi32(0x8000);
+
+  __m128i sign = _mm_slli_epi32(_mm_and_si128(h, signBit), 16);
+  __m128i em = _mm_andnot_si128(signBit, h);
+
+  __m128i normal = _mm_add_epi32(_mm_slli_epi32(em, 13), _mm_set1_epi32((127 - 15) << 23));
+
+  // subnormals are mantissa * 2^-24, which a float represents exactly
+  __m128i subnormal =
+      _mm_castps_si128(_mm_mul_ps(_mm_cvtepi32_ps(em), _mm_set1_ps(1.0f / 16777216.0f)));
+
+  __m128i isSubnormal = _mm_cmplt_epi32(em, _mm_set1_epi32(0x0400));
+  __m128i isInfNaN = _mm_cmpgt_epi32(em, _mm_set1_epi32(0x7bff));
+  __m128i isZero = _mm_cmpeq_epi32(em, _mm_setzero_si128());
+
+  __m128i ret = Select(isSubnormal, subnormal, normal);
+
+  // as in ConvertFromHalf, zero is always positive and inf/NaN all become the same NaN
+  ret = _mm_or_si128(ret, _mm_andnot_si128(_mm_or_si128(isZero, isInfNaN), sign));
+
+  return Select(isInfNaN, _mm_set1_epi32(0x7F800001), ret);
+}
+
+// four floats to halves, in the low 16 bits of each lane
+static inline __m128i FloatToHalfBits(__m128 f)
+{
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i infinity = _mm_set1_epi32(0x7c00);
+
+  __m128i i = _mm_castps_si128(f);
+  __m128i sign = _mm_and_si128(_mm_srli_epi32(i, 16), _mm_set1_epi32(0x8000));
+  __m128i abs = _mm_and_si128(i, _mm_set1_epi32(0x7fffffff));
+
+  // normal halves round the mantissa to nearest even, carrying into the exponent, and clamp
+  // anything too large to infinity
+  __m128i lsb = _mm_and_si128(_mm_srli_epi32(abs, 13), one);
+  __m128i normal = _mm_sub_epi32(abs, _mm_set1_epi32((127 - 15) << 23));
+  normal = _mm_srli_epi32(_mm_add_epi32(normal, _mm_add_epi32(_mm_set1_epi32(0xfff), lsb)), 13);
+  normal = Select(_mm_cmpgt_epi32(normal, infinity), infinity, normal);
+
+  // the mantissa of a subnormal half is the value * 2^24 rounded to nearest even, and anything
+  // too small for a half rounds to 0
+  __m128i subnormal =
+      _mm_cvtps_epi32(_mm_mul_ps(_mm_castsi128_ps(abs), _mm_set1_ps(16777216.0f)));
+
+  // NaNs keep the top of their payload, with the low bit set if that would make them infinity
+  __m128i payload = _mm_srli_epi32(_mm_and_si128(abs, _mm_set1_epi32(0x007fffff)), 13);
+  __m128i payloadZero = _mm_cmpeq_epi32(payload, _mm_setzero_si128());
+  payload = _mm_or_si128(payload, _mm_and_si128(payloadZero, one));
+  __m128i isNaN = _mm_cmpgt_epi32(abs, _mm_set1_epi32(0x7f800000));
+  __m128i infnan = _mm_or_si128(infinity, _mm_and_si128(isNaN, payload));
+
+  __m128i ret = Select(_mm_cmplt_epi32(abs, _mm_set1_epi32((127 - 14) << 23)), subnormal, normal);
+  ret = Select(_mm_cmpgt_epi32(abs, _mm_set1_epi32(0x7f7fffff)), infnan, ret);
+
+  return _mm_or_si128(ret, sign);
+}
+
+// writes four texels from one register per channel
+static inline void StoreChannels(__m128 x, __m128 y, __m128 z, __m128 w, Vec4f *dst)
+{
+  _MM_TRANSPOSE4_PS(x, y, z, w);
+
+  _mm_storeu_ps(&dst[0].x, x);
+  _mm_storeu_ps(&dst[1].x, y);
+  _mm_storeu_ps(&dst[2].x, z);
+  _mm_storeu_ps(&dst[3].x, w);
+}
+
+// one channel of four R11G11B10 texels, from the given bit offset
+static inline __m128 UnpackSmallFloat(__m128i packed, int offset, int mantissaBits)
+{
+  __m128i mantissa = _mm_srl_epi32(packed, _mm_cvtsi32_si128(offset));
+  mantissa = _mm_and_si128(mantissa, _mm_set1_epi32((1 << mantissaBits) - 1));
+
+  __m128i exponent = _mm_srl_epi32(packed, _mm_cvtsi32_si128(offset + mantissaBits));
+  exponent = _mm_and_si128(exponent, _mm_set1_epi32(0x1f));
+
+  __m128i shiftedMantissa = _mm_sll_epi32(mantissa, _mm_cvtsi32_si128(23 - mantissaBits));
+
+  __m128i normal = _mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(127 - 15)), 23);
+  normal = _mm_or_si128(normal, shiftedMantissa);
+
+  __m128i infnan = _mm_or_si128(_mm_set1_epi32(0x7f800000), shiftedMantissa);
+
+  // denormals are mantissa * 2^(-14 - mantissaBits), exactly
+  __m128 scale = _mm_castsi128_ps(_mm_set1_epi32((127 - 14 - mantissaBits) << 23));
+  __m128i denormal = _mm_castps_si128(_mm_mul_ps(_mm_cvtepi32_ps(mantissa), scale));
+
+  __m128i ret = Select(_mm_cmpeq_epi32(exponent, _mm_setzero_si128()), denormal, normal);
+  ret = Select(_mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x1f)), infnan, ret);
+
+  return _mm_castsi128_ps(ret);
+}
+#endif
+
+void ConvertFromHalf(const uint16_t *src, float *dst, size_t count)
+{
+  size_t i = 0;
+
+#if defined(RDC_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+
+  for(; i + 8 <= count; i += 8)
+  {
+    __m128i h = _mm_loadu_si128((const __m128i *)(src + i));
+
+    _mm_storeu_si128((__m128i *)(dst + i), HalfToFloatBits(_mm_unpacklo_epi16(h, zero)));
+    _mm_storeu_si128((__m128i *)(dst + i + 4), HalfToFloatBits(_mm_unpackhi_epi16(h, zero)));
+  }
+#endif
+
+  for(; i < count; i++)
+    dst[i] = ConvertFromHalf(src[i]);
+}
+
+void ConvertToHalf(const float *src, uint16_t *dst, size_t count)
+{
+  size_t i = 0;
+
+#if defined(RDC_SSE2)
+  for(; i + 8 <= count; i += 8)
+  {
+    __m128i lo = FloatToHalfBits(_mm_loadu_ps(src + i));
+    __m128i hi = FloatToHalfBits(_mm_loadu_ps(src + i + 4));
+
+    // sign extend, so that the saturating pack leaves the values alone
+    lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+    hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(lo, hi));
+  }
+#endif
+
+  for(; i < count; i++)
+    dst[i] = ConvertToHalf(src[i]);
+}
+
+static void DecodeR10G10B10A2(const uint32_t *src, size_t count, bool normalised, bool bgra,
+                              Vec4f *dst)
+{
+  size_t i = 0;
+
+#if defined(RDC_SSE2)
+  const __m128i mask = _mm_set1_epi32(0x3ff);
+  const __m128 rgbDivisor = _mm_set1_ps(normalised ? 1023.0f : 1.0f);
+  const __m128 alphaDivisor = _mm_set1_ps(normalised ? 3.0f : 1.0f);
+
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i packed = _mm_loadu_si128((const __m128i *)(src + i));
+
+    // divides rather than multiplying by the reciprocal, to match the scalar conversion
+    __m128 r = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(packed, mask)), rgbDivisor);
+    __m128 g =
+        _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 10), mask)), rgbDivisor);
+    __m128 b =
+        _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 20), mask)), rgbDivisor);
+    __m128 a = _mm_div_ps(_mm_cvtepi32_ps(_mm_srli_epi32(packed, 30)), alphaDivisor);
+
+    if(bgra)
+      StoreChannels(b, g, r, a, dst + i);
+    else
+      StoreChannels(r, g, b, a, dst + i);
+  }
+#endif
+
+  for(; i < count; i++)
+  {
+    if(normalised)
+      dst[i] = ConvertFromR10G10B10A2(src[i]);
+    else
+      dst[i] = Vec4f(float((src[i] >> 0) & 0x3ff), float((src[i] >> 10) & 0x3ff),
+                     float((src[i] >> 20) & 0x3ff), float((src[i] >> 30) & 0x003));
+
+    if(bgra)
+      std::swap(dst[i].x, dst[i].z);
+  }
+}
+
+void ConvertFromR10G10B10A2(const uint32_t *src, Vec4f *dst, size_t count)
+{
+  DecodeR10G10B10A2(src, count, true, false, dst);
+}
+
+void ConvertToR10G10B10A2(const Vec4f *src, uint32_t *dst, size_t count)
+{
+  size_t i = 0;
+
+#if defined(RDC_SSE2)
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 scale = _mm_setr_ps(1023.0f, 1023.0f, 1023.0f, 3.0f);
+
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i texels[4];
+
+    for(int t = 0; t < 4; t++)
+    {
+      // min returns its second operand for NaN, so NaN clamps to 1 like the scalar conversion
+      __m128 v = _mm_max_ps(_mm_min_ps(_mm_loadu_ps(&src[i + t].x), one), zero);
+      texels[t] = _mm_cvttps_epi32(_mm_mul_ps(v, scale));
+    }
+
+    __m128 x = _mm_castsi128_ps(texels[0]);
+    __m128 y = _mm_castsi128_ps(texels[1]);
+    __m128 z = _mm_castsi128_ps(texels[2]);
+    __m128 w = _mm_castsi128_ps(texels[3]);
+
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+
+    __m128i packed = _mm_castps_si128(x);
+    packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_castps_si128(y), 10));
+    packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_castps_si128(z), 20));
+    packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_castps_si128(w), 30));
+
+    _mm_storeu_si128((__m128i *)(dst + i), packed);
+  }
+#endif
+
+  for(; i < count; i++)
+    dst[i] = ConvertToR10G10B10A2(src[i]);
+}
+
+static void DecodeR11G11B10(const uint32_t *src, size_t count, Vec4f *dst)
+{
+  size_t i = 0;
+
+#if defined(RDC_SSE2)
+  const __m128 one = _mm_set1_ps(1.0f);
+
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i packed = _mm_loadu_si128((const __m128i *)(src + i));
+
+    StoreChannels(UnpackSmallFloat(packed, 0, 6), UnpackSmallFloat(packed, 11, 6),
+                  UnpackSmallFloat(packed, 22, 5), one, dst + i);
+  }
+#endif
+
+  for(; i < count; i++)
+  {
+    Vec3f v = ConvertFromR11G11B10(src[i]);
+    dst[i] = Vec4f(v.x, v.y, v.z, 1.0f);
+  }
+}
+
+static void DecodeR9G9B9E5(const uint32_t *src, size_t count, Vec4f *dst)
+{
+  size_t i = 0;
+
+#if defined(RDC_SSE2)
+  const __m128i mask = _mm_set1_epi32(0x1ff);
+  const __m128 one = _mm_set1_ps(1.0f);
+
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i packed = _mm_loadu_si128((const __m128i *)(src + i));
+
+    __m128i exponent = _mm_srli_epi32(packed, 27);
+    __m128 scale =
+        _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(127 - 15 - 9)), 23));
+
+    __m128 r = _mm_cvtepi32_ps(_mm_and_si128(packed, mask));
+    __m128 g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 9), mask));
+    __m128 b = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 18), mask));
+
+    StoreChannels(_mm_mul_ps(r, scale), _mm_mul_ps(g, scale), _mm_mul_ps(b, scale), one, dst + i);
+  }
+#endif
+
+  for(; i < count; i++)
+  {
+    Vec3f v = ConvertFromR9G9B9E5(src[i]);
+    dst[i] = Vec4f(v.x, v.y, v.z, 1.0f);
+  }
+}
+
+// the packed 16-bit helpers return blue in x, from the low bits
+static void DecodePacked16(const ResourceFormat &fmt, const uint16_t *src, size_t count,
+                           Vec4f *dst)
+{
+  for(size_t i = 0; i < count; i++)
+  {
+    if(fmt.specialFormat == eSpecial_R5G6B5)
+    {
+      Vec3f v = ConvertFromB5G6R5(src[i]);
+      dst[i] = Vec4f(v.x, v.y, v.z, 1.0f);
+    }
+    else if(fmt.specialFormat == eSpecial_R5G5B5A1)
+    {
+      dst[i] = ConvertFromB5G5R5A1(src[i]);
+    }
+    else
+    {
+      dst[i] = ConvertFromB4G4R4A4(src[i]);
+    }
+
+    if(!fmt.bgraOrder)
+      std::swap(dst[i].x, dst[i].z);
+  }
+}
+
+static void DecodeSpecial(const ResourceFormat &fmt, const uint8_t *src, size_t count, Vec4f *dst)
+{
+  const uint32_t *u32 = (const uint32_t *)src;
+
+  switch(fmt.specialFormat)
+  {
+    case eSpecial_R10G10B10A2:
+      DecodeR10G10B10A2(u32, count, fmt.compType != eCompType_UInt, fmt.bgraOrder != 0, dst);
+      break;
+    case eSpecial_R11G11B10: DecodeR11G11B10(u32, count, dst); break;
+    case eSpecial_R9G9B9E5: DecodeR9G9B9E5(u32, count, dst); break;
+    case eSpecial_R5G6B5:
+    case eSpecial_R5G5B5A1:
+    case eSpecial_R4G4B4A4: DecodePacked16(fmt, (const uint16_t *)src, count, dst); break;
+    case eSpecial_R4G4:
+      for(size_t i = 0; i < count; i++)
+        dst[i] = Vec4f(float(src[i] >> 4) / 15.0f, float(src[i] & 0xf) / 15.0f, 0.0f, 1.0f);
+      break;
+    // depth-stencil formats are sampled as depth only
+    case eSpecial_D24S8:
+      for(size_t i = 0; i < count; i++)
+        dst[i] = Vec4f(float(u32[i] & 0xffffff) / 16777215.0f, 0.0f, 0.0f, 1.0f);
+      break;
+    // depth packed with the stencil byte straight after, as in SaveTexture
+    case eSpecial_D32S8:
+      for(size_t i = 0; i < count; i++)
+      {
+        float depth = 0.0f;
+        memcpy(&depth, src + i * 5, sizeof(float));
+        dst[i] = Vec4f(depth, 0.0f, 0.0f, 1.0f);
+      }
+      break;
+    case eSpecial_S8:
+      for(size_t i = 0; i < count; i++)
+        dst[i] = Vec4f(float(src[i]), 0.0f, 0.0f, 1.0f);
+      break;
+    default: RDCERR("Unexpected special format %u", fmt.specialFormat); break;
+  }
+}
+
+typedef float (*ComponentDecoder)(const uint8_t *data);
+
+static float DecodeFloat(const uint8_t *data)
+{
+  return *(const float *)data;
+}
+
+static float DecodeHalf(const uint8_t *data)
+{
+  return ConvertFromHalf(*(const uint16_t *)data);
+}
+
+static float DecodeDouble(const uint8_t *data)
+{
+  return float(*(const double *)data);
+}
+
+static float DecodeUNorm8(const uint8_t *data)
+{
+  return float(*data) / 255.0f;
+}
+
+static float DecodeSRGB8(const uint8_t *data)
+{
+  return ConvertFromSRGB8(*data);
+}
+
+static float DecodeSNorm8(const uint8_t *data)
+{
+  int8_t i8 = *(const int8_t *)data;
+  return i8 == -128 ? -1.0f : float(i8) / 127.0f;
+}
+
+static float DecodeUNorm16(const uint8_t *data)
+{
+  return float(*(const uint16_t *)data) / 65535.0f;
+}
+
+static float DecodeSNorm16(const uint8_t *data)
+{
+  int16_t i16 = *(const int16_t *)data;
+  return i16 == -32768 ? -1.0f : float(i16) / 32767.0f;
+}
+
+static float DecodeUInt8(const uint8_t *data)
+{
+  return float(*data);
+}
+
+static float DecodeSInt8(const uint8_t *data)
+{
+  return float(*(const int8_t *)data);
+}
+
+static float DecodeUInt16(const uint8_t *data)
+{
+  return float(*(const uint16_t *)data);
+}
+
+static float DecodeSInt16(const uint8_t *data)
+{
+  return float(*(const int16_t *)data);
+}
+
+static float DecodeUInt32(const uint8_t *data)
+{
+  return float(*(const uint32_t *)data);
+}
+
+static float DecodeSInt32(const uint8_t *data)
+{
+  return float(*(const int32_t *)data);
+}
+
+// the same conversions as ConvertComponent, picked once per span instead of once per component
+static ComponentDecoder GetComponentDecoder(const ResourceFormat &fmt)
+{
+  switch(fmt.compType)
+  {
+    case eCompType_Float:
+      if(fmt.compByteWidth == 4)
+        return &DecodeFloat;
+      if(fmt.compByteWidth == 2)
+        return &DecodeHalf;
+      break;
+    case eCompType_Double:
+      if(fmt.compByteWidth == 8)
+        return &DecodeDouble;
+      break;
+    case eCompType_Depth:
+      if(fmt.compByteWidth == 4)
+        return &DecodeFloat;
+      if(fmt.compByteWidth == 2)
+        return &DecodeUNorm16;
+      break;
+    case eCompType_UNorm:
+      if(fmt.compByteWidth == 1)
+        return fmt.srgbCorrected ? &DecodeSRGB8 : &DecodeUNorm8;
+      if(fmt.compByteWidth == 2)
+        return &DecodeUNorm16;
+      break;
+    case eCompType_SNorm:
+      if(fmt.compByteWidth == 1)
+        return &DecodeSNorm8;
+      if(fmt.compByteWidth == 2)
+        return &DecodeSNorm16;
+      break;
+    case eCompType_UInt:
+    case eCompType_UScaled:
+      if(fmt.compByteWidth == 1)
+        return &DecodeUInt8;
+      if(fmt.compByteWidth == 2)
+        return &DecodeUInt16;
+      if(fmt.compByteWidth == 4)
+        return &DecodeUInt32;
+      break;
+    case eCompType_SInt:
+    case eCompType_SScaled:
+      if(fmt.compByteWidth == 1)
+        return &DecodeSInt8;
+      if(fmt.compByteWidth == 2)
+        return &DecodeSInt16;
+      if(fmt.compByteWidth == 4)
+        return &DecodeSInt32;
+      break;
+    default: break;
+  }
+
+  return NULL;
+}
+
+#if defined(RDC_SSE2)
+// RGBA8/BGRA8 unorm, four texels at a time. Returns how many texels were decoded
+static size_t DecodeUNorm8x4(const uint8_t *src, size_t count, bool bgra, Vec4f *dst)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 divisor = _mm_set1_ps(255.0f);
+
+  size_t i = 0;
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i texels = _mm_loadu_si128((const __m128i *)(src + i * 4));
+
+    __m128i lo = _mm_unpacklo_epi8(texels, zero);
+    __m128i hi = _mm_unpackhi_epi8(texels, zero);
+
+    __m128 t[4] = {
+        _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)),
+        _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)),
+        _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)),
+        _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)),
+    };
+
+    for(int c = 0; c < 4; c++)
+    {
+      t[c] = _mm_div_ps(t[c], divisor);
+
+      if(bgra)
+        t[c] = _mm_shuffle_ps(t[c], t[c], _MM_SHUFFLE(3, 0, 1, 2));
+
+      _mm_storeu_ps(&dst[i + c].x, t[c]);
+    }
+  }
+
+  return i;
+}
+#endif
+
+// halves with fewer than four components go through a small buffer, so the bulk conversion can
+// still be used
+static void DecodeHalfComponents(const ResourceFormat &fmt, const uint8_t *src, size_t count,
+                                 Vec4f *dst)
+{
+  const uint32_t compCount = fmt.compCount;
+  const size_t chunkTexels = 64;
+
+  float comps[chunkTexels * 4];
+
+  for(size_t i = 0; i < count; i += chunkTexels)
+  {
+    size_t n = RDCMIN(chunkTexels, count - i);
+
+    ConvertFromHalf((const uint16_t *)src + i * compCount, comps, n * compCount);
+
+    for(size_t t = 0; t < n; t++)
+    {
+      float texel[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+      for(uint32_t c = 0; c < compCount; c++)
+        texel[c] = comps[t * compCount + c];
+
+      if(fmt.bgraOrder)
+        std::swap(texel[0], texel[2]);
+
+      dst[i + t] = Vec4f(texel[0], texel[1], texel[2], texel[3]);
+    }
+  }
+}
+
+static inline bool IsSpecial(const ResourceFormat &fmt)
+{
+  return fmt.special && fmt.specialFormat != eSpecial_Unknown;
+}
+
+uint32_t GetFloat4TexelSize(const ResourceFormat &fmt)
+{
+  if(IsSpecial(fmt))
+  {
+    switch(fmt.specialFormat)
+    {
+      case eSpecial_R10G10B10A2:
+      case eSpecial_R11G11B10:
+      case eSpecial_R9G9B9E5:
+      case eSpecial_D24S8: return 4;
+      case eSpecial_R5G6B5:
+      case eSpecial_R5G5B5A1:
+      case eSpecial_R4G4B4A4: return 2;
+      case eSpecial_R4G4:
+      case eSpecial_S8: return 1;
+      case eSpecial_D32S8: return 5;
+      default: return 0;
+    }
+  }
+
+  if(fmt.compCount < 1 || fmt.compCount > 4 || GetComponentDecoder(fmt) == NULL)
+    return 0;
+
+  return fmt.compCount * fmt.compByteWidth;
+}
+
+bool ConvertToFloat4(const ResourceFormat &fmt, const uint8_t *src, size_t count, Vec4f *dst)
+{
+  if(GetFloat4TexelSize(fmt) == 0)
+    return false;
+
+  if(IsSpecial(fmt))
+  {
+    DecodeSpecial(fmt, src, count, dst);
+    return true;
+  }
+
+  ComponentDecoder decoder = GetComponentDecoder(fmt);
+
+  if(fmt.compCount == 4 && !fmt.bgraOrder)
+  {
+    if(decoder == &DecodeFloat)
+    {
+      memcpy(dst, src, count * sizeof(Vec4f));
+      return true;
+    }
+
+    if(decoder == &DecodeHalf)
+    {
+      ConvertFromHalf((const uint16_t *)src, &dst[0].x, count * 4);
+      return true;
+    }
+  }
+
+  if(decoder == &DecodeHalf)
+  {
+    DecodeHalfComponents(fmt, src, count, dst);
+    return true;
+  }
+
+  size_t i = 0;
+
+#if defined(RDC_SSE2)
+  if(fmt.compCount == 4 && decoder == &DecodeUNorm8)
+    i = DecodeUNorm8x4(src, count, fmt.bgraOrder != 0, dst);
+#endif
+
+  const uint32_t compWidth = fmt.compByteWidth;
+  const uint32_t texelSize = fmt.compCount * compWidth;
+
+  for(; i < count; i++)
+  {
+    const uint8_t *texel = src + i * texelSize;
+
+    float comps[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    for(uint32_t c = 0; c < fmt.compCount; c++)
+      comps[c] = decoder(texel + c * compWidth);
+
+    if(fmt.bgraOrder)
+      std::swap(comps[0], comps[2]);
+
+    dst[i] = Vec4f(comps[0], comps[1], comps[2], comps[3]);
+  }
+
+  return true;
+}
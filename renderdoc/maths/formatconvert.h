@@ -0,0 +1,50 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "vec.h"
+
+struct ResourceFormat;
+
+// Bulk versions of the conversions in formatpacking.h and half_convert.h that work on a whole
+// span at a time, with SSE2 where it's available. The results are bit-identical to calling the
+// per-value functions on each element in turn (this relies on the default round-to-nearest mode).
+
+void ConvertFromHalf(const uint16_t *src, float *dst, size_t count);
+void ConvertToHalf(const float *src, uint16_t *dst, size_t count);
+
+void ConvertFromR10G10B10A2(const uint32_t *src, Vec4f *dst, size_t count);
+void ConvertToR10G10B10A2(const Vec4f *src, uint32_t *dst, size_t count);
+
+// the size in bytes of one texel of fmt, or 0 if ConvertToFloat4 can't decode the format (block
+// compressed, YUV and some depth-stencil formats)
+uint32_t GetFloat4TexelSize(const ResourceFormat &fmt);
+
+// decodes count tightly packed texels of fmt to RGBA floats, the same way sampling the texture
+// would: components are swizzled out of BGRA order and missing components are 0 (alpha 1). Returns
+// false if the format can't be decoded
+bool ConvertToFloat4(const ResourceFormat &fmt, const uint8_t *src, size_t count, Vec4f *dst);
@@ -61,6 +61,7 @@ inline Vec3f ConvertFromR11G11B10(uint32_t data)
   // R11G11B10 has 6/6/5 bit mantissas, 5bit exponents
 
   const int mantissaShift[] = {23 - 6, 23 - 6, 23 - 5};
+  const uint32_t hiddenBit[] = {0x40, 0x40, 0x20};
 
   for(int i = 0; i < 3; i++)
   {
@@ -87,14 +88,14 @@ inline Vec3f ConvertFromR11G11B10(uint32_t data)
         exponents[i] = 1;
 
         // shift until hidden bit is set
-        while((mantissas[i] & 0x40) == 0)
+        while((mantissas[i] & hiddenBit[i]) == 0)
         {
           mantissas[i] <<= 1;
           exponents[i]--;
         }
 
         // remove the hidden bit
-        mantissas[i] &= ~0x40;
+        mantissas[i] &= ~hiddenBit[i];
 
         retu[i] = (exponents[i] + (127 - 15)) << 23 | mantissas[i] << mantissaShift[i];
       }
@@ -104,6 +105,19 @@ inline Vec3f ConvertFromR11G11B10(uint32_t data)
   return ret;
 }
 
+inline Vec3f ConvertFromR9G9B9E5(uint32_t data)
+{
+  // the mantissas have no implicit leading 1, and share an exponent with a bias of 15. Build the
+  // scale 2^(exponent - 15 - 9) directly as a float, it's always a normal float
+  float scale = 0.0f;
+  uint32_t *scaleu = (uint32_t *)&scale;
+
+  *scaleu = (((data >> 27) & 0x1f) + 127 - 15 - 9) << 23;
+
+  return Vec3f(float((data >> 0) & 0x1ff) * scale, float((data >> 9) & 0x1ff) * scale,
+               float((data >> 18) & 0x1ff) * scale);
+}
+
 /*
 inline uint32_t ConvertToR11G11B10(Vec3f data)
 {
@@ -118,14 +118,38 @@ private:
   data m_Data;
 };
 
+template <class data>
+class SemaphoreTemplate
+{
+public:
+  SemaphoreTemplate();
+  ~SemaphoreTemplate();
+  // increments the count by 'count', releasing up to that many waiting threads
+  void Wake(uint32_t count);
+  // waits until the count is non-zero then decrements it. Returns false if timeoutMS
+  // elapsed first
+  bool WaitForWake(uint32_t timeoutMS);
+
+private:
+  // no copying
+  SemaphoreTemplate &operator=(const SemaphoreTemplate &other);
+  SemaphoreTemplate(const SemaphoreTemplate &other);
+
+  data m_Data;
+};
+
 void Init();
 void Shutdown();
 uint64_t AllocateTLSSlot();
+// the slot can be reallocated afterwards. Values any thread stored under it are forgotten, but
+// not freed
+void FreeTLSSlot(uint64_t slot);
 
 void *GetTLSValue(uint64_t slot);
 void SetTLSValue(uint64_t slot, void *value);
 
 // must typedef CriticalSectionTemplate<X> CriticalSection
+// must typedef SemaphoreTemplate<X> Semaphore
 
 typedef void (*ThreadEntry)(void *);
 typedef uint64_t ThreadHandle;
@@ -146,13 +170,19 @@ namespace Network
 class Socket
 {
 public:
-  Socket(ptrdiff_t s) : socket(s) {}
+  Socket(ptrdiff_t s) : socket(s), cancel(NULL) {}
   ~Socket();
   void Shutdown();
 
+  // once set, blocking sends and receives check *flag at least every 100ms and fail - shutting
+  // the socket down - when it becomes non-zero, so another thread can make this one give up
+  void SetCancelFlag(volatile uint32_t *flag) { cancel = flag; }
+
   bool Connected() const;
 
-  Socket *AcceptClient(bool wait);
+  // waits up to timeoutMS for a pending connection. Returns NULL on timeout or error - check
+  // Connected() to tell the two apart.
+  Socket *AcceptClient(uint32_t timeoutMS);
 
   bool IsRecvDataWaiting();
 
@@ -160,7 +190,42 @@ public:
   bool RecvDataBlocking(void *data, uint32_t length);
 
 private:
+  friend class SocketWaiter;
+
+  // with a cancel flag set, waits in short slices until the socket is ready to send or receive.
+  // Returns false if the flag was set
+  bool WaitUnlessCancelled(bool write);
+
   ptrdiff_t socket;
+  volatile uint32_t *cancel;
+};
+
+// lets the thread that owns a socket sleep until data arrives on it, or until another thread has
+// something for it to do, instead of polling both on a timer.
+class SocketWaiter
+{
+public:
+  SocketWaiter();
+  ~SocketWaiter();
+
+  // wakes the thread in Wait(), or the next call to Wait() if none is waiting. Wakes that arrive
+  // while nothing is waiting are coalesced. Safe to call from any thread.
+  void Wake();
+
+  enum
+  {
+    eWait_Timeout = 0x0,
+    eWait_Data = 0x1,
+    eWait_Woken = 0x2,
+  };
+
+  // sleeps for up to timeoutMS until sock is readable (data, a pending connection on a server
+  // socket, or the remote end closing) or Wake() is called. Returns a combination of eWait_*
+  // flags. Errors are returned as eWait_Woken so callers re-check their state.
+  uint32_t Wait(Socket *sock, uint32_t timeoutMS);
+
+private:
+  ptrdiff_t m_Handles[2];
 };
 
 Socket *CreateServerSocket(const char *addr, uint16_t port, int queuesize);
@@ -177,6 +242,9 @@ int32_t Dec32(volatile int32_t *i);
 int64_t Inc64(volatile int64_t *i);
 int64_t Dec64(volatile int64_t *i);
 int64_t ExchAdd64(volatile int64_t *i, int64_t a);
+// returns the value of *i before the operation. *i is set to newVal only if it was oldVal
+int32_t CmpExch32(volatile int32_t *i, int32_t oldVal, int32_t newVal);
+void *CmpExchPtr(void *volatile *dest, void *oldVal, void *newVal);
 };
 
 namespace Callstack
@@ -235,6 +303,9 @@ void GetExecutableFilename(string &selfName);
 uint64_t GetModifiedTimestamp(const string &filename);
 
 void Copy(const char *from, const char *to, bool allowOverwrite);
+// renames a file, replacing the destination in one step if it exists and allowOverwrite is set.
+// Both paths must be on the same volume
+bool Move(const char *from, const char *to, bool allowOverwrite);
 void Delete(const char *path);
 
 FILE *fopen(const char *filename, const char *mode);
@@ -247,6 +318,7 @@ void fseek64(FILE *f, uint64_t offset, int origin);
 
 bool feof(FILE *f);
 
+int fflush(FILE *f);
 int fclose(FILE *f);
 
 // utility functions
@@ -325,6 +397,9 @@ enum
   Output_StdErr
 };
 void WriteOutput(int channel, const char *str);
+
+// physical memory that can be allocated without swapping, or 0 if it can't be determined
+uint64_t GetAvailableSystemMemory();
 };
 
 namespace Bits
@@ -94,4 +94,32 @@ void WriteOutput(int channel, const char *str)
   else if(channel == OSUtility::Output_DebugMon)
     __android_log_print(ANDROID_LOG_INFO, LOGCAT_TAG, "%s", str);
 }
+
+uint64_t GetAvailableSystemMemory()
+{
+  FILE *f = fopen("/proc/meminfo", "r");
+
+  if(f == NULL)
+    return 0;
+
+  uint64_t ret = 0;
+
+  // MemAvailable accounts for reclaimable caches, older kernels only have MemFree
+  char line[256];
+  while(fgets(line, sizeof(line), f))
+  {
+    unsigned long long kb = 0;
+    if(sscanf(line, "MemAvailable: %llu kB", &kb) == 1)
+    {
+      ret = kb * 1024;
+      break;
+    }
+    if(sscanf(line, "MemFree: %llu kB", &kb) == 1)
+      ret = kb * 1024;
+  }
+
+  fclose(f);
+
+  return ret;
+}
 };
@@ -100,6 +100,14 @@ void GetExecutableFilename(string &selfName)
 }
 };
 
+namespace OSUtility
+{
+uint64_t GetAvailableSystemMemory()
+{
+  return 0;
+}
+};
+
 namespace StringFormat
 {
 string Wide2UTF8(const std::wstring &s)
@@ -27,6 +27,7 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -69,35 +70,77 @@ bool Socket::Connected() const
   return (int)socket != -1;
 }
 
-Socket *Socket::AcceptClient(bool wait)
+Socket *Socket::AcceptClient(uint32_t timeoutMS)
 {
-  do
+  // sleep in poll() until a connection is pending, rather than spinning on accept()
+  pollfd pfd = {};
+  pfd.fd = (int)socket;
+  pfd.events = POLLIN;
+
+  int ret = poll(&pfd, 1, (int)timeoutMS);
+
+  if(ret < 0)
   {
-    int s = accept(socket, NULL, NULL);
+    int err = errno;
 
-    if(s != -1)
+    if(err != EINTR)
     {
-      int flags = fcntl(s, F_GETFL, 0);
-      fcntl(s, F_SETFL, flags | O_NONBLOCK);
+      RDCWARN("poll: %d", err);
+      Shutdown();
+    }
+
+    return NULL;
+  }
 
-      int nodelay = 1;
-      setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (char *)&nodelay, sizeof(nodelay));
+  if(ret == 0)
+    return NULL;
 
-      return new Socket((ptrdiff_t)s);
-    }
+  int s = accept(socket, NULL, NULL);
 
-    int err = errno;
+  if(s != -1)
+  {
+    int flags = fcntl(s, F_GETFL, 0);
+    fcntl(s, F_SETFL, flags | O_NONBLOCK);
+
+    int nodelay = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (char *)&nodelay, sizeof(nodelay));
 
-    if(err != EWOULDBLOCK)
+    return new Socket((ptrdiff_t)s);
+  }
+
+  int err = errno;
+
+  if(err != EWOULDBLOCK)
+  {
+    RDCWARN("accept: %d", err);
+    Shutdown();
+  }
+
+  return NULL;
+}
+
+bool Socket::WaitUnlessCancelled(bool write)
+{
+  if(cancel == NULL)
+    return true;
+
+  for(;;)
+  {
+    if(*cancel)
     {
-      RDCWARN("accept: %d", err);
+      RDCWARN("Socket operation cancelled");
       Shutdown();
+      return false;
     }
 
-    Threading::Sleep(4);
-  } while(wait);
+    pollfd pfd = {};
+    pfd.fd = (int)socket;
+    pfd.events = write ? POLLOUT : POLLIN;
 
-  return NULL;
+    // ready, or an error that the send/recv will report
+    if(poll(&pfd, 1, 100) != 0)
+      return true;
+  }
 }
 
 bool Socket::SendDataBlocking(const void *buf, uint32_t length)
@@ -109,11 +152,21 @@ bool Socket::SendDataBlocking(const void *buf, uint32_t length)
 
   char *src = (char *)buf;
 
-  int flags = fcntl(socket, F_GETFL, 0);
-  fcntl(socket, F_SETFL, flags & ~O_NONBLOCK);
+  // cancellable sockets stay non-blocking and wait in WaitUnlessCancelled instead
+  bool blocking = (cancel == NULL);
+
+  int flags = 0;
+  if(blocking)
+  {
+    flags = fcntl(socket, F_GETFL, 0);
+    fcntl(socket, F_SETFL, flags & ~O_NONBLOCK);
+  }
 
   while(sent < length)
   {
+    if(!WaitUnlessCancelled(true))
+      return false;
+
     int ret = send(socket, src, length - sent, 0);
 
     if(ret <= 0)
@@ -136,8 +189,11 @@ bool Socket::SendDataBlocking(const void *buf, uint32_t length)
     src += ret;
   }
 
-  flags = fcntl(socket, F_GETFL, 0);
-  fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+  if(blocking)
+  {
+    flags = fcntl(socket, F_GETFL, 0);
+    fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+  }
 
   RDCASSERT(sent == length);
 
@@ -182,11 +238,20 @@ bool Socket::RecvDataBlocking(void *buf, uint32_t length)
 
   char *dst = (char *)buf;
 
-  int flags = fcntl(socket, F_GETFL, 0);
-  fcntl(socket, F_SETFL, flags & ~O_NONBLOCK);
+  bool blocking = (cancel == NULL);
+
+  int flags = 0;
+  if(blocking)
+  {
+    flags = fcntl(socket, F_GETFL, 0);
+    fcntl(socket, F_SETFL, flags & ~O_NONBLOCK);
+  }
 
   while(received < length)
   {
+    if(!WaitUnlessCancelled(false))
+      return false;
+
     int ret = recv(socket, dst, length - received, 0);
 
     if(ret == 0)
@@ -214,14 +279,110 @@ bool Socket::RecvDataBlocking(void *buf, uint32_t length)
     dst += ret;
   }
 
-  flags = fcntl(socket, F_GETFL, 0);
-  fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+  if(blocking)
+  {
+    flags = fcntl(socket, F_GETFL, 0);
+    fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+  }
 
   RDCASSERT(received == length);
 
   return true;
 }
 
+SocketWaiter::SocketWaiter()
+{
+  // a self-pipe - Wake() writes a byte to it, and Wait() polls its read end alongside the socket
+  int fds[2] = {-1, -1};
+
+  if(pipe(fds) != 0)
+  {
+    RDCWARN("pipe: %d", errno);
+    fds[0] = fds[1] = -1;
+  }
+
+  for(int i = 0; i < 2; i++)
+  {
+    if(fds[i] == -1)
+      continue;
+
+    int flags = fcntl(fds[i], F_GETFL, 0);
+    fcntl(fds[i], F_SETFL, flags | O_NONBLOCK);
+    fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+  }
+
+  m_Handles[0] = fds[0];
+  m_Handles[1] = fds[1];
+}
+
+SocketWaiter::~SocketWaiter()
+{
+  for(int i = 0; i < 2; i++)
+    if((int)m_Handles[i] != -1)
+      close((int)m_Handles[i]);
+}
+
+void SocketWaiter::Wake()
+{
+  if((int)m_Handles[1] == -1)
+    return;
+
+  // if the pipe is full there are already wakes pending, so a failed write doesn't matter
+  char dummy = 0;
+  ssize_t ret = write((int)m_Handles[1], &dummy, 1);
+  (void)ret;
+}
+
+uint32_t SocketWaiter::Wait(Socket *sock, uint32_t timeoutMS)
+{
+  pollfd pfds[2] = {};
+  nfds_t numfds = 0;
+
+  if(sock && sock->Connected())
+  {
+    pfds[numfds].fd = (int)sock->socket;
+    pfds[numfds].events = POLLIN;
+    numfds++;
+  }
+
+  int wakeIdx = -1;
+
+  if((int)m_Handles[0] != -1)
+  {
+    wakeIdx = (int)numfds;
+    pfds[numfds].fd = (int)m_Handles[0];
+    pfds[numfds].events = POLLIN;
+    numfds++;
+  }
+
+  int ret = poll(pfds, numfds, (int)timeoutMS);
+
+  if(ret < 0)
+    return errno == EINTR ? eWait_Timeout : eWait_Woken;
+
+  if(ret == 0)
+    return eWait_Timeout;
+
+  uint32_t result = eWait_Timeout;
+
+  // hangups and errors are reported as data, so the owner's next recv notices the closed socket
+  if(wakeIdx != 0 && pfds[0].revents != 0)
+    result |= eWait_Data;
+
+  if(wakeIdx >= 0 && pfds[wakeIdx].revents != 0)
+  {
+    // drain every pending wake, they're all serviced by this one
+    char dummy[64];
+    while(read((int)m_Handles[0], dummy, sizeof(dummy)) > 0)
+    {
+    }
+
+    result |= eWait_Woken;
+  }
+
+  return result;
+}
+
 Socket *CreateServerSocket(const char *bindaddr, uint16_t port, int queuesize)
 {
   int s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
@@ -293,12 +454,19 @@ Socket *CreateClientSocket(const char *host, uint16_t port, int timeoutMS)
 
       int err = errno;
 
-      if(err == EWOULDBLOCK)
+      // non-blocking sockets report a connection in progress with EINPROGRESS
+      if(err == EWOULDBLOCK || err == EINPROGRESS)
       {
         timeval timeout;
         timeout.tv_sec = (timeoutMS / 1000);
         timeout.tv_usec = (timeoutMS % 1000) * 1000;
-        result = select(0, NULL, &set, NULL, &timeout);
+        result = select(s + 1, NULL, &set, NULL, &timeout);
+
+        int sockerr = 0;
+        socklen_t len = sizeof(sockerr);
+        if(result > 0 && getsockopt(s, SOL_SOCKET, SO_ERROR, (char *)&sockerr, &len) == 0 &&
+           sockerr != 0)
+          result = -1;
 
         if(result <= 0)
         {
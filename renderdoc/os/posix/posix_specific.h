@@ -61,6 +61,14 @@ struct pthreadLockData
   pthread_mutexattr_t attr;
 };
 typedef CriticalSectionTemplate<pthreadLockData> CriticalSection;
+
+struct pthreadSemaphoreData
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  uint32_t count;
+};
+typedef SemaphoreTemplate<pthreadSemaphoreData> Semaphore;
 };
 
 namespace Bits
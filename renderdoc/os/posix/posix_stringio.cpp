@@ -239,6 +239,17 @@ void Copy(const char *from, const char *to, bool allowOverwrite)
   ::fclose(tf);
 }
 
+bool Move(const char *from, const char *to, bool allowOverwrite)
+{
+  if(!allowOverwrite && access(to, F_OK) == 0)
+  {
+    RDCERR("Destination file for non-overwriting move '%s' already exists", to);
+    return false;
+  }
+
+  return ::rename(from, to) == 0;
+}
+
 void Delete(const char *path)
 {
   unlink(path);
@@ -272,6 +283,11 @@ bool feof(FILE *f)
   return ::feof(f) != 0;
 }
 
+int fflush(FILE *f)
+{
+  return ::fflush(f);
+}
+
 int fclose(FILE *f)
 {
   return ::fclose(f);
@@ -22,6 +22,8 @@
  * THE SOFTWARE.
  ******************************************************************************/
 
+#include <errno.h>
+#include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 #include "os/os_specific.h"
@@ -57,6 +59,16 @@ int64_t ExchAdd64(volatile int64_t *i, int64_t a)
 {
   return __sync_add_and_fetch(i, int64_t(a));
 }
+
+int32_t CmpExch32(volatile int32_t *i, int32_t oldVal, int32_t newVal)
+{
+  return __sync_val_compare_and_swap(i, oldVal, newVal);
+}
+
+void *CmpExchPtr(void *volatile *dest, void *oldVal, void *newVal)
+{
+  return __sync_val_compare_and_swap(dest, oldVal, newVal);
+}
 };
 
 namespace Threading
@@ -94,6 +106,63 @@ void CriticalSection::Unlock()
   pthread_mutex_unlock(&m_Data.lock);
 }
 
+template <>
+Semaphore::SemaphoreTemplate()
+{
+  pthread_mutex_init(&m_Data.lock, NULL);
+  pthread_cond_init(&m_Data.cond, NULL);
+  m_Data.count = 0;
+}
+
+template <>
+Semaphore::~SemaphoreTemplate()
+{
+  pthread_cond_destroy(&m_Data.cond);
+  pthread_mutex_destroy(&m_Data.lock);
+}
+
+template <>
+void Semaphore::Wake(uint32_t count)
+{
+  pthread_mutex_lock(&m_Data.lock);
+  m_Data.count += count;
+  if(count == 1)
+    pthread_cond_signal(&m_Data.cond);
+  else
+    pthread_cond_broadcast(&m_Data.cond);
+  pthread_mutex_unlock(&m_Data.lock);
+}
+
+template <>
+bool Semaphore::WaitForWake(uint32_t timeoutMS)
+{
+  // gettimeofday rather than clock_gettime as the latter isn't available everywhere we build
+  timeval now;
+  gettimeofday(&now, NULL);
+
+  uint64_t nsec = uint64_t(now.tv_usec) * 1000 + uint64_t(timeoutMS % 1000) * 1000000;
+
+  timespec abstime;
+  abstime.tv_sec = now.tv_sec + timeoutMS / 1000 + time_t(nsec / 1000000000);
+  abstime.tv_nsec = long(nsec % 1000000000);
+
+  pthread_mutex_lock(&m_Data.lock);
+
+  while(m_Data.count == 0)
+  {
+    if(pthread_cond_timedwait(&m_Data.cond, &m_Data.lock, &abstime) == ETIMEDOUT)
+      break;
+  }
+
+  bool ret = m_Data.count > 0;
+  if(ret)
+    m_Data.count--;
+
+  pthread_mutex_unlock(&m_Data.lock);
+
+  return ret;
+}
+
 struct ThreadInitData
 {
   ThreadEntry entryFunc;
@@ -116,13 +185,35 @@ static void *sThreadInit(void *init)
 // to not exhaust OS slots, we only allocate one that points
 // to our own array
 pthread_key_t OSTLSHandle;
-int64_t nextTLSSlot = 0;
+
+struct TLSValue
+{
+  uint32_t generation;
+  void *value;
+};
 
 struct TLSData
 {
-  vector<void *> data;
+  vector<TLSValue> data;
+};
+
+// slots are a 1-based index into the per-thread arrays in the low 32 bits, and the generation of
+// that index in the high 32 bits. Freed indices are reused with the next generation, so a value
+// another thread stored under a freed slot is never returned for the slot that replaces it.
+struct TLSSlotAllocator
+{
+  CriticalSection lock;
+  vector<uint32_t> generations;
+  vector<uint32_t> freeIndices;
 };
 
+// never destroyed, as slots can be freed from static destructors that run after it would be
+static TLSSlotAllocator &slotAllocator()
+{
+  static TLSSlotAllocator *alloc = new TLSSlotAllocator;
+  return *alloc;
+}
+
 void Init()
 {
   int err = pthread_key_create(&OSTLSHandle, NULL);
@@ -139,21 +230,54 @@ void Shutdown()
   pthread_key_delete(OSTLSHandle);
 }
 
-// allocate a TLS slot in our per-thread vectors with an atomic increment.
-// Note this is going to be 1-indexed because Inc64 returns the post-increment
-// value
 uint64_t AllocateTLSSlot()
 {
-  return Atomic::Inc64(&nextTLSSlot);
+  TLSSlotAllocator &alloc = slotAllocator();
+
+  alloc.lock.Lock();
+
+  uint32_t idx = 0;
+
+  if(!alloc.freeIndices.empty())
+  {
+    idx = alloc.freeIndices.back();
+    alloc.freeIndices.pop_back();
+    alloc.generations[idx]++;
+  }
+  else
+  {
+    idx = (uint32_t)alloc.generations.size();
+    alloc.generations.push_back(0);
+  }
+
+  uint64_t slot = (uint64_t(alloc.generations[idx]) << 32) | uint64_t(idx + 1);
+
+  alloc.lock.Unlock();
+
+  return slot;
+}
+
+void FreeTLSSlot(uint64_t slot)
+{
+  if(slot == 0)
+    return;
+
+  TLSSlotAllocator &alloc = slotAllocator();
+
+  alloc.lock.Lock();
+  alloc.freeIndices.push_back(uint32_t(slot) - 1);
+  alloc.lock.Unlock();
 }
 
 // look up our per-thread vector.
 void *GetTLSValue(uint64_t slot)
 {
   TLSData *slots = (TLSData *)pthread_getspecific(OSTLSHandle);
-  if(slots == NULL || slot - 1 >= slots->data.size())
+  size_t idx = size_t(uint32_t(slot)) - 1;
+  if(slots == NULL || idx >= slots->data.size() ||
+     slots->data[idx].generation != uint32_t(slot >> 32))
     return NULL;
-  return slots->data[(size_t)slot - 1];
+  return slots->data[idx].value;
 }
 
 void SetTLSValue(uint64_t slot, void *value)
@@ -163,7 +287,9 @@ void SetTLSValue(uint64_t slot, void *value)
   // resize or allocate slot data if needed.
   // We don't need to lock this, as it is by definition thread local so we are
   // blocking on the only possible concurrent access.
-  if(slots == NULL || slot - 1 >= slots->data.size())
+  size_t idx = size_t(uint32_t(slot)) - 1;
+
+  if(slots == NULL || idx >= slots->data.size())
   {
     if(slots == NULL)
     {
@@ -171,11 +297,15 @@ void SetTLSValue(uint64_t slot, void *value)
       pthread_setspecific(OSTLSHandle, slots);
     }
 
-    if(slot - 1 >= slots->data.size())
-    slots->data.resize((size_t)slot);
+    if(idx >= slots->data.size())
+    {
+      TLSValue empty = {0, NULL};
+      slots->data.resize(idx + 1, empty);
+    }
   }
 
-  slots->data[(size_t)slot - 1] = value;
+  slots->data[idx].generation = uint32_t(slot >> 32);
+  slots->data[idx].value = value;
 }
 
 ThreadHandle CreateThread(ThreadEntry entryFunc, void *userData)
@@ -64,35 +64,77 @@ bool Socket::Connected() const
   return (SOCKET)socket != INVALID_SOCKET;
 }
 
-Socket *Socket::AcceptClient(bool wait)
+Socket *Socket::AcceptClient(uint32_t timeoutMS)
 {
-  do
+  // sleep in select() until a connection is pending, rather than spinning on accept()
+  fd_set readSet;
+  FD_ZERO(&readSet);
+  FD_SET((SOCKET)socket, &readSet);
+
+  timeval timeout;
+  timeout.tv_sec = timeoutMS / 1000;
+  timeout.tv_usec = (timeoutMS % 1000) * 1000;
+
+  int ret = select(0, &readSet, NULL, NULL, &timeout);
+
+  if(ret == SOCKET_ERROR)
   {
-    SOCKET s = accept(socket, NULL, NULL);
+    RDCWARN("select: %d", WSAGetLastError());
+    Shutdown();
+    return NULL;
+  }
 
-    if(s != INVALID_SOCKET)
-    {
-      u_long enable = 1;
-      ioctlsocket(s, FIONBIO, &enable);
+  if(ret == 0)
+    return NULL;
 
-      BOOL nodelay = TRUE;
-      setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char *)&nodelay, sizeof(nodelay));
+  SOCKET s = accept(socket, NULL, NULL);
 
-      return new Socket((ptrdiff_t)s);
-    }
+  if(s != INVALID_SOCKET)
+  {
+    u_long enable = 1;
+    ioctlsocket(s, FIONBIO, &enable);
 
-    int err = WSAGetLastError();
+    BOOL nodelay = TRUE;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char *)&nodelay, sizeof(nodelay));
+
+    return new Socket((ptrdiff_t)s);
+  }
+
+  int err = WSAGetLastError();
+
+  if(err != WSAEWOULDBLOCK)
+  {
+    RDCWARN("accept: %d", err);
+    Shutdown();
+  }
+
+  return NULL;
+}
 
-    if(err != WSAEWOULDBLOCK)
+bool Socket::WaitUnlessCancelled(bool write)
+{
+  if(cancel == NULL)
+    return true;
+
+  for(;;)
+  {
+    if(*cancel)
     {
-      RDCWARN("accept: %d", err);
+      RDCWARN("Socket operation cancelled");
       Shutdown();
+      return false;
     }
 
-    Threading::Sleep(4);
-  } while(wait);
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET((SOCKET)socket, &set);
 
-  return NULL;
+    timeval timeout = {0, 100 * 1000};
+
+    // ready, or an error that the send/recv will report
+    if(select(0, write ? NULL : &set, write ? &set : NULL, NULL, &timeout) != 0)
+      return true;
+  }
 }
 
 bool Socket::SendDataBlocking(const void *buf, uint32_t length)
@@ -104,14 +146,22 @@ bool Socket::SendDataBlocking(const void *buf, uint32_t length)
 
   char *src = (char *)buf;
 
-  u_long enable = 0;
-  ioctlsocket(socket, FIONBIO, &enable);
+  // cancellable sockets stay non-blocking and wait in WaitUnlessCancelled instead
+  bool blocking = (cancel == NULL);
 
+  u_long enable = 0;
   DWORD timeout = 3000;
-  setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout, sizeof(timeout));
+  if(blocking)
+  {
+    ioctlsocket(socket, FIONBIO, &enable);
+    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout, sizeof(timeout));
+  }
 
   while(sent < length)
   {
+    if(!WaitUnlessCancelled(true))
+      return false;
+
     int ret = send(socket, src, length - sent, 0);
 
     if(ret <= 0)
@@ -134,11 +184,14 @@ bool Socket::SendDataBlocking(const void *buf, uint32_t length)
     src += ret;
   }
 
-  enable = 1;
-  ioctlsocket(socket, FIONBIO, &enable);
+  if(blocking)
+  {
+    enable = 1;
+    ioctlsocket(socket, FIONBIO, &enable);
 
-  timeout = 600000;
-  setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout, sizeof(timeout));
+    timeout = 600000;
+    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout, sizeof(timeout));
+  }
 
   RDCASSERT(sent == length);
 
@@ -183,14 +236,21 @@ bool Socket::RecvDataBlocking(void *buf, uint32_t length)
 
   char *dst = (char *)buf;
 
-  u_long enable = 0;
-  ioctlsocket(socket, FIONBIO, &enable);
+  bool blocking = (cancel == NULL);
 
+  u_long enable = 0;
   DWORD timeout = 3000;
-  setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+  if(blocking)
+  {
+    ioctlsocket(socket, FIONBIO, &enable);
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+  }
 
   while(received < length)
   {
+    if(!WaitUnlessCancelled(false))
+      return false;
+
     int ret = recv(socket, dst, length - received, 0);
 
     if(ret == 0)
@@ -218,17 +278,94 @@ bool Socket::RecvDataBlocking(void *buf, uint32_t length)
     dst += ret;
   }
 
-  enable = 1;
-  ioctlsocket(socket, FIONBIO, &enable);
+  if(blocking)
+  {
+    enable = 1;
+    ioctlsocket(socket, FIONBIO, &enable);
 
-  timeout = 600000;
-  setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+    timeout = 600000;
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+  }
 
   RDCASSERT(received == length);
 
   return true;
 }
 
+SocketWaiter::SocketWaiter()
+{
+  // [0] is signalled by network events on the socket being waited on, [1] by Wake(). These are
+  // plain events rather than WSACreateEvent() so a waiter can be created before WSAStartup()
+  m_Handles[0] = (ptrdiff_t)CreateEvent(NULL, TRUE, FALSE, NULL);
+  m_Handles[1] = (ptrdiff_t)CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+SocketWaiter::~SocketWaiter()
+{
+  for(int i = 0; i < 2; i++)
+    if((HANDLE)m_Handles[i] != NULL)
+      CloseHandle((HANDLE)m_Handles[i]);
+}
+
+void SocketWaiter::Wake()
+{
+  if((HANDLE)m_Handles[1] != NULL)
+    SetEvent((HANDLE)m_Handles[1]);
+}
+
+uint32_t SocketWaiter::Wait(Socket *sock, uint32_t timeoutMS)
+{
+  WSAEVENT sockEvent = (WSAEVENT)m_Handles[0];
+
+  HANDLE handles[2];
+  DWORD count = 0;
+  bool selected = false;
+
+  if(sock && sock->Connected() && sockEvent != NULL)
+  {
+    ResetEvent(sockEvent);
+
+    // if the socket is already readable the event is signalled immediately
+    if(WSAEventSelect((SOCKET)sock->socket, sockEvent, FD_READ | FD_ACCEPT | FD_CLOSE) == 0)
+    {
+      selected = true;
+      handles[count++] = sockEvent;
+    }
+  }
+
+  DWORD wakeIdx = ~0U;
+
+  if((HANDLE)m_Handles[1] != NULL)
+  {
+    wakeIdx = count;
+    handles[count++] = (HANDLE)m_Handles[1];
+  }
+
+  DWORD ret = WAIT_TIMEOUT;
+
+  if(count > 0)
+    ret = WaitForMultipleObjects(count, handles, FALSE, timeoutMS);
+  else
+    Sleep(timeoutMS);
+
+  uint32_t result = eWait_Timeout;
+
+  if(selected)
+  {
+    if(WaitForSingleObject(sockEvent, 0) == WAIT_OBJECT_0)
+      result |= eWait_Data;
+
+    // the socket can't be switched back to blocking mode for sends while it's associated with an
+    // event, so drop the association until the next wait
+    WSAEventSelect((SOCKET)sock->socket, NULL, 0);
+  }
+
+  if(ret == WAIT_OBJECT_0 + wakeIdx || ret == WAIT_FAILED)
+    result |= eWait_Woken;
+
+  return result;
+}
+
 Socket *CreateServerSocket(const char *bindaddr, uint16_t port, int queuesize)
 {
   SOCKET s = WSASocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, NULL, 0, WSA_FLAG_NO_HANDLE_INHERIT);
@@ -327,6 +327,15 @@ void Copy(const char *from, const char *to, bool allowOverwrite)
   ::CopyFileW(wfrom.c_str(), wto.c_str(), allowOverwrite == false);
 }
 
+bool Move(const char *from, const char *to, bool allowOverwrite)
+{
+  wstring wfrom = StringFormat::UTF82Wide(string(from));
+  wstring wto = StringFormat::UTF82Wide(string(to));
+
+  return ::MoveFileExW(wfrom.c_str(), wto.c_str(),
+                       allowOverwrite ? MOVEFILE_REPLACE_EXISTING : 0) != FALSE;
+}
+
 void Delete(const char *path)
 {
   wstring wpath = StringFormat::UTF82Wide(string(path));
@@ -366,6 +375,11 @@ bool feof(FILE *f)
   return ::feof(f) != 0;
 }
 
+int fflush(FILE *f)
+{
+  return ::fflush(f);
+}
+
 int fclose(FILE *f)
 {
   return ::fclose(f);
@@ -494,4 +508,15 @@ void WriteOutput(int channel, const char *str)
   else if(channel == OSUtility::Output_StdErr)
     fwprintf(stderr, L"%ls", wstr.c_str());
 }
+
+uint64_t GetAvailableSystemMemory()
+{
+  MEMORYSTATUSEX status = {};
+  status.dwLength = sizeof(status);
+
+  if(!GlobalMemoryStatusEx(&status))
+    return 0;
+
+  return status.ullAvailPhys;
+}
 };
@@ -72,6 +72,16 @@ int64_t ExchAdd64(volatile int64_t *i, int64_t a)
 {
   return (int64_t)InterlockedExchangeAdd64((volatile LONG64 *)i, a);
 }
+
+int32_t CmpExch32(volatile int32_t *i, int32_t oldVal, int32_t newVal)
+{
+  return (int32_t)InterlockedCompareExchange((volatile LONG *)i, newVal, oldVal);
+}
+
+void *CmpExchPtr(void *volatile *dest, void *oldVal, void *newVal)
+{
+  return InterlockedCompareExchangePointer(dest, newVal, oldVal);
+}
 };
 
 namespace Threading
@@ -101,6 +111,26 @@ void CriticalSection::Unlock()
   LeaveCriticalSection(&m_Data);
 }
 
+Semaphore::SemaphoreTemplate()
+{
+  m_Data = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+}
+
+Semaphore::~SemaphoreTemplate()
+{
+  CloseHandle(m_Data);
+}
+
+void Semaphore::Wake(uint32_t count)
+{
+  ReleaseSemaphore(m_Data, (LONG)count, NULL);
+}
+
+bool Semaphore::WaitForWake(uint32_t timeoutMS)
+{
+  return WaitForSingleObject(m_Data, (DWORD)timeoutMS) == WAIT_OBJECT_0;
+}
+
 struct ThreadInitData
 {
   ThreadEntry entryFunc;
@@ -123,13 +153,35 @@ static DWORD __stdcall sThreadInit(void *init)
 // to not exhaust OS slots, we only allocate one that points
 // to our own array
 DWORD OSTLSHandle;
-int64_t nextTLSSlot = 0;
+
+struct TLSValue
+{
+  uint32_t generation;
+  void *value;
+};
 
 struct TLSData
 {
-  vector<void *> data;
+  vector<TLSValue> data;
+};
+
+// slots are a 1-based index into the per-thread arrays in the low 32 bits, and the generation of
+// that index in the high 32 bits. Freed indices are reused with the next generation, so a value
+// another thread stored under a freed slot is never returned for the slot that replaces it.
+struct TLSSlotAllocator
+{
+  CriticalSection lock;
+  vector<uint32_t> generations;
+  vector<uint32_t> freeIndices;
 };
 
+// never destroyed, as slots can be freed from static destructors that run after it would be
+static TLSSlotAllocator &slotAllocator()
+{
+  static TLSSlotAllocator *alloc = new TLSSlotAllocator;
+  return *alloc;
+}
+
 void Init()
 {
   OSTLSHandle = TlsAlloc();
@@ -146,21 +198,54 @@ void Shutdown()
   TlsFree(OSTLSHandle);
 }
 
-// allocate a TLS slot in our per-thread vectors with an atomic increment.
-// Note this is going to be 1-indexed because Inc64 returns the post-increment
-// value
 uint64_t AllocateTLSSlot()
 {
-  return Atomic::Inc64(&nextTLSSlot);
+  TLSSlotAllocator &alloc = slotAllocator();
+
+  alloc.lock.Lock();
+
+  uint32_t idx = 0;
+
+  if(!alloc.freeIndices.empty())
+  {
+    idx = alloc.freeIndices.back();
+    alloc.freeIndices.pop_back();
+    alloc.generations[idx]++;
+  }
+  else
+  {
+    idx = (uint32_t)alloc.generations.size();
+    alloc.generations.push_back(0);
+  }
+
+  uint64_t slot = (uint64_t(alloc.generations[idx]) << 32) | uint64_t(idx + 1);
+
+  alloc.lock.Unlock();
+
+  return slot;
+}
+
+void FreeTLSSlot(uint64_t slot)
+{
+  if(slot == 0)
+    return;
+
+  TLSSlotAllocator &alloc = slotAllocator();
+
+  alloc.lock.Lock();
+  alloc.freeIndices.push_back(uint32_t(slot) - 1);
+  alloc.lock.Unlock();
 }
 
 // look up our per-thread vector.
 void *GetTLSValue(uint64_t slot)
 {
   TLSData *slots = (TLSData *)TlsGetValue(OSTLSHandle);
-  if(slots == NULL || slot - 1 >= slots->data.size())
+  size_t idx = size_t(uint32_t(slot)) - 1;
+  if(slots == NULL || idx >= slots->data.size() ||
+     slots->data[idx].generation != uint32_t(slot >> 32))
     return NULL;
-  return slots->data[(size_t)slot - 1];
+  return slots->data[idx].value;
 }
 
 void SetTLSValue(uint64_t slot, void *value)
@@ -170,7 +255,9 @@ void SetTLSValue(uint64_t slot, void *value)
   // resize or allocate slot data if needed.
   // We don't need to lock this, as it is by definition thread local so we are
   // blocking on the only possible concurrent access.
-  if(slots == NULL || slot - 1 >= slots->data.size())
+  size_t idx = size_t(uint32_t(slot)) - 1;
+
+  if(slots == NULL || idx >= slots->data.size())
   {
     if(slots == NULL)
     {
@@ -178,11 +265,15 @@ void SetTLSValue(uint64_t slot, void *value)
       TlsSetValue(OSTLSHandle, slots);
     }
 
-    if(slot - 1 >= slots->data.size())
-    slots->data.resize((size_t)slot);
+    if(idx >= slots->data.size())
+    {
+      TLSValue empty = {0, NULL};
+      slots->data.resize(idx + 1, empty);
+    }
   }
 
-  slots->data[(size_t)slot - 1] = value;
+  slots->data[idx].generation = uint32_t(slot >> 32);
+  slots->data[idx].value = value;
 }
 
 ThreadHandle CreateThread(ThreadEntry entryFunc, void *userData)
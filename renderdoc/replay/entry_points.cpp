@@ -247,6 +247,24 @@ extern "C" RENDERDOC_API void RENDERDOC_CC RENDERDOC_SetConfigSetting(const char
   RenderDoc::Inst().SetConfigSetting(name, value);
 }
 
+extern "C" RENDERDOC_API void RENDERDOC_CC RENDERDOC_StartProfiling(const char *tracefile)
+{
+  if(tracefile == NULL || tracefile[0] == 0)
+    return;
+
+  RenderDoc::Inst().SetProfileTrace(tracefile);
+
+  // propagate to any processes we launch after this point
+  Process::RegisterEnvironmentModification(Process::EnvironmentModification(
+      Process::eEnvModification_Replace, "RENDERDOC_PROFILE_TRACE", tracefile));
+  Process::ApplyEnvironmentModification();
+}
+
+extern "C" RENDERDOC_API void RENDERDOC_CC RENDERDOC_WriteProfileTrace()
+{
+  RenderDoc::Inst().WriteProfileTrace();
+}
+
 extern "C" RENDERDOC_API void RENDERDOC_CC RENDERDOC_LogText(const char *text)
 {
   RDCLOG("%s", text);
@@ -0,0 +1,338 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "mesh_pick.h"
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+#include "common/timing.h"
+
+const float MeshPickIndex::PickRadius = 35.0f;
+
+struct PickCandidate
+{
+  float len;
+  float depth;
+  uint32_t vertid;
+};
+
+static inline float Component(const Vec3f &v, int axis)
+{
+  return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+// false for infinities and NaNs
+static inline bool IsFinite(float f)
+{
+  return f - f == 0.0f;
+}
+
+// the same test and ordering as the mesh pick compute shaders, see data/spv/mesh.comp
+static inline void TestPoint(const float *m, const FloatVector &pos, uint32_t vertid,
+                             bool unproject, float viewWidth, float viewHeight, float x, float y,
+                             PickCandidate &best)
+{
+  float wx = m[0] * pos.x + m[4] * pos.y + m[8] * pos.z + m[12] * pos.w;
+  float wy = m[1] * pos.x + m[5] * pos.y + m[9] * pos.z + m[13] * pos.w;
+  float wz = m[2] * pos.x + m[6] * pos.y + m[10] * pos.z + m[14] * pos.w;
+  float ww = m[3] * pos.x + m[7] * pos.y + m[11] * pos.z + m[15] * pos.w;
+
+  wx /= ww;
+  wy /= ww;
+  wz /= ww;
+
+  if(!unproject)
+    wy = -wy;
+
+  float dx = (wx + 1.0f) * 0.5f * viewWidth - x;
+  float dy = (wy + 1.0f) * 0.5f * viewHeight - y;
+
+  float len = sqrtf(dx * dx + dy * dy);
+
+  if(!(len < MeshPickIndex::PickRadius))
+    return;
+
+  if(len < best.len || (len == best.len && wz < best.depth) ||
+     (len == best.len && wz == best.depth && vertid < best.vertid))
+  {
+    best.len = len;
+    best.depth = wz;
+    best.vertid = vertid;
+  }
+}
+
+bool MeshPickIndex::IsBuiltFor(uint32_t eventID, const MeshFormat &fmt) const
+{
+  if(!m_Built || eventID != m_EventID)
+    return false;
+
+  const MeshFormat &a = m_Format;
+
+  return a.idxbuf == fmt.idxbuf && a.idxoffs == fmt.idxoffs && a.idxByteWidth == fmt.idxByteWidth &&
+         a.baseVertex == fmt.baseVertex && a.buf == fmt.buf && a.offset == fmt.offset &&
+         a.stride == fmt.stride && a.compCount == fmt.compCount &&
+         a.compByteWidth == fmt.compByteWidth && a.compType == fmt.compType &&
+         a.bgraOrder == fmt.bgraOrder && a.specialFormat == fmt.specialFormat &&
+         a.numVerts == fmt.numVerts;
+}
+
+void MeshPickIndex::Clear()
+{
+  m_Built = false;
+  m_Points.clear();
+  m_Nodes.clear();
+  m_Unbounded.clear();
+}
+
+void MeshPickIndex::Build(uint32_t eventID, const MeshFormat &fmt,
+                          const std::vector<FloatVector> &positions,
+                          const std::vector<uint32_t> &indices)
+{
+  PerformanceTimer timer;
+
+  Clear();
+
+  m_EventID = eventID;
+  m_Format = fmt;
+  m_Built = true;
+
+  // many vertex IDs can share one position through the indices. They'd all tie, and the lowest
+  // vertex ID would win, so only that one needs to be in the index
+  std::vector<uint32_t> firstVert;
+
+  if(!indices.empty())
+  {
+    firstVert.resize(positions.size(), ~0U);
+
+    for(uint32_t v = 0; v < fmt.numVerts && v < (uint32_t)indices.size(); v++)
+    {
+      uint32_t idx = indices[v];
+      if(idx < firstVert.size() && firstVert[idx] == ~0U)
+        firstVert[idx] = v;
+    }
+  }
+  else
+  {
+    firstVert.resize(RDCMIN((size_t)fmt.numVerts, positions.size()));
+
+    for(size_t v = 0; v < firstVert.size(); v++)
+      firstVert[v] = (uint32_t)v;
+  }
+
+  std::vector<BuildPoint> points;
+  points.reserve(firstVert.size());
+
+  for(size_t i = 0; i < firstVert.size(); i++)
+  {
+    if(firstVert[i] == ~0U)
+      continue;
+
+    const FloatVector &pos = positions[i];
+
+    BuildPoint p;
+    p.point.pos = pos;
+    p.point.vertid = firstVert[i];
+
+    if(pos.w != 0.0f)
+      p.pos = Vec3f(pos.x / pos.w, pos.y / pos.w, pos.z / pos.w);
+
+    if(pos.w == 0.0f || !IsFinite(p.pos.x) || !IsFinite(p.pos.y) || !IsFinite(p.pos.z))
+    {
+      m_Unbounded.push_back(p.point);
+      continue;
+    }
+
+    points.push_back(p);
+  }
+
+  if(!points.empty())
+  {
+    m_Nodes.reserve(4 * (points.size() / LeafSize + 1));
+    m_Nodes.resize(1);
+    BuildNode(points, 0, 0, (uint32_t)points.size());
+
+    m_Points.resize(points.size());
+    for(size_t i = 0; i < points.size(); i++)
+      m_Points[i] = points[i].point;
+  }
+
+  RDCDEBUG("Built mesh pick index over %u vertices (%u nodes) in %.2f ms", (uint32_t)points.size(),
+           (uint32_t)m_Nodes.size(), timer.GetMilliseconds());
+}
+
+bool MeshPickIndex::AxisLess::operator()(const BuildPoint &a, const BuildPoint &b) const
+{
+  return Component(a.pos, axis) < Component(b.pos, axis);
+}
+
+void MeshPickIndex::BuildNode(std::vector<BuildPoint> &points, uint32_t node, uint32_t first,
+                              uint32_t count)
+{
+  Vec3f minBound = points[first].pos;
+  Vec3f maxBound = points[first].pos;
+
+  for(uint32_t i = first + 1; i < first + count; i++)
+  {
+    const Vec3f &p = points[i].pos;
+
+    minBound = Vec3f(RDCMIN(minBound.x, p.x), RDCMIN(minBound.y, p.y), RDCMIN(minBound.z, p.z));
+    maxBound = Vec3f(RDCMAX(maxBound.x, p.x), RDCMAX(maxBound.y, p.y), RDCMAX(maxBound.z, p.z));
+  }
+
+  m_Nodes[node].minBound = minBound;
+  m_Nodes[node].maxBound = maxBound;
+
+  if(count <= LeafSize)
+  {
+    m_Nodes[node].first = first;
+    m_Nodes[node].count = count;
+    return;
+  }
+
+  // split at the median along the longest axis
+  Vec3f extent = Vec3f(maxBound.x - minBound.x, maxBound.y - minBound.y, maxBound.z - minBound.z);
+
+  int axis = 0;
+  if(extent.y > extent.x)
+    axis = 1;
+  if(extent.z > Component(extent, axis))
+    axis = 2;
+
+  uint32_t mid = first + count / 2;
+
+  std::nth_element(points.begin() + first, points.begin() + mid, points.begin() + first + count,
+                   AxisLess(axis));
+
+  uint32_t child = (uint32_t)m_Nodes.size();
+  m_Nodes.resize(child + 2);
+
+  m_Nodes[node].first = child;
+  m_Nodes[node].count = 0;
+
+  BuildNode(points, child, first, mid - first);
+  BuildNode(points, child + 1, mid, first + count - mid);
+}
+
+bool MeshPickIndex::NodeInRange(const Node &node, const Matrix4f &mvp, bool unproject,
+                                float viewWidth, float viewHeight, float x, float y) const
+{
+  const float *m = mvp.Data();
+
+  float minX = FLT_MAX, minY = FLT_MAX;
+  float maxX = -FLT_MAX, maxY = -FLT_MAX;
+
+  int front = 0, behind = 0;
+
+  for(int c = 0; c < 8; c++)
+  {
+    float px = (c & 1) ? node.maxBound.x : node.minBound.x;
+    float py = (c & 2) ? node.maxBound.y : node.minBound.y;
+    float pz = (c & 4) ? node.maxBound.z : node.minBound.z;
+
+    float wx = m[0] * px + m[4] * py + m[8] * pz + m[12];
+    float wy = m[1] * px + m[5] * py + m[9] * pz + m[13];
+    float ww = m[3] * px + m[7] * py + m[11] * pz + m[15];
+
+    if(ww > 0.0f)
+      front++;
+    else if(ww < 0.0f)
+      behind++;
+
+    wx /= ww;
+    wy /= ww;
+
+    if(!unproject)
+      wy = -wy;
+
+    float sx = (wx + 1.0f) * 0.5f * viewWidth;
+    float sy = (wy + 1.0f) * 0.5f * viewHeight;
+
+    minX = RDCMIN(minX, sx);
+    minY = RDCMIN(minY, sy);
+    maxX = RDCMAX(maxX, sx);
+    maxY = RDCMAX(maxY, sy);
+  }
+
+  // if the box straddles w = 0 its projection isn't bounded by its corners', so it can't be culled
+  if(front != 8 && behind != 8)
+    return true;
+
+  // otherwise the box projects inside its corners' projections. The extra pixel of radius covers
+  // any rounding difference from projecting the divided-through positions
+  float dx = RDCMAX(RDCMAX(minX - x, x - maxX), 0.0f);
+  float dy = RDCMAX(RDCMAX(minY - y, y - maxY), 0.0f);
+
+  float radius = PickRadius + 1.0f;
+
+  // written so that NaNs from degenerate projections are never culled
+  return !(dx * dx + dy * dy > radius * radius);
+}
+
+uint32_t MeshPickIndex::Pick(const Matrix4f &mvp, bool unproject, float viewWidth,
+                             float viewHeight, float x, float y) const
+{
+  PickCandidate best = {FLT_MAX, FLT_MAX, ~0U};
+
+  const float *m = mvp.Data();
+
+  for(size_t i = 0; i < m_Unbounded.size(); i++)
+    TestPoint(m, m_Unbounded[i].pos, m_Unbounded[i].vertid, unproject, viewWidth, viewHeight, x, y,
+              best);
+
+  if(m_Nodes.empty())
+    return best.vertid;
+
+  // the tree is balanced, so its depth is at most log2 of the number of points
+  uint32_t stack[64];
+  int top = 0;
+  stack[top++] = 0;
+
+  while(top > 0)
+  {
+    const Node &node = m_Nodes[stack[--top]];
+
+    if(!NodeInRange(node, mvp, unproject, viewWidth, viewHeight, x, y))
+      continue;
+
+    if(node.count > 0)
+    {
+      for(uint32_t i = node.first; i < node.first + node.count; i++)
+        TestPoint(m, m_Points[i].pos, m_Points[i].vertid, unproject, viewWidth, viewHeight, x, y,
+                  best);
+    }
+    else
+    {
+      stack[top++] = node.first;
+      stack[top++] = node.first + 1;
+    }
+  }
+
+  return best.vertid;
+}
+
+uint64_t MeshPickIndex::GetMemoryUsage() const
+{
+  return m_Points.capacity() * sizeof(Point) + m_Nodes.capacity() * sizeof(Node) +
+         m_Unbounded.capacity() * sizeof(Point);
+}
@@ -0,0 +1,104 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include "api/replay/renderdoc_replay.h"
+#include "maths/matrix.h"
+#include "maths/vec.h"
+
+// A bounding volume hierarchy over one mesh's vertex positions, so that vertex picking can be
+// answered on the CPU without any replay or GPU work. Picks give the same answer as the mesh pick
+// compute shaders: a vertex is a candidate if it projects to within PickRadius pixels of the
+// cursor, and the closest candidate wins, then the one nearest in depth, then the lowest vertex ID.
+class MeshPickIndex
+{
+public:
+  MeshPickIndex() : m_Built(false), m_EventID(0) {}
+  // whether the index was built from the given mesh data at the given event
+  bool IsBuiltFor(uint32_t eventID, const MeshFormat &fmt) const;
+
+  // positions are the unpacked vertices from fmt's buffer. If indices is non-empty then vertex ID
+  // i is at positions[indices[i]], otherwise it's at positions[i]
+  void Build(uint32_t eventID, const MeshFormat &fmt, const std::vector<FloatVector> &positions,
+             const std::vector<uint32_t> &indices);
+  void Clear();
+
+  // returns the picked vertex ID, or ~0U if there's no vertex near enough to (x, y)
+  uint32_t Pick(const Matrix4f &mvp, bool unproject, float viewWidth, float viewHeight, float x,
+                float y) const;
+
+  uint64_t GetMemoryUsage() const;
+
+  static const float PickRadius;
+
+private:
+  struct Point
+  {
+    FloatVector pos;
+    uint32_t vertid;
+  };
+
+  // leaves have count > 0 and cover m_Points[first, first + count). Inner nodes have count == 0
+  // and their children are nodes first and first + 1
+  struct Node
+  {
+    Vec3f minBound, maxBound;
+    uint32_t first;
+    uint32_t count;
+  };
+
+  static const uint32_t LeafSize = 16;
+
+  // while building, each point carries its position divided through by w, which projects to the
+  // same place as the original position
+  struct BuildPoint
+  {
+    Vec3f pos;
+    Point point;
+  };
+
+  struct AxisLess
+  {
+    AxisLess(int a) : axis(a) {}
+    bool operator()(const BuildPoint &a, const BuildPoint &b) const;
+    int axis;
+  };
+
+  void BuildNode(std::vector<BuildPoint> &points, uint32_t node, uint32_t first, uint32_t count);
+  bool NodeInRange(const Node &node, const Matrix4f &mvp, bool unproject, float viewWidth,
+                   float viewHeight, float x, float y) const;
+
+  bool m_Built;
+  uint32_t m_EventID;
+  MeshFormat m_Format;
+
+  std::vector<Point> m_Points;
+  std::vector<Node> m_Nodes;
+
+  // points at infinity (w == 0) or otherwise without a finite position can't be bounded, so
+  // they're tested on every pick
+  std::vector<Point> m_Unbounded;
+};
@@ -37,6 +37,26 @@ struct FetchFrameRecord
   rdctype::array<FetchDrawcall> drawcallList;
 };
 
+struct TextureDataRequest
+{
+  ResourceId tex;
+  uint32_t arrayIdx;
+  uint32_t mip;
+  bool resolve;
+  bool forceRGBA8unorm;
+  float blackPoint;
+  float whitePoint;
+};
+
+// receives the subresources fetched by GetTextureDataBatch, in request order, as each becomes
+// available. data is allocated with new[] and owned by the receiver, or is NULL on failure.
+class TextureDataReceiver
+{
+public:
+  virtual ~TextureDataReceiver() {}
+  virtual void ReceiveTextureData(size_t requestIdx, byte *data, size_t dataSize) = 0;
+};
+
 // these two interfaces define what an API driver implementation must provide
 // to the replay. At minimum it must implement IRemoteDriver which contains
 // all of the functionality that cannot be achieved elsewhere. An IReplayDriver
@@ -65,8 +85,12 @@ public:
   virtual ShaderReflection *GetShader(ResourceId shader, string entryPoint) = 0;
 
   virtual vector<EventUsage> GetUsage(ResourceId id) = 0;
+  // the usage of each of ids, in the same order. The IDs are mapped with GetLiveID here, so
+  // everything is fetched in one call - and over the network, one round trip
+  virtual vector<vector<EventUsage> > GetUsages(const vector<ResourceId> &ids) = 0;
 
-  virtual void SavePipelineState() = 0;
+  // returns the PipelineStateChanges since the previous call
+  virtual uint32_t SavePipelineState() = 0;
   virtual D3D11PipelineState GetD3D11PipelineState() = 0;
   virtual GLPipelineState GetGLPipelineState() = 0;
   virtual VulkanPipelineState GetVulkanPipelineState() = 0;
@@ -81,6 +105,9 @@ public:
 
   virtual void InitPostVSBuffers(uint32_t eventID) = 0;
   virtual void InitPostVSBuffers(const vector<uint32_t> &passEvents) = 0;
+  // the post-transform data for these events must stay resident until the next call, even if
+  // other fetches need the memory. Drivers that never evict their post-transform data ignore this
+  virtual void PinPostVSBuffers(const vector<uint32_t> &events) = 0;
 
   virtual ResourceId GetLiveID(ResourceId id) = 0;
 
@@ -91,6 +118,10 @@ public:
   virtual byte *GetTextureData(ResourceId tex, uint32_t arrayIdx, uint32_t mip, bool resolve,
                                bool forceRGBA8unorm, float blackPoint, float whitePoint,
                                size_t &dataSize) = 0;
+  // fetches many subresources, possibly from several textures, in as few GPU round trips as
+  // the driver can manage
+  virtual void GetTextureDataBatch(const vector<TextureDataRequest> &requests,
+                                   TextureDataReceiver *receiver) = 0;
 
   virtual void BuildTargetShader(string source, string entry, const uint32_t compileFlags,
                                  ShaderStageType type, ResourceId *id, string *errors) = 0;
@@ -173,6 +204,36 @@ public:
   virtual uint32_t PickVertex(uint32_t eventID, const MeshDisplay &cfg, uint32_t x, uint32_t y) = 0;
 };
 
+// GetTextureDataBatch for drivers that have nothing better than fetching one at a time
+inline void GetTextureDataSerially(IRemoteDriver *driver,
+                                   const vector<TextureDataRequest> &requests,
+                                   TextureDataReceiver *receiver)
+{
+  for(size_t i = 0; i < requests.size(); i++)
+  {
+    const TextureDataRequest &req = requests[i];
+
+    size_t dataSize = 0;
+    byte *data = driver->GetTextureData(req.tex, req.arrayIdx, req.mip, req.resolve,
+                                        req.forceRGBA8unorm, req.blackPoint, req.whitePoint,
+                                        dataSize);
+
+    receiver->ReceiveTextureData(i, data, dataSize);
+  }
+}
+
+// GetUsages for drivers where each resource's usage is a local lookup anyway
+inline vector<vector<EventUsage> > GetUsagesSerially(IRemoteDriver *driver,
+                                                     const vector<ResourceId> &ids)
+{
+  vector<vector<EventUsage> > ret(ids.size());
+
+  for(size_t i = 0; i < ids.size(); i++)
+    ret[i] = driver->GetUsage(driver->GetLiveID(ids[i]));
+
+  return ret;
+}
+
 // utility function useful in any driver implementation
 template <typename FetchDrawcallContainer>
 FetchDrawcall *SetupDrawcallPointers(vector<FetchDrawcall *> *drawcallTable, ResourceId contextID,
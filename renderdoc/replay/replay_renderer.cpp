@@ -24,11 +24,15 @@
  ******************************************************************************/
 
 #include "replay_renderer.h"
+#include <algorithm>
 #include <string.h>
 #include <time.h>
 #include "common/dds_readwrite.h"
+#include "common/profiler.h"
+#include "common/timing.h"
 #include "jpeg-compressor/jpgd.h"
 #include "jpeg-compressor/jpge.h"
+#include "maths/formatconvert.h"
 #include "maths/formatpacking.h"
 #include "os/os_specific.h"
 #include "serialise/serialiser.h"
@@ -138,6 +142,7 @@ ReplayRenderer::ReplayRenderer()
   m_pDevice = NULL;
 
   m_EventID = 100000;
+  m_PipelineStateChanges = ePipeChange_All;
 
   m_DeferredCtx = ResourceId();
   m_FirstDeferredEvent = 0;
@@ -189,6 +194,8 @@ bool ReplayRenderer::SetFrameEvent(uint32_t eventID, bool force)
 {
   if(eventID != m_EventID || force)
   {
+    RDCPROFILE_SCOPE("ReplayRenderer::SetFrameEvent");
+
     m_EventID = eventID;
 
     m_pDevice->ReplayLog(eventID, eReplay_WithoutDraw);
@@ -237,6 +244,17 @@ bool ReplayRenderer::GetVulkanPipelineState(VulkanPipelineState *state)
   return false;
 }
 
+bool ReplayRenderer::GetPipelineStateChanges(uint32_t *changes)
+{
+  if(changes)
+  {
+    *changes = m_PipelineStateChanges;
+    return true;
+  }
+
+  return false;
+}
+
 bool ReplayRenderer::GetFrameInfo(FetchFrameInfo *info)
 {
   if(info == NULL)
@@ -272,12 +290,45 @@ bool ReplayRenderer::FetchCounters(uint32_t *counters, uint32_t numCounters,
   if(results == NULL)
     return false;
 
+  // only counters that haven't been fetched before go to the driver, all in one request
   vector<uint32_t> counterArray;
+  vector<uint32_t> missing;
   counterArray.reserve(numCounters);
   for(uint32_t i = 0; i < numCounters; i++)
+  {
+    if(std::find(counterArray.begin(), counterArray.end(), counters[i]) != counterArray.end())
+      continue;
+
     counterArray.push_back(counters[i]);
 
-  *results = m_pDevice->FetchCounters(counterArray);
+    if(m_CounterResults.find(counters[i]) == m_CounterResults.end())
+      missing.push_back(counters[i]);
+  }
+
+  if(!missing.empty())
+  {
+    vector<CounterResult> fetched = m_pDevice->FetchCounters(missing);
+
+    // counters without any results are still cached, so they aren't fetched again
+    for(size_t i = 0; i < missing.size(); i++)
+      m_CounterResults[missing[i]].clear();
+
+    for(size_t i = 0; i < fetched.size(); i++)
+      m_CounterResults[fetched[i].counterID].push_back(fetched[i]);
+  }
+
+  vector<CounterResult> ret;
+  for(size_t i = 0; i < counterArray.size(); i++)
+  {
+    const vector<CounterResult> &cached = m_CounterResults[counterArray[i]];
+    ret.insert(ret.end(), cached.begin(), cached.end());
+  }
+
+  // interleave the counters by event, the same as a single fetch returns them
+  if(counterArray.size() > 1)
+    std::sort(ret.begin(), ret.end());
+
+  *results = ret;
 
   return true;
 }
@@ -380,15 +431,65 @@ bool ReplayRenderer::GetDebugMessages(rdctype::array<DebugMessage> *msgs)
   return false;
 }
 
+void ReplayRenderer::BuildUsageIndex()
+{
+  if(m_UsageIndex.IsBuilt())
+    return;
+
+  GetTextures(NULL);
+  GetBuffers(NULL);
+
+  vector<ResourceId> ids;
+  ids.reserve(m_Textures.size() + m_Buffers.size());
+
+  for(size_t i = 0; i < m_Textures.size(); i++)
+    ids.push_back(m_Textures[i].ID);
+  for(size_t i = 0; i < m_Buffers.size(); i++)
+    ids.push_back(m_Buffers[i].ID);
+
+  m_UsageIndex.Build(m_pDevice, ids);
+}
+
 bool ReplayRenderer::GetUsage(ResourceId id, rdctype::array<EventUsage> *usage)
 {
-  if(usage)
-  {
-    *usage = m_pDevice->GetUsage(m_pDevice->GetLiveID(id));
+  return GetUsageInRange(id, 0, ~0U, usage);
+}
+
+bool ReplayRenderer::GetUsageInRange(ResourceId id, uint32_t startEID, uint32_t endEID,
+                                     rdctype::array<EventUsage> *usage)
+{
+  if(usage == NULL)
+    return false;
+
+  BuildUsageIndex();
+
+  if(m_UsageIndex.GetUsage(id, startEID, endEID, usage))
     return true;
-  }
 
-  return false;
+  // not a texture or buffer, so not indexed. Fall back to filtering the driver's list
+  vector<EventUsage> all = m_pDevice->GetUsage(m_pDevice->GetLiveID(id));
+  vector<EventUsage> ret;
+
+  for(size_t i = 0; i < all.size(); i++)
+    if(all[i].eventID >= startEID && all[i].eventID <= endEID)
+      ret.push_back(all[i]);
+
+  std::sort(ret.begin(), ret.end());
+
+  *usage = ret;
+  return true;
+}
+
+bool ReplayRenderer::GetResourcesUsedInRange(uint32_t startEID, uint32_t endEID, bool writesOnly,
+                                             rdctype::array<ResourceId> *resources)
+{
+  if(resources == NULL)
+    return false;
+
+  BuildUsageIndex();
+
+  m_UsageIndex.GetResourcesUsed(startEID, endEID, writesOnly, resources);
+  return true;
 }
 
 bool ReplayRenderer::GetPostVSData(uint32_t instID, MeshDataStage stage, MeshFormat *data)
@@ -411,6 +512,84 @@ bool ReplayRenderer::GetPostVSData(uint32_t instID, MeshDataStage stage, MeshFor
   return true;
 }
 
+bool ReplayRenderer::PrefetchPostVSData(uint32_t startEID, uint32_t endEID)
+{
+  if(m_Drawcalls.empty() || startEID >= m_Drawcalls.size())
+    return false;
+
+  endEID = RDCMIN(endEID, uint32_t(m_Drawcalls.size() - 1));
+
+  PerformanceTimer timer;
+
+  // the current draw and its pass may already be displayed from buffers fetched earlier, so they
+  // must survive however much the prefetch evicts
+  vector<uint32_t> current = m_pDevice->GetPassEvents(m_EventID);
+  current.push_back(m_EventID);
+  m_pDevice->PinPostVSBuffers(current);
+
+  uint32_t numDraws = 0;
+
+  // consecutive draws in the same pass are gathered up and fetched together, so that each pass is
+  // one replay and the driver can batch all of its draws
+  vector<uint32_t> pass;
+
+  for(uint32_t eid = startEID; eid <= endEID; eid++)
+  {
+    FetchDrawcall *draw = m_Drawcalls[eid];
+
+    if(draw == NULL || draw->eventID != eid || (draw->flags & eDraw_Drawcall) == 0)
+      continue;
+
+    numDraws++;
+
+    vector<uint32_t> passEvents = m_pDevice->GetPassEvents(eid);
+
+    if(!pass.empty() && !passEvents.empty() && passEvents[0] == pass[0])
+    {
+      pass.push_back(eid);
+      continue;
+    }
+
+    if(!pass.empty())
+      m_pDevice->InitPostVSBuffers(pass);
+
+    pass.clear();
+
+    if(passEvents.empty())
+    {
+      // not inside a pass, this draw has to be fetched on its own
+      m_pDevice->ReplayLog(eid, eReplay_WithoutDraw);
+      m_pDevice->InitPostVSBuffers(eid);
+      continue;
+    }
+
+    pass.swap(passEvents);
+    pass.push_back(eid);
+  }
+
+  if(!pass.empty())
+    m_pDevice->InitPostVSBuffers(pass);
+
+  // put the replay back where it was
+  m_pDevice->ReplayLog(m_EventID, eReplay_WithoutDraw);
+
+  m_pDevice->PinPostVSBuffers(vector<uint32_t>());
+
+  // the current draw's data is normally still resident and this only marks it as recently used.
+  // If it was never fetched it's fetched now, with the replay back at the right event
+  FetchDrawcall *draw = GetDrawcallByEID(m_EventID, m_LastDeferredEvent);
+
+  if(draw && (draw->flags & eDraw_Drawcall))
+    m_pDevice->InitPostVSBuffers(draw->eventID);
+
+  double ms = timer.GetMilliseconds();
+
+  RDCLOG("Prefetched post-transform data for %u draws in %.2f ms (%.0f draws/sec)", numDraws, ms,
+         ms > 0.0 ? double(numDraws) * 1000.0 / ms : 0.0);
+
+  return true;
+}
+
 bool ReplayRenderer::GetMinMax(ResourceId tex, uint32_t sliceFace, uint32_t mip, uint32_t sample,
                                PixelValue *minval, PixelValue *maxval)
 {
@@ -492,6 +671,103 @@ bool ReplayRenderer::GetTextureData(ResourceId tex, uint32_t arrayIdx, uint32_t
   return true;
 }
 
+// sorts the subresources fetched for SaveTexture into the list of images to write, splitting the
+// depth slices of 3D textures out into separate images
+class SaveTextureReceiver : public TextureDataReceiver
+{
+public:
+  SaveTextureReceiver(vector<byte *> &sub, const vector<TextureDataRequest> &reqs,
+                      const vector<uint32_t> &reqMips)
+      : subdata(sub), requests(reqs), requestMips(reqMips), failed(false)
+  {
+  }
+
+  void ReceiveTextureData(size_t requestIdx, byte *bytes, size_t dataSize)
+  {
+    if(failed)
+    {
+      delete[] bytes;
+      return;
+    }
+
+    if(bytes == NULL)
+    {
+      RDCERR("Couldn't get bytes for mip %u, slice %u", requests[requestIdx].mip,
+             requests[requestIdx].arrayIdx);
+      failed = true;
+      return;
+    }
+
+    if(depth == 1)
+    {
+      subdata.push_back(bytes);
+      return;
+    }
+
+    uint32_t m = requestMips[requestIdx];
+
+    uint32_t mipSlicePitch = slicePitch;
+
+    uint32_t w = RDCMAX(1U, width >> m);
+    uint32_t h = RDCMAX(1U, height >> m);
+    uint32_t d = RDCMAX(1U, depth >> m);
+
+    if(blockformat)
+    {
+      mipSlicePitch = RDCMAX(1U, ((w + 3) / 4)) * blockSize * RDCMAX(1U, h / 4);
+    }
+    else
+    {
+      mipSlicePitch = w * bytesPerPixel * h;
+    }
+
+    // we don't support slice ranges, only all-or-nothing
+    // we're also not dealing with multisampled slices if
+    // depth > 1. So if we only want one slice out of a 3D texture
+    // then make sure we get it
+    if(numSlices == 1)
+    {
+      byte *depthslice = new byte[mipSlicePitch];
+      byte *b = bytes + mipSlicePitch * sliceOffset;
+      memcpy(depthslice, b, slicePitch);
+      subdata.push_back(depthslice);
+
+      delete[] bytes;
+      return;
+    }
+
+    byte *b = bytes;
+
+    // add each depth slice as a separate subdata
+    for(uint32_t di = 0; di < d; di++)
+    {
+      byte *depthslice = new byte[mipSlicePitch];
+
+      memcpy(depthslice, b, mipSlicePitch);
+
+      subdata.push_back(depthslice);
+
+      b += mipSlicePitch;
+    }
+
+    delete[] bytes;
+  }
+
+  vector<byte *> &subdata;
+  const vector<TextureDataRequest> &requests;
+  const vector<uint32_t> &requestMips;
+
+  bool failed;
+
+  uint32_t width, height, depth;
+  bool blockformat;
+  int blockSize;
+  uint32_t bytesPerPixel;
+  uint32_t slicePitch;
+  uint32_t numSlices;
+  uint32_t sliceOffset;
+};
+
 bool ReplayRenderer::SaveTexture(const TextureSave &saveData, const char *path)
 {
   TextureSave sd = saveData;    // mutable copy
@@ -730,7 +1006,10 @@ bool ReplayRenderer::SaveTexture(const TextureSave &saveData, const char *path)
     slicePitch = rowPitch * td.height;
   }
 
-  // loop over fetching subresources
+  // work out every subresource we need up front, so they can be fetched in one batch
+  vector<TextureDataRequest> requests;
+  vector<uint32_t> requestMips;
+
   for(uint32_t s = 0; s < numSlices; s++)
   {
     uint32_t slice = s * sliceStride + sliceOffset;
@@ -739,74 +1018,39 @@ bool ReplayRenderer::SaveTexture(const TextureSave &saveData, const char *path)
     {
       uint32_t mip = m + mipOffset;
 
-      size_t datasize = 0;
-      byte *bytes = m_pDevice->GetTextureData(liveid, slice, mip, resolveSamples, downcast,
-                                              sd.comp.blackPoint, sd.comp.whitePoint, datasize);
-
-      if(bytes == NULL)
-      {
-        RDCERR("Couldn't get bytes for mip %u, slice %u", mip, slice);
-
-        for(size_t i = 0; i < subdata.size(); i++)
-          delete[] subdata[i];
-
-        return false;
-      }
-
-      if(td.depth == 1)
-      {
-        subdata.push_back(bytes);
-        continue;
-      }
-
-      uint32_t mipSlicePitch = slicePitch;
-
-      uint32_t w = RDCMAX(1U, td.width >> m);
-      uint32_t h = RDCMAX(1U, td.height >> m);
-      uint32_t d = RDCMAX(1U, td.depth >> m);
-
-      if(blockformat)
-      {
-        mipSlicePitch = RDCMAX(1U, ((w + 3) / 4)) * blockSize * RDCMAX(1U, h / 4);
-      }
-      else
-      {
-        mipSlicePitch = w * bytesPerPixel * h;
-      }
-
-      // we don't support slice ranges, only all-or-nothing
-      // we're also not dealing with multisampled slices if
-      // depth > 1. So if we only want one slice out of a 3D texture
-      // then make sure we get it
-      if(numSlices == 1)
-      {
-        byte *depthslice = new byte[mipSlicePitch];
-        byte *b = bytes + mipSlicePitch * sliceOffset;
-        memcpy(depthslice, b, slicePitch);
-        subdata.push_back(depthslice);
-
-        delete[] bytes;
-        continue;
-      }
+      TextureDataRequest req = {
+          liveid, slice, mip, resolveSamples, downcast, sd.comp.blackPoint, sd.comp.whitePoint,
+      };
 
-      s += (d - 1);
+      requests.push_back(req);
+      requestMips.push_back(m);
 
-      byte *b = bytes;
+      // a 3D texture's mip comes back with all of its depth slices
+      if(td.depth > 1 && numSlices > 1)
+        s += (RDCMAX(1U, td.depth >> m) - 1);
+    }
+  }
 
-      // add each depth slice as a separate subdata
-      for(uint32_t di = 0; di < d; di++)
-      {
-        byte *depthslice = new byte[mipSlicePitch];
+  SaveTextureReceiver receiver(subdata, requests, requestMips);
 
-        memcpy(depthslice, b, mipSlicePitch);
+  receiver.depth = td.depth;
+  receiver.width = td.width;
+  receiver.height = td.height;
+  receiver.blockformat = blockformat;
+  receiver.blockSize = blockSize;
+  receiver.bytesPerPixel = bytesPerPixel;
+  receiver.slicePitch = slicePitch;
+  receiver.numSlices = numSlices;
+  receiver.sliceOffset = sliceOffset;
 
-        subdata.push_back(depthslice);
+  m_pDevice->GetTextureDataBatch(requests, &receiver);
 
-        b += mipSlicePitch;
-      }
+  if(receiver.failed)
+  {
+    for(size_t i = 0; i < subdata.size(); i++)
+      delete[] subdata[i];
 
-      delete[] bytes;
-    }
+    return false;
   }
 
   // should have been handled above, but verify incoming data is RGBA8
@@ -1099,55 +1343,25 @@ bool ReplayRenderer::SaveTexture(const TextureSave &saveData, const char *path)
       }
 
       byte *srcData = subdata[0];
+      uint32_t texelSize = GetFloat4TexelSize(td.format);
+
+      if(texelSize == 0)
+        RDCERR("Unexpected format to convert from");
+
+      // rows are decoded in bulk, unknown formats are left as (0,0,0,1)
+      vector<Vec4f> row(td.width, Vec4f(0.0f, 0.0f, 0.0f, 1.0f));
 
       for(uint32_t y = 0; y < td.height; y++)
       {
+        if(texelSize > 0)
+          ConvertToFloat4(td.format, srcData + y * td.width * texelSize, td.width, &row[0]);
+
         for(uint32_t x = 0; x < td.width; x++)
         {
-          float r = 0.0f;
-          float g = 0.0f;
-          float b = 0.0f;
-          float a = 1.0f;
-
-          if(td.format.special && td.format.specialFormat == eSpecial_R10G10B10A2)
-          {
-            uint32_t *u32 = (uint32_t *)srcData;
-
-            Vec4f vec = ConvertFromR10G10B10A2(*u32);
-
-            r = vec.x;
-            g = vec.y;
-            b = vec.z;
-            a = vec.w;
-
-            srcData += 4;
-          }
-          else if(td.format.special && td.format.specialFormat == eSpecial_R11G11B10)
-          {
-            uint32_t *u32 = (uint32_t *)srcData;
-
-            Vec3f vec = ConvertFromR11G11B10(*u32);
-
-            r = vec.x;
-            g = vec.y;
-            b = vec.z;
-            a = 1.0f;
-
-            srcData += 4;
-          }
-          else
-          {
-            if(td.format.compCount >= 1)
-              r = ConvertComponent(td.format, srcData + td.format.compByteWidth * 0);
-            if(td.format.compCount >= 2)
-              g = ConvertComponent(td.format, srcData + td.format.compByteWidth * 1);
-            if(td.format.compCount >= 3)
-              b = ConvertComponent(td.format, srcData + td.format.compByteWidth * 2);
-            if(td.format.compCount >= 4)
-              a = ConvertComponent(td.format, srcData + td.format.compByteWidth * 3);
-
-            srcData += td.format.compCount * td.format.compByteWidth;
-          }
+          float r = row[x].x;
+          float g = row[x].y;
+          float b = row[x].z;
+          float a = row[x].w;
 
           // HDR can't represent negative values
           if(sd.destType == eFileType_HDR)
@@ -1284,15 +1498,13 @@ bool ReplayRenderer::PixelHistory(ResourceId target, uint32_t x, uint32_t y, uin
     }
   }
 
-  auto usage = m_pDevice->GetUsage(m_pDevice->GetLiveID(target));
+  rdctype::array<EventUsage> usage;
+  GetUsageInRange(target, 0, m_EventID, &usage);
 
   vector<EventUsage> events;
 
   for(size_t i = 0; i < usage.size(); i++)
   {
-    if(usage[i].eventID > m_EventID)
-      continue;
-
     switch(usage[i].usage)
     {
       case eUsage_VertexBuffer:
@@ -1516,6 +1728,9 @@ bool ReplayRenderer::ReplaceResource(ResourceId from, ResourceId to)
 {
   m_pDevice->ReplaceResource(from, to);
 
+  // replaced resources can change any counter's results
+  m_CounterResults.clear();
+
   SetFrameEvent(m_EventID, true);
 
   for(size_t i = 0; i < m_Outputs.size(); i++)
@@ -1529,6 +1744,9 @@ bool ReplayRenderer::RemoveReplacement(ResourceId id)
 {
   m_pDevice->RemoveReplacement(id);
 
+  // replaced resources can change any counter's results
+  m_CounterResults.clear();
+
   SetFrameEvent(m_EventID, true);
 
   for(size_t i = 0; i < m_Outputs.size(); i++)
@@ -1540,6 +1758,8 @@ bool ReplayRenderer::RemoveReplacement(ResourceId id)
 
 ReplayCreateStatus ReplayRenderer::CreateDevice(const char *logfile)
 {
+  RDCPROFILE_SCOPE("ReplayRenderer::CreateDevice");
+
   RDCLOG("Creating replay device for %s", logfile);
 
   RDCDriver driverType = RDC_Unknown;
@@ -1579,6 +1799,8 @@ ReplayCreateStatus ReplayRenderer::SetDevice(IReplayDriver *device)
 
 ReplayCreateStatus ReplayRenderer::PostCreateInit(IReplayDriver *device)
 {
+  RDCPROFILE_SCOPE("ReplayRenderer::PostCreateInit");
+
   m_pDevice = device;
 
   m_pDevice->ReadLogInitialisation();
@@ -1592,6 +1814,9 @@ ReplayCreateStatus ReplayRenderer::PostCreateInit(IReplayDriver *device)
   SetupDrawcallPointers(&m_Drawcalls, fr.frameInfo.immContextId, m_FrameRecord.m_DrawCallList, NULL,
                         NULL);
 
+  // usage doesn't change after load, so it's indexed once up front
+  BuildUsageIndex();
+
   return eReplayCreate_Success;
 }
 
@@ -1618,7 +1843,13 @@ bool ReplayRenderer::InitResolver()
 
 void ReplayRenderer::FetchPipelineState()
 {
-  m_pDevice->SavePipelineState();
+  RDCPROFILE_SCOPE("ReplayRenderer::FetchPipelineState");
+
+  m_PipelineStateChanges = m_pDevice->SavePipelineState();
+
+  // nothing to copy if stepping between events didn't change anything
+  if(m_PipelineStateChanges == ePipeChange_None)
+    return;
 
   m_D3D11PipelineState = m_pDevice->GetD3D11PipelineState();
   m_GLPipelineState = m_pDevice->GetGLPipelineState();
@@ -1712,6 +1943,11 @@ ReplayRenderer_GetVulkanPipelineState(ReplayRenderer *rend, VulkanPipelineState
 {
   return rend->GetVulkanPipelineState(state);
 }
+extern "C" RENDERDOC_API bool32 RENDERDOC_CC
+ReplayRenderer_GetPipelineStateChanges(ReplayRenderer *rend, uint32_t *changes)
+{
+  return rend->GetPipelineStateChanges(changes);
+}
 
 extern "C" RENDERDOC_API void RENDERDOC_CC ReplayRenderer_BuildCustomShader(
     ReplayRenderer *rend, const char *entry, const char *source, const uint32_t compileFlags,
@@ -1836,6 +2072,18 @@ ReplayRenderer_GetUsage(ReplayRenderer *rend, ResourceId id, rdctype::array<Even
 {
   return rend->GetUsage(id, usage);
 }
+extern "C" RENDERDOC_API bool32 RENDERDOC_CC
+ReplayRenderer_GetUsageInRange(ReplayRenderer *rend, ResourceId id, uint32_t startEID,
+                               uint32_t endEID, rdctype::array<EventUsage> *usage)
+{
+  return rend->GetUsageInRange(id, startEID, endEID, usage);
+}
+extern "C" RENDERDOC_API bool32 RENDERDOC_CC
+ReplayRenderer_GetResourcesUsedInRange(ReplayRenderer *rend, uint32_t startEID, uint32_t endEID,
+                                       bool32 writesOnly, rdctype::array<ResourceId> *resources)
+{
+  return rend->GetResourcesUsedInRange(startEID, endEID, writesOnly != 0, resources);
+}
 
 extern "C" RENDERDOC_API bool32 RENDERDOC_CC ReplayRenderer_GetCBufferVariableContents(
     ReplayRenderer *rend, ResourceId shader, const char *entryPoint, uint32_t cbufslot,
@@ -1859,6 +2107,12 @@ extern "C" RENDERDOC_API bool32 RENDERDOC_CC ReplayRenderer_GetPostVSData(Replay
   return rend->GetPostVSData(instID, stage, data);
 }
 
+extern "C" RENDERDOC_API bool32 RENDERDOC_CC
+ReplayRenderer_PrefetchPostVSData(ReplayRenderer *rend, uint32_t startEID, uint32_t endEID)
+{
+  return rend->PrefetchPostVSData(startEID, endEID);
+}
+
 extern "C" RENDERDOC_API bool32 RENDERDOC_CC
 ReplayRenderer_GetMinMax(ReplayRenderer *rend, ResourceId tex, uint32_t sliceFace, uint32_t mip,
                          uint32_t sample, PixelValue *minval, PixelValue *maxval)
@@ -25,6 +25,7 @@
 
 #pragma once
 
+#include <map>
 #include <set>
 #include <vector>
 #include "api/replay/renderdoc_replay.h"
@@ -32,6 +33,7 @@
 #include "core/core.h"
 #include "replay/replay_driver.h"
 #include "type_helpers.h"
+#include "usage_index.h"
 
 struct ReplayRenderer;
 
@@ -143,6 +145,7 @@ public:
   bool GetD3D11PipelineState(D3D11PipelineState *state);
   bool GetGLPipelineState(GLPipelineState *state);
   bool GetVulkanPipelineState(VulkanPipelineState *state);
+  bool GetPipelineStateChanges(uint32_t *changes);
 
   ResourceId BuildCustomShader(const char *entry, const char *source, const uint32_t compileFlags,
                                ShaderStageType type, rdctype::str *errors);
@@ -174,6 +177,7 @@ public:
   bool DebugThread(uint32_t groupid[3], uint32_t threadid[3], ShaderDebugTrace *trace);
 
   bool GetPostVSData(uint32_t instID, MeshDataStage stage, MeshFormat *data);
+  bool PrefetchPostVSData(uint32_t startEID, uint32_t endEID);
 
   bool GetMinMax(ResourceId tex, uint32_t sliceFace, uint32_t mip, uint32_t sample,
                  PixelValue *minval, PixelValue *maxval);
@@ -181,6 +185,10 @@ public:
                     float maxval, bool channels[4], rdctype::array<uint32_t> *histogram);
 
   bool GetUsage(ResourceId id, rdctype::array<EventUsage> *usage);
+  bool GetUsageInRange(ResourceId id, uint32_t startEID, uint32_t endEID,
+                       rdctype::array<EventUsage> *usage);
+  bool GetResourcesUsedInRange(uint32_t startEID, uint32_t endEID, bool writesOnly,
+                               rdctype::array<ResourceId> *resources);
 
   bool GetBufferData(ResourceId buff, uint64_t offset, uint64_t len, rdctype::array<byte> *data);
   bool GetTextureData(ResourceId buff, uint32_t arrayIdx, uint32_t mip, rdctype::array<byte> *data);
@@ -201,6 +209,8 @@ private:
 
   FetchDrawcall *GetDrawcallByEID(uint32_t eventID, uint32_t defEventID);
 
+  void BuildUsageIndex();
+
   IReplayDriver *GetDevice() { return m_pDevice; }
   struct FrameRecord
   {
@@ -220,11 +230,20 @@ private:
   GLPipelineState m_GLPipelineState;
   VulkanPipelineState m_VulkanPipelineState;
 
+  // PipelineStateChanges between the last two events that were selected
+  uint32_t m_PipelineStateChanges;
+
+  // results from FetchCounters, by counter ID. Each counter is only fetched once per capture
+  std::map<uint32_t, std::vector<CounterResult> > m_CounterResults;
+
   std::vector<ReplayOutput *> m_Outputs;
 
   std::vector<FetchBuffer> m_Buffers;
   std::vector<FetchTexture> m_Textures;
 
+  // usage of every texture and buffer, built the first time usage is queried
+  ResourceUsageIndex m_UsageIndex;
+
   IReplayDriver *m_pDevice;
 
   std::set<ResourceId> m_TargetResources;
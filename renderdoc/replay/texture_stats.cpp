@@ -0,0 +1,365 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "texture_stats.h"
+#include <string.h>
+#include "common/common.h"
+#include "maths/formatconvert.h"
+#include "os/os_specific.h"
+
+#if defined(RDC_SSE2)
+#include <emmintrin.h>
+#endif
+
+namespace TextureStats
+{
+// rows in each tile handed out to a worker, matches HGRAM_PIXELS_PER_TILE
+static const uint32_t TileRows = 64;
+
+// slices smaller than this aren't worth starting threads for
+static const uint64_t MinParallelTexels = 256 * 256;
+
+static const uint32_t MaxWorkers = 8;
+
+// decodes a row of texels to float4. Returns a pointer to the decoded row, which is the source
+// data itself when that's already float4
+static const Vec4f *DecodeRow(const ResourceFormat &fmt, const byte *src, uint32_t count,
+                              Vec4f *dst)
+{
+  if(!fmt.special && fmt.compType == eCompType_Float && fmt.compCount == 4 &&
+     fmt.compByteWidth == 4 && !fmt.bgraOrder)
+    return (const Vec4f *)src;
+
+  ConvertToFloat4(fmt, src, count, dst);
+  return dst;
+}
+
+// NaNs are skipped, as min/max with a NaN returns the other operand
+static void ReduceMinMax(const Vec4f *texels, uint32_t count, Vec4f &minval, Vec4f &maxval)
+{
+  const float *f = &texels[0].x;
+
+  uint32_t i = 0;
+
+#if defined(RDC_SSE2)
+  // two sets of accumulators to hide the min/max latency
+  __m128 min0 = _mm_loadu_ps(&minval.x), min1 = min0;
+  __m128 max0 = _mm_loadu_ps(&maxval.x), max1 = max0;
+
+  for(; i + 2 <= count; i += 2)
+  {
+    __m128 a = _mm_loadu_ps(f + i * 4);
+    __m128 b = _mm_loadu_ps(f + i * 4 + 4);
+
+    min0 = _mm_min_ps(a, min0);
+    max0 = _mm_max_ps(a, max0);
+    min1 = _mm_min_ps(b, min1);
+    max1 = _mm_max_ps(b, max1);
+  }
+
+  _mm_storeu_ps(&minval.x, _mm_min_ps(min1, min0));
+  _mm_storeu_ps(&maxval.x, _mm_max_ps(max1, max0));
+#endif
+
+  float *mn = &minval.x;
+  float *mx = &maxval.x;
+
+  for(; i < count; i++)
+  {
+    for(int c = 0; c < 4; c++)
+    {
+      float v = f[i * 4 + c];
+      mn[c] = v < mn[c] ? v : mn[c];
+      mx[c] = v > mx[c] ? v : mx[c];
+    }
+  }
+}
+
+struct HistogramParams
+{
+  bool channels[4];
+  float divisor;
+  float minval;
+  float range;
+};
+
+// the same arithmetic as the histogram compute shaders: the enabled channels are averaged, then
+// normalised to the range and bucketed. Anything outside the range (or NaN) isn't counted
+static void AccumulateHistogram(const Vec4f *texels, uint32_t count, const HistogramParams &params,
+                                uint32_t *buckets)
+{
+  const float *f = &texels[0].x;
+
+  uint32_t i = 0;
+
+#if defined(RDC_SSE2)
+  const __m128 divisor = _mm_set1_ps(params.divisor);
+  const __m128 minval = _mm_set1_ps(params.minval);
+  const __m128 range = _mm_set1_ps(params.range);
+  const __m128 numBuckets = _mm_set1_ps(float(NumBuckets));
+  const __m128 zero = _mm_setzero_ps();
+
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128 x = _mm_loadu_ps(f + i * 4 + 0);
+    __m128 y = _mm_loadu_ps(f + i * 4 + 4);
+    __m128 z = _mm_loadu_ps(f + i * 4 + 8);
+    __m128 w = _mm_loadu_ps(f + i * 4 + 12);
+
+    // four texels to four channels
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+
+    __m128 sum = zero;
+    if(params.channels[0])
+      sum = _mm_add_ps(sum, x);
+    if(params.channels[1])
+      sum = _mm_add_ps(sum, y);
+    if(params.channels[2])
+      sum = _mm_add_ps(sum, z);
+    if(params.channels[3])
+      sum = _mm_add_ps(sum, w);
+
+    __m128 normalised = _mm_div_ps(_mm_sub_ps(_mm_div_ps(sum, divisor), minval), range);
+    __m128 bucket = _mm_mul_ps(normalised, numBuckets);
+
+    int inRange = _mm_movemask_ps(
+        _mm_and_ps(_mm_cmpge_ps(bucket, zero), _mm_cmplt_ps(bucket, numBuckets)));
+
+    if(inRange == 0)
+      continue;
+
+    // truncation is floor, as the in-range values are all positive
+    int32_t idx[4];
+    _mm_storeu_si128((__m128i *)idx, _mm_cvttps_epi32(bucket));
+
+    for(int t = 0; t < 4; t++)
+      if(inRange & (1 << t))
+        buckets[idx[t]]++;
+  }
+#endif
+
+  for(; i < count; i++)
+  {
+    float sum = 0.0f;
+    for(int c = 0; c < 4; c++)
+      if(params.channels[c])
+        sum += f[i * 4 + c];
+
+    float normalised = (sum / params.divisor - params.minval) / params.range;
+    float bucket = normalised * float(NumBuckets);
+
+    if(bucket >= 0.0f && bucket < float(NumBuckets))
+      buckets[uint32_t(bucket)]++;
+  }
+}
+
+struct StatsJob
+{
+  const ResourceFormat *fmt;
+  const byte *data;
+  uint32_t texelSize;
+  uint32_t width, height;
+  uint32_t numTiles;
+
+  // if set, a histogram is calculated rather than the min/max
+  const HistogramParams *histogram;
+
+  // one entry (or NumBuckets entries) per tile, merged in tile order once all workers are done
+  std::vector<Vec4f> tileMin, tileMax;
+  std::vector<uint32_t> tileBuckets;
+
+  volatile int32_t next;
+};
+
+static inline float PositiveInfinity()
+{
+  uint32_t bits = 0x7f800000;
+  float ret = 0.0f;
+  memcpy(&ret, &bits, sizeof(ret));
+  return ret;
+}
+
+static void StatsWorker(void *d)
+{
+  StatsJob *job = (StatsJob *)d;
+
+  std::vector<Vec4f> scratch(job->width);
+
+  const size_t rowPitch = size_t(job->width) * job->texelSize;
+  const float inf = PositiveInfinity();
+
+  for(;;)
+  {
+    int32_t tile = Atomic::Inc32(&job->next) - 1;
+
+    if(tile >= (int32_t)job->numTiles)
+      break;
+
+    uint32_t firstRow = tile * TileRows;
+    uint32_t lastRow = RDCMIN(firstRow + TileRows, job->height);
+
+    Vec4f minval(inf, inf, inf, inf);
+    Vec4f maxval(-inf, -inf, -inf, -inf);
+
+    for(uint32_t y = firstRow; y < lastRow; y++)
+    {
+      const Vec4f *row = DecodeRow(*job->fmt, job->data + y * rowPitch, job->width, &scratch[0]);
+
+      if(job->histogram)
+        AccumulateHistogram(row, job->width, *job->histogram, &job->tileBuckets[tile * NumBuckets]);
+      else
+        ReduceMinMax(row, job->width, minval, maxval);
+    }
+
+    if(!job->histogram)
+    {
+      job->tileMin[tile] = minval;
+      job->tileMax[tile] = maxval;
+    }
+  }
+}
+
+static bool RunJob(StatsJob &job, const ResourceFormat &fmt, const byte *data, size_t dataSize,
+                   uint32_t width, uint32_t height)
+{
+  job.fmt = &fmt;
+  job.data = data;
+  job.texelSize = GetFloat4TexelSize(fmt);
+  job.width = width;
+  job.height = height;
+  job.numTiles = (height + TileRows - 1) / TileRows;
+  job.next = 0;
+
+  if(job.texelSize == 0 || width == 0 || height == 0)
+    return false;
+
+  if(data == NULL || dataSize < uint64_t(width) * height * job.texelSize)
+  {
+    RDCWARN("Texture data is %llu bytes, expected %llu for %ux%u", (uint64_t)dataSize,
+            uint64_t(width) * height * job.texelSize, width, height);
+    return false;
+  }
+
+  if(job.histogram)
+  {
+    job.tileBuckets.resize(job.numTiles * NumBuckets);
+  }
+  else
+  {
+    job.tileMin.resize(job.numTiles);
+    job.tileMax.resize(job.numTiles);
+  }
+
+  // this thread works through the tiles too, so only start extra threads if there's work for them
+  uint32_t numThreads = 0;
+  if(uint64_t(width) * height >= MinParallelTexels)
+    numThreads = RDCMIN(job.numTiles, MaxWorkers) - 1;
+
+  Threading::ThreadHandle threads[MaxWorkers];
+  for(uint32_t i = 0; i < numThreads; i++)
+    threads[i] = Threading::CreateThread(&StatsWorker, &job);
+
+  StatsWorker(&job);
+
+  for(uint32_t i = 0; i < numThreads; i++)
+  {
+    Threading::JoinThread(threads[i]);
+    Threading::CloseThread(threads[i]);
+  }
+
+  return true;
+}
+
+bool GetMinMax(const ResourceFormat &fmt, const byte *data, size_t dataSize, uint32_t width,
+               uint32_t height, float minval[4], float maxval[4])
+{
+  StatsJob job;
+  job.histogram = NULL;
+
+  if(!RunJob(job, fmt, data, dataSize, width, height))
+    return false;
+
+  for(int c = 0; c < 4; c++)
+  {
+    minval[c] = (&job.tileMin[0].x)[c];
+    maxval[c] = (&job.tileMax[0].x)[c];
+
+    for(uint32_t t = 1; t < job.numTiles; t++)
+    {
+      minval[c] = RDCMIN(minval[c], (&job.tileMin[t].x)[c]);
+      maxval[c] = RDCMAX(maxval[c], (&job.tileMax[t].x)[c]);
+    }
+
+    // every value was NaN
+    if(minval[c] > maxval[c])
+      minval[c] = maxval[c] = 0.0f;
+  }
+
+  return true;
+}
+
+bool GetHistogram(const ResourceFormat &fmt, const byte *data, size_t dataSize, uint32_t width,
+                  uint32_t height, float minval, float maxval, const bool channels[4],
+                  std::vector<uint32_t> &histogram)
+{
+  if(minval >= maxval)
+    return false;
+
+  HistogramParams params;
+  params.divisor = 0.0f;
+  params.minval = minval;
+  params.range = maxval - minval;
+
+  for(int c = 0; c < 4; c++)
+  {
+    params.channels[c] = channels[c];
+    if(channels[c])
+      params.divisor += 1.0f;
+  }
+
+  // with no channels selected nothing is counted
+  if(params.divisor == 0.0f)
+  {
+    if(GetFloat4TexelSize(fmt) == 0)
+      return false;
+
+    histogram.assign(NumBuckets, 0);
+    return true;
+  }
+
+  StatsJob job;
+  job.histogram = &params;
+
+  if(!RunJob(job, fmt, data, dataSize, width, height))
+    return false;
+
+  histogram.assign(NumBuckets, 0);
+
+  for(uint32_t t = 0; t < job.numTiles; t++)
+    for(uint32_t b = 0; b < NumBuckets; b++)
+      histogram[b] += job.tileBuckets[t * NumBuckets + b];
+
+  return true;
+}
+};
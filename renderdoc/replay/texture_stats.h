@@ -0,0 +1,48 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include "api/replay/renderdoc_replay.h"
+#include "maths/formatconvert.h"
+
+// CPU implementations of IReplayDriver::GetMinMax and GetHistogram, for when the texel data is
+// already on the CPU (image files, proxied textures) or there's no GPU to run the compute shaders
+// on. Both work on one 2D slice of tightly packed texels, as returned by GetTextureData, decode
+// texels with ConvertToFloat4 (so GetFloat4TexelSize gives the texel size), and give the same
+// results as the histogram compute shaders. The slice is split into tiles of rows that are spread
+// across worker threads for large slices.
+namespace TextureStats
+{
+// matches HGRAM_NUM_BUCKETS in the GPU implementations
+const uint32_t NumBuckets = 256;
+
+bool GetMinMax(const ResourceFormat &fmt, const byte *data, size_t dataSize, uint32_t width,
+               uint32_t height, float minval[4], float maxval[4]);
+
+bool GetHistogram(const ResourceFormat &fmt, const byte *data, size_t dataSize, uint32_t width,
+                  uint32_t height, float minval, float maxval, const bool channels[4],
+                  std::vector<uint32_t> &histogram);
+};
@@ -0,0 +1,214 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "usage_index.h"
+#include <algorithm>
+#include "common/timing.h"
+#include "replay/replay_driver.h"
+
+void ResourceUsageIndex::Build(IReplayDriver *driver, const std::vector<ResourceId> &resources)
+{
+  RDCPROFILE_SCOPE("ResourceUsageIndex::Build");
+
+  PerformanceTimer timer;
+
+  Clear();
+
+  m_Resources = resources;
+  std::sort(m_Resources.begin(), m_Resources.end());
+  m_Resources.erase(std::unique(m_Resources.begin(), m_Resources.end()), m_Resources.end());
+
+  m_ResourceOffsets.reserve(m_Resources.size() + 1);
+
+  // which resource each by-resource position belongs to, to fill the by-event columns
+  std::vector<uint32_t> owners;
+
+  // fetched all at once, a remote replay would otherwise need a round trip per resource
+  std::vector<std::vector<EventUsage> > usages = driver->GetUsages(m_Resources);
+  usages.resize(m_Resources.size());
+
+  for(size_t i = 0; i < m_Resources.size(); i++)
+  {
+    m_ResourceOffsets.push_back((uint32_t)m_EventIDs.size());
+
+    std::vector<EventUsage> &usage = usages[i];
+
+    std::sort(usage.begin(), usage.end());
+
+    for(size_t u = 0; u < usage.size(); u++)
+    {
+      m_EventIDs.push_back(usage[u].eventID);
+      m_Usages.push_back((uint8_t)usage[u].usage);
+      owners.push_back((uint32_t)i);
+    }
+  }
+
+  m_ResourceOffsets.push_back((uint32_t)m_EventIDs.size());
+
+  m_EventIDs.shrink_to_fit();
+  m_Usages.shrink_to_fit();
+
+  // counting sort the by-resource positions into event order. Event IDs are dense and the
+  // positions are visited in resource order, so each event's usages stay sorted by resource
+  uint32_t maxEID = 0;
+  for(size_t i = 0; i < m_EventIDs.size(); i++)
+    maxEID = RDCMAX(maxEID, m_EventIDs[i]);
+
+  std::vector<uint32_t> eventStart(maxEID + 2, 0);
+  for(size_t i = 0; i < m_EventIDs.size(); i++)
+    eventStart[m_EventIDs[i] + 1]++;
+  for(size_t e = 1; e < eventStart.size(); e++)
+    eventStart[e] += eventStart[e - 1];
+
+  m_EventOrderIDs.resize(m_EventIDs.size());
+  m_EventOrderResources.resize(m_EventIDs.size());
+  m_EventOrderUsages.resize(m_EventIDs.size());
+
+  for(size_t pos = 0; pos < m_EventIDs.size(); pos++)
+  {
+    uint32_t i = eventStart[m_EventIDs[pos]]++;
+
+    m_EventOrderIDs[i] = m_EventIDs[pos];
+    m_EventOrderResources[i] = owners[pos];
+    m_EventOrderUsages[i] = m_Usages[pos];
+  }
+
+  m_Built = true;
+
+  RDCLOG("Indexed %u usages of %u resources in %.2lf ms, using %llu bytes",
+         (uint32_t)m_EventIDs.size(), (uint32_t)m_Resources.size(), timer.GetMilliseconds(),
+         GetMemoryUsage());
+}
+
+void ResourceUsageIndex::Clear()
+{
+  m_Built = false;
+
+  m_Resources.clear();
+  m_ResourceOffsets.clear();
+  m_EventIDs.clear();
+  m_Usages.clear();
+  m_EventOrderIDs.clear();
+  m_EventOrderResources.clear();
+  m_EventOrderUsages.clear();
+}
+
+bool ResourceUsageIndex::GetUsage(ResourceId resource, uint32_t startEID, uint32_t endEID,
+                                  rdctype::array<EventUsage> *usage) const
+{
+  auto it = std::lower_bound(m_Resources.begin(), m_Resources.end(), resource);
+
+  if(it == m_Resources.end() || *it != resource)
+    return false;
+
+  size_t res = it - m_Resources.begin();
+
+  const uint32_t *begin = m_EventIDs.data() + m_ResourceOffsets[res];
+  const uint32_t *end = m_EventIDs.data() + m_ResourceOffsets[res + 1];
+
+  const uint32_t *first = std::lower_bound(begin, end, startEID);
+  const uint32_t *last = std::upper_bound(first, end, endEID);
+
+  if(usage)
+  {
+    std::vector<EventUsage> ret;
+    ret.reserve(last - first);
+
+    for(const uint32_t *e = first; e != last; ++e)
+      ret.push_back(EventUsage(*e, (ResourceUsage)m_Usages[e - m_EventIDs.data()]));
+
+    *usage = ret;
+  }
+
+  return true;
+}
+
+void ResourceUsageIndex::GetResourcesUsed(uint32_t startEID, uint32_t endEID, bool writesOnly,
+                                          rdctype::array<ResourceId> *resources) const
+{
+  if(resources == NULL)
+    return;
+
+  size_t first =
+      std::lower_bound(m_EventOrderIDs.begin(), m_EventOrderIDs.end(), startEID) -
+      m_EventOrderIDs.begin();
+  size_t last = std::upper_bound(m_EventOrderIDs.begin() + first, m_EventOrderIDs.end(), endEID) -
+                m_EventOrderIDs.begin();
+
+  std::vector<uint32_t> used;
+
+  for(size_t i = first; i < last; i++)
+  {
+    if(writesOnly && !IsWriteUsage((ResourceUsage)m_EventOrderUsages[i]))
+      continue;
+
+    used.push_back(m_EventOrderResources[i]);
+  }
+
+  std::sort(used.begin(), used.end());
+  used.erase(std::unique(used.begin(), used.end()), used.end());
+
+  std::vector<ResourceId> ret;
+  ret.reserve(used.size());
+
+  for(size_t i = 0; i < used.size(); i++)
+    ret.push_back(m_Resources[used[i]]);
+
+  *resources = ret;
+}
+
+uint64_t ResourceUsageIndex::GetMemoryUsage() const
+{
+  return m_Resources.capacity() * sizeof(ResourceId) +
+         m_ResourceOffsets.capacity() * sizeof(uint32_t) +
+         m_EventIDs.capacity() * sizeof(uint32_t) + m_Usages.capacity() * sizeof(uint8_t) +
+         m_EventOrderIDs.capacity() * sizeof(uint32_t) +
+         m_EventOrderResources.capacity() * sizeof(uint32_t) +
+         m_EventOrderUsages.capacity() * sizeof(uint8_t);
+}
+
+bool ResourceUsageIndex::IsWriteUsage(ResourceUsage usage)
+{
+  switch(usage)
+  {
+    case eUsage_SO:
+    case eUsage_VS_RWResource:
+    case eUsage_HS_RWResource:
+    case eUsage_DS_RWResource:
+    case eUsage_GS_RWResource:
+    case eUsage_PS_RWResource:
+    case eUsage_CS_RWResource:
+    case eUsage_ColourTarget:
+    case eUsage_DepthStencilTarget:
+    case eUsage_Clear:
+    case eUsage_GenMips:
+    case eUsage_Resolve:
+    case eUsage_ResolveDst:
+    case eUsage_Copy:
+    case eUsage_CopyDst: return true;
+    default: break;
+  }
+
+  return false;
+}
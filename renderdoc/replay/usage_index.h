@@ -0,0 +1,74 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <vector>
+#include "api/replay/renderdoc_replay.h"
+
+class IReplayDriver;
+
+// A columnar index of every resource's usage in a capture, built once from the driver's
+// per-resource usage lists. The usages are stored twice as parallel arrays - once sorted by
+// resource then event, and once sorted by event then resource - so that queries binary search
+// straight to the range they want rather than copying or walking a resource's whole list.
+class ResourceUsageIndex
+{
+public:
+  ResourceUsageIndex() : m_Built(false) {}
+  bool IsBuilt() const { return m_Built; }
+  // fetches the usage of each of resources from the driver and indexes it
+  void Build(IReplayDriver *driver, const std::vector<ResourceId> &resources);
+  void Clear();
+
+  // the usages of resource between startEID and endEID inclusive, in event order. Returns false
+  // if the resource isn't in the index
+  bool GetUsage(ResourceId resource, uint32_t startEID, uint32_t endEID,
+                rdctype::array<EventUsage> *usage) const;
+
+  // the resources used between startEID and endEID inclusive, sorted by ID. If writesOnly is set
+  // only resources that were written to in the range are returned
+  void GetResourcesUsed(uint32_t startEID, uint32_t endEID, bool writesOnly,
+                        rdctype::array<ResourceId> *resources) const;
+
+  uint64_t GetMemoryUsage() const;
+
+  static bool IsWriteUsage(ResourceUsage usage);
+
+private:
+  bool m_Built;
+
+  // sorted resource IDs, with the range of each one's usages in the by-resource columns
+  std::vector<ResourceId> m_Resources;
+  std::vector<uint32_t> m_ResourceOffsets;
+
+  // by resource, then by event. Usages are ResourceUsage values, which all fit in a byte
+  std::vector<uint32_t> m_EventIDs;
+  std::vector<uint8_t> m_Usages;
+
+  // by event, then by resource. Resources are indices into m_Resources
+  std::vector<uint32_t> m_EventOrderIDs;
+  std::vector<uint32_t> m_EventOrderResources;
+  std::vector<uint8_t> m_EventOrderUsages;
+};
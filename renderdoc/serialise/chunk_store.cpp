@@ -0,0 +1,357 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "chunk_store.h"
+#include "3rdparty/lz4/lz4.h"
+#include "common/profiler.h"
+#include "common/threading.h"
+#include "serialiser.h"
+
+ChunkStore *ChunkStore::m_Inst = NULL;
+
+void ChunkStore::Init(const std::string &spillFilename, uint64_t budget)
+{
+  RDCASSERT(m_Inst == NULL);
+
+  FILE *f = FileIO::fopen(spillFilename.c_str(), "w+b");
+
+  if(f == NULL)
+  {
+    RDCWARN("Couldn't open chunk spill file '%s', idle chunks will be kept in memory",
+            spillFilename.c_str());
+    return;
+  }
+
+  RDCLOG("Keeping idle chunks within %llu MB, spilling to '%s'", budget / (1024 * 1024),
+         spillFilename.c_str());
+
+  m_Inst = new ChunkStore(f, spillFilename, budget);
+}
+
+void ChunkStore::Shutdown()
+{
+  // any chunks still registered keep their flag, and when they're deleted they find no store and
+  // skip unregistering. Spilled data is gone with the file.
+  SAFE_DELETE(m_Inst);
+}
+
+ChunkStore::ChunkStore(FILE *f, const std::string &filename, uint64_t budget)
+{
+  m_File = f;
+  m_Filename = filename;
+  m_Failed = false;
+  m_Budget = budget;
+  m_Head = m_Tail = NULL;
+  m_ResidentBytes = m_SpilledBytes = m_SpillFileBytes = 0;
+  m_FileEnd = 0;
+}
+
+ChunkStore::~ChunkStore()
+{
+  FileIO::fclose(m_File);
+  FileIO::Delete(m_Filename.c_str());
+}
+
+void ChunkStore::Link(Chunk *chunk)
+{
+  chunk->m_StorePrev = NULL;
+  chunk->m_StoreNext = m_Head;
+  if(m_Head)
+    m_Head->m_StorePrev = chunk;
+  m_Head = chunk;
+  if(m_Tail == NULL)
+    m_Tail = chunk;
+
+  m_ResidentBytes += chunk->m_Length;
+}
+
+void ChunkStore::Unlink(Chunk *chunk)
+{
+  if(chunk->m_StorePrev)
+    chunk->m_StorePrev->m_StoreNext = chunk->m_StoreNext;
+  else
+    m_Head = chunk->m_StoreNext;
+
+  if(chunk->m_StoreNext)
+    chunk->m_StoreNext->m_StorePrev = chunk->m_StorePrev;
+  else
+    m_Tail = chunk->m_StorePrev;
+
+  chunk->m_StorePrev = chunk->m_StoreNext = NULL;
+
+  m_ResidentBytes -= chunk->m_Length;
+}
+
+void ChunkStore::Register(Chunk *chunk)
+{
+  // temporary chunks are deleted as soon as they're written, and small chunks aren't worth it
+  if(chunk->m_Temporary || chunk->m_Length < MinSpillSize)
+    return;
+
+  SCOPED_LOCK(m_Lock);
+
+  // the same chunk can be added to more than one record
+  if(chunk->m_Stored)
+    return;
+
+  chunk->m_Stored = true;
+  Link(chunk);
+
+  EnforceBudget(chunk);
+}
+
+void ChunkStore::Remove(Chunk *chunk, bool pageIn)
+{
+  SCOPED_LOCK(m_Lock);
+
+  if(!chunk->m_Stored)
+    return;
+
+  if(chunk->m_Data)
+  {
+    Unlink(chunk);
+  }
+  else if(pageIn)
+  {
+    PageIn(chunk);
+  }
+  else
+  {
+    FreeExtent(chunk->m_SpillOffset, chunk->m_SpillLength);
+    m_SpilledBytes -= chunk->m_Length;
+    m_SpillFileBytes -= chunk->m_SpillLength;
+  }
+
+  chunk->m_Stored = false;
+}
+
+byte *ChunkStore::Acquire(Chunk *chunk)
+{
+  SCOPED_LOCK(m_Lock);
+
+  chunk->m_DataRefs++;
+
+  if(chunk->m_Stored)
+  {
+    if(chunk->m_Data == NULL)
+    {
+      PageIn(chunk);
+      Link(chunk);
+      EnforceBudget(chunk);
+    }
+    else
+    {
+      // move to most recently used
+      Unlink(chunk);
+      Link(chunk);
+    }
+  }
+
+  return chunk->m_Data;
+}
+
+void ChunkStore::Release(Chunk *chunk)
+{
+  SCOPED_LOCK(m_Lock);
+
+  RDCASSERT(chunk->m_DataRefs > 0);
+  chunk->m_DataRefs--;
+}
+
+void ChunkStore::EnforceBudget(Chunk *keep)
+{
+  if(m_Failed)
+    return;
+
+  Chunk *chunk = m_Tail;
+
+  while(chunk && m_ResidentBytes > m_Budget)
+  {
+    Chunk *prev = chunk->m_StorePrev;
+
+    // chunks being read from stay resident
+    if(chunk != keep && chunk->m_DataRefs == 0)
+    {
+      if(!Spill(chunk))
+        return;
+    }
+
+    chunk = prev;
+  }
+}
+
+bool ChunkStore::Spill(Chunk *chunk)
+{
+  const byte *src = chunk->m_Data;
+  uint32_t length = chunk->m_Length;
+  uint32_t diskLength = length;
+
+  if(length <= LZ4_MAX_INPUT_SIZE)
+  {
+    int bound = LZ4_COMPRESSBOUND(length);
+    if(m_CompressBuf.size() < (size_t)bound)
+      m_CompressBuf.resize(bound);
+
+    int compSize = LZ4_compress_default((const char *)src, (char *)&m_CompressBuf[0], (int)length,
+                                        bound);
+
+    // not worth decompressing later unless it saves at least 1/8th, and if it doesn't we can
+    // read straight back into the chunk
+    if(compSize > 0 && (uint32_t)compSize < length - length / 8)
+    {
+      src = &m_CompressBuf[0];
+      diskLength = (uint32_t)compSize;
+    }
+  }
+
+  uint64_t offset = AllocExtent(diskLength);
+
+  FileIO::fseek64(m_File, offset, SEEK_SET);
+  if(FileIO::fwrite(src, 1, diskLength, m_File) != diskLength)
+  {
+    RDCERR("Failed to write %u bytes to chunk spill file, keeping chunks in memory from now on",
+           diskLength);
+    FreeExtent(offset, diskLength);
+    m_Failed = true;
+    return false;
+  }
+
+  Unlink(chunk);
+
+  if(chunk->m_AlignedData)
+    Serialiser::FreeAlignedBuffer(chunk->m_Data);
+  else
+    delete[] chunk->m_Data;
+
+  chunk->m_Data = NULL;
+  chunk->m_SpillOffset = offset;
+  chunk->m_SpillLength = diskLength;
+
+  m_SpilledBytes += length;
+  m_SpillFileBytes += diskLength;
+
+  RDCPROFILE_COUNTER(Profile_ChunkBytesSpilled, length);
+
+  return true;
+}
+
+void ChunkStore::PageIn(Chunk *chunk)
+{
+  uint32_t length = chunk->m_Length;
+  uint32_t diskLength = chunk->m_SpillLength;
+
+  byte *data = NULL;
+  if(chunk->m_AlignedData)
+    data = Serialiser::AllocAlignedBuffer(length);
+  else
+    data = new byte[length];
+
+  byte *dst = data;
+  if(diskLength != length)
+  {
+    if(m_CompressBuf.size() < diskLength)
+      m_CompressBuf.resize(diskLength);
+    dst = &m_CompressBuf[0];
+  }
+
+  FileIO::fseek64(m_File, chunk->m_SpillOffset, SEEK_SET);
+  bool success = (FileIO::fread(dst, 1, diskLength, m_File) == diskLength);
+
+  if(success && diskLength != length)
+    success = LZ4_decompress_safe((const char *)dst, (char *)data, (int)diskLength, (int)length) ==
+              (int)length;
+
+  if(!success)
+  {
+    RDCERR("Failed to read back %u byte chunk from spill file", length);
+    memset(data, 0, length);
+  }
+
+  chunk->m_Data = data;
+
+  FreeExtent(chunk->m_SpillOffset, diskLength);
+
+  m_SpilledBytes -= length;
+  m_SpillFileBytes -= diskLength;
+
+  RDCPROFILE_COUNTER(Profile_ChunkBytesPagedIn, length);
+}
+
+uint64_t ChunkStore::AllocExtent(uint64_t size)
+{
+  // first fit. Spilled chunks are all fairly large so there are never very many free ranges
+  for(auto it = m_FreeExtents.begin(); it != m_FreeExtents.end(); ++it)
+  {
+    if(it->second < size)
+      continue;
+
+    uint64_t offset = it->first;
+    uint64_t remaining = it->second - size;
+
+    m_FreeExtents.erase(it);
+
+    if(remaining > 0)
+      m_FreeExtents[offset + size] = remaining;
+
+    return offset;
+  }
+
+  uint64_t offset = m_FileEnd;
+  m_FileEnd += size;
+  return offset;
+}
+
+void ChunkStore::FreeExtent(uint64_t offset, uint64_t size)
+{
+  if(size == 0)
+    return;
+
+  // merge with the following range
+  auto next = m_FreeExtents.find(offset + size);
+  if(next != m_FreeExtents.end())
+  {
+    size += next->second;
+    m_FreeExtents.erase(next);
+  }
+
+  // and with the preceding one
+  auto it = m_FreeExtents.lower_bound(offset);
+  if(it != m_FreeExtents.begin())
+  {
+    --it;
+    if(it->first + it->second == offset)
+    {
+      offset = it->first;
+      size += it->second;
+      m_FreeExtents.erase(it);
+    }
+  }
+
+  // ranges at the end just shrink the file. We don't bother truncating it on disk, the space is
+  // reused by the next spill.
+  if(offset + size == m_FileEnd)
+    m_FileEnd = offset;
+  else
+    m_FreeExtents[offset] = size;
+}
@@ -0,0 +1,112 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "common/common.h"
+#include "os/os_specific.h"
+
+class Chunk;
+
+// Bounds the memory used by chunks that resource records keep for the lifetime of the application
+// - buffer and texture uploads, resource creation and so on - which are only needed if the
+// resource is used in a capture. Registered chunks are kept in least-recently-used order, and once
+// they exceed the budget the oldest are LZ4 compressed and written out to a temporary file. Their
+// data is read back in when it's next needed, usually when the chunk is written into a capture.
+//
+// Chunks that hand out their data pointer with GetData() are taken out of the store, since the
+// pointer may be held indefinitely (e.g. as a record's backing store for map writes).
+class ChunkStore
+{
+public:
+  // chunks smaller than this aren't registered, they aren't worth the bookkeeping
+  static const uint32_t MinSpillSize = 16 * 1024;
+
+  // used if RENDERDOC_CHUNK_BUDGET_MB isn't set. Setting it to 0 disables spilling.
+  static const uint64_t DefaultBudgetMB = 512;
+
+  static void Init(const std::string &spillFilename, uint64_t budget);
+  static void Shutdown();
+
+  // returns NULL if spilling isn't enabled
+  static ChunkStore *Get() { return m_Inst; }
+  void Register(Chunk *chunk);
+  // removes the chunk from the store. If pageIn is true any spilled data is read back first,
+  // otherwise it's discarded (for when the chunk is being deleted).
+  void Remove(Chunk *chunk, bool pageIn);
+
+  // makes sure the chunk's data is resident, and holds it so until the matching Release()
+  byte *Acquire(Chunk *chunk);
+  void Release(Chunk *chunk);
+
+  // bytes of registered chunk data held in memory
+  uint64_t GetResidentBytes() { return m_ResidentBytes; }
+  // uncompressed bytes of chunk data that are spilled to disk
+  uint64_t GetSpilledBytes() { return m_SpilledBytes; }
+  // bytes the spilled chunks take up in the spill file
+  uint64_t GetSpillFileBytes() { return m_SpillFileBytes; }
+private:
+  ChunkStore(FILE *f, const std::string &filename, uint64_t budget);
+  ~ChunkStore();
+
+  static ChunkStore *m_Inst;
+
+  void Link(Chunk *chunk);
+  void Unlink(Chunk *chunk);
+
+  // spills least recently used chunks until we're within budget. keep is never spilled.
+  void EnforceBudget(Chunk *keep);
+  bool Spill(Chunk *chunk);
+  void PageIn(Chunk *chunk);
+
+  uint64_t AllocExtent(uint64_t size);
+  void FreeExtent(uint64_t offset, uint64_t size);
+
+  Threading::CriticalSection m_Lock;
+
+  FILE *m_File;
+  std::string m_Filename;
+  // set after a write fails, we stop spilling and keep everything resident
+  bool m_Failed;
+
+  uint64_t m_Budget;
+
+  // resident registered chunks, most recently used at the head
+  Chunk *m_Head, *m_Tail;
+
+  uint64_t m_ResidentBytes;
+  uint64_t m_SpilledBytes;
+  uint64_t m_SpillFileBytes;
+
+  // free ranges in the spill file, offset -> size. The file is only appended to when there's no
+  // free range big enough.
+  std::map<uint64_t, uint64_t> m_FreeExtents;
+  uint64_t m_FileEnd;
+
+  std::vector<byte> m_CompressBuf;
+};
@@ -28,6 +28,7 @@
 #include "3rdparty/lz4/lz4.h"
 #include "common/timing.h"
 #include "core/core.h"
+#include "serialise/chunk_store.h"
 #include "serialise/string_utils.h"
 
 #ifdef _MSC_VER
@@ -47,15 +48,105 @@ int64_t Chunk::m_MaxChunks = 0;
 const uint32_t Serialiser::MAGIC_HEADER = MAKE_FOURCC('R', 'D', 'O', 'C');
 const uint64_t Serialiser::BufferAlignment = 64;
 
+static Threading::CriticalSection partialFilesLock;
+static vector<PartialCaptureFile *> partialFiles;
+
+PartialCaptureFile::PartialCaptureFile(const char *path)
+    : m_Path(path), m_Length(0), m_Available(0), m_FrameCaptureEnd(0), m_State(0)
+{
+  SCOPED_LOCK(partialFilesLock);
+  partialFiles.push_back(this);
+}
+
+PartialCaptureFile::~PartialCaptureFile()
+{
+  SCOPED_LOCK(partialFilesLock);
+  for(size_t i = 0; i < partialFiles.size(); i++)
+  {
+    if(partialFiles[i] == this)
+    {
+      partialFiles.erase(partialFiles.begin() + i);
+      break;
+    }
+  }
+}
+
+PartialCaptureFile *PartialCaptureFile::Find(const string &path)
+{
+  SCOPED_LOCK(partialFilesLock);
+  for(size_t i = 0; i < partialFiles.size(); i++)
+    if(partialFiles[i]->m_Path == path)
+      return partialFiles[i];
+
+  return NULL;
+}
+
+void PartialCaptureFile::Begin(uint64_t length)
+{
+  Atomic::ExchAdd64(&m_Length, (int64_t)length);
+}
+
+void PartialCaptureFile::Advance(uint64_t length)
+{
+  Atomic::ExchAdd64(&m_Available, (int64_t)length);
+  m_Written.Wake(1);
+}
+
+void PartialCaptureFile::Finish(bool success)
+{
+  Atomic::CmpExch32(&m_State, 0, success ? 1 : -1);
+  m_Written.Wake(1);
+}
+
+bool PartialCaptureFile::WaitFor(uint64_t end)
+{
+  for(;;)
+  {
+    // check the state first, so if it's finished everything written is counted below
+    int32_t state = Atomic::CmpExch32(&m_State, 0, 0);
+
+    if((uint64_t)Atomic::ExchAdd64(&m_Available, 0) >= end)
+      return true;
+
+    if(state != 0)
+      return state > 0;
+
+    // wakes can be missed or left over, so this only bounds how long before checking again
+    m_Written.WaitForWake(100);
+  }
+}
+
+bool PartialCaptureFile::WaitForComplete()
+{
+  return WaitFor(~0ULL) && Atomic::CmpExch32(&m_State, 0, 0) > 0;
+}
+
+void PartialCaptureFile::SetFrameCaptureEnd(uint64_t end)
+{
+  // every reader finds the same offset, so it doesn't matter which one sets it
+  m_FrameCaptureEnd = (int64_t)end;
+}
+
+// reads from a file that may still be being written, see PartialCaptureFile. If writing failed
+// before the data arrived this reads from the end, as it would from a truncated file
+static size_t ReadPartialFile(PartialCaptureFile *partial, void *buf, size_t length, FILE *f)
+{
+  if(partial && !partial->WaitFor(FileIO::ftell64(f) + length))
+    FileIO::fseek64(f, 0, SEEK_END);
+
+  return FileIO::fread(buf, 1, length, f);
+}
+
 // based on blockStreaming_doubleBuffer.c in lz4 examples
 struct CompressedFileIO
 {
   // large block size
   static const size_t BlockSize = 64 * 1024;
 
-  CompressedFileIO(FILE *f)
+  CompressedFileIO(FILE *f, PartialCaptureFile *partial = NULL)
   {
     m_F = f;
+    m_PartialFile = partial;
     LZ4_resetStream(&m_LZ4Comp);
     LZ4_setStreamDecode(&m_LZ4Decomp, NULL, 0);
     m_CompressedSize = m_UncompressedSize = 0;
@@ -171,7 +262,16 @@ struct CompressedFileIO
       }
 
       if(len > 0)
+      {
         FillBuffer();    // this will swap the input pages and reset the page offset
+
+        // past the end of a truncated or corrupt file there's nothing more to read
+        if(m_PageData == 0)
+        {
+          memset(data, 0, len);
+          break;
+        }
+      }
     } while(len > 0);
   }
 
@@ -179,8 +279,16 @@ struct CompressedFileIO
   {
     int32_t compSize = 0;
 
-    FileIO::fread(&compSize, sizeof(compSize), 1, m_F);
-    FileIO::fread(m_CompressBuf, 1, compSize, m_F);
+    ReadPartialFile(m_PartialFile, &compSize, sizeof(compSize), m_F);
+
+    if(compSize <= 0 || (size_t)compSize > m_CompressSize)
+    {
+      RDCERR("Invalid compressed block size %d", compSize);
+      m_PageData = 0;
+      return;
+    }
+
+    ReadPartialFile(m_PartialFile, m_CompressBuf, compSize, m_F);
 
     m_CompressedSize += compSize;
 
@@ -228,6 +336,7 @@ struct CompressedFileIO
   LZ4_stream_t m_LZ4Comp;
   LZ4_streamDecode_t m_LZ4Decomp;
   FILE *m_F;
+  PartialCaptureFile *m_PartialFile;
   uint32_t m_CompressedSize, m_UncompressedSize;
 
   byte m_InPages[2][BlockSize];
@@ -247,6 +356,12 @@ Chunk::Chunk(Serialiser *ser, uint32_t chunkType, bool temporary)
 
   m_Temporary = temporary;
 
+  m_Stored = false;
+  m_DataRefs = 0;
+  m_StorePrev = m_StoreNext = NULL;
+  m_SpillOffset = 0;
+  m_SpillLength = 0;
+
   if(ser->HasAlignedData())
   {
     m_Data = Serialiser::AllocAlignedBuffer(m_Length);
@@ -265,6 +380,9 @@ Chunk::Chunk(Serialiser *ser, uint32_t chunkType, bool temporary)
 
   ser->Rewind();
 
+  RDCPROFILE_COUNTER(Profile_ChunksCreated, 1);
+  RDCPROFILE_COUNTER(Profile_BytesSerialised, m_Length);
+
 #if !defined(RELEASE)
   int64_t newval = Atomic::Inc64(&m_LiveChunks);
   Atomic::ExchAdd64(&m_TotalMem, m_Length);
@@ -281,6 +399,9 @@ Chunk::Chunk(Serialiser *ser, uint32_t chunkType, bool temporary)
 
 Chunk::~Chunk()
 {
+  if(m_Stored && ChunkStore::Get())
+    ChunkStore::Get()->Remove(this, false);
+
 #if !defined(RELEASE)
   Atomic::Dec64(&m_LiveChunks);
   Atomic::ExchAdd64(&m_TotalMem, -int64_t(m_Length));
@@ -299,6 +420,26 @@ Chunk::~Chunk()
   }
 }
 
+void Chunk::Unstore()
+{
+  if(ChunkStore::Get())
+    ChunkStore::Get()->Remove(this, true);
+}
+
+byte *Chunk::AcquireData()
+{
+  if(ChunkStore::Get())
+    return ChunkStore::Get()->Acquire(this);
+
+  return m_Data;
+}
+
+void Chunk::ReleaseData()
+{
+  if(ChunkStore::Get())
+    ChunkStore::Get()->Release(this);
+}
+
 /*
 
  -----------------------------
@@ -628,7 +769,10 @@ Serialiser::Serialiser(const char *path, Mode mode, bool debugMode)
 
     RDCDEBUG("Opened capture file for read");
 
-    FileIO::fread(&header, 1, sizeof(FileHeader), m_ReadFileHandle);
+    // if the file is still being written, reads wait for the parts they need
+    m_PartialFile = PartialCaptureFile::Find(m_Filename);
+
+    ReadPartialFile(m_PartialFile, &header, sizeof(FileHeader), m_ReadFileHandle);
 
     if(header.magic != MAGIC_HEADER)
     {
@@ -646,6 +790,10 @@ Serialiser::Serialiser(const char *path, Mode mode, bool debugMode)
 
     if(header.version == 0x00000031)    // backwards compatibility
     {
+      // the file's length is checked up front, so it has to be complete
+      if(m_PartialFile)
+        m_PartialFile->WaitForComplete();
+
       uint64_t headerRemainder[2];
 
       FileIO::fread(&headerRemainder, 1, sizeof(headerRemainder), m_ReadFileHandle);
@@ -702,148 +850,13 @@ Serialiser::Serialiser(const char *path, Mode mode, bool debugMode)
     }
     else if(header.version == SERIALISE_VERSION)
     {
-      while(!FileIO::feof(m_ReadFileHandle))
+      // a file that's still arriving can be read once its frame capture section starts, the
+      // sections after that are read when they're needed
+      if(!ReadSectionTable(m_ReadFileHandle, m_PartialFile != NULL))
       {
-        BinarySectionHeader sectionHeader = {0};
-        byte *reading = (byte *)&sectionHeader;
-
-        FileIO::fread(reading, 1, 1, m_ReadFileHandle);
-        reading++;
-
-        if(FileIO::feof(m_ReadFileHandle))
-          break;
-
-        if(sectionHeader.isASCII == 'A')
-        {
-          // ASCII section
-          char c = 0;
-          FileIO::fread(&c, 1, 1, m_ReadFileHandle);
-          if(c != '\n')
-            RETURNCORRUPT("Invalid ASCII data section '%hhx'", c);
-
-          if(FileIO::feof(m_ReadFileHandle))
-            RETURNCORRUPT("Invalid truncated ASCII data section");
-
-          uint64_t length = 0;
-
-          c = '0';
-
-          while(!FileIO::feof(m_ReadFileHandle) && c != '\n')
-          {
-            c = '0';
-            FileIO::fread(&c, 1, 1, m_ReadFileHandle);
-
-            if(c == '\n')
-              break;
-
-            length *= 10;
-            length += int(c - '0');
-          }
-
-          if(FileIO::feof(m_ReadFileHandle))
-            RETURNCORRUPT("Invalid truncated ASCII data section");
-
-          union
-          {
-            uint32_t u32;
-            SectionType t;
-          } type;
-
-          type.u32 = 0;
-
-          c = '0';
-
-          while(!FileIO::feof(m_ReadFileHandle) && c != '\n')
-          {
-            c = '0';
-            FileIO::fread(&c, 1, 1, m_ReadFileHandle);
-
-            if(c == '\n')
-              break;
-
-            type.u32 *= 10;
-            type.u32 += int(c - '0');
-          }
-
-          if(FileIO::feof(m_ReadFileHandle))
-            RETURNCORRUPT("Invalid truncated ASCII data section");
-
-          string name;
-
-          c = 0;
-
-          while(!FileIO::feof(m_ReadFileHandle) && c != '\n')
-          {
-            c = 0;
-            FileIO::fread(&c, 1, 1, m_ReadFileHandle);
-
-            if(c == 0 || c == '\n')
-              break;
-
-            name.push_back(c);
-          }
-
-          if(FileIO::feof(m_ReadFileHandle))
-            RETURNCORRUPT("Invalid truncated ASCII data section");
-
-          Section *sect = new Section();
-          sect->flags = eSectionFlag_ASCIIStored;
-          sect->type = type.t;
-          sect->name = name;
-          sect->size = length;
-          sect->data.resize((size_t)length);
-          sect->fileoffset = FileIO::ftell64(m_ReadFileHandle);
-
-          FileIO::fread(&sect->data[0], 1, (size_t)length, m_ReadFileHandle);
-
-          if(sect->type != eSectionType_Unknown && sect->type < eSectionType_Num)
-            m_KnownSections[sect->type] = sect;
-          m_Sections.push_back(sect);
-        }
-        else if(sectionHeader.isASCII == 0x0)
-        {
-          FileIO::fread(reading, 1, offsetof(BinarySectionHeader, name) - 1, m_ReadFileHandle);
-
-          Section *sect = new Section();
-          sect->flags = sectionHeader.sectionFlags;
-          sect->type = sectionHeader.sectionType;
-          sect->name.resize(sectionHeader.sectionNameLength - 1);
-          sect->size = sectionHeader.sectionLength;
-
-          FileIO::fread(&sect->name[0], 1, sectionHeader.sectionNameLength - 1, m_ReadFileHandle);
-          char nullterm = 0;
-          FileIO::fread(&nullterm, 1, 1, m_ReadFileHandle);
-
-          sect->fileoffset = FileIO::ftell64(m_ReadFileHandle);
-
-          if(sect->flags & eSectionFlag_LZ4Compressed)
-          {
-            sect->compressedReader = new CompressedFileIO(m_ReadFileHandle);
-            FileIO::fread(&sect->size, 1, sizeof(uint64_t), m_ReadFileHandle);
-
-            sect->fileoffset += sizeof(uint64_t);
-          }
-
-          if(sect->type != eSectionType_Unknown && sect->type < eSectionType_Num)
-            m_KnownSections[sect->type] = sect;
-          m_Sections.push_back(sect);
-
-          // if section isn't frame capture data and is small enough, read it all into memory now,
-          // otherwise skip
-          if(sect->type != eSectionType_FrameCapture && sectionHeader.sectionLength < 4 * 1024 * 1024)
-          {
-            sect->data.resize(sectionHeader.sectionLength);
-            FileIO::fread(&sect->data[0], 1, sectionHeader.sectionLength, m_ReadFileHandle);
-          }
-          else
-          {
-            FileIO::fseek64(m_ReadFileHandle, sectionHeader.sectionLength, SEEK_CUR);
-          }
-        }
-        else
-        {
-          RETURNCORRUPT("Unrecognised section type '%hhx'", sectionHeader.isASCII);
-        }
+        m_ErrorCode = eSerError_Corrupt;
+        m_HasError = true;
+        return;
       }
     }
     else
@@ -899,6 +912,206 @@ Serialiser::Serialiser(const char *path, Mode mode, bool debugMode)
   }
 }
 
+bool Serialiser::ReadSectionTable(FILE *f, bool stopAtFrameCapture)
+{
+  while(!FileIO::feof(f))
+  {
+    BinarySectionHeader sectionHeader = {0};
+    byte *reading = (byte *)&sectionHeader;
+
+    ReadPartialFile(m_PartialFile, reading, 1, f);
+    reading++;
+
+    if(FileIO::feof(f))
+      break;
+
+    if(sectionHeader.isASCII == 'A')
+    {
+      // ASCII section
+      char c = 0;
+      ReadPartialFile(m_PartialFile, &c, 1, f);
+      if(c != '\n')
+      {
+        RDCERR("Invalid ASCII data section '%hhx'", c);
+        return false;
+      }
+
+      if(FileIO::feof(f))
+      {
+        RDCERR("Invalid truncated ASCII data section");
+        return false;
+      }
+
+      uint64_t length = 0;
+
+      c = '0';
+
+      while(!FileIO::feof(f) && c != '\n')
+      {
+        c = '0';
+        ReadPartialFile(m_PartialFile, &c, 1, f);
+
+        if(c == '\n')
+          break;
+
+        length *= 10;
+        length += int(c - '0');
+      }
+
+      if(FileIO::feof(f))
+      {
+        RDCERR("Invalid truncated ASCII data section");
+        return false;
+      }
+
+      union
+      {
+        uint32_t u32;
+        SectionType t;
+      } type;
+
+      type.u32 = 0;
+
+      c = '0';
+
+      while(!FileIO::feof(f) && c != '\n')
+      {
+        c = '0';
+        ReadPartialFile(m_PartialFile, &c, 1, f);
+
+        if(c == '\n')
+          break;
+
+        type.u32 *= 10;
+        type.u32 += int(c - '0');
+      }
+
+      if(FileIO::feof(f))
+      {
+        RDCERR("Invalid truncated ASCII data section");
+        return false;
+      }
+
+      string name;
+
+      c = 0;
+
+      while(!FileIO::feof(f) && c != '\n')
+      {
+        c = 0;
+        ReadPartialFile(m_PartialFile, &c, 1, f);
+
+        if(c == 0 || c == '\n')
+          break;
+
+        name.push_back(c);
+      }
+
+      if(FileIO::feof(f))
+      {
+        RDCERR("Invalid truncated ASCII data section");
+        return false;
+      }
+
+      Section *sect = new Section();
+      sect->flags = eSectionFlag_ASCIIStored;
+      sect->type = type.t;
+      sect->name = name;
+      sect->size = length;
+      sect->data.resize((size_t)length);
+      sect->fileoffset = FileIO::ftell64(f);
+
+      ReadPartialFile(m_PartialFile, &sect->data[0], (size_t)length, f);
+
+      if(sect->type != eSectionType_Unknown && sect->type < eSectionType_Num)
+        m_KnownSections[sect->type] = sect;
+      m_Sections.push_back(sect);
+    }
+    else if(sectionHeader.isASCII == 0x0)
+    {
+      ReadPartialFile(m_PartialFile, reading, offsetof(BinarySectionHeader, name) - 1, f);
+
+      Section *sect = new Section();
+      sect->flags = sectionHeader.sectionFlags;
+      sect->type = sectionHeader.sectionType;
+      sect->name.resize(sectionHeader.sectionNameLength - 1);
+      sect->size = sectionHeader.sectionLength;
+
+      ReadPartialFile(m_PartialFile, &sect->name[0], sectionHeader.sectionNameLength - 1, f);
+      char nullterm = 0;
+      ReadPartialFile(m_PartialFile, &nullterm, 1, f);
+
+      sect->fileoffset = FileIO::ftell64(f);
+
+      if(sect->flags & eSectionFlag_LZ4Compressed)
+      {
+        // only the frame capture is read through a decompressing reader, see ReadFromFile
+        if(sect->type == eSectionType_FrameCapture)
+          sect->compressedReader = new CompressedFileIO(f, m_PartialFile);
+        ReadPartialFile(m_PartialFile, &sect->size, sizeof(uint64_t), f);
+
+        sect->fileoffset += sizeof(uint64_t);
+      }
+
+      if(sect->type != eSectionType_Unknown && sect->type < eSectionType_Num)
+        m_KnownSections[sect->type] = sect;
+      m_Sections.push_back(sect);
+
+      // if section isn't frame capture data and is small enough, read it all into memory now,
+      // otherwise skip
+      if(sect->type != eSectionType_FrameCapture && sectionHeader.sectionLength < 4 * 1024 * 1024)
+      {
+        sect->data.resize(sectionHeader.sectionLength);
+        ReadPartialFile(m_PartialFile, &sect->data[0], sectionHeader.sectionLength, f);
+      }
+      else
+      {
+        FileIO::fseek64(f, sectionHeader.sectionLength, SEEK_CUR);
+      }
+
+      if(stopAtFrameCapture && sect->type == eSectionType_FrameCapture)
+      {
+        m_DeferredSectionsOffset = FileIO::ftell64(f);
+        if(m_PartialFile)
+          m_PartialFile->SetFrameCaptureEnd(m_DeferredSectionsOffset);
+        break;
+      }
+    }
+    else
+    {
+      RDCERR("Unrecognised section type '%hhx'", sectionHeader.isASCII);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void Serialiser::ReadDeferredSections()
+{
+  if(m_DeferredSectionsOffset == 0)
+    return;
+
+  uint64_t offset = m_DeferredSectionsOffset;
+  m_DeferredSectionsOffset = 0;
+
+  // the frame capture's file handle may have been closed already, so these are read through
+  // their own
+  FILE *f = FileIO::fopen(m_Filename.c_str(), "rb");
+
+  if(f == NULL)
+  {
+    RDCERR("Can't open capture file '%s' to read sections - errno %d", m_Filename.c_str(), errno);
+    return;
+  }
+
+  FileIO::fseek64(f, offset, SEEK_SET);
+
+  ReadSectionTable(f, false);
+
+  FileIO::fclose(f);
+}
+
 void Serialiser::Reset()
 {
   if(m_ResolverThread != 0)
@@ -937,6 +1150,8 @@ void Serialiser::Reset()
   m_AlignedData = false;
 
   m_ReadFileHandle = NULL;
+  m_PartialFile = NULL;
+  m_DeferredSectionsOffset = 0;
 
   m_ReadOffset = 0;
 
@@ -1096,7 +1311,7 @@ void Serialiser::ReadFromFile(uint64_t bufferOffs, size_t length)
   }
   else
   {
-    FileIO::fread(m_Buffer + bufferOffs, 1, length, m_ReadFileHandle);
+    ReadPartialFile(m_PartialFile, m_Buffer + bufferOffs, length, m_ReadFileHandle);
   }
 }
 
@@ -1236,6 +1451,8 @@ void Serialiser::SetOffset(uint64_t offs)
 
 void Serialiser::InitCallstackResolver()
 {
+  ReadDeferredSections();
+
   if(m_pResolver == NULL && m_ResolverThread == 0 &&
      m_KnownSections[eSectionType_ResolveDatabase] != NULL)
   {
@@ -1377,7 +1594,8 @@ void Serialiser::FlushToDisk()
         }
       }
 
-      fwriter.Write(chunk->GetData(), chunk->GetLength());
+      fwriter.Write(chunk->AcquireData(), chunk->GetLength());
+      chunk->ReleaseData();
 
       offs += chunk->GetLength();
 
@@ -1746,6 +1964,13 @@ void Serialiser::Insert(Chunk *chunk)
   m_DebugText += chunk->GetDebugString();
 }
 
+void Serialiser::InsertFront(Chunk *chunk)
+{
+  m_Chunks.insert(m_Chunks.begin(), chunk);
+
+  m_DebugText = chunk->GetDebugString() + m_DebugText;
+}
+
 void Serialiser::AlignNextBuffer(const size_t alignment)
 {
   // on new logs, we don't have to align. This code will be deleted once backwards-compat is dropped
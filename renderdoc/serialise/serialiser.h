@@ -97,7 +97,19 @@ public:
   ~Chunk();
 
   const char *GetDebugString() { return m_DebugStr.c_str(); }
-  byte *GetData() { return m_Data; }
+  // if the chunk is in the ChunkStore this takes it back out, as the pointer may be kept
+  byte *GetData()
+  {
+    if(m_Stored)
+      Unstore();
+    return m_Data;
+  }
+
+  // for reading a chunk's data without taking it out of the ChunkStore. The data stays resident
+  // until the matching ReleaseData().
+  byte *AcquireData();
+  void ReleaseData();
+
   uint32_t GetLength() { return m_Length; }
   uint32_t GetChunkType() { return m_ChunkType; }
   bool IsAligned() { return m_AlignedData; }
@@ -119,6 +131,9 @@ private:
   Chunk &operator=(const Chunk &);
 
   friend class ScopedContext;
+  friend class ChunkStore;
+
+  void Unstore();
 
   bool m_AlignedData;
   bool m_Temporary;
@@ -129,11 +144,65 @@ private:
   byte *m_Data;
   string m_DebugStr;
 
+  // ChunkStore bookkeeping. A stored chunk with NULL m_Data has been spilled to disk.
+  bool m_Stored;
+  int32_t m_DataRefs;
+  Chunk *m_StorePrev, *m_StoreNext;
+  uint64_t m_SpillOffset;
+  uint32_t m_SpillLength;
+
 #if !defined(RELEASE)
   static int64_t m_LiveChunks, m_MaxChunks, m_TotalMem;
 #endif
 };
 
+// a capture file that is still being written - e.g. received over the network - and can be read
+// before it's complete. While one is registered for a path, Serialisers that open that path for
+// reading wait for each part of the file they need to arrive instead of treating the end of what
+// is on disk as the end of the file. Sections after the frame capture are then read on demand.
+// If writing fails, the file reads as if it were truncated where the data stopped.
+class PartialCaptureFile
+{
+public:
+  PartialCaptureFile(const char *path);
+  ~PartialCaptureFile();
+
+  // called by the writer: with the total length once it's known, after each part of the file has
+  // been written and flushed, then once at the end
+  void Begin(uint64_t length);
+  void Advance(uint64_t length);
+  void Finish(bool success);
+
+  uint64_t GetLength() { return (uint64_t)Atomic::ExchAdd64(&m_Length, 0); }
+  // waits until the first 'end' bytes are on disk or the file is finished. Returns false if
+  // writing failed before getting that far
+  bool WaitFor(uint64_t end);
+  // waits until the file is finished, returns whether it was written successfully
+  bool WaitForComplete();
+
+  // where the frame capture section ends, noted by Serialisers reading the file. 0 until known
+  void SetFrameCaptureEnd(uint64_t end);
+  uint64_t GetFrameCaptureEnd() { return (uint64_t)Atomic::ExchAdd64(&m_FrameCaptureEnd, 0); }
+
+  // the file registered for a path, or NULL
+  static PartialCaptureFile *Find(const string &path);
+
+private:
+  // no copying
+  PartialCaptureFile(const PartialCaptureFile &);
+  PartialCaptureFile &operator=(const PartialCaptureFile &);
+
+  string m_Path;
+
+  volatile int64_t m_Length;
+  volatile int64_t m_Available;
+  volatile int64_t m_FrameCaptureEnd;
+  // 0 while writing, 1 once finished successfully, -1 if it failed
+  volatile int32_t m_State;
+
+  Threading::Semaphore m_Written;
+};
+
 // this class has a few functions. It can be used to serialise chunks - on writing it enforces
 // that we only ever write a single chunk, then pull out the data into a Chunk class and erase
 // the contents of the serialiser ready to serialise the next (see the RDCASSERT at the start
@@ -276,7 +345,11 @@ public:
   // assumes buffer head is sitting in a chunk (ie. immediately after a pushcontext)
   void SkipCurrentChunk() { ReadBytes(m_LastChunkLen); }
   void InitCallstackResolver();
-  bool HasCallstacks() { return m_KnownSections[eSectionType_ResolveDatabase] != NULL; }
+  bool HasCallstacks()
+  {
+    ReadDeferredSections();
+    return m_KnownSections[eSectionType_ResolveDatabase] != NULL;
+  }
   // get callstack resolver, created with the DB in the file
   Callstack::StackResolver *GetCallstackResolver() { return m_pResolver; }
   void SetCallstack(uint64_t *levels, size_t numLevels);
@@ -296,6 +369,9 @@ public:
 
   // Write a chunk to disk
   void Insert(Chunk *el);
+  // as Insert, but before any chunks already inserted. For data that's only ready once the rest of
+  // the capture has been serialised but has to come first in the file
+  void InsertFront(Chunk *el);
 
   // serialise a fixed-size array.
   template <int Num, class T>
@@ -563,6 +639,12 @@ private:
 
   void ReadFromFile(uint64_t bufferOffs, size_t length);
 
+  // reads section headers - and small sections' data - from f until the end of the file. If
+  // stopAtFrameCapture is set it stops after the frame capture section, leaving the rest for
+  // ReadDeferredSections(). Returns false if the file is corrupt
+  bool ReadSectionTable(FILE *f, bool stopAtFrameCapture);
+  void ReadDeferredSections();
+
   template <class T>
   void WriteFrom(const T &f)
   {
@@ -665,6 +747,11 @@ private:
   // the file pointer to read from
   FILE *m_ReadFileHandle;
 
+  // set when reading a file that's still being written
+  PartialCaptureFile *m_PartialFile;
+  // where the sections after the frame capture start, if they haven't been read yet
+  uint64_t m_DeferredSectionsOffset;
+
   // writing to file
   vector<Chunk *> m_Chunks;
 
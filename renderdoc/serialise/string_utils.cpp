@@ -47,6 +47,22 @@ uint32_t strhash(const char *str, uint32_t seed)
   return hash;
 }
 
+uint64_t strhash64(const char *str, uint64_t seed)
+{
+  if(str == NULL)
+    return seed;
+
+  uint64_t hash = seed;
+
+  do
+  {
+    hash ^= (uint8_t)*str;
+    hash *= 1099511628211ULL;
+  } while(*str++);
+
+  return hash;
+}
+
 string strlower(const string &str)
 {
   string newstr(str);
@@ -39,6 +39,10 @@ std::wstring strupper(const std::wstring &str);
 
 uint32_t strhash(const char *str, uint32_t existingHash = 5381);
 
+// 64-bit FNV-1a. The terminating NULL is hashed too, so chaining several strings doesn't
+// collide with a different split of the same characters.
+uint64_t strhash64(const char *str, uint64_t existingHash = 14695981039346656037ULL);
+
 template <class strType>
 strType basename(const strType &path)
 {
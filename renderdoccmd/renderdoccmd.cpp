@@ -141,6 +141,15 @@ int renderdoccmd(int argc, char **argv)
   opts.DelayForDebugger = 5;
   opts.HookIntoChildren = true;
 
+  // profile this run and anything it launches into a chrome trace. Can precede any command
+  if(argc >= 3 && (argequal(argv[1], "--profile") || argequal(argv[1], "-p")))
+  {
+    RENDERDOC_StartProfiling(argv[2]);
+
+    argc -= 2;
+    argv += 2;
+  }
+
   if(argc >= 2)
   {
     // fall through and print usage
@@ -161,6 +170,7 @@ int renderdoccmd(int argc, char **argv)
 
         ReplayRenderer_Shutdown(renderer);
       }
+      RENDERDOC_WriteProfileTrace();
       return 0;
     }
     // dump the image from a logfile
@@ -233,6 +243,7 @@ int renderdoccmd(int argc, char **argv)
 
           ReplayRenderer_Shutdown(renderer);
         }
+        RENDERDOC_WriteProfileTrace();
         return 0;
       }
       else
@@ -342,6 +353,7 @@ int renderdoccmd(int argc, char **argv)
 
           ReplayRenderer_Shutdown(renderer);
         }
+        RENDERDOC_WriteProfileTrace();
         return 0;
       }
       else
@@ -410,6 +422,12 @@ int renderdoccmd(int argc, char **argv)
   fprintf(
       stderr,
       "                                    window. Use the remote host to replay all commands.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr,
+          "  -p,  --profile TRACE.json ...     Profiles the following command and any program "
+          "it\n");
+  fprintf(stderr,
+          "                                    captures, writing a chrome://tracing trace.\n");
 
   return 1;
 }
@@ -27,6 +27,7 @@
 #include <locale.h>
 #include <replay/renderdoc_replay.h>
 #include <string.h>
+#include <X11/Xlib.h>
 #include <unistd.h>
 #include <xcb/xcb.h>
 #include <string>
@@ -152,6 +153,10 @@ int main(int argc, char *argv[])
 
   // do any linux-specific setup here
 
+  // the replay host loads captures for several clients on their own threads, which can open X
+  // displays concurrently for GL replay
+  XInitThreads();
+
   // process any linux-specific arguments here
 
   return renderdoccmd(argc, argv);
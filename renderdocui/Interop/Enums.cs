@@ -316,6 +316,19 @@ public enum ShaderStageType
         Count,
     };
 
+    [Flags]
+    public enum PipelineStateChanges
+    {
+        None         = 0x0,
+        Compute      = 0x1,
+        Graphics     = 0x2,
+        DynamicState = 0x4,
+        Pass         = 0x8,
+        Descriptors  = 0x10,
+        ImageLayouts = 0x20,
+        All          = 0x3f,
+    };
+
     [Flags]
     public enum ShaderStageBits
     {
@@ -476,6 +489,7 @@ public enum GPUCounters
         PSInvocations,
         RasterizedPrimitives,
         SamplesWritten,
+        EventCPUDuration,
 
         FirstAMD = 1000000,
 
@@ -504,6 +518,7 @@ public enum ReplayCreateStatus
         APIInitFailed,
         APIIncompatibleVersion,
         APIHardwareUnsupported,
+        NetworkRemoteBusy,
     };
 
     public enum RemoteMessageType
@@ -579,6 +594,7 @@ public static string Str(this ReplayCreateStatus status)
                 case ReplayCreateStatus.APIInitFailed: return "Replay API failed to initialise";
                 case ReplayCreateStatus.APIIncompatibleVersion: return "API-specific data used in logfile is of an incompatible version";
                 case ReplayCreateStatus.APIHardwareUnsupported: return "Your hardware or software configuration doesn't meet this API's minimum requirements";
+                case ReplayCreateStatus.NetworkRemoteBusy: return "Replay host is busy, try again later";
             }
 
             return "Unknown Error Code";
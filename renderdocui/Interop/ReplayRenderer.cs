@@ -216,6 +216,8 @@ public class ReplayRenderer
         private static extern bool ReplayRenderer_GetGLPipelineState(IntPtr real, IntPtr mem);
         [DllImport("renderdoc.dll", CharSet = CharSet.Unicode, CallingConvention = CallingConvention.Cdecl)]
         private static extern bool ReplayRenderer_GetVulkanPipelineState(IntPtr real, IntPtr mem);
+        [DllImport("renderdoc.dll", CharSet = CharSet.Unicode, CallingConvention = CallingConvention.Cdecl)]
+        private static extern bool ReplayRenderer_GetPipelineStateChanges(IntPtr real, ref UInt32 changes);
 
         [DllImport("renderdoc.dll", CharSet = CharSet.Unicode, CallingConvention = CallingConvention.Cdecl)]
         private static extern void ReplayRenderer_BuildCustomShader(IntPtr real, IntPtr entry, IntPtr source, UInt32 compileFlags, ShaderStageType type, ref ResourceId shaderID, IntPtr errorMem);
@@ -261,6 +263,10 @@ public class ReplayRenderer
 
         [DllImport("renderdoc.dll", CharSet = CharSet.Unicode, CallingConvention = CallingConvention.Cdecl)]
         private static extern bool ReplayRenderer_GetUsage(IntPtr real, ResourceId id, IntPtr outusage);
+        [DllImport("renderdoc.dll", CharSet = CharSet.Unicode, CallingConvention = CallingConvention.Cdecl)]
+        private static extern bool ReplayRenderer_GetUsageInRange(IntPtr real, ResourceId id, UInt32 startEID, UInt32 endEID, IntPtr outusage);
+        [DllImport("renderdoc.dll", CharSet = CharSet.Unicode, CallingConvention = CallingConvention.Cdecl)]
+        private static extern bool ReplayRenderer_GetResourcesUsedInRange(IntPtr real, UInt32 startEID, UInt32 endEID, bool writesOnly, IntPtr outresources);
 
         [DllImport("renderdoc.dll", CharSet = CharSet.Unicode, CallingConvention = CallingConvention.Cdecl)]
         private static extern bool ReplayRenderer_GetCBufferVariableContents(IntPtr real, ResourceId shader, IntPtr entryPoint, UInt32 cbufslot, ResourceId buffer, UInt64 offs, IntPtr outvars);
@@ -270,6 +276,8 @@ public class ReplayRenderer
 
         [DllImport("renderdoc.dll", CharSet = CharSet.Unicode, CallingConvention = CallingConvention.Cdecl)]
         private static extern bool ReplayRenderer_GetPostVSData(IntPtr real, UInt32 instID, MeshDataStage stage, IntPtr outdata);
+        [DllImport("renderdoc.dll", CharSet = CharSet.Unicode, CallingConvention = CallingConvention.Cdecl)]
+        private static extern bool ReplayRenderer_PrefetchPostVSData(IntPtr real, UInt32 startEID, UInt32 endEID);
 
         [DllImport("renderdoc.dll", CharSet = CharSet.Unicode, CallingConvention = CallingConvention.Cdecl)]
         private static extern bool ReplayRenderer_GetMinMax(IntPtr real, ResourceId tex, UInt32 sliceFace, UInt32 mip, UInt32 sample, IntPtr outminval, IntPtr outmaxval);
@@ -379,6 +387,16 @@ public VulkanPipelineState GetVulkanPipelineState()
             return ret;
         }
 
+        public PipelineStateChanges GetPipelineStateChanges()
+        {
+            UInt32 changes = 0;
+
+            if (!ReplayRenderer_GetPipelineStateChanges(m_Real, ref changes))
+                return PipelineStateChanges.All;
+
+            return (PipelineStateChanges)changes;
+        }
+
         public ResourceId BuildCustomShader(string entry, string source, UInt32 compileFlags, ShaderStageType type, out string errors)
         {
             IntPtr mem = CustomMarshal.Alloc(typeof(templated_array));
@@ -714,6 +732,38 @@ public EventUsage[] GetUsage(ResourceId id)
             return ret;
         }
 
+        public EventUsage[] GetUsageInRange(ResourceId id, UInt32 startEID, UInt32 endEID)
+        {
+            IntPtr mem = CustomMarshal.Alloc(typeof(templated_array));
+
+            bool success = ReplayRenderer_GetUsageInRange(m_Real, id, startEID, endEID, mem);
+
+            EventUsage[] ret = null;
+
+            if (success)
+                ret = (EventUsage[])CustomMarshal.GetTemplatedArray(mem, typeof(EventUsage), true);
+
+            CustomMarshal.Free(mem);
+
+            return ret;
+        }
+
+        public ResourceId[] GetResourcesUsedInRange(UInt32 startEID, UInt32 endEID, bool writesOnly)
+        {
+            IntPtr mem = CustomMarshal.Alloc(typeof(templated_array));
+
+            bool success = ReplayRenderer_GetResourcesUsedInRange(m_Real, startEID, endEID, writesOnly, mem);
+
+            ResourceId[] ret = null;
+
+            if (success)
+                ret = (ResourceId[])CustomMarshal.GetTemplatedArray(mem, typeof(ResourceId), true);
+
+            CustomMarshal.Free(mem);
+
+            return ret;
+        }
+
         public ShaderVariable[] GetCBufferVariableContents(ResourceId shader, string entryPoint, UInt32 cbufslot, ResourceId buffer, UInt64 offs)
         {
             IntPtr mem = CustomMarshal.Alloc(typeof(templated_array));
@@ -761,6 +811,9 @@ public MeshFormat GetPostVSData(UInt32 instID, MeshDataStage stage)
             return ret;
         }
 
+        public bool PrefetchPostVSData(UInt32 startEID, UInt32 endEID)
+        { return ReplayRenderer_PrefetchPostVSData(m_Real, startEID, endEID); }
+
         public bool GetMinMax(ResourceId tex, UInt32 sliceFace, UInt32 mip, UInt32 sample, out PixelValue minval, out PixelValue maxval)
         {
             IntPtr mem1 = CustomMarshal.Alloc(typeof(PixelValue));